@@ -0,0 +1,507 @@
+#include "backends.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+#include <iostream>
+
+#ifdef ENGINE_SOUND_WITH_JACK
+#include <jack/jack.h>
+#endif
+
+#ifdef _WIN32
+#include <atlbase.h>
+#include <Audioclient.h>
+#include <mmdeviceapi.h>
+
+#undef max
+#undef min
+
+inline void CHECK_HR(const HRESULT hr)
+{
+    if(FAILED(hr))
+    {
+        std::cout << std::hex << "0x" << hr << std::endl;
+        system("pause");
+        abort();
+    }
+}
+#endif
+
+bool populateAudioBuffer(
+    const Wave::SampleContainer& samples,
+    float* const audioBuffer,
+    const uint32_t bufferFrameCount,
+    const uint32_t channelCount)
+{
+    assert(samples.size() == bufferFrameCount * simSampleRateRatio);
+
+    // find the peak value and normalize in relation to that
+    SimT peakValue = 0.0001 * 1000.0;
+    const SimT normalizedPeakValue = 0.2;
+    /*for(auto val : samples)
+    {
+        val -= atmosphericPressure;
+        peakValue = std::max(peakValue, std::abs(val));
+    }*/
+    const SimT normalizationFactor = normalizedPeakValue / peakValue;
+
+    for(uint32_t frame = 0; frame < bufferFrameCount; frame++)
+    {
+        float* const samplePtr = audioBuffer + frame * channelCount;
+        for(uint32_t channel = 0; channel < channelCount; channel++)
+        {
+            samplePtr[channel] = static_cast<float>(
+                (samples[frame * simSampleRateRatio]) *
+                normalizationFactor);
+
+            if(samplePtr[channel] > normalizedPeakValue)
+                samplePtr[channel] = static_cast<float>(normalizedPeakValue);
+            if(samplePtr[channel] < -normalizedPeakValue)
+                samplePtr[channel] = -static_cast<float>(normalizedPeakValue);
+        }
+    }
+
+    return !std::isnormal(normalizationFactor);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+void PeriodClock::start(const SimT periodDuration)
+{
+    this->period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<SimT>(periodDuration));
+    this->nextWakeup = std::chrono::steady_clock::now();
+}
+
+bool PeriodClock::wait()
+{
+    this->nextWakeup += this->period;
+    const bool onTime = std::chrono::steady_clock::now() <= this->nextWakeup;
+    std::this_thread::sleep_until(this->nextWakeup);
+
+    return onTime;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+NullBackend::NullBackend(const uint32_t periodFrameCount, const bool paced) : paced(paced)
+{
+    this->periodFrameCount = periodFrameCount;
+}
+
+bool NullBackend::open(const AudioFormat& requestedFormat)
+{
+    this->format = requestedFormat;
+    this->buffer.resize(static_cast<size_t>(this->periodFrameCount) * this->format.channelCount);
+
+    return true;
+}
+
+void NullBackend::run(const RenderCallback& callback)
+{
+    this->clock.start(this->getPeriodDuration());
+
+    while(this->running)
+    {
+        callback(this->buffer.data(), this->periodFrameCount);
+
+        if(this->paced && !this->clock.wait())
+            this->underrunCount++;
+    }
+}
+
+void NullBackend::close()
+{
+    this->buffer.clear();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+WavFileBackend::WavFileBackend(
+    const std::string& path, const uint32_t periodFrameCount, const bool paced) :
+    path(path),
+    paced(paced)
+{
+    this->periodFrameCount = periodFrameCount;
+}
+
+bool WavFileBackend::open(const AudioFormat& requestedFormat)
+{
+    this->format = requestedFormat;
+    this->buffer.resize(static_cast<size_t>(this->periodFrameCount) * this->format.channelCount);
+    this->writtenFrameCount = 0;
+
+    this->file.open(this->path, std::ios::binary | std::ios::trunc);
+    if(!this->file)
+    {
+        std::cerr << "cannot open " << this->path << " for writing" << std::endl;
+        return false;
+    }
+
+    // sizes are zero until the file is closed
+    this->writeHeader();
+
+    return static_cast<bool>(this->file);
+}
+
+void WavFileBackend::run(const RenderCallback& callback)
+{
+    this->clock.start(this->getPeriodDuration());
+
+    while(this->running && this->file)
+    {
+        callback(this->buffer.data(), this->periodFrameCount);
+
+        this->file.write(reinterpret_cast<const char*>(this->buffer.data()),
+            this->buffer.size() * sizeof(float));
+        this->writtenFrameCount += this->periodFrameCount;
+
+        if(this->paced && !this->clock.wait())
+            this->underrunCount++;
+    }
+}
+
+void WavFileBackend::close()
+{
+    if(!this->file.is_open())
+        return;
+
+    this->file.seekp(0);
+    this->writeHeader();
+    this->file.close();
+    this->buffer.clear();
+}
+
+void WavFileBackend::writeHeader()
+{
+    const auto write = [this](const auto value)
+    {
+        this->file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    constexpr uint16_t formatIeeeFloat = 3;
+    const uint16_t blockAlign = static_cast<uint16_t>(this->format.channelCount * sizeof(float));
+    const uint64_t dataSize = this->writtenFrameCount * blockAlign;
+    // riff sizes are 32 bit; clamp instead of wrapping around so that the header stays sane
+    const uint32_t dataSize32 = static_cast<uint32_t>(std::min<uint64_t>(dataSize, 0xffffffffu - 36));
+
+    this->file.write("RIFF", 4);
+    write(static_cast<uint32_t>(36 + dataSize32));
+    this->file.write("WAVE", 4);
+
+    this->file.write("fmt ", 4);
+    write(static_cast<uint32_t>(16));
+    write(formatIeeeFloat);
+    write(static_cast<uint16_t>(this->format.channelCount));
+    write(static_cast<uint32_t>(this->format.sampleRate));
+    write(static_cast<uint32_t>(this->format.sampleRate * blockAlign));
+    write(blockAlign);
+    write(static_cast<uint16_t>(sizeof(float) * 8));
+
+    this->file.write("data", 4);
+    write(dataSize32);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+#ifdef ENGINE_SOUND_WITH_JACK
+
+JackBackend::JackBackend(const std::string& clientName) : clientName(clientName)
+{
+}
+
+JackBackend::~JackBackend()
+{
+    this->close();
+}
+
+bool JackBackend::open(const AudioFormat& requestedFormat)
+{
+    jack_status_t status;
+    this->client = jack_client_open(this->clientName.c_str(), JackNoStartServer, &status);
+    if(!this->client)
+    {
+        std::cerr << "cannot connect to the jack server, status 0x" <<
+            std::hex << status << std::dec << std::endl;
+        return false;
+    }
+
+    // the server dictates the rate and the period
+    this->format.sampleRate = jack_get_sample_rate(this->client);
+    this->format.channelCount = requestedFormat.channelCount;
+    this->periodFrameCount = jack_get_buffer_size(this->client);
+    this->buffer.resize(static_cast<size_t>(this->periodFrameCount) * this->format.channelCount);
+
+    for(uint32_t channel = 0; channel < this->format.channelCount; channel++)
+    {
+        const std::string portName = "out_" + std::to_string(channel + 1);
+        jack_port_t* port = jack_port_register(this->client, portName.c_str(),
+            JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+        if(!port)
+        {
+            std::cerr << "cannot register jack port " << portName << std::endl;
+            this->close();
+            return false;
+        }
+        this->ports.push_back(port);
+    }
+
+    if(jack_set_process_callback(this->client, &JackBackend::processCallback, this) != 0 ||
+        jack_set_xrun_callback(this->client, &JackBackend::xrunCallback, this) != 0)
+    {
+        this->close();
+        return false;
+    }
+
+    return true;
+}
+
+void JackBackend::run(const RenderCallback& callback)
+{
+    assert(this->client);
+
+    this->callback = &callback;
+    if(jack_activate(this->client) != 0)
+    {
+        std::cerr << "cannot activate the jack client" << std::endl;
+        this->callback = nullptr;
+        return;
+    }
+
+    // connect to the physical playback ports, if there are any
+    if(const char** playbackPorts = jack_get_ports(
+        this->client, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical | JackPortIsInput))
+    {
+        for(size_t i = 0; i < this->ports.size() && playbackPorts[i]; i++)
+            jack_connect(this->client, jack_port_name(this->ports[i]), playbackPorts[i]);
+        jack_free(playbackPorts);
+    }
+
+    // rendering happens in the jack process thread
+    while(this->running)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    jack_deactivate(this->client);
+    this->callback = nullptr;
+}
+
+void JackBackend::close()
+{
+    if(!this->client)
+        return;
+
+    jack_client_close(this->client);
+    this->client = nullptr;
+    this->ports.clear();
+    this->buffer.clear();
+}
+
+SimT JackBackend::getLatency() const
+{
+    if(!this->client || this->ports.empty())
+        return 0.0;
+
+    jack_latency_range_t range;
+    jack_port_get_latency_range(this->ports.front(), JackPlaybackLatency, &range);
+
+    return static_cast<SimT>(range.max + this->periodFrameCount) / this->format.sampleRate;
+}
+
+int JackBackend::processCallback(uint32_t frameCount, void* arg)
+{
+    JackBackend* backend = static_cast<JackBackend*>(arg);
+    const uint32_t channelCount = backend->format.channelCount;
+
+    // the buffer size can only grow in the non realtime thread, so output silence instead
+    const bool fits = frameCount * channelCount <= backend->buffer.size();
+    if(fits && backend->callback)
+        (*backend->callback)(backend->buffer.data(), frameCount);
+
+    for(uint32_t channel = 0; channel < channelCount; channel++)
+    {
+        float* const out = static_cast<float*>(
+            jack_port_get_buffer(backend->ports[channel], frameCount));
+        for(uint32_t frame = 0; frame < frameCount; frame++)
+            out[frame] = fits ? backend->buffer[frame * channelCount + channel] : 0.f;
+    }
+
+    return 0;
+}
+
+int JackBackend::xrunCallback(void* arg)
+{
+    static_cast<JackBackend*>(arg)->underrunCount++;
+    return 0;
+}
+
+#endif
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+#ifdef _WIN32
+
+WasapiBackend::~WasapiBackend()
+{
+    this->close();
+}
+
+bool WasapiBackend::open(const AudioFormat& /*requestedFormat*/)
+{
+    HRESULT hr = S_OK;
+    CComPtr<IMMDeviceEnumerator> enumerator;
+    CComPtr<IMMDevice> device;
+    REFERENCE_TIME defaultDevicePeriod, streamLatency;
+
+    CHECK_HR(hr = CoInitialize(nullptr));
+    this->comInitialized = true;
+
+    // create audio client
+    CHECK_HR(hr = CoCreateInstance(
+        __uuidof(MMDeviceEnumerator), nullptr,
+        CLSCTX_ALL, __uuidof(IMMDeviceEnumerator), (void**)&enumerator));
+    CHECK_HR(hr = enumerator->GetDefaultAudioEndpoint(eRender, eConsole, &device));
+    CHECK_HR(hr = device->Activate(
+        __uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)&this->audioClient));
+    CHECK_HR(hr = this->audioClient->GetMixFormat(&this->mixFormat));
+    CHECK_HR(hr = this->audioClient->Initialize(AUDCLNT_SHAREMODE_SHARED,
+        AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 0, 0, this->mixFormat, nullptr));
+    CHECK_HR(hr = this->audioClient->GetBufferSize(&this->bufferFrameCount));
+    CHECK_HR(hr = this->audioClient->GetDevicePeriod(&defaultDevicePeriod, nullptr));
+    CHECK_HR(hr = this->audioClient->GetStreamLatency(&streamLatency));
+
+    if(this->mixFormat->wBitsPerSample != 32)
+        CHECK_HR(hr = E_UNEXPECTED);
+
+    // the audio engine signals the event each time a period has been consumed
+    this->bufferEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if(!this->bufferEvent)
+        CHECK_HR(hr = HRESULT_FROM_WIN32(GetLastError()));
+    CHECK_HR(hr = this->audioClient->SetEventHandle(this->bufferEvent));
+
+    CHECK_HR(hr = this->audioClient->GetService(
+        __uuidof(IAudioRenderClient), (void**)&this->renderClient));
+
+    // the shared mode engine decides the format
+    this->format.sampleRate = this->mixFormat->nSamplesPerSec;
+    this->format.channelCount = this->mixFormat->nChannels;
+
+    // reference time is in 100 nanosecond units
+    constexpr SimT referenceTimeUnit = 1e-7;
+    this->periodFrameCount = std::min(this->bufferFrameCount, static_cast<uint32_t>(std::lround(
+        defaultDevicePeriod * referenceTimeUnit * this->format.sampleRate)));
+    this->latency = streamLatency * referenceTimeUnit +
+        static_cast<SimT>(this->bufferFrameCount) / this->format.sampleRate;
+
+    return true;
+}
+
+void WasapiBackend::run(const RenderCallback& callback)
+{
+    HRESULT hr = S_OK;
+
+    // set the initial buffer
+    this->renderPeriods(callback);
+    CHECK_HR(hr = this->audioClient->Start());
+    this->started = true;
+
+    while(this->running)
+    {
+        // a stalled device wakes the thread up so that stopping is still possible
+        constexpr DWORD timeoutMs = 200;
+        if(WaitForSingleObject(this->bufferEvent, timeoutMs) != WAIT_OBJECT_0)
+            continue;
+
+        this->renderPeriods(callback);
+    }
+
+    CHECK_HR(hr = this->audioClient->Stop());
+    this->started = false;
+}
+
+void WasapiBackend::close()
+{
+    if(this->renderClient)
+    {
+        this->renderClient->Release();
+        this->renderClient = nullptr;
+    }
+    if(this->audioClient)
+    {
+        this->audioClient->Release();
+        this->audioClient = nullptr;
+    }
+    if(this->bufferEvent)
+    {
+        CloseHandle(this->bufferEvent);
+        this->bufferEvent = nullptr;
+    }
+
+    CoTaskMemFree(this->mixFormat);
+    this->mixFormat = nullptr;
+
+    if(this->comInitialized)
+    {
+        CoUninitialize();
+        this->comInitialized = false;
+    }
+}
+
+void WasapiBackend::renderPeriods(const RenderCallback& callback)
+{
+    // debug flag
+    const DWORD force_silence = 0; AUDCLNT_BUFFERFLAGS_SILENT;
+    ///
+
+    HRESULT hr = S_OK;
+    UINT32 numFramesPadding;
+    BYTE* audioBuffer;
+
+    CHECK_HR(hr = this->audioClient->GetCurrentPadding(&numFramesPadding));
+
+    // the device has played everything that was written
+    if(numFramesPadding == 0 && this->started)
+        this->underrunCount++;
+
+    // the mix format is 32 bit float with no padding between the frames
+    assert(this->mixFormat->nBlockAlign == this->format.channelCount * sizeof(float));
+
+    UINT32 numFramesAvailable = this->bufferFrameCount - numFramesPadding;
+    while(numFramesAvailable >= this->periodFrameCount)
+    {
+        CHECK_HR(hr = this->renderClient->GetBuffer(this->periodFrameCount, &audioBuffer));
+
+        const bool silence = callback(reinterpret_cast<float*>(audioBuffer), this->periodFrameCount);
+        const DWORD flags = silence ? AUDCLNT_BUFFERFLAGS_SILENT : 0;
+
+        CHECK_HR(hr = this->renderClient->ReleaseBuffer(
+            this->periodFrameCount, flags | force_silence));
+
+        numFramesAvailable -= this->periodFrameCount;
+    }
+}
+
+#endif
\ No newline at end of file
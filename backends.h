@@ -0,0 +1,227 @@
+#pragma once
+#include "wave.h"
+#include <functional>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+// TODO: this is somewhat broken
+constexpr int simSampleRateRatio = 1;
+
+// output format negotiated between the simulation and an audio backend;
+// samples are always interleaved 32 bit floats
+struct AudioFormat
+{
+    uint32_t sampleRate = 48000;
+    uint32_t channelCount = 2;
+};
+
+// converts the simulated pressure samples to interleaved device samples;
+// returns if the buffer is just silence
+bool populateAudioBuffer(
+    const Wave::SampleContainer& samples,
+    float* const audioBuffer,
+    const uint32_t bufferFrameCount,
+    const uint32_t channelCount);
+
+// audio output device that pulls the rendered audio from a callback in fixed size periods;
+// the render thread sleeps until the device wakes it up for the next period;
+// open -> run -> close are called from the same thread, stop can be called from any thread
+class AudioBackend
+{
+public:
+    // fills frameCount interleaved frames to buffer;
+    // returns if the buffer is just silence
+    using RenderCallback = std::function<bool(float* buffer, uint32_t frameCount)>;
+public:
+    virtual ~AudioBackend() = default;
+
+    // negotiates the format with the device; the actual format is returned by getFormat;
+    // returns false if the device couldn't be opened
+    virtual bool open(const AudioFormat& requestedFormat) = 0;
+    // pulls audio from the callback until stop is called;
+    // blocks the calling thread
+    virtual void run(const RenderCallback& callback) = 0;
+    virtual void close() = 0;
+    void stop() { this->running = false; }
+    bool isRunning() const { return this->running; }
+
+    virtual const char* getName() const = 0;
+    // false if the callback is called from a thread owned by the device
+    virtual bool rendersOnCallingThread() const { return true; }
+    const AudioFormat& getFormat() const { return this->format; }
+    // amount of frames requested per callback
+    uint32_t getPeriodFrameCount() const { return this->periodFrameCount; }
+    SimT getPeriodDuration() const
+    { return static_cast<SimT>(this->periodFrameCount) / this->format.sampleRate; }
+    // time in seconds from the render callback to the audio reaching the output
+    virtual SimT getLatency() const = 0;
+    // times the device ran out of audio
+    uint64_t getUnderrunCount() const { return this->underrunCount; }
+protected:
+    AudioFormat format;
+    uint32_t periodFrameCount = 0;
+    std::atomic_bool running = true;
+    std::atomic<uint64_t> underrunCount = 0;
+};
+
+// wakes up the render thread once per period against the steady clock;
+// used by the backends that don't have a device clock
+class PeriodClock
+{
+public:
+    void start(const SimT periodDuration);
+    // sleeps until the start of the next period;
+    // a late wakeup doesn't shift the following periods;
+    // returns false if the next period had already started, which is an underrun
+    bool wait();
+private:
+    std::chrono::steady_clock::time_point nextWakeup;
+    std::chrono::steady_clock::duration period;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+// discards the rendered audio;
+// renders as fast as the simulation runs unless paced to realtime
+class NullBackend final : public AudioBackend
+{
+public:
+    static constexpr uint32_t defaultPeriodFrameCount = 480;
+public:
+    explicit NullBackend(
+        const uint32_t periodFrameCount = defaultPeriodFrameCount, const bool paced = false);
+
+    bool open(const AudioFormat& requestedFormat) override;
+    void run(const RenderCallback& callback) override;
+    void close() override;
+
+    const char* getName() const override { return "null"; }
+    SimT getLatency() const override { return this->getPeriodDuration(); }
+private:
+    std::vector<float> buffer;
+    PeriodClock clock;
+    bool paced;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+// streams the rendered audio to a 32 bit float wav file;
+// the header sizes are patched when the file is closed;
+// renders as fast as the simulation runs unless paced to realtime
+class WavFileBackend final : public AudioBackend
+{
+public:
+    static constexpr uint32_t defaultPeriodFrameCount = 4096;
+public:
+    explicit WavFileBackend(const std::string& path,
+        const uint32_t periodFrameCount = defaultPeriodFrameCount, const bool paced = false);
+
+    bool open(const AudioFormat& requestedFormat) override;
+    void run(const RenderCallback& callback) override;
+    void close() override;
+
+    const char* getName() const override { return "wav"; }
+    SimT getLatency() const override { return this->getPeriodDuration(); }
+    uint64_t getWrittenFrameCount() const { return this->writtenFrameCount; }
+private:
+    std::string path;
+    std::ofstream file;
+    std::vector<float> buffer;
+    uint64_t writtenFrameCount = 0;
+    PeriodClock clock;
+    bool paced;
+
+    void writeHeader();
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+#ifdef ENGINE_SOUND_WITH_JACK
+
+typedef struct _jack_client jack_client_t;
+typedef struct _jack_port jack_port_t;
+
+// jack client that connects its output ports to the physical playback ports;
+// the sampling rate and the period are dictated by the jack server
+class JackBackend final : public AudioBackend
+{
+public:
+    explicit JackBackend(const std::string& clientName = "engine sound");
+    ~JackBackend();
+
+    bool open(const AudioFormat& requestedFormat) override;
+    void run(const RenderCallback& callback) override;
+    void close() override;
+
+    const char* getName() const override { return "jack"; }
+    bool rendersOnCallingThread() const override { return false; }
+    SimT getLatency() const override;
+private:
+    std::string clientName;
+    jack_client_t* client = nullptr;
+    std::vector<jack_port_t*> ports;
+    std::vector<float> buffer;
+    const RenderCallback* callback = nullptr;
+
+    static int processCallback(uint32_t frameCount, void* arg);
+    static int xrunCallback(void* arg);
+};
+
+#endif
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+#ifdef _WIN32
+
+struct IAudioClient;
+struct IAudioRenderClient;
+struct tWAVEFORMATEX;
+
+// event driven shared mode wasapi client on the default render endpoint;
+// the format is the mix format of the device and the period is the default device period
+class WasapiBackend final : public AudioBackend
+{
+public:
+    WasapiBackend() = default;
+    ~WasapiBackend();
+
+    bool open(const AudioFormat& requestedFormat) override;
+    void run(const RenderCallback& callback) override;
+    void close() override;
+
+    const char* getName() const override { return "wasapi"; }
+    SimT getLatency() const override { return this->latency; }
+private:
+    IAudioClient* audioClient = nullptr;
+    IAudioRenderClient* renderClient = nullptr;
+    void* bufferEvent = nullptr;
+    tWAVEFORMATEX* mixFormat = nullptr;
+    uint32_t bufferFrameCount = 0;
+    SimT latency = 0.0;
+    bool comInitialized = false, started = false;
+
+    // renders as many whole periods as there is space in the device buffer
+    void renderPeriods(const RenderCallback& callback);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "batch.h"
+#include "simulators.h"
+#include "trace.h"
+#include <cmath>
+#include <numbers>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+
+constexpr size_t laneCount = BatchSimulation::laneCount;
+using Sample = BatchSimulation::Sample;
+
+// one sample of every lane;
+// the first rows of incident and returning are the previous sample
+void progressLanes(Sample* __restrict cosines, Sample* __restrict sines,
+    const Sample* __restrict stepCosineDeltas, const Sample* __restrict stepSines,
+    const Sample* __restrict amplitudes, const Sample* __restrict gains,
+    const Sample* __restrict losses,
+    const Sample* __restrict incident, const Sample* __restrict returning,
+    Sample* __restrict forward, Sample* __restrict radiated)
+{
+    for(size_t lane = 0; lane < laneCount; lane++)
+    {
+        const Sample cosine = cosines[lane] +
+            (cosines[lane] * stepCosineDeltas[lane] - sines[lane] * stepSines[lane]);
+        sines[lane] += cosines[lane] * stepSines[lane] + sines[lane] * stepCosineDeltas[lane];
+        cosines[lane] = cosine;
+
+        const Sample returning1 = returning[lane], returning0 = returning[lane + laneCount];
+        const Sample reflected = -gains[lane] * (returning0 - returning1) - returning1;
+        forward[lane] = amplitudes[lane] * sines[lane] + losses[lane] * reflected;
+
+        radiated[lane] = -gains[lane] * (incident[lane + laneCount] - incident[lane]);
+    }
+}
+
+}
+
+BatchSimulation::BatchSimulation(const SimT samplingRate, const size_t instanceCount) :
+    samplingRate(samplingRate),
+    instanceCount(instanceCount),
+    groups((instanceCount + laneCount - 1) / laneCount)
+{
+    assert(instanceCount > 0);
+
+    // the oldest read is 2D + 1 samples back
+    const SimT sampleLength = Wave::getLength(1.0, 1.0 / samplingRate);
+    const size_t maxDelay = static_cast<size_t>(std::ceil(
+        (maxPipeLengthPhysical + endCorrectionFactor * maxPipeRadius) / sampleLength));
+    while(this->capacity < 2 * maxDelay + 2)
+        this->capacity <<= 1;
+    this->delayLines.assign(this->groups.size() * laneCount * this->capacity, 0.0f);
+
+    // the silent lanes of the last group run the default engine without excitation
+    for(size_t instance = 0; instance < this->groups.size() * laneCount; instance++)
+    {
+        this->setFrequency(instance, Cylinder::startFrequency);
+        this->setAmplitude(instance, instance < instanceCount ? 0.02 : 0.0);
+        this->setPipe(instance, Pipe::startPipeLengthPhysicalCm / 100.0,
+            Pipe::startPipeRadiusCm / 100.0, Pipe::startEchoIterations);
+    }
+    this->reset();
+}
+
+void BatchSimulation::setFrequency(const size_t instance, const SimT frequency)
+{
+    Group& group = this->groups[instance / laneCount];
+    const size_t lane = instance % laneCount;
+
+    const SimT step = 2.0 * std::numbers::pi * frequency / this->samplingRate;
+    group.phaseSteps[lane] = step;
+    group.stepCosineDeltas[lane] = static_cast<Sample>(-2.0 * std::sin(0.5 * step) * std::sin(0.5 * step));
+    group.stepSines[lane] = static_cast<Sample>(std::sin(step));
+}
+
+void BatchSimulation::setAmplitude(const size_t instance, const SimT amplitude)
+{
+    this->groups[instance / laneCount].amplitudes[instance % laneCount] =
+        static_cast<Sample>(amplitude);
+}
+
+void BatchSimulation::setPipe(const size_t instance, const SimT pipeLengthPhysical,
+    const SimT pipeRadius, const size_t echoIterations)
+{
+    assert(pipeLengthPhysical > 0.0 && pipeLengthPhysical <= maxPipeLengthPhysical);
+    assert(pipeRadius > 0.0 && pipeRadius <= maxPipeRadius);
+
+    Group& group = this->groups[instance / laneCount];
+    const size_t lane = instance % laneCount;
+
+    const DelayLinePipe::Loop loop =
+        DelayLinePipe::getLoop(this->samplingRate, pipeLengthPhysical, pipeRadius, echoIterations);
+    group.loops[lane] = loop;
+    group.returnDelays[lane] = static_cast<size_t>(std::max<SimT>(1.0, std::round(2.0 * loop.exactDelay)));
+    group.gains[lane] = static_cast<Sample>(loop.radiationGain);
+    group.losses[lane] = static_cast<Sample>(loop.loss);
+
+    group.minDelay = group.loops[0].delay;
+    for(size_t i = 1; i < laneCount; i++)
+        group.minDelay = std::min(group.minDelay, group.loops[i].delay);
+}
+
+const DelayLinePipe::Loop& BatchSimulation::getLoop(const size_t instance) const
+{
+    return this->groups[instance / laneCount].loops[instance % laneCount];
+}
+
+void BatchSimulation::reset()
+{
+    for(auto& group : this->groups)
+    {
+        std::fill(std::begin(group.phases), std::end(group.phases), 0.0);
+        group.position = 0;
+    }
+    std::fill(this->delayLines.begin(), this->delayLines.end(), 0.0f);
+}
+
+void BatchSimulation::progressSimulation(const size_t sampleCount)
+{
+    TRACE_SCOPE("BatchSimulation::progressSimulation");
+
+    this->outputSampleCount = sampleCount;
+    this->outputs.resize(this->instanceCount * sampleCount);
+
+    for(size_t groupIndex = 0; groupIndex < this->groups.size(); groupIndex++)
+    {
+        Group& group = this->groups[groupIndex];
+        for(size_t lane = 0; lane < laneCount; lane++)
+        {
+            group.cosines[lane] = static_cast<Sample>(std::cos(group.phases[lane]));
+            group.sines[lane] = static_cast<Sample>(std::sin(group.phases[lane]));
+            group.phases[lane] = std::fmod(group.phases[lane] + group.phaseSteps[lane] * sampleCount,
+                2.0 * std::numbers::pi);
+        }
+
+        const size_t blockSize = std::min(maxBlockSize, group.minDelay);
+        for(size_t first = 0; first < sampleCount; first += blockSize)
+            this->progressGroup(groupIndex, first, std::min(blockSize, sampleCount - first));
+    }
+}
+
+void BatchSimulation::progressGroup(const size_t groupIndex, const size_t firstSample,
+    const size_t blockSize)
+{
+    Group& group = this->groups[groupIndex];
+    assert(blockSize <= group.minDelay && blockSize <= maxBlockSize);
+
+    const size_t mask = this->capacity - 1;
+    const size_t firstInstance = groupIndex * laneCount;
+
+    // the block only reads samples that were written before it, so the delay lines are
+    // gathered to sample major rows first
+    for(size_t lane = 0; lane < laneCount; lane++)
+    {
+        const Sample* const delayLine = this->getDelayLine(firstInstance + lane);
+        const size_t delay = group.loops[lane].delay, returnDelay = group.returnDelays[lane];
+        for(size_t i = 0; i <= blockSize; i++)
+        {
+            group.incident[i * laneCount + lane] =
+                delayLine[(group.position + i - 1 - delay) & mask];
+            group.returning[i * laneCount + lane] =
+                delayLine[(group.position + i - 1 - returnDelay) & mask];
+        }
+    }
+
+    // lockstep part; the lanes are independent and the samples of the block don't feed each other
+    for(size_t i = 0; i < blockSize; i++)
+    {
+        progressLanes(group.cosines, group.sines, group.stepCosineDeltas, group.stepSines,
+            group.amplitudes, group.gains, group.losses,
+            group.incident + i * laneCount, group.returning + i * laneCount,
+            group.forward + i * laneCount, group.radiated + i * laneCount);
+    }
+
+    // scattered back to the lanes
+    for(size_t lane = 0; lane < laneCount; lane++)
+    {
+        Sample* const delayLine = this->getDelayLine(firstInstance + lane);
+        for(size_t i = 0; i < blockSize; i++)
+            delayLine[(group.position + i) & mask] = group.forward[i * laneCount + lane];
+
+        if(firstInstance + lane < this->instanceCount)
+        {
+            Sample* const output = this->outputs.data() +
+                (firstInstance + lane) * this->outputSampleCount + firstSample;
+            for(size_t i = 0; i < blockSize; i++)
+                output[i] = group.radiated[i * laneCount + lane];
+        }
+    }
+
+    group.position += blockSize;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+#include "wave.h"
+#include "delayline.h"
+#include <vector>
+
+// many independent engines rendered in lockstep, one engine per simd lane;
+// every engine is a sine cylinder into a DelayLinePipe with its own frequency, amplitude and
+// pipe, in float precision;
+// the delays are read in whole samples, so the engines match the DelayLinePipe of fractional
+// delay order 0;
+// the engines are grouped by lane count, a group advances all of its engines with one pass of
+// vector instructions (two avx2 or one avx-512 register of floats)
+class BatchSimulation
+{
+public:
+    using Sample = float;
+    static constexpr size_t laneCount = 16;
+    // delays of a group are read in blocks of at most the shortest delay
+    static constexpr size_t maxBlockSize = 256;
+    // the delay lines are allocated for the longest pipe
+    static constexpr SimT maxPipeLengthPhysical = 4.0, maxPipeRadius = 0.1;
+public:
+    const SimT samplingRate;
+
+    BatchSimulation(const SimT samplingRate, const size_t instanceCount);
+
+    size_t getInstanceCount() const { return this->instanceCount; }
+    void setFrequency(const size_t instance, const SimT frequency);
+    void setAmplitude(const size_t instance, const SimT amplitude);
+    // same parameters as in Pipe; the contents of the delay line are kept
+    void setPipe(const size_t instance, const SimT pipeLengthPhysical, const SimT pipeRadius,
+        const size_t echoIterations);
+    const DelayLinePipe::Loop& getLoop(const size_t instance) const;
+
+    // renders sample count samples of every engine
+    void progressSimulation(const size_t sampleCount);
+    // radiated pressure of the last progress
+    const Sample* getOutput(const size_t instance) const
+    { return this->outputs.data() + instance * this->outputSampleCount; }
+
+    void reset();
+private:
+    struct alignas(64) Group
+    {
+        // oscillators as rotating phasors, restarted from the phase in double precision
+        // at every progress;
+        // the rotation uses cos - 1 of the step, which keeps its precision in float
+        SimT phases[laneCount], phaseSteps[laneCount];
+        Sample cosines[laneCount], sines[laneCount];
+        Sample stepCosineDeltas[laneCount], stepSines[laneCount];
+        Sample amplitudes[laneCount];
+        Sample gains[laneCount], losses[laneCount];
+        DelayLinePipe::Loop loops[laneCount];
+        // the return is rounded from 2D, not doubled from the rounded D
+        size_t returnDelays[laneCount];
+        size_t minDelay = 1, position = 0;
+
+        // block of delayed waves, sample major;
+        // the first row is the sample before the block
+        Sample incident[(maxBlockSize + 1) * laneCount];
+        Sample returning[(maxBlockSize + 1) * laneCount];
+        Sample forward[maxBlockSize * laneCount];
+        Sample radiated[maxBlockSize * laneCount];
+    };
+
+    const size_t instanceCount;
+    std::vector<Group> groups;
+    // lane major delay lines of the forward waves, including the silent lanes of the last group;
+    // the lanes of a group share the position
+    std::vector<Sample> delayLines;
+    size_t capacity = 1;
+    std::vector<Sample> outputs;
+    size_t outputSampleCount = 0;
+
+    Sample* getDelayLine(const size_t instance)
+    { return this->delayLines.data() + instance * this->capacity; }
+
+    void progressGroup(const size_t groupIndex, const size_t firstSample, const size_t blockSize);
+};
\ No newline at end of file
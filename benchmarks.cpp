@@ -0,0 +1,2080 @@
+#include "benchmarks.h"
+#include "simulation.h"
+#include "batch.h"
+#include "voices.h"
+#include "fft.h"
+#include "vehiclelog.h"
+#include <vector>
+#include <complex>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <fstream>
+#include <filesystem>
+#include <numbers>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cstdlib>
+
+#include <iostream>
+#include <iomanip>
+
+namespace
+{
+
+constexpr SimT benchSamplingRate = 48000.0;
+constexpr size_t benchBlockSize = 480;
+
+// renders duration seconds of the simulation in blocks;
+// returns the wall time in seconds per second of audio
+SimT measureRenderTime(Simulation& simulation, const SimT duration,
+    std::vector<SimT>* const output = nullptr,
+    const std::function<void(Wave&)>& excite = {})
+{
+    const size_t blockCount = static_cast<size_t>(duration * simulation.samplingRate / benchBlockSize);
+    if(output)
+        output->reserve(output->size() + blockCount * benchBlockSize);
+
+    const auto start = std::chrono::steady_clock::now();
+    for(size_t block = 0; block < blockCount; block++)
+    {
+        const Wave* wave;
+        if(excite)
+        {
+            excite(simulation.cylinder.currentOutWave);
+            wave = &simulation.progressPipe(static_cast<SimT>(benchBlockSize));
+        }
+        else
+            wave = &simulation.progressSimulation(static_cast<SimT>(benchBlockSize));
+
+        if(output)
+            output->insert(output->end(), wave->samples.begin(), wave->samples.end());
+    }
+    const SimT elapsed =
+        std::chrono::duration<SimT>(std::chrono::steady_clock::now() - start).count();
+
+    return elapsed / duration;
+}
+
+// welch averaged power spectrum with a hann window;
+// a signal shorter than the fft has no frames and gives a spectrum of nans, not of silence
+std::vector<SimT> getPowerSpectrum(const std::vector<SimT>& signal, const size_t fftSize)
+{
+    std::vector<SimT> spectrum(fftSize / 2 + 1, 0.0);
+    std::vector<std::complex<SimT>> frame(fftSize);
+
+    size_t frameCount = 0;
+    for(size_t offset = 0; offset + fftSize <= signal.size(); offset += fftSize / 2, frameCount++)
+    {
+        for(size_t i = 0; i < fftSize; i++)
+        {
+            const SimT window = 0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * i / fftSize);
+            frame[i] = signal[offset + i] * window;
+        }
+        fft(frame);
+        for(size_t i = 0; i < spectrum.size(); i++)
+            spectrum[i] += std::norm(frame[i]);
+    }
+
+    for(auto& power : spectrum)
+        power = frameCount > 0 ? power / static_cast<SimT>(frameCount) : std::numeric_limits<SimT>::quiet_NaN();
+
+    return spectrum;
+}
+
+struct SpectralError
+{
+    // rms level difference over the band
+    SimT broadbandDb = 0.0;
+    // rms differences of the resonance peaks
+    SimT peakLevelDb = 0.0, peakFrequencyCents = 0.0;
+};
+
+// compares the test spectrum to the reference spectrum between the frequencies;
+// the errors are nan if the signals are too short for a frame of the fft;
+// bins more than 60 db below the reference peak are left out of the broadband error;
+// the peaks are searched within 3 % of the given resonance frequencies
+SpectralError getSpectralError(const std::vector<SimT>& reference, const std::vector<SimT>& test,
+    const SimT samplingRate, const SimT minFrequency, const SimT maxFrequency,
+    const std::vector<SimT>& resonanceFrequencies)
+{
+    const size_t fftSize = 32768;
+    const std::vector<SimT> referenceSpectrum = getPowerSpectrum(reference, fftSize);
+    const std::vector<SimT> testSpectrum = getPowerSpectrum(test, fftSize);
+    const SimT binWidth = samplingRate / fftSize;
+    const auto toDb = [](const SimT power) { return 10.0 * std::log10(std::max(power, 1e-30)); };
+
+    SpectralError error;
+    if(std::isnan(referenceSpectrum[0]) || std::isnan(testSpectrum[0]))
+    {
+        error.broadbandDb = error.peakLevelDb = error.peakFrequencyCents = std::numeric_limits<SimT>::quiet_NaN();
+        return error;
+    }
+
+    const SimT floor = *std::max_element(referenceSpectrum.begin(), referenceSpectrum.end()) * 1e-6;
+    SimT squareSum = 0.0;
+    size_t count = 0;
+    for(size_t i = 0; i < referenceSpectrum.size(); i++)
+    {
+        const SimT frequency = i * binWidth;
+        if(frequency < minFrequency || frequency > maxFrequency || referenceSpectrum[i] < floor)
+            continue;
+
+        const SimT difference = toDb(testSpectrum[i]) - toDb(referenceSpectrum[i]);
+        squareSum += difference * difference;
+        count++;
+    }
+    error.broadbandDb = count ? std::sqrt(squareSum / count) : 0.0;
+
+    SimT levelSquareSum = 0.0, centsSquareSum = 0.0;
+    count = 0;
+    for(const SimT frequency : resonanceFrequencies)
+    {
+        if(frequency < minFrequency || frequency > maxFrequency)
+            continue;
+
+        const auto findPeak = [&](const std::vector<SimT>& spectrum)
+        {
+            const size_t first = static_cast<size_t>(frequency * 0.97 / binWidth);
+            const size_t last = std::min(spectrum.size() - 1,
+                static_cast<size_t>(frequency * 1.03 / binWidth));
+            return static_cast<size_t>(std::max_element(
+                spectrum.begin() + first, spectrum.begin() + last + 1) - spectrum.begin());
+        };
+        const size_t referencePeak = findPeak(referenceSpectrum);
+        const size_t testPeak = findPeak(testSpectrum);
+
+        const SimT levelDifference =
+            toDb(testSpectrum[testPeak]) - toDb(referenceSpectrum[referencePeak]);
+        const SimT cents = 1200.0 * std::log2(
+            std::max<SimT>(testPeak, 1) / std::max<SimT>(referencePeak, 1));
+        levelSquareSum += levelDifference * levelDifference;
+        centsSquareSum += cents * cents;
+        count++;
+    }
+    if(count)
+    {
+        error.peakLevelDb = std::sqrt(levelSquareSum / count);
+        error.peakFrequencyCents = std::sqrt(centsSquareSum / count);
+    }
+
+    return error;
+}
+
+// excitation that covers the whole spectrum
+std::function<void(Wave&)> makeNoiseExcitation(std::mt19937& generator)
+{
+    return [&generator](Wave& wave)
+    {
+        // same level as the default amplitude of the cylinder
+        std::normal_distribution<SimT> distribution(0.0, 0.02);
+        wave.samples.resize(benchBlockSize);
+        for(auto& sample : wave.samples)
+            sample = distribution(generator);
+    };
+}
+
+// renders duration seconds of noise through the pipe after a warmup;
+// returns the wall time in seconds per second of audio
+SimT renderNoise(const std::function<void(Simulation&)>& configure, const SimT duration,
+    std::vector<SimT>& output)
+{
+    const SimT warmup = 1.0;
+
+    std::mt19937 generator{1234};
+    Simulation simulation{benchSamplingRate};
+    configure(simulation);
+
+    const auto excite = makeNoiseExcitation(generator);
+    measureRenderTime(simulation, warmup, nullptr, excite);
+    return measureRenderTime(simulation, duration, &output, excite);
+}
+
+void printEngineHeader()
+{
+    std::cout << std::setw(16) << std::left << "engine" << std::right <<
+        std::setw(13) << "cpu/audio %" << std::setw(11) << "rt factor" <<
+        std::setw(14) << "broadband db" << std::setw(11) << "peak db" <<
+        std::setw(13) << "peak cents" << std::endl;
+}
+
+void printEngineResult(const std::string& name, const SimT time, const SpectralError& error)
+{
+    std::cout << std::setw(16) << std::left << name << std::right << std::fixed <<
+        std::setprecision(3) << std::setw(13) << time * 100.0 <<
+        std::setprecision(1) << std::setw(11) << 1.0 / time;
+    if(std::isnan(error.broadbandDb))
+        std::cout << std::setw(14) << "n/a" << std::setw(11) << "n/a" << std::setw(13) << "n/a" << std::endl;
+    else
+        std::cout << std::setprecision(2) << std::setw(14) << error.broadbandDb <<
+            std::setw(11) << error.peakLevelDb <<
+            std::setprecision(1) << std::setw(13) << error.peakFrequencyCents << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
+
+// resonances of the default geometry up to the frequency
+std::vector<SimT> getResonanceFrequencies(const SimT maxFrequency)
+{
+    Simulation geometry{benchSamplingRate};
+    std::vector<SimT> resonanceFrequencies;
+    for(size_t mode = 0; geometry.modalPipe.getModeFrequency(mode) < maxFrequency; mode++)
+        resonanceFrequencies.push_back(geometry.modalPipe.getModeFrequency(mode));
+
+    return resonanceFrequencies;
+}
+
+// modal engine against the echo model for cpu and spectral error
+int benchmarkModal(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+    const SimT minFrequency = 50.0, maxFrequency = 16000.0;
+
+    std::cout << "modal engine vs echo model, " << duration << " s of noise excitation, " <<
+        benchSamplingRate << " hz, " << benchBlockSize << " sample blocks" << std::endl;
+    std::cout << "errors are rms over " << minFrequency << " - " << maxFrequency <<
+        " hz, or up to the highest mode" << std::endl;
+    printEngineHeader();
+
+    const std::vector<SimT> resonanceFrequencies = getResonanceFrequencies(maxFrequency);
+
+    std::vector<SimT> reference;
+    const SimT referenceTime = renderNoise([](Simulation&) {}, duration, reference);
+    printEngineResult("echo " + std::to_string(Pipe::startEchoIterations), referenceTime, {});
+
+    for(const size_t echoIterations : {25, 50, 200})
+    {
+        std::vector<SimT> output;
+        const SimT time = renderNoise([echoIterations](Simulation& simulation)
+        {
+            simulation.pipe.setEchoIterationsAndReset(echoIterations);
+        }, duration, output);
+        printEngineResult("echo " + std::to_string(echoIterations), time, getSpectralError(
+            reference, output, benchSamplingRate, minFrequency, maxFrequency, resonanceFrequencies));
+    }
+
+    for(const size_t modeCount : {4, 8, 16, 32, 64, 128})
+    {
+        std::vector<SimT> output;
+        const SimT time = renderNoise([modeCount](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::Modal);
+            simulation.modalPipe.setModeCount(modeCount);
+        }, duration, output);
+
+        // the error is measured over the band that the modes cover
+        const SimT bandEnd = std::min(maxFrequency,
+            resonanceFrequencies[0] * static_cast<SimT>(2 * modeCount));
+        printEngineResult("modal " + std::to_string(modeCount), time, getSpectralError(
+            reference, output, benchSamplingRate, minFrequency, bandEnd, resonanceFrequencies));
+    }
+
+    return 0;
+}
+
+// horn engine against the echo model for a uniform pipe,
+// then the cost and stability for profiles that the echo model can't do
+int benchmarkHorn(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+    const SimT minFrequency = 50.0, maxFrequency = 16000.0;
+
+    std::cout << "horn engine vs echo model, " << duration << " s of noise excitation, " <<
+        benchSamplingRate << " hz, " << benchBlockSize << " sample blocks" << std::endl;
+    std::cout << "errors are rms over " << minFrequency << " - " << maxFrequency <<
+        " hz" << std::endl;
+    printEngineHeader();
+
+    const std::vector<SimT> resonanceFrequencies = getResonanceFrequencies(maxFrequency);
+
+    std::vector<SimT> reference;
+    const SimT referenceTime = renderNoise([](Simulation&) {}, duration, reference);
+    printEngineResult("echo " + std::to_string(Pipe::startEchoIterations), referenceTime, {});
+
+    std::vector<SimT> uniform;
+    const SimT uniformTime = renderNoise([](Simulation& simulation)
+    {
+        simulation.setPipeEngine(Simulation::PipeEngine::Horn);
+    }, duration, uniform);
+    printEngineResult("horn uniform", uniformTime, getSpectralError(
+        reference, uniform, benchSamplingRate, minFrequency, maxFrequency, resonanceFrequencies));
+    // the echo model is close to lossless at the open end, the radiation resistance of the
+    // horn damps the high modes like the modal engine does, so the low band is shown separately
+    printEngineResult("horn < 2 khz", uniformTime, getSpectralError(
+        reference, uniform, benchSamplingRate, minFrequency, 2000.0, resonanceFrequencies));
+
+    struct Geometry
+    {
+        const char* name;
+        SimT lengthCm;
+        std::vector<HornPipe::ProfilePoint> profile;
+    };
+    const Geometry geometries[] =
+    {
+        {"uniform", 50.0, {}},
+        {"cone", 50.0, {{0.0, 1.0}, {1.0, 3.0}}},
+        {"flare", 50.0, {{0.0, 1.0}, {0.6, 1.2}, {0.8, 1.8}, {0.9, 2.6}, {1.0, 4.0}}},
+        {"muffler", 50.0, {{0.0, 1.0}, {0.4, 1.0}, {0.4, 4.0}, {0.7, 4.0}, {0.7, 1.0}, {1.0, 1.0}}},
+        {"uniform long", 300.0, {}},
+        {"muffler long", 300.0, {{0.0, 1.0}, {0.4, 1.0}, {0.4, 4.0}, {0.7, 4.0}, {0.7, 1.0}, {1.0, 1.0}}},
+    };
+
+    std::cout << std::endl << std::setw(16) << std::left << "profile" << std::right <<
+        std::setw(8) << "cells" << std::setw(10) << "courant" << std::setw(13) << "cpu/audio %" <<
+        std::setw(14) << "ns/sample" << std::setw(13) << "peak level" << std::endl;
+    for(const auto& geometry : geometries)
+    {
+        size_t cellCount = 0;
+        SimT courantNumber = 0.0;
+        std::vector<SimT> output;
+        const SimT time = renderNoise([&](Simulation& simulation)
+        {
+            simulation.pipe.setPipePhysicalLengthAndReset(geometry.lengthCm / 100.0);
+            simulation.setPipeEngine(Simulation::PipeEngine::Horn);
+            simulation.hornPipe.setProfile(geometry.profile);
+            // an empty progress fits the grid
+            simulation.progressPipe(0.0);
+            cellCount = simulation.hornPipe.getCellCount();
+            courantNumber = simulation.hornPipe.getCourantNumber();
+        }, duration, output);
+
+        // a growing output would mean that the scheme is unstable
+        SimT peakLevel = 0.0;
+        for(const SimT sample : output)
+            peakLevel = std::max(peakLevel, std::abs(sample));
+
+        std::cout << std::setw(16) << std::left << geometry.name << std::right <<
+            std::setw(8) << cellCount << std::fixed << std::setprecision(4) <<
+            std::setw(10) << courantNumber << std::setprecision(3) <<
+            std::setw(13) << time * 100.0 << std::setprecision(1) <<
+            std::setw(14) << time * 1e9 / benchSamplingRate << std::setprecision(4) <<
+            std::setw(13) << peakLevel << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    return 0;
+}
+
+// batched engine against independent scalar delay line engines of the same vehicles
+int benchmarkBatch(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+    const SimT minFrequency = 50.0, maxFrequency = 16000.0;
+
+    std::cout << "delay line engine vs echo model, " << duration << " s of noise excitation, " <<
+        benchSamplingRate << " hz, " << benchBlockSize << " sample blocks" << std::endl;
+    printEngineHeader();
+
+    const std::vector<SimT> resonanceFrequencies = getResonanceFrequencies(maxFrequency);
+
+    std::vector<SimT> reference;
+    const SimT referenceTime = renderNoise([](Simulation&) {}, duration, reference);
+    printEngineResult("echo " + std::to_string(Pipe::startEchoIterations), referenceTime, {});
+
+    std::vector<SimT> delayLine;
+    const SimT delayLineTime = renderNoise([](Simulation& simulation)
+    {
+        simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+    }, duration, delayLine);
+    printEngineResult("delay line", delayLineTime, getSpectralError(
+        reference, delayLine, benchSamplingRate, minFrequency, maxFrequency, resonanceFrequencies));
+
+    struct Vehicle
+    {
+        SimT frequency, pipeLength, pipeRadius;
+    };
+    std::mt19937 generator{1234};
+    std::uniform_real_distribution<SimT> frequencies(50.0, 400.0), pipeLengths(0.3, 2.0),
+        pipeRadii(0.005, 0.011);
+
+    // both are excited with the same sine as the cylinder, without its start ramp;
+    // the error is the largest difference in relation to the peak level of the scalar engines
+    std::cout << std::endl << "batch of vehicles vs independent scalar delay line engines, " <<
+        duration << " s of sine excitation, " << BatchSimulation::laneCount <<
+        " lanes per group" << std::endl;
+    std::cout << std::setw(10) << "vehicles" << std::setw(16) << "scalar cpu %" <<
+        std::setw(15) << "batch cpu %" << std::setw(14) << "scalar ns" << std::setw(13) <<
+        "batch ns" << std::setw(10) << "speedup" << std::setw(14) << "max error" << std::endl;
+    std::cout << std::setw(10) << "" << std::setw(16) << "per vehicle" << std::setw(15) <<
+        "per vehicle" << std::setw(14) << "per sample" << std::setw(13) << "per sample" << std::endl;
+
+    for(const size_t vehicleCount : {1, 4, 8, 16, 32, 64})
+    {
+        std::vector<Vehicle> vehicles(vehicleCount);
+        for(auto& vehicle : vehicles)
+            vehicle = {frequencies(generator), pipeLengths(generator), pipeRadii(generator)};
+
+        std::vector<std::unique_ptr<Simulation>> simulations;
+        BatchSimulation batch{benchSamplingRate, vehicleCount};
+        for(size_t i = 0; i < vehicleCount; i++)
+        {
+            auto& simulation = *simulations.emplace_back(std::make_unique<Simulation>(benchSamplingRate));
+            simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+            // the batch reads whole sample delays
+            simulation.pipe.setFractionalDelayOrder(0);
+            simulation.pipe.setPipePhysicalLengthAndReset(vehicles[i].pipeLength);
+            simulation.pipe.setPipeRadiusAndReset(vehicles[i].pipeRadius);
+
+            batch.setFrequency(i, vehicles[i].frequency);
+            batch.setPipe(i, vehicles[i].pipeLength, vehicles[i].pipeRadius,
+                simulation.pipe.getEchoIterations());
+        }
+
+        // the blocks alternate between the engines so that both see the same cache state
+        const size_t blockCount = static_cast<size_t>(duration * benchSamplingRate / benchBlockSize);
+        std::vector<SimT> counters(vehicleCount, 0.0);
+        SimT scalarTime = 0.0, batchTime = 0.0, peakLevel = 0.0, maxError = 0.0;
+        for(size_t block = 0; block < blockCount; block++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for(size_t i = 0; i < vehicleCount; i++)
+            {
+                Wave& wave = simulations[i]->cylinder.currentOutWave;
+                wave.samples.resize(benchBlockSize);
+                for(auto& sample : wave.samples)
+                {
+                    counters[i] += vehicles[i].frequency * 2.0 * std::numbers::pi / benchSamplingRate;
+                    sample = std::sin(counters[i]) * 0.02;
+                }
+                simulations[i]->progressPipe(static_cast<SimT>(benchBlockSize));
+            }
+            scalarTime += std::chrono::duration<SimT>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            batch.progressSimulation(benchBlockSize);
+            batchTime += std::chrono::duration<SimT>(std::chrono::steady_clock::now() - start).count();
+
+            for(size_t i = 0; i < vehicleCount; i++)
+            {
+                const Wave::SampleContainer& scalar = simulations[i]->outWave.samples;
+                const BatchSimulation::Sample* const batched = batch.getOutput(i);
+                for(size_t j = 0; j < benchBlockSize; j++)
+                {
+                    peakLevel = std::max(peakLevel, std::abs(scalar[j]));
+                    maxError = std::max(maxError, std::abs(scalar[j] - batched[j]));
+                }
+            }
+        }
+
+        const SimT audioTime = blockCount * benchBlockSize / benchSamplingRate;
+        const SimT scalarVehicleTime = scalarTime / audioTime / vehicleCount;
+        const SimT batchVehicleTime = batchTime / audioTime / vehicleCount;
+
+        std::cout << std::setw(10) << vehicleCount << std::fixed << std::setprecision(4) <<
+            std::setw(16) << scalarVehicleTime * 100.0 << std::setw(15) << batchVehicleTime * 100.0 <<
+            std::setprecision(2) << std::setw(14) << scalarVehicleTime * 1e9 / benchSamplingRate <<
+            std::setw(13) << batchVehicleTime * 1e9 / benchSamplingRate <<
+            std::setw(10) << scalarTime / batchTime << std::scientific << std::setprecision(2) <<
+            std::setw(14) << maxError / peakLevel << std::endl;
+        std::cout.unsetf(std::ios::fixed | std::ios::scientific);
+    }
+
+    return 0;
+}
+
+// voice manager with many echo engines on a growing number of threads;
+// the blocks are rendered back to back, each with the deadline of a realtime block
+int benchmarkVoices(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 5.0;
+    const SimT blockDuration = benchBlockSize / benchSamplingRate;
+
+    std::cout << "voice manager, " << duration << " s, " << benchSamplingRate << " hz, " <<
+        benchBlockSize << " sample blocks, deadline " <<
+        VoiceManager::defaultDeadlineFraction * blockDuration * 1000.0 << " ms, " <<
+        std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << std::setw(8) << "voices" << std::setw(9) << "threads" <<
+        std::setw(14) << "block ms" << std::setw(11) << "max ms" << std::setw(12) << "skipped %" <<
+        std::setw(15) << "voice cpu %" << std::setw(11) << "stolen" << std::endl;
+
+    for(const size_t voiceCount : {8, 32, 128})
+    {
+        for(const size_t threadCount : {1, 2, 4})
+        {
+            VoiceManager voices{benchSamplingRate, threadCount};
+            std::mt19937 generator{1234};
+            std::uniform_real_distribution<SimT> frequencies(50.0, 400.0), pipeLengths(0.3, 2.0);
+            for(size_t i = 0; i < voiceCount; i++)
+            {
+                const VoiceManager::VoiceId voice = voices.addVoice();
+                Simulation& simulation = voices.getSimulation(voice);
+                simulation.cylinder.setFrequency(frequencies(generator));
+                simulation.pipe.setPipePhysicalLengthAndReset(pipeLengths(generator));
+                voices.setGain(voice, 1.0 / std::sqrt(static_cast<SimT>(voiceCount)));
+            }
+
+            const size_t blockCount = static_cast<size_t>(duration / blockDuration);
+            SimT totalTime = 0.0, maxTime = 0.0;
+            size_t skippedCount = 0;
+            for(size_t block = 0; block < blockCount; block++)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                voices.render(benchBlockSize);
+                const SimT time =
+                    std::chrono::duration<SimT>(std::chrono::steady_clock::now() - start).count();
+
+                totalTime += time;
+                maxTime = std::max(maxTime, time);
+                skippedCount += voices.getLastSkippedCount();
+            }
+
+            SimT voiceCpuUsage = 0.0;
+            for(VoiceManager::VoiceId voice = 0; voice < voiceCount; voice++)
+                voiceCpuUsage += voices.getStats(voice).cpuUsage;
+
+            std::cout << std::setw(8) << voiceCount << std::setw(9) << threadCount <<
+                std::fixed << std::setprecision(3) <<
+                std::setw(14) << totalTime / blockCount * 1000.0 << std::setw(11) << maxTime * 1000.0 <<
+                std::setprecision(2) << std::setw(12) <<
+                100.0 * skippedCount / static_cast<SimT>(blockCount * voiceCount) <<
+                std::setprecision(3) << std::setw(15) << voiceCpuUsage / voiceCount * 100.0 <<
+                std::setw(11) << voices.getPool().getStealCount() << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+
+    return 0;
+}
+
+// cost and level of the detail tiers, and the smoothness of switching between them at runtime
+int benchmarkDetail(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 5.0;
+
+    std::cout << "detail tiers, " << duration << " s of the cylinder, " << benchSamplingRate <<
+        " hz, " << benchBlockSize << " sample blocks" << std::endl;
+    std::cout << "level is the rms level in relation to the full tier of the engine" << std::endl;
+    std::cout << std::setw(8) << std::left << "engine" << std::setw(8) << "tier" << std::right <<
+        std::setw(13) << "cpu/audio %" << std::setw(14) << "ns/sample" << std::setw(11) <<
+        "level db" << std::endl;
+
+    const auto getRms = [](const std::vector<SimT>& samples)
+    {
+        SimT sum = 0.0;
+        for(const SimT sample : samples)
+            sum += sample * sample;
+        return std::sqrt(sum / static_cast<SimT>(samples.size()));
+    };
+
+    const std::pair<const char*, Simulation::PipeEngine> engines[] =
+    {
+        {"echo", Simulation::PipeEngine::Echo},
+        {"modal", Simulation::PipeEngine::Modal},
+    };
+    for(const auto& [engineName, engine] : engines)
+    {
+        SimT fullRms = 0.0;
+        for(size_t tier = 0; tier < Simulation::detailTierCount; tier++)
+        {
+            Simulation simulation{benchSamplingRate};
+            simulation.setPipeEngine(engine);
+            simulation.setDetailTier(tier);
+            simulation.setDetailCostMeasuring(true);
+            // the first blocks ramp the caps
+            measureRenderTime(simulation, 0.5);
+
+            std::vector<SimT> output;
+            measureRenderTime(simulation, duration, &output);
+            const SimT rms = getRms(output);
+            if(tier == 0)
+                fullRms = rms;
+
+            const SimT cost = simulation.getDetailCost(tier);
+            std::cout << std::setw(8) << std::left << engineName << std::setw(8) <<
+                Simulation::detailTiers[tier].name << std::right << std::fixed <<
+                std::setprecision(3) << std::setw(13) << cost * 100.0 <<
+                std::setprecision(1) << std::setw(14) << cost * 1e9 / benchSamplingRate <<
+                std::setprecision(2) << std::setw(11) << 20.0 * std::log10(rms / fullRms) << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+
+    // the largest step between two samples shows clicks;
+    // the tier changes every half second through all of the tiers
+    const auto getMaxStep = [](const std::vector<SimT>& samples)
+    {
+        // the start of the sound is left out
+        SimT maxStep = 0.0;
+        for(size_t i = static_cast<size_t>(0.5 * benchSamplingRate); i < samples.size(); i++)
+            maxStep = std::max(maxStep, std::abs(samples[i] - samples[i - 1]));
+        return maxStep;
+    };
+
+    std::vector<SimT> steady, switching;
+    Simulation steadySimulation{benchSamplingRate}, switchingSimulation{benchSamplingRate};
+    const size_t tierSequence[] = {0, 3, 1, 2, 0, 2, 3, 0};
+    for(const size_t tier : tierSequence)
+    {
+        switchingSimulation.setDetailTier(tier);
+        measureRenderTime(switchingSimulation, 0.5, &switching);
+        measureRenderTime(steadySimulation, 0.5, &steady);
+    }
+
+    std::cout << std::endl << "largest sample step while switching tiers in relation to the full tier: " <<
+        getMaxStep(switching) / getMaxStep(steady) << std::endl;
+
+    return 0;
+}
+
+// a quarter wave tube and a helmholtz resonator on the pipe for the cases of the delay line engine
+std::vector<SideBranch> getCaseBranches(const Pipe& pipe)
+{
+    std::vector<SideBranch> branches(2);
+    branches[0].position = 0.3;
+    branches[0].tune(pipe, 300.0);
+    branches[1].type = SideBranch::Type::Helmholtz;
+    branches[1].position = 0.7;
+    branches[1].length = 0.05;
+    branches[1].tune(pipe, 170.0);
+    return branches;
+}
+
+int benchmarkSnapshot(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 1.0;
+    constexpr size_t repeatCount = 100;
+
+    std::cout << "snapshots after " << duration << " s of the cylinder, " << benchSamplingRate <<
+        " hz, times are the mean of " << repeatCount << std::endl;
+    std::cout << "difference is the largest difference of the next 0.5 s rendered from the restored copy" <<
+        std::endl;
+    std::cout << std::setw(14) << std::left << "engine" << std::right << std::setw(10) << "bytes" <<
+        std::setw(10) << "save us" << std::setw(12) << "restore us" << std::setw(13) << "difference" <<
+        std::endl;
+
+    const auto toMicroseconds = [](const std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<SimT, std::micro>(duration).count() / static_cast<SimT>(repeatCount);
+    };
+
+    struct Case
+    {
+        const char* name;
+        std::function<void(Simulation&)> configure;
+    };
+    const Case cases[] =
+    {
+        {"echo", [](Simulation&) {}},
+        {"echo low", [](Simulation& simulation) { simulation.setDetailTier(3); }},
+        {"echo filtered", [](Simulation& simulation)
+        {
+            std::vector<SimT> impulseResponse(256);
+            for(size_t i = 0; i < impulseResponse.size(); i++)
+                impulseResponse[i] = std::exp(-static_cast<SimT>(i) / 32.0) / 32.0;
+            simulation.outputFilter.setImpulseResponse(impulseResponse);
+        }},
+        {"modal", [](Simulation& simulation) { simulation.setPipeEngine(Simulation::PipeEngine::Modal); }},
+        {"horn", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::Horn);
+            simulation.hornPipe.setProfile({{0.0, 1.0}, {1.0, 3.0}});
+        }},
+        {"delay", [](Simulation& simulation) { simulation.setPipeEngine(Simulation::PipeEngine::DelayLine); }},
+        {"horn hot", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::Horn);
+            simulation.pipe.setTemperatures({600.0, 450.0, 300.0});
+        }},
+        {"echo pulses", [](Simulation& simulation)
+        {
+            ExcitationShape shape;
+            findExcitationPreset("v8bank", shape);
+            simulation.cylinder.setExcitation(&shape);
+            simulation.cylinder.setFrequency(50.0);
+        }},
+        {"delay walls", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+            simulation.pipe.setWallLoss(true);
+        }},
+        {"echo walls", [](Simulation& simulation) { simulation.pipe.setWallLoss(true); }},
+        {"delay order 7", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+            simulation.pipe.setFractionalDelayOrder(FractionalDelay::maxOrder);
+            simulation.pipe.setTemperatures({400.0, 200.0});
+        }},
+        {"delay branches", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+            simulation.pipe.setWallLoss(true);
+            simulation.pipe.setSideBranches(getCaseBranches(simulation.pipe));
+        }},
+        {"echo intake", [](Simulation& simulation) { simulation.setMixGains(0.8, 0.5); }},
+        {"delay intake", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+            simulation.setMixGains(0.8, 0.5);
+        }},
+        {"low ramps", [](Simulation& simulation)
+        {
+            ExcitationShape shape;
+            findExcitationPreset("inline4", shape);
+            simulation.cylinder.setExcitation(&shape);
+            simulation.cylinder.setFrequency(10.0);
+            simulation.cylinder.rampFrequency(50.0, 60.0);
+            simulation.cylinder.rampLoad(1.0, 60.0);
+            simulation.setDetailTier(3);
+        }},
+    };
+
+    bool deterministic = true;
+    for(const auto& [name, configure] : cases)
+    {
+        Simulation original{benchSamplingRate};
+        configure(original);
+        measureRenderTime(original, duration);
+
+        std::vector<uint8_t> snapshot;
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < repeatCount; i++)
+        {
+            snapshot.clear();
+            original.saveSnapshot(snapshot);
+        }
+        const SimT saveTime = toMicroseconds(std::chrono::steady_clock::now() - start);
+
+        // the copy starts from the defaults, everything comes from the snapshot
+        Simulation copy{benchSamplingRate};
+        start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < repeatCount; i++)
+        {
+            if(!copy.restoreSnapshot(snapshot.data(), snapshot.size()))
+            {
+                std::cerr << "restoring the snapshot of " << name << " failed" << std::endl;
+                return 1;
+            }
+        }
+        const SimT restoreTime = toMicroseconds(std::chrono::steady_clock::now() - start);
+
+        std::vector<SimT> originalOutput, copyOutput;
+        measureRenderTime(original, 0.5, &originalOutput);
+        measureRenderTime(copy, 0.5, &copyOutput);
+        SimT difference = 0.0;
+        for(size_t i = 0; i < originalOutput.size(); i++)
+            difference = std::max(difference, std::abs(originalOutput[i] - copyOutput[i]));
+        deterministic = deterministic && difference == 0.0;
+
+        std::cout << std::setw(14) << std::left << name << std::right << std::setw(10) << snapshot.size() <<
+            std::fixed << std::setprecision(1) << std::setw(10) << saveTime << std::setw(12) << restoreTime <<
+            std::scientific << std::setprecision(2) << std::setw(13) << difference << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    // a cut snapshot has to be refused instead of restoring garbage
+    Simulation original{benchSamplingRate}, copy{benchSamplingRate};
+    measureRenderTime(original, 0.1);
+    std::vector<uint8_t> snapshot;
+    original.saveSnapshot(snapshot);
+    const bool refusesCut = !copy.restoreSnapshot(snapshot.data(), snapshot.size() / 2);
+    const bool refusesRate = !Simulation{benchSamplingRate / 2.0}.restoreSnapshot(snapshot.data(), snapshot.size());
+
+    std::cout << std::endl << "restored output identical: " << (deterministic ? "yes" : "no") <<
+        ", cut snapshot refused: " << (refusesCut ? "yes" : "no") <<
+        ", other sampling rate refused: " << (refusesRate ? "yes" : "no") << std::endl;
+
+    return deterministic && refusesCut && refusesRate ? 0 : 1;
+}
+
+int benchmarkWarmStart(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 3.0;
+    constexpr SimT blockDuration = 0.01, settleTolerance = 1.0;
+    constexpr size_t repeatCount = 10;
+
+    std::cout << "cold and warm starts against the same engine settled for 10 s, " <<
+        benchSamplingRate << " hz" << std::endl;
+    std::cout << "settled is the end of the last " << blockDuration * 1000.0 << " ms block that is off by more than " <<
+        settleTolerance << " db within " << duration << " s, level is the first block" << std::endl;
+    std::cout << "difference is the largest difference to the settled engine at the same phase in relation to its peak" <<
+        std::endl;
+    std::cout << std::setw(14) << std::left << "engine" << std::right << std::setw(13) << "cold ms" <<
+        std::setw(12) << "cold db" << std::setw(12) << "warm ms" << std::setw(12) << "warm db" <<
+        std::setw(11) << "start us" << std::setw(10) << "ahead" << std::setw(13) << "difference" << std::endl;
+
+    const size_t blockSampleCount = static_cast<size_t>(blockDuration * benchSamplingRate);
+    const auto getBlockLevel = [blockSampleCount](const std::vector<SimT>& samples, const size_t block)
+    {
+        SimT sum = 0.0;
+        for(size_t i = block * blockSampleCount; i < (block + 1) * blockSampleCount; i++)
+            sum += samples[i] * samples[i];
+        return 10.0 * std::log10(sum / static_cast<SimT>(blockSampleCount) + 1e-30);
+    };
+    const auto getSettleTime = [&](const std::vector<SimT>& samples, const SimT steadyLevel)
+    {
+        size_t settledBlock = 0;
+        for(size_t block = 0; block < samples.size() / blockSampleCount; block++)
+        {
+            if(std::abs(getBlockLevel(samples, block) - steadyLevel) > settleTolerance)
+                settledBlock = block + 1;
+        }
+        return static_cast<SimT>(settledBlock) * blockDuration * 1000.0;
+    };
+
+    struct Case
+    {
+        const char* name;
+        std::function<void(Simulation&)> configure;
+        // the copies of the lower rates have phases of their own
+        bool aligned;
+    };
+    const Case cases[] =
+    {
+        {"echo", [](Simulation&) {}, true},
+        {"echo low", [](Simulation& simulation) { simulation.setDetailTier(3); }, false},
+        {"modal", [](Simulation& simulation) { simulation.setPipeEngine(Simulation::PipeEngine::Modal); }, true},
+        {"horn", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::Horn);
+            simulation.hornPipe.setProfile({{0.0, 1.0}, {1.0, 3.0}});
+        }, true},
+        {"delay", [](Simulation& simulation) { simulation.setPipeEngine(Simulation::PipeEngine::DelayLine); }, true},
+        {"delay walls", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+            simulation.pipe.setWallLoss(true);
+        }, true},
+        {"branches", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+            simulation.pipe.setWallLoss(true);
+            simulation.pipe.setSideBranches(getCaseBranches(simulation.pipe));
+        }, true},
+        {"delay intake", [](Simulation& simulation)
+        {
+            simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+            simulation.setMixGains(0.8, 0.5);
+        }, true},
+        {"echo intake", [](Simulation& simulation) { simulation.setMixGains(0.8, 0.5); }, true},
+    };
+
+    for(const auto& [name, configure, aligned] : cases)
+    {
+        Simulation settled{benchSamplingRate};
+        configure(settled);
+        measureRenderTime(settled, 10.0);
+        std::vector<SimT> steady;
+        measureRenderTime(settled, 0.5, &steady);
+        SimT steadyLevel = 0.0;
+        for(size_t block = 0; block < steady.size() / blockSampleCount; block++)
+            steadyLevel += getBlockLevel(steady, block);
+        steadyLevel /= static_cast<SimT>(steady.size() / blockSampleCount);
+
+        Simulation cold{benchSamplingRate};
+        configure(cold);
+        std::vector<SimT> coldOutput;
+        measureRenderTime(cold, duration, &coldOutput);
+
+        // the warm start is timed on fresh simulations
+        SimT startTime = 0.0;
+        size_t aheadSampleCount = 0;
+        for(size_t i = 0; i < repeatCount; i++)
+        {
+            Simulation simulation{benchSamplingRate};
+            configure(simulation);
+            const auto start = std::chrono::steady_clock::now();
+            aheadSampleCount = simulation.warmStart(benchBlockSize);
+            startTime += std::chrono::duration<SimT, std::micro>(std::chrono::steady_clock::now() - start).count();
+        }
+        startTime /= static_cast<SimT>(repeatCount);
+
+        // the phase is set back by the samples that the warm start runs ahead, so that the warm
+        // engine ends up at the phase of the settled one
+        Simulation warm{benchSamplingRate};
+        configure(warm);
+        const SimT step = 2.0 * std::numbers::pi * warm.cylinder.getFrequency() / benchSamplingRate;
+        warm.cylinder.setPhase(settled.cylinder.getPhase() - step * static_cast<SimT>(aheadSampleCount));
+        warm.warmStart(benchBlockSize);
+
+        std::vector<SimT> warmOutput, settledOutput;
+        measureRenderTime(warm, duration, &warmOutput);
+        measureRenderTime(settled, duration, &settledOutput);
+        SimT difference = 0.0, peak = 0.0;
+        for(size_t i = 0; i < warmOutput.size(); i++)
+        {
+            difference = std::max(difference, std::abs(warmOutput[i] - settledOutput[i]));
+            peak = std::max(peak, std::abs(settledOutput[i]));
+        }
+
+        std::cout << std::setw(14) << std::left << name << std::right << std::fixed << std::setprecision(0) <<
+            std::setw(13) << getSettleTime(coldOutput, steadyLevel) <<
+            std::setprecision(1) << std::setw(12) << getBlockLevel(coldOutput, 0) - steadyLevel <<
+            std::setprecision(0) << std::setw(12) << getSettleTime(warmOutput, steadyLevel) <<
+            std::setprecision(1) << std::setw(12) << getBlockLevel(warmOutput, 0) - steadyLevel <<
+            std::setw(11) << startTime << std::setw(10) << aheadSampleCount;
+        if(aligned)
+            std::cout << std::scientific << std::setprecision(2) << std::setw(13) << difference / peak;
+        else
+            std::cout << std::setw(13) << "-";
+        std::cout << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    return 0;
+}
+
+// cost of the excitation sources per sample, and the aliasing of the pulse tables against pulses
+// that are sampled from the shape directly
+int benchmarkExcitation(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+    constexpr size_t fftSize = 16384;
+    // the cycle frequency is put on an odd bin, so the harmonics fall on bins and the aliases
+    // between them
+    const SimT binWidth = benchSamplingRate / static_cast<SimT>(fftSize);
+    const SimT frequency = (2.0 * std::floor((argc > 1 ? std::atof(argv[1]) : 50.0) / binWidth / 2.0) + 1.0) * binWidth;
+
+    std::cout << "cylinder at a cycle rate of " << frequency << " hz (" << frequency * 120.0 << " rpm), " <<
+        benchSamplingRate << " hz" << std::endl;
+    std::cout << "alias is the power between the harmonics in relation to the whole, " <<
+        "without the cycle variation" << std::endl;
+    std::cout << std::setw(12) << std::left << "source" << std::right << std::setw(10) << "ns/sample" <<
+        std::setw(9) << "x sine" << std::setw(11) << "alias db" << std::setw(11) << "naive db" <<
+        std::setw(11) << "table kb" << std::setw(10) << "build ms" << std::endl;
+
+    const auto render = [&](Simulation& simulation, const SimT seconds, std::vector<SimT>* output)
+    {
+        const size_t blockCount = static_cast<size_t>(seconds * benchSamplingRate / benchBlockSize);
+        SimT oldSampleCount = 0.0;
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t block = 0; block < blockCount; block++)
+        {
+            simulation.cylinder.progressSimulation(oldSampleCount, oldSampleCount + benchBlockSize);
+            oldSampleCount += benchBlockSize;
+            if(output)
+            {
+                const Wave::SampleContainer& samples = simulation.cylinder.currentOutWave.samples;
+                output->insert(output->end(), samples.begin(), samples.end());
+            }
+        }
+
+        return std::chrono::duration<SimT, std::nano>(std::chrono::steady_clock::now() - start).count() /
+            static_cast<SimT>(blockCount * benchBlockSize);
+    };
+
+    const size_t fundamentalBin = static_cast<size_t>(std::llround(frequency / binWidth));
+    const auto getAliasLevel = [&](const std::vector<SimT>& samples)
+    {
+        const std::vector<SimT> spectrum = getPowerSpectrum(samples, fftSize);
+        SimT total = 0.0, alias = 0.0;
+        for(size_t bin = fundamentalBin - 2; bin < spectrum.size(); bin++)
+        {
+            const size_t offset = bin % fundamentalBin;
+            total += spectrum[bin];
+            if(offset > 2 && offset < fundamentalBin - 2)
+                alias += spectrum[bin];
+        }
+        return 10.0 * std::log10(std::max(alias, 1e-30) / total);
+    };
+
+    SimT sineTime = 0.0;
+    for(const bool fast : {false, true})
+    {
+        Simulation simulation{benchSamplingRate};
+        simulation.cylinder.setFrequency(frequency);
+        simulation.cylinder.setFastOscillator(fast);
+        const SimT time = render(simulation, duration, nullptr);
+        if(!fast)
+            sineTime = time;
+
+        std::cout << std::setw(12) << std::left << (fast ? "sine fast" : "sine") << std::right <<
+            std::fixed << std::setprecision(2) << std::setw(10) << time << std::setw(9) << time / sineTime <<
+            std::setw(11) << "-" << std::setw(11) << "-" << std::setw(11) << "-" << std::setw(10) << "-" << std::endl;
+    }
+
+    for(const char* name : {"single", "twin", "vtwin", "inline4", "v8bank"})
+    {
+        ExcitationShape shape;
+        findExcitationPreset(name, shape);
+
+        const auto start = std::chrono::steady_clock::now();
+        const ExcitationTable table{shape, benchSamplingRate};
+        const SimT buildTime = std::chrono::duration<SimT, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        Simulation simulation{benchSamplingRate};
+        simulation.cylinder.setFrequency(frequency);
+        simulation.cylinder.setExcitation(&shape);
+        const SimT time = render(simulation, duration, nullptr);
+
+        Simulation steady{benchSamplingRate};
+        steady.cylinder.setFrequency(frequency);
+        steady.cylinder.setExcitation(&shape);
+        steady.cylinder.setExcitationVariation({0.0, 0.0, 0.0});
+        steady.cylinder.skipStartSmoothing();
+        std::vector<SimT> samples;
+        render(steady, 4.0, &samples);
+
+        // the same pressure sampled at the sample positions
+        std::vector<SimT> naiveSamples(samples.size());
+        for(size_t i = 0; i < naiveSamples.size(); i++)
+        {
+            SimT blowdown, displacement;
+            shape.getPressure(std::fmod(frequency * static_cast<SimT>(i) / benchSamplingRate, 1.0), frequency,
+                blowdown, displacement);
+            naiveSamples[i] = getBlowdownLevel(steady.cylinder.getLoad()) * blowdown + displacement;
+        }
+
+        std::cout << std::setw(12) << std::left << name << std::right <<
+            std::fixed << std::setprecision(2) << std::setw(10) << time << std::setw(9) << time / sineTime <<
+            std::setprecision(1) << std::setw(11) << getAliasLevel(samples) <<
+            std::setw(11) << getAliasLevel(naiveSamples) <<
+            std::setprecision(0) << std::setw(11) << static_cast<SimT>(table.getMemoryUsage()) / 1024.0 <<
+            std::setprecision(1) << std::setw(10) << buildTime << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+
+    return 0;
+}
+
+// cost of the valve coupling against the closed end, and how the level of the pulses follows the
+// tuning of the pipe with it
+int benchmarkCoupling(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 5.0;
+    const SimT frequency = argc > 1 ? std::atof(argv[1]) : 50.0;
+
+    std::cout << "single cylinder pulses at a cycle rate of " << frequency << " hz (" << frequency * 120.0 <<
+        " rpm), " << benchSamplingRate << " hz" << std::endl;
+    std::cout << "level is the rms of the coupled output in relation to the closed end after 1 s" << std::endl;
+    std::cout << std::setw(8) << std::left << "engine" << std::right << std::setw(11) << "length cm" <<
+        std::setw(13) << "closed ms/s" << std::setw(14) << "coupled ms/s" << std::setw(9) << "ratio" <<
+        std::setw(11) << "level db" << std::endl;
+
+    const auto getLevel = [](const std::vector<SimT>& samples)
+    {
+        SimT sum = 0.0;
+        for(const SimT sample : samples)
+            sum += sample * sample;
+        return 10.0 * std::log10(sum / static_cast<SimT>(samples.size()));
+    };
+
+    for(const auto engine : {Simulation::PipeEngine::Echo, Simulation::PipeEngine::DelayLine})
+    {
+        for(const SimT lengthCm : {30.0, 50.0, 80.0, 120.0, 200.0})
+        {
+            SimT times[2], levels[2];
+            for(const bool coupled : {false, true})
+            {
+                Simulation simulation{benchSamplingRate};
+                ExcitationShape shape;
+                findExcitationPreset("single", shape);
+                simulation.cylinder.setExcitation(&shape);
+                simulation.cylinder.setFrequency(frequency);
+                simulation.cylinder.setExcitationVariation({0.0, 0.0, 0.0});
+                simulation.cylinder.setValveCoupling(coupled);
+                simulation.pipe.setPipePhysicalLengthAndReset(lengthCm / 100.0);
+                simulation.setPipeEngine(engine);
+
+                measureRenderTime(simulation, 1.0);
+                std::vector<SimT> output;
+                times[coupled] = measureRenderTime(simulation, duration, &output);
+                levels[coupled] = getLevel(output);
+            }
+
+            std::cout << std::setw(8) << std::left << (engine == Simulation::PipeEngine::Echo ? "echo" : "delay") <<
+                std::right << std::fixed << std::setprecision(0) << std::setw(11) << lengthCm <<
+                std::setprecision(2) << std::setw(13) << times[0] * 1000.0 << std::setw(14) << times[1] * 1000.0 <<
+                std::setw(9) << times[1] / times[0] << std::setprecision(1) << std::setw(11) <<
+                levels[1] - levels[0] << std::endl;
+        }
+    }
+    std::cout.unsetf(std::ios::floatfield);
+
+    return 0;
+}
+
+// rpm sweeps set per block like the device buffers vs the ramps of the cylinder;
+// the phase error is the largest difference of the phase of the cylinder at the ends of the blocks
+// from the integral of the sweep
+int benchmarkRamps(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+    const SimT rampDuration = 0.5 * duration;
+
+    std::cout << "sweeps over " << rampDuration << " s in blocks of " << benchBlockSize << " samples, " <<
+        benchSamplingRate << " hz, held after the sweep" << std::endl;
+    std::cout << std::setw(10) << std::left << "source" << std::setw(13) << "sweep" << std::right <<
+        std::setw(10) << "ns/sample" << std::setw(10) << "x const" << std::setw(16) << "phase err rad" << std::endl;
+
+    // sweeps of the sine and of the cycle rate of the pulses, 1000 to 6000 rpm
+    struct Source
+    {
+        const char* name;
+        bool fast, pulses;
+        SimT fromFrequency, toFrequency;
+    };
+    const Source sources[] =
+    {
+        {"sine", false, false, 200.0, 1200.0},
+        {"sine fast", true, false, 200.0, 1200.0},
+        {"pulses", false, true, 1000.0 / 120.0, 6000.0 / 120.0},
+    };
+    struct Sweep
+    {
+        const char* name;
+        bool ramped, constant;
+        ParameterRamp::Shape shape;
+    };
+    const Sweep sweeps[] =
+    {
+        {"constant", false, true, ParameterRamp::Shape::Linear},
+        {"steps linear", false, false, ParameterRamp::Shape::Linear},
+        {"ramp linear", true, false, ParameterRamp::Shape::Linear},
+        {"steps exp", false, false, ParameterRamp::Shape::Exponential},
+        {"ramp exp", true, false, ParameterRamp::Shape::Exponential},
+    };
+
+    for(const Source& source : sources)
+    {
+        // frequency and phase of the sweep at the time
+        const auto getFrequency = [&](const Sweep& sweep, const SimT time)
+        {
+            const SimT position = std::min(time / rampDuration, 1.0);
+            if(sweep.constant)
+                return source.fromFrequency;
+            if(sweep.shape == ParameterRamp::Shape::Exponential)
+                return source.fromFrequency * std::pow(source.toFrequency / source.fromFrequency, position);
+            return source.fromFrequency + position * (source.toFrequency - source.fromFrequency);
+        };
+        const auto getPhase = [&](const Sweep& sweep, const SimT time)
+        {
+            const SimT rampTime = std::min(time, rampDuration);
+            SimT cycles;
+            if(sweep.constant)
+                cycles = source.fromFrequency * rampTime;
+            else if(sweep.shape == ParameterRamp::Shape::Exponential)
+            {
+                const SimT ratio = std::log(source.toFrequency / source.fromFrequency);
+                cycles = source.fromFrequency * rampDuration / ratio * (std::exp(ratio * rampTime / rampDuration) - 1.0);
+            }
+            else
+            {
+                cycles = source.fromFrequency * rampTime +
+                    0.5 * (source.toFrequency - source.fromFrequency) * rampTime * rampTime / rampDuration;
+            }
+            return 2.0 * std::numbers::pi * (cycles + getFrequency(sweep, time) * (time - rampTime));
+        };
+
+        SimT constantTime = 0.0;
+        for(const Sweep& sweep : sweeps)
+        {
+            Simulation simulation{benchSamplingRate};
+            simulation.cylinder.setFastOscillator(source.fast);
+            if(source.pulses)
+            {
+                ExcitationShape shape;
+                findExcitationPreset("inline4", shape);
+                simulation.cylinder.setExcitation(&shape);
+                simulation.cylinder.setExcitationVariation({0.0, 0.0, 0.0});
+            }
+            simulation.cylinder.setFrequency(source.fromFrequency);
+            if(sweep.ramped)
+                simulation.cylinder.rampFrequency(source.toFrequency, rampDuration, sweep.shape);
+
+            const size_t blockCount = static_cast<size_t>(duration * benchSamplingRate / benchBlockSize);
+            SimT oldSampleCount = 0.0, renderTime = 0.0, phaseError = 0.0;
+            for(size_t block = 0; block < blockCount; block++)
+            {
+                if(!sweep.ramped)
+                    simulation.cylinder.setFrequency(getFrequency(sweep, oldSampleCount / benchSamplingRate));
+
+                const auto start = std::chrono::steady_clock::now();
+                simulation.cylinder.progressSimulation(oldSampleCount, oldSampleCount + benchBlockSize);
+                renderTime += std::chrono::duration<SimT, std::nano>(std::chrono::steady_clock::now() - start).count();
+                oldSampleCount += benchBlockSize;
+
+                phaseError = std::max(phaseError,
+                    std::abs(simulation.cylinder.getPhase() - getPhase(sweep, oldSampleCount / benchSamplingRate)));
+            }
+
+            const SimT time = renderTime / static_cast<SimT>(blockCount * benchBlockSize);
+            if(sweep.constant)
+                constantTime = time;
+
+            std::cout << std::setw(10) << std::left << source.name << std::setw(13) << sweep.name << std::right <<
+                std::fixed << std::setprecision(2) << std::setw(10) << time << std::setw(10) << time / constantTime <<
+                std::scientific << std::setprecision(2) << std::setw(16) << phaseError << std::endl;
+            std::cout.unsetf(std::ios::floatfield);
+        }
+    }
+
+    return 0;
+}
+
+// parsing of an hour long drive log in csv and binary and the replay of it to a simulation;
+// the drive is synthetic, gears of 8 s from 1500 to 6500 rpm with a throttle that follows them
+int benchmarkReplay(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 30.0;
+    constexpr SimT logDuration = 3600.0, logRate = 100.0;
+
+    std::vector<VehicleLogPoint> points(static_cast<size_t>(logDuration * logRate) + 1);
+    for(size_t i = 0; i < points.size(); i++)
+    {
+        const SimT time = static_cast<SimT>(i) / logRate;
+        const SimT gear = std::fmod(time / 8.0, 1.0);
+        points[i] = VehicleLogPoint {time, 1500.0 + 5000.0 * gear, 0.6 + 0.4 * std::sin(0.3 * time),
+            std::min(200.0, 20.0 + time * 0.1)};
+    }
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string csvPath = (directory / "engine sound bench log.csv").string();
+    const std::string binaryPath = (directory / "engine sound bench log.bin").string();
+    {
+        std::ofstream file(csvPath);
+        file << "time,rpm,throttle,speed\n";
+        for(const VehicleLogPoint& point : points)
+            file << point.time << "," << point.rpm << "," << point.throttle << "," << point.speed << "\n";
+    }
+    if(!VehicleLog::writeBinary(binaryPath, points))
+        return 1;
+
+    std::cout << "drive log of " << logDuration << " s at " << logRate << " hz, " << points.size() <<
+        " points" << std::endl;
+    std::cout << "parse is a full pass of the log in blocks of " << benchBlockSize << " samples at " <<
+        benchSamplingRate << " hz, render is " << duration << " s of the delay line engine with pulses" << std::endl;
+    std::cout << std::setw(8) << std::left << "format" << std::right << std::setw(10) << "size mb" <<
+        std::setw(10) << "parse ms" << std::setw(12) << "mpoints/s" << std::setw(12) << "x realtime" <<
+        std::setw(12) << "max err rpm" << std::endl;
+
+    for(const std::string& path : {csvPath, binaryPath})
+    {
+        // a replay that doesn't render, the cost of the parsing and the interpolation
+        VehicleLog log;
+        const auto parseStart = std::chrono::steady_clock::now();
+        if(!log.open(path))
+            return 1;
+        const SimT blockDuration = static_cast<SimT>(benchBlockSize) / benchSamplingRate;
+        SimT maxError = 0.0;
+        for(SimT time = 0.0; !log.isFinished(time); time += blockDuration)
+        {
+            const VehicleLogPoint point = log.getPoint(time);
+            const size_t index = std::min(static_cast<size_t>(time * logRate), points.size() - 2);
+            const SimT weight = time * logRate - static_cast<SimT>(index);
+            const SimT expected = points[index].rpm + std::min(weight, 1.0) * (points[index + 1].rpm - points[index].rpm);
+            maxError = std::max(maxError, std::abs(point.rpm - expected));
+        }
+        const SimT parseTime = std::chrono::duration<SimT, std::milli>(std::chrono::steady_clock::now() - parseStart).count();
+        const uint64_t pointCount = log.getPointCount();
+
+        // the replay of the start of the log to a simulation
+        VehicleLog replay;
+        replay.open(path);
+        Simulation simulation{benchSamplingRate};
+        ExcitationShape shape;
+        findExcitationPreset("inline4", shape);
+        simulation.cylinder.setExcitation(&shape);
+        simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+        const VehicleLogPoint first = replay.getPoint(0.0);
+        simulation.cylinder.setFrequency(first.rpm / 120.0);
+        simulation.cylinder.setLoad(first.throttle);
+
+        const size_t blockCount = static_cast<size_t>(duration * benchSamplingRate / benchBlockSize);
+        const auto renderStart = std::chrono::steady_clock::now();
+        for(size_t block = 0; block < blockCount; block++)
+        {
+            replay.apply(simulation.cylinder, static_cast<SimT>(block) * blockDuration, blockDuration);
+            simulation.progressSimulation(static_cast<SimT>(benchBlockSize));
+        }
+        const SimT renderTime = std::chrono::duration<SimT>(std::chrono::steady_clock::now() - renderStart).count();
+
+        std::cout << std::setw(8) << std::left << (path == csvPath ? "csv" : "binary") << std::right <<
+            std::fixed << std::setprecision(1) << std::setw(10) <<
+            static_cast<SimT>(std::filesystem::file_size(path)) / (1024.0 * 1024.0) <<
+            std::setw(10) << parseTime << std::setprecision(2) << std::setw(12) <<
+            static_cast<SimT>(pointCount) / parseTime / 1000.0 << std::setprecision(1) << std::setw(12) <<
+            duration / renderTime << std::scientific << std::setprecision(2) << std::setw(12) << maxError << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    std::filesystem::remove(csvPath);
+    std::filesystem::remove(binaryPath);
+
+    return 0;
+}
+
+// fundamental of the segments of the pipe with the reflections between them, from the transfer
+// matrices of the segments and the end correction mass at the open end;
+// searched within 30 % of the estimate
+SimT getExactFundamental(const Pipe& pipe, const SimT estimate)
+{
+    const size_t segmentCount = std::max<size_t>(1, pipe.getTemperatures().size());
+    const SimT segmentLength = pipe.getPipePhysicalLength() / static_cast<SimT>(segmentCount);
+    const SimT area = std::numbers::pi * pipe.getPipeRadius() * pipe.getPipeRadius();
+    const SimT endMass = pipe.getDensity(1.0) * endCorrectionFactor * pipe.getPipeRadius() / area;
+
+    // pressure and volume flow from the closed end, the open end has p = jw m U
+    const auto getEndMismatch = [&](const SimT frequency)
+    {
+        const SimT w = 2.0 * std::numbers::pi * frequency;
+        std::complex<SimT> pressure = 1.0, flow = 0.0;
+        for(size_t i = 0; i < segmentCount; i++)
+        {
+            const SimT position = (static_cast<SimT>(i) + 0.5) / static_cast<SimT>(segmentCount);
+            const SimT kl = w / pipe.getWaveSpeed(position) * segmentLength;
+            const SimT impedance = pipe.getDensity(position) * pipe.getWaveSpeed(position) / area;
+            const std::complex<SimT> j {0.0, 1.0};
+            const std::complex<SimT> nextPressure = pressure * std::cos(kl) - j * impedance * flow * std::sin(kl);
+            flow = -j / impedance * pressure * std::sin(kl) + flow * std::cos(kl);
+            pressure = nextPressure;
+        }
+        return std::abs(pressure - std::complex<SimT> {0.0, w * endMass} * flow);
+    };
+
+    SimT best = estimate, bestMismatch = getEndMismatch(estimate);
+    for(SimT frequency = 0.7 * estimate; frequency < 1.3 * estimate; frequency += 0.01)
+    {
+        const SimT mismatch = getEndMismatch(frequency);
+        if(mismatch < bestMismatch)
+        {
+            best = frequency;
+            bestMismatch = mismatch;
+        }
+    }
+
+    return best;
+}
+
+// fundamental of the pipe for temperature profiles of the exhaust, measured from the noise response
+// of every engine against 1 / 4T of the travel time T and against the exact fundamental with the
+// reflections between the segments, which only the horn engine models;
+// and the cost of the engines with the profiles and with a profile that changes at every block
+int benchmarkTemperature(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+
+    std::cout << duration << " s of noise excitation, " << benchSamplingRate << " hz, " <<
+        benchBlockSize << " sample blocks" << std::endl;
+    std::cout << std::setw(8) << std::left << "engine" << std::setw(16) << "temperatures" << std::right <<
+        std::setw(13) << "cpu/audio %" << std::setw(10) << "x 15 c" << std::setw(10) << "1/4T hz" <<
+        std::setw(10) << "exact hz" << std::setw(10) << "peak hz" << std::setw(12) << "cents 1/4T" <<
+        std::setw(13) << "cents exact" << std::endl;
+
+    struct Profile
+    {
+        const char* name;
+        std::vector<SimT> temperatures;
+        bool cooling;
+    };
+    const Profile profiles[] =
+    {
+        {"15 c", {}, false},
+        {"300 c", {300.0}, false},
+        {"600 to 300 c", {600.0, 525.0, 450.0, 375.0, 300.0}, false},
+        {"cooling", {}, true},
+    };
+    const std::pair<const char*, Simulation::PipeEngine> engines[] =
+    {
+        {"echo", Simulation::PipeEngine::Echo},
+        {"modal", Simulation::PipeEngine::Modal},
+        {"horn", Simulation::PipeEngine::Horn},
+        {"delay", Simulation::PipeEngine::DelayLine},
+    };
+    const size_t fftSize = 32768;
+
+    for(const auto& [engineName, engine] : engines)
+    {
+        SimT uniformTime = 0.0;
+        for(const Profile& profile : profiles)
+        {
+            std::mt19937 generator{1234};
+            Simulation simulation{benchSamplingRate};
+            simulation.setPipeEngine(engine);
+            simulation.pipe.setTemperatures(profile.temperatures);
+            const auto excite = makeNoiseExcitation(generator);
+            measureRenderTime(simulation, 1.0, nullptr, excite);
+
+            // the cooling profile goes from 600 to 300 c at the cylinder over the run, with the open
+            // end 300 c cooler, and is set before every block
+            size_t block = 0;
+            const size_t blockCount = static_cast<size_t>(duration * benchSamplingRate / benchBlockSize);
+            const auto coolingExcite = [&](Wave& wave)
+            {
+                const SimT position = static_cast<SimT>(block++) / static_cast<SimT>(blockCount);
+                const SimT temperature = 600.0 - 300.0 * position;
+                simulation.pipe.setTemperatures({temperature, temperature - 150.0, temperature - 300.0});
+                excite(wave);
+            };
+
+            std::vector<SimT> output;
+            const SimT time = measureRenderTime(simulation, duration, &output,
+                profile.cooling ? std::function<void(Wave&)>(coolingExcite) : excite);
+            if(!profile.cooling && profile.temperatures.empty())
+                uniformTime = time;
+
+            std::cout << std::setw(8) << std::left << engineName << std::setw(16) << profile.name << std::right <<
+                std::fixed << std::setprecision(3) << std::setw(13) << time * 100.0 <<
+                std::setprecision(2) << std::setw(10) << time / uniformTime;
+            if(profile.cooling)
+            {
+                const bool finite = std::all_of(output.begin(), output.end(),
+                    [](const SimT sample) { return std::isfinite(sample); });
+                std::cout << std::setw(30) << (finite ? "finite" : "not finite") << std::endl;
+                std::cout.unsetf(std::ios::fixed);
+                continue;
+            }
+
+            // the peak is searched within 20 % of the estimated fundamental and refined with a
+            // parabola through the levels of its bins
+            const SimT expected = simulation.modalPipe.getModeFrequency(0);
+            const SimT exact = getExactFundamental(simulation.pipe, expected);
+            const std::vector<SimT> spectrum = getPowerSpectrum(output, fftSize);
+            const SimT binWidth = benchSamplingRate / fftSize;
+            const size_t first = static_cast<size_t>(expected * 0.8 / binWidth);
+            const size_t last = static_cast<size_t>(expected * 1.2 / binWidth);
+            const size_t peak = static_cast<size_t>(std::max_element(
+                spectrum.begin() + first, spectrum.begin() + last + 1) - spectrum.begin());
+            const SimT left = std::log(spectrum[peak - 1]), center = std::log(spectrum[peak]),
+                right = std::log(spectrum[peak + 1]);
+            const SimT offset = 0.5 * (left - right) / (left - 2.0 * center + right);
+            const SimT measured = (static_cast<SimT>(peak) + offset) * binWidth;
+
+            std::cout << std::setprecision(1) << std::setw(10) << expected << std::setw(10) << exact <<
+                std::setw(10) << measured << std::setw(12) << 1200.0 * std::log2(measured / expected) <<
+                std::setw(13) << 1200.0 * std::log2(measured / exact) << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+
+    return 0;
+}
+
+int benchmarkWallLoss(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+
+    // the fit of the shelf cascade to exp(-k sqrt(f)) from 20 hz to 0.45 fs
+    std::cout << "fit of the filter, " << benchSamplingRate << " hz" << std::endl;
+    std::cout << std::setw(16) << std::left << "pipe" << std::right << std::setw(10) << "k" <<
+        std::setw(12) << "1 khz db" << std::setw(12) << "10 khz db" << std::setw(14) << "max error db" <<
+        std::setw(14) << "delay samples" << std::endl;
+
+    struct Geometry
+    {
+        const char* name;
+        SimT length, radius;
+        std::vector<SimT> temperatures;
+    };
+    const Geometry geometries[] =
+    {
+        {"default", Pipe::startPipeLengthPhysicalCm / 100.0, Pipe::startPipeRadiusCm / 100.0, {}},
+        {"narrow 5 mm", Pipe::startPipeLengthPhysicalCm / 100.0, 0.005, {}},
+        {"long 5 m", 5.0, Pipe::startPipeRadiusCm / 100.0, {}},
+        {"600 to 300 c", Pipe::startPipeLengthPhysicalCm / 100.0, Pipe::startPipeRadiusCm / 100.0,
+            {600.0, 450.0, 300.0}},
+    };
+    for(const Geometry& geometry : geometries)
+    {
+        Simulation simulation{benchSamplingRate};
+        simulation.pipe.setPipePhysicalLengthAndReset(geometry.length);
+        simulation.pipe.setPipeRadiusAndReset(geometry.radius);
+        simulation.pipe.setTemperatures(geometry.temperatures);
+        simulation.pipe.setWallLoss(true);
+        const WallLossFilter& filter = simulation.pipe.getWallLossFilter();
+
+        SimT maxError = 0.0;
+        for(SimT frequency = 20.0; frequency <= 0.45 * benchSamplingRate; frequency *= 1.01)
+        {
+            maxError = std::max(maxError, std::abs(20.0 * std::log10(filter.getMagnitude(frequency) /
+                filter.getTargetMagnitude(frequency))));
+        }
+
+        std::cout << std::setw(16) << std::left << geometry.name << std::right << std::fixed <<
+            std::setprecision(4) << std::setw(10) << filter.getAttenuation() << std::setprecision(2) <<
+            std::setw(12) << 20.0 * std::log10(filter.getMagnitude(1000.0)) <<
+            std::setw(12) << 20.0 * std::log10(filter.getMagnitude(10000.0)) <<
+            std::setw(14) << maxError << std::setw(14) << filter.getDelay() + WallLossFilter::latency << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    // the cost of the filter in every engine and its damping of the highs of the noise;
+    // the horn has no wall losses
+    std::cout << std::endl << duration << " s of noise excitation, " << benchBlockSize << " sample blocks" <<
+        std::endl;
+    std::cout << std::setw(8) << std::left << "engine" << std::setw(8) << "loss" << std::right <<
+        std::setw(13) << "cpu/audio %" << std::setw(10) << "x off" << std::setw(10) << "peak hz" <<
+        std::setw(16) << "over 4 khz db" << std::endl;
+
+    const std::pair<const char*, Simulation::PipeEngine> engines[] =
+    {
+        {"echo", Simulation::PipeEngine::Echo},
+        {"modal", Simulation::PipeEngine::Modal},
+        {"delay", Simulation::PipeEngine::DelayLine},
+    };
+    const size_t fftSize = 32768;
+    for(const auto& [engineName, engine] : engines)
+    {
+        SimT offTime = 0.0, offHighPower = 0.0;
+        for(const bool wallLoss : {false, true})
+        {
+            std::mt19937 generator{1234};
+            Simulation simulation{benchSamplingRate};
+            simulation.setPipeEngine(engine);
+            simulation.pipe.setWallLoss(wallLoss);
+            const auto excite = makeNoiseExcitation(generator);
+            measureRenderTime(simulation, 1.0, nullptr, excite);
+
+            std::vector<SimT> output;
+            const SimT time = measureRenderTime(simulation, duration, &output, excite);
+
+            const std::vector<SimT> spectrum = getPowerSpectrum(output, fftSize);
+            const SimT binWidth = benchSamplingRate / fftSize;
+            const SimT expected = simulation.modalPipe.getModeFrequency(0);
+            const size_t first = static_cast<size_t>(expected * 0.8 / binWidth);
+            const size_t last = static_cast<size_t>(expected * 1.2 / binWidth);
+            const size_t peak = static_cast<size_t>(std::max_element(
+                spectrum.begin() + first, spectrum.begin() + last + 1) - spectrum.begin());
+            const SimT highPower = std::accumulate(
+                spectrum.begin() + static_cast<ptrdiff_t>(4000.0 / binWidth), spectrum.end(), 0.0);
+            if(!wallLoss)
+            {
+                offTime = time;
+                offHighPower = highPower;
+            }
+
+            std::cout << std::setw(8) << std::left << engineName << std::setw(8) << (wallLoss ? "on" : "off") <<
+                std::right << std::fixed << std::setprecision(3) << std::setw(13) << time * 100.0 <<
+                std::setprecision(2) << std::setw(10) << time / offTime << std::setprecision(1) <<
+                std::setw(10) << static_cast<SimT>(peak) * binWidth <<
+                std::setw(16) << 10.0 * std::log10(highPower / offHighPower) << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+
+    // with many echo iterations the damped echoes are pruned long before the echo limit
+    std::cout << std::endl << "echo model with 1000 echo iterations, " << duration << " s of the cylinder" <<
+        std::endl;
+    std::cout << std::setw(8) << std::left << "loss" << std::right << std::setw(13) << "cpu/audio %" <<
+        std::setw(10) << "x off" << std::setw(12) << "mean waves" << std::setw(11) << "max waves" << std::endl;
+
+    SimT offTime = 0.0;
+    for(const bool wallLoss : {false, true})
+    {
+        Simulation simulation{benchSamplingRate};
+        simulation.pipe.setEchoIterationsAndReset(1000);
+        simulation.pipe.setWallLoss(wallLoss);
+        measureRenderTime(simulation, 1.0);
+
+        // the wave counts are sampled after every block
+        const size_t blockCount = static_cast<size_t>(duration * benchSamplingRate / benchBlockSize);
+        size_t waveSum = 0, maxWaves = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t block = 0; block < blockCount; block++)
+        {
+            simulation.progressSimulation(static_cast<SimT>(benchBlockSize));
+            waveSum += simulation.pipe.pipeWaves.size();
+            maxWaves = std::max(maxWaves, simulation.pipe.pipeWaves.size());
+        }
+        const SimT time = std::chrono::duration<SimT>(std::chrono::steady_clock::now() - start).count() / duration;
+        if(!wallLoss)
+            offTime = time;
+
+        std::cout << std::setw(8) << std::left << (wallLoss ? "on" : "off") << std::right << std::fixed <<
+            std::setprecision(3) << std::setw(13) << time * 100.0 << std::setprecision(2) << std::setw(10) <<
+            time / offTime << std::setprecision(1) << std::setw(12) <<
+            static_cast<SimT>(waveSum) / static_cast<SimT>(blockCount) << std::setw(11) << maxWaves << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    return 0;
+}
+
+int benchmarkFractional(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+
+    // the kernel over a long stream in blocks and its error up to a quarter of the sampling rate at the
+    // worst rest, half way between the taps, which is the edge of the range for the even orders
+    const size_t streamLength = 1 << 20;
+    std::cout << "lagrange kernel, " << streamLength << " samples in " << benchBlockSize << " sample blocks, " <<
+        "errors up to " << 0.25 * benchSamplingRate << " hz" << std::endl;
+    std::cout << std::setw(8) << std::left << "order" << std::right << std::setw(13) << "ns/sample" <<
+        std::setw(16) << "magnitude db" << std::setw(17) << "delay samples" << std::endl;
+
+    std::mt19937 generator{1234};
+    std::normal_distribution<SimT> distribution{0.0, 1.0};
+    std::vector<SimT> stream(streamLength);
+    for(auto& sample : stream)
+        sample = distribution(generator);
+
+    for(size_t order = 0; order <= FractionalDelay::maxOrder; order++)
+    {
+        FractionalDelay delay;
+        const SimT rest = 1.0 + FractionalDelay::getMinDelay(order) + (order % 2 == 1 ? 0.5 : 0.0);
+        delay.design(order, rest);
+        FractionalDelay::State state;
+        std::vector<SimT> samples = stream;
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t first = 0; first < streamLength; first += benchBlockSize)
+            delay.process(state, samples.data() + first, std::min(benchBlockSize, streamLength - first));
+        const SimT time = std::chrono::duration<SimT, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        SimT magnitudeError = 0.0, delayError = 0.0;
+        for(SimT frequency = 10.0; frequency <= 0.25 * benchSamplingRate; frequency += 10.0)
+        {
+            const std::complex<SimT> response = delay.getResponse(frequency, benchSamplingRate);
+            magnitudeError = std::max(magnitudeError, std::abs(20.0 * std::log10(std::abs(response))));
+            // against the exact delay, so the phase doesn't wrap
+            const SimT step = 2.0 * std::numbers::pi * frequency / benchSamplingRate;
+            delayError = std::max(delayError, std::abs(std::arg(response * std::polar(1.0, step * rest)) / step));
+        }
+
+        std::cout << std::setw(8) << std::left << order << std::right << std::fixed << std::setprecision(3) <<
+            std::setw(13) << time / static_cast<SimT>(streamLength) << std::setw(16) << magnitudeError <<
+            std::setw(17) << delayError << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    // the fundamental of short pipes at a low sampling rate, where a sample is a large part of the
+    // period, from the spectrum of the impulse response against the exact fundamental;
+    // the echoes are let to decay for the tuning, a truncated response moves the peak
+    const SimT lowSamplingRate = 16000.0;
+    const size_t lowBlockSize = 160, responseLength = 1 << 17, lengthCount = 9, tuningEchoIterations = 2000;
+    std::cout << std::endl << "tuning of " << lengthCount << " pipes of 10 - 12 cm at " << lowSamplingRate <<
+        " hz, cpu of " << duration << " s of the cylinder" << std::endl;
+    std::cout << std::setw(8) << std::left << "engine" << std::setw(8) << "order" << std::right <<
+        std::setw(13) << "cpu/audio %" << std::setw(13) << "mean cents" << std::setw(12) << "max cents" << std::endl;
+
+    const std::pair<const char*, Simulation::PipeEngine> engines[] =
+    {
+        {"echo", Simulation::PipeEngine::Echo},
+        {"delay", Simulation::PipeEngine::DelayLine},
+    };
+    for(const auto& [engineName, engine] : engines)
+    {
+        for(const size_t order : {0, 1, 3, 5, 7})
+        {
+            SimT meanError = 0.0, maxError = 0.0;
+            for(size_t i = 0; i < lengthCount; i++)
+            {
+                Simulation simulation{lowSamplingRate};
+                simulation.setPipeEngine(engine);
+                simulation.pipe.setFractionalDelayOrder(order);
+                simulation.pipe.setEchoIterationsAndReset(tuningEchoIterations);
+                simulation.pipe.setPipePhysicalLengthAndReset(0.1 + 0.02 * static_cast<SimT>(i) / (lengthCount - 1));
+
+                std::vector<std::complex<SimT>> response;
+                response.reserve(responseLength);
+                for(size_t block = 0; response.size() < responseLength; block++)
+                {
+                    Wave::SampleContainer& samples = simulation.cylinder.currentOutWave.samples;
+                    samples.assign(lowBlockSize, 0.0);
+                    if(block == 0)
+                        samples[0] = 1.0;
+                    const Wave& wave = simulation.progressPipe(static_cast<SimT>(lowBlockSize));
+                    response.insert(response.end(), wave.samples.begin(), wave.samples.end());
+                }
+                response.resize(responseLength);
+                fft(response);
+
+                // the peak is searched within 20 % of the estimated fundamental and refined with a
+                // parabola through the levels of its bins
+                const SimT expected = simulation.modalPipe.getModeFrequency(0);
+                const SimT binWidth = lowSamplingRate / responseLength;
+                size_t peak = static_cast<size_t>(expected * 0.8 / binWidth);
+                for(size_t bin = peak; bin <= static_cast<size_t>(expected * 1.2 / binWidth); bin++)
+                {
+                    if(std::norm(response[bin]) > std::norm(response[peak]))
+                        peak = bin;
+                }
+                const SimT left = std::log(std::norm(response[peak - 1])),
+                    center = std::log(std::norm(response[peak])), right = std::log(std::norm(response[peak + 1]));
+                const SimT offset = 0.5 * (left - right) / (left - 2.0 * center + right);
+                const SimT measured = (static_cast<SimT>(peak) + offset) * binWidth;
+
+                const SimT error = 1200.0 * std::log2(measured / getExactFundamental(simulation.pipe, expected));
+                meanError += std::abs(error) / lengthCount;
+                maxError = std::max(maxError, std::abs(error));
+            }
+
+            Simulation simulation{lowSamplingRate};
+            simulation.setPipeEngine(engine);
+            simulation.pipe.setFractionalDelayOrder(order);
+            simulation.pipe.setPipePhysicalLengthAndReset(0.1);
+            measureRenderTime(simulation, 1.0);
+            const SimT time = measureRenderTime(simulation, duration);
+
+            std::cout << std::setw(8) << std::left << engineName << std::setw(8) << order << std::right <<
+                std::fixed << std::setprecision(3) << std::setw(13) << time * 100.0 << std::setprecision(1) <<
+                std::setw(13) << meanError << std::setw(12) << maxError << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+
+    // the delay line engine with the pipe heating from 15 to 300 c over the run, set before every
+    // block; the whole sample steps of order 0 click, which shows in the level of the second
+    // difference of the output against the static pipe
+    std::cout << std::endl << "delay line engine heating over " << duration << " s, " << benchSamplingRate <<
+        " hz" << std::endl;
+    std::cout << std::setw(8) << std::left << "order" << std::right << std::setw(20) << "2nd difference db" << std::endl;
+    for(const size_t order : {0, 1, 3, 5})
+    {
+        SimT levels[2];
+        for(const bool heating : {false, true})
+        {
+            Simulation simulation{benchSamplingRate};
+            simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+            simulation.pipe.setFractionalDelayOrder(order);
+            const size_t blockCount = static_cast<size_t>(duration * benchSamplingRate / benchBlockSize);
+            SimT previous = 0.0, beforePrevious = 0.0, sum = 0.0;
+            for(size_t block = 0; block < blockCount; block++)
+            {
+                if(heating)
+                    simulation.pipe.setTemperatures({15.0 + 285.0 * static_cast<SimT>(block) / blockCount});
+                for(const SimT sample : simulation.progressSimulation(static_cast<SimT>(benchBlockSize)).samples)
+                {
+                    const SimT difference = sample - 2.0 * previous + beforePrevious;
+                    sum += difference * difference;
+                    beforePrevious = previous;
+                    previous = sample;
+                }
+            }
+            levels[heating] = 10.0 * std::log10(sum / static_cast<SimT>(blockCount * benchBlockSize));
+        }
+
+        std::cout << std::setw(8) << std::left << order << std::right << std::fixed << std::setprecision(1) <<
+            std::setw(20) << levels[1] - levels[0] << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    return 0;
+}
+
+int benchmarkSideBranches(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+
+    // the delay line engine driven by the sine of the cylinder at the fundamental of the pipe, the
+    // drone, and at twice that between the resonances, with branches tuned to the drone;
+    // the levels are of the last second in relation to the pipe without branches
+    Simulation reference{benchSamplingRate};
+    const SimT drone = getExactFundamental(reference.pipe, reference.modalPipe.getModeFrequency(0));
+    std::cout << "delay line engine at the drone " << drone << " hz and twice that, " << duration << " s, " <<
+        benchSamplingRate << " hz" << std::endl;
+    std::cout << std::setw(24) << std::left << "branch" << std::right << std::setw(14) << "size" <<
+        std::setw(12) << "drone db" << std::setw(12) << "2x db" << std::endl;
+
+    const auto getLevel = [&](const std::vector<SideBranch>& branches, const SimT frequency)
+    {
+        Simulation simulation{benchSamplingRate};
+        simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+        simulation.pipe.setSideBranches(branches);
+        simulation.cylinder.setFrequency(frequency);
+        std::vector<SimT> output;
+        measureRenderTime(simulation, duration, &output);
+        const size_t lastSecond = std::min(output.size(), static_cast<size_t>(benchSamplingRate));
+        const SimT power = std::inner_product(output.end() - lastSecond, output.end(), output.end() - lastSecond, 0.0);
+        return 10.0 * std::log10(power / static_cast<SimT>(lastSecond));
+    };
+    const SimT droneLevel = getLevel({}, drone), offLevel = getLevel({}, 2.0 * drone);
+
+    struct Case
+    {
+        const char* name;
+        SideBranch::Type type;
+        SimT position;
+    };
+    const Case cases[] =
+    {
+        {"quarter wave at 0", SideBranch::Type::QuarterWave, 0.0},
+        {"quarter wave at 0.5", SideBranch::Type::QuarterWave, 0.5},
+        {"helmholtz at 0", SideBranch::Type::Helmholtz, 0.0},
+        {"helmholtz at 0.5", SideBranch::Type::Helmholtz, 0.5},
+    };
+    for(const Case& branchCase : cases)
+    {
+        SideBranch branch;
+        branch.type = branchCase.type;
+        branch.position = branchCase.position;
+        branch.length = branch.type == SideBranch::Type::Helmholtz ? 0.05 : branch.length;
+        branch.tune(reference.pipe, drone);
+
+        std::ostringstream size;
+        if(branch.type == SideBranch::Type::Helmholtz)
+            size << std::fixed << std::setprecision(0) << branch.volume * 1e6 << " cm3";
+        else
+            size << std::fixed << std::setprecision(1) << branch.length * 100.0 << " cm";
+
+        std::cout << std::setw(24) << std::left << branchCase.name << std::right << std::setw(14) << size.str() <<
+            std::fixed << std::setprecision(1) << std::setw(12) << getLevel({branch}, drone) - droneLevel <<
+            std::setw(12) << getLevel({branch}, 2.0 * drone) - offLevel << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    // the cost of the junctions for branches of both types spread along the pipe and tuned to
+    // different frequencies; the first branch also splits the loop to sections, which are read a
+    // sample at a time, so the cost of a branch is the slope of a line fit over the counts from one
+    // branch;
+    // the pipe is long enough that the branches are several samples apart and don't share junctions
+    const SimT costPipeLength = 4.0;
+    std::cout << std::endl << "cost of the branches on a " << costPipeLength << " m pipe, " << duration <<
+        " s of the cylinder" << std::endl;
+    std::cout << std::setw(10) << std::left << "branches" << std::right << std::setw(11) << "junctions" <<
+        std::setw(13) << "cpu/audio %" << std::setw(13) << "ns/sample" << std::endl;
+    std::vector<std::pair<SimT, SimT>> costs;
+    for(const size_t branchCount : {0, 1, 2, 4, 8, 16, 32, 64})
+    {
+        Simulation simulation{benchSamplingRate};
+        simulation.setPipeEngine(Simulation::PipeEngine::DelayLine);
+        simulation.pipe.setPipePhysicalLengthAndReset(costPipeLength);
+        std::vector<SideBranch> branches(branchCount);
+        for(size_t i = 0; i < branchCount; i++)
+        {
+            branches[i].type = i % 2 == 0 ? SideBranch::Type::QuarterWave : SideBranch::Type::Helmholtz;
+            branches[i].position = (static_cast<SimT>(i) + 0.5) / static_cast<SimT>(branchCount);
+            branches[i].length = 0.05;
+            branches[i].tune(simulation.pipe, 100.0 + 50.0 * static_cast<SimT>(i));
+        }
+        simulation.pipe.setSideBranches(branches);
+        measureRenderTime(simulation, 1.0);
+        const SimT time = measureRenderTime(simulation, duration);
+        const SimT sampleTime = time / benchSamplingRate * 1e9;
+        if(branchCount > 0)
+            costs.emplace_back(static_cast<SimT>(branchCount), sampleTime);
+
+        std::cout << std::setw(10) << std::left << branchCount << std::right <<
+            std::setw(11) << simulation.delayLinePipe.getJunctionCount() << std::fixed << std::setprecision(3) <<
+            std::setw(13) << time * 100.0 << std::setprecision(1) << std::setw(13) << sampleTime << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    // least squares slope
+    SimT meanCount = 0.0, meanTime = 0.0;
+    for(const auto& [count, time] : costs)
+    {
+        meanCount += count / static_cast<SimT>(costs.size());
+        meanTime += time / static_cast<SimT>(costs.size());
+    }
+    SimT covariance = 0.0, variance = 0.0;
+    for(const auto& [count, time] : costs)
+    {
+        covariance += (count - meanCount) * (time - meanTime);
+        variance += (count - meanCount) * (count - meanCount);
+    }
+    const SimT slope = covariance / variance;
+    SimT maxResidual = 0.0;
+    for(const auto& [count, time] : costs)
+        maxResidual = std::max(maxResidual, std::abs(time - meanTime - slope * (count - meanCount)));
+    std::cout << std::fixed << std::setprecision(1) << "fit from one branch: " << slope <<
+        " ns per branch and sample, " << meanTime - slope * meanCount << " ns at no branches, max residual " <<
+        maxResidual << " ns" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+
+    return 0;
+}
+
+// intake tract next to the exhaust: the resonance of the intake from its noise response against the
+// exact fundamental of its geometry and the mix against the two pipes rendered alone, per engine;
+// and the cost of the intake rendered after the exhaust and next to it per block size
+int benchmarkIntake(int argc, char* argv[])
+{
+    const SimT duration = argc > 0 ? std::atof(argv[0]) : 10.0;
+    constexpr SimT intakeLength = Simulation::startIntakeLength, intakeRadius = Simulation::startIntakeRadius;
+    constexpr SimT mixExhaustGain = 0.7, mixIntakeGain = 0.4;
+    const size_t fftSize = 32768;
+
+    std::cout << "intake " << intakeLength * 100.0 << " cm x " << intakeRadius * 1000.0 << " mm next to the exhaust, " <<
+        duration << " s of noise excitation, " << benchSamplingRate << " hz, " << benchBlockSize << " sample blocks" <<
+        std::endl;
+    std::cout << "mix error is the largest difference of " << mixExhaustGain << " exhaust - " << mixIntakeGain <<
+        " intake to the pipes rendered alone in relation to the peak" << std::endl;
+    std::cout << std::setw(8) << std::left << "engine" << std::right << std::setw(13) << "exhaust %" <<
+        std::setw(13) << "+ intake %" << std::setw(10) << "exact hz" << std::setw(10) << "peak hz" <<
+        std::setw(8) << "cents" << std::setw(12) << "mix error" << std::endl;
+
+    const std::pair<const char*, Simulation::PipeEngine> engines[] =
+    {
+        {"echo", Simulation::PipeEngine::Echo},
+        {"modal", Simulation::PipeEngine::Modal},
+        {"horn", Simulation::PipeEngine::Horn},
+        {"delay", Simulation::PipeEngine::DelayLine},
+    };
+
+    Simulation geometry{benchSamplingRate};
+    geometry.pipe.setPipePhysicalLengthAndReset(intakeLength);
+    geometry.pipe.setPipeRadiusAndReset(intakeRadius);
+    const SimT expected = geometry.modalPipe.getModeFrequency(0);
+    const SimT exact = getExactFundamental(geometry.pipe, expected);
+
+    for(const auto& [engineName, engine] : engines)
+    {
+        const auto render = [&, engine](const SimT exhaustGain, const SimT intakeGain, std::vector<SimT>& output)
+        {
+            return renderNoise([&](Simulation& simulation)
+            {
+                simulation.setPipeEngine(engine);
+                simulation.setIntakeGeometry(intakeLength, intakeRadius);
+                simulation.setMixGains(exhaustGain, intakeGain);
+            }, duration, output);
+        };
+        std::vector<SimT> exhaust, intake, mix;
+        const SimT exhaustTime = render(1.0, 0.0, exhaust);
+        render(0.0, -1.0, intake);
+        const SimT mixTime = render(mixExhaustGain, mixIntakeGain, mix);
+
+        SimT difference = 0.0, peak = 0.0;
+        for(size_t i = 0; i < mix.size(); i++)
+        {
+            difference = std::max(difference, std::abs(mix[i] - mixExhaustGain * exhaust[i] + mixIntakeGain * intake[i]));
+            peak = std::max(peak, std::abs(mix[i]));
+        }
+
+        // the peak is searched within 20 % of the estimated fundamental and refined with a
+        // parabola through the levels of its bins
+        const std::vector<SimT> spectrum = getPowerSpectrum(intake, fftSize);
+        const SimT binWidth = benchSamplingRate / fftSize;
+        const size_t first = static_cast<size_t>(expected * 0.8 / binWidth);
+        const size_t last = static_cast<size_t>(expected * 1.2 / binWidth);
+        const size_t peakBin = static_cast<size_t>(std::max_element(
+            spectrum.begin() + first, spectrum.begin() + last + 1) - spectrum.begin());
+        const SimT left = std::log(spectrum[peakBin - 1]), center = std::log(spectrum[peakBin]),
+            right = std::log(spectrum[peakBin + 1]);
+        const SimT offset = 0.5 * (left - right) / (left - 2.0 * center + right);
+        const SimT measured = (static_cast<SimT>(peakBin) + offset) * binWidth;
+
+        std::cout << std::setw(8) << std::left << engineName << std::right << std::fixed << std::setprecision(3) <<
+            std::setw(13) << exhaustTime * 100.0 << std::setw(13) << mixTime * 100.0 << std::setprecision(1) <<
+            std::setw(10) << exact << std::setw(10) << measured << std::setw(8) << 1200.0 * std::log2(measured / exact) <<
+            std::scientific << std::setprecision(2) << std::setw(12) << difference / peak << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    // the pulses of a v8 through the delay line engine with wall losses, which is the costliest per
+    // sample after the horn, and through the echo model
+    // the crossover is the smallest block size from which the handoff to the worker is faster at
+    // every larger size, which is the min sample count to give setIntakePool on this machine
+    std::cout << std::endl << "v8 pulses at 3000 rpm, " << duration << " s per block size, the parallel intake is a job " <<
+        "on a pool of two workers, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << "difference is the largest difference of the parallel output to the serial one, nested is the " <<
+        "parallel intake rendered inside a job of its own pool, which renders it serially" << std::endl;
+    std::cout << std::setw(8) << std::left << "engine" << std::right << std::setw(8) << "block" <<
+        std::setw(13) << "exhaust %" << std::setw(12) << "serial %" << std::setw(14) << "parallel %" <<
+        std::setw(10) << "speedup" << std::setw(13) << "difference" << std::setw(10) << "nested" << std::endl;
+
+    const auto renderBlocks = [duration](Simulation& simulation, const size_t blockSize, std::vector<SimT>& output)
+    {
+        const size_t blockCount = static_cast<size_t>(duration * benchSamplingRate) / blockSize;
+        output.clear();
+        output.reserve(blockCount * blockSize);
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t block = 0; block < blockCount; block++)
+        {
+            const Wave& wave = simulation.progressSimulation(static_cast<SimT>(blockSize));
+            output.insert(output.end(), wave.samples.begin(), wave.samples.end());
+        }
+        return std::chrono::duration<SimT>(std::chrono::steady_clock::now() - start).count() / duration;
+    };
+
+    ExcitationShape shape;
+    findExcitationPreset("v8bank", shape);
+    WorkStealingPool pool{2};
+    bool identical = true;
+    for(const auto& [engineName, engine] : {engines[0], engines[3]})
+    {
+        size_t crossover = 0;
+        for(const size_t blockSize : {32, 64, 128, 256, 512, 1024, 2048})
+        {
+            const auto renderCase = [&, engine](const SimT intakeGain, const bool parallel, std::vector<SimT>& output)
+            {
+                Simulation simulation{benchSamplingRate};
+                simulation.setPipeEngine(engine);
+                simulation.pipe.setWallLoss(engine == Simulation::PipeEngine::DelayLine);
+                simulation.cylinder.setExcitation(&shape);
+                simulation.cylinder.setFrequency(3000.0 / 120.0);
+                simulation.setMixGains(1.0, intakeGain);
+                simulation.setIntakePool(parallel ? &pool : nullptr, 1);
+                return renderBlocks(simulation, blockSize, output);
+            };
+            std::vector<SimT> exhaust, serial, parallel, nested;
+            const SimT exhaustTime = renderCase(0.0, false, exhaust);
+            const SimT serialTime = renderCase(0.5, false, serial);
+            const SimT parallelTime = renderCase(0.5, true, parallel);
+            // a nested dispatch to the pool would wait on the worker that runs the outer job
+            pool.run(1, [&](const size_t, const size_t) { renderCase(0.5, true, nested); });
+
+            SimT difference = 0.0;
+            for(size_t i = 0; i < serial.size(); i++)
+                difference = std::max(difference, std::abs(parallel[i] - serial[i]));
+            const bool nestedIdentical = nested == serial;
+            identical = identical && difference == 0.0 && nestedIdentical;
+            if(parallelTime >= serialTime)
+                crossover = 0;
+            else if(!crossover)
+                crossover = blockSize;
+
+            std::cout << std::setw(8) << std::left << engineName << std::right << std::setw(8) << blockSize <<
+                std::fixed << std::setprecision(3) << std::setw(13) << exhaustTime * 100.0 <<
+                std::setw(12) << serialTime * 100.0 << std::setw(14) << parallelTime * 100.0 <<
+                std::setprecision(2) << std::setw(10) << serialTime / parallelTime <<
+                std::scientific << std::setw(13) << difference << std::setw(10) <<
+                (nestedIdentical ? "same" : "differs") << std::endl;
+            std::cout.unsetf(std::ios::floatfield);
+        }
+
+        std::cout << "crossover of " << engineName << ": ";
+        if(crossover)
+            std::cout << crossover << " samples" << std::endl;
+        else
+            std::cout << "none, the serial intake is faster" << std::endl;
+    }
+
+    std::cout << std::endl << "parallel output identical: " << (identical ? "yes" : "no") << std::endl;
+
+    return identical ? 0 : 1;
+}
+
+struct Benchmark
+{
+    const char* name;
+    const char* description;
+    int (*run)(int argc, char* argv[]);
+};
+
+const Benchmark benchmarks[] =
+{
+    {"modal", "[seconds]  modal resonator bank vs the echo model", benchmarkModal},
+    {"horn", "[seconds]  fdtd horn engine vs the echo model and its cost per profile", benchmarkHorn},
+    {"batch", "[seconds]  simd batch of vehicles vs independent scalar delay line engines", benchmarkBatch},
+    {"voices", "[seconds]  voice manager with many echo engines on the work stealing pool", benchmarkVoices},
+    {"detail", "[seconds]  cost of the detail tiers and switching between them", benchmarkDetail},
+    {"snapshot", "[seconds]  size and speed of the state snapshots and determinism of a restore", benchmarkSnapshot},
+    {"warm", "[seconds]  settling of a cold start vs the warm start of every engine", benchmarkWarmStart},
+    {"excitation", "[seconds] [hz]  cost and aliasing of the pulse tables vs the sine", benchmarkExcitation},
+    {"coupling", "[seconds] [hz]  valve coupling at the closed end vs the closed end", benchmarkCoupling},
+    {"ramps", "[seconds]  rpm sweeps in per block steps vs the per sample ramps", benchmarkRamps},
+    {"replay", "[seconds]  parsing of an hour long drive log and the render speed of its replay", benchmarkReplay},
+    {"temperature", "[seconds]  resonance and cost of the engines with hot and cooling exhaust gas", benchmarkTemperature},
+    {"wallloss", "[seconds]  fit and cost of the wall loss filter and the pruning of the damped echoes",
+        benchmarkWallLoss},
+    {"fractional", "[seconds]  cost and error of the fractional delay per order and the tuning of short pipes",
+        benchmarkFractional},
+    {"branches", "[seconds]  drones with tuned resonators and side branches and the cost per branch",
+        benchmarkSideBranches},
+    {"intake", "[seconds]  resonance and mix of the intake tract and its cost next to the exhaust per block size",
+        benchmarkIntake},
+};
+
+}
+
+int runBenchmark(int argc, char* argv[])
+{
+    if(argc >= 1)
+    {
+        for(const auto& benchmark : benchmarks)
+        {
+            if(argv[0] == std::string(benchmark.name))
+                return benchmark.run(argc - 1, argv + 1);
+        }
+    }
+
+    std::cout << "usage: engine sound bench <name> [arguments]" << std::endl;
+    for(const auto& benchmark : benchmarks)
+        std::cout << "  " << benchmark.name << " " << benchmark.description << std::endl;
+
+    return argc >= 1 ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+#pragma once
+
+// runs the benchmark named by the first argument;
+// returns the process exit code
+int runBenchmark(int argc, char* argv[]);
\ No newline at end of file
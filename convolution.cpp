@@ -0,0 +1,203 @@
+#include "convolution.h"
+#include "trace.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cassert>
+
+#include <iostream>
+
+void ConvolutionFilter::setImpulseResponse(const std::vector<SimT>& impulseResponse)
+{
+    const size_t length =
+        (impulseResponse.size() + laneCount - 1) / laneCount * laneCount;
+
+    this->taps.assign(length, 0.0);
+    std::reverse_copy(impulseResponse.begin(), impulseResponse.end(),
+        this->taps.begin() + (length - impulseResponse.size()));
+
+    this->history.assign(2 * length, 0.0);
+    this->position = 0;
+}
+
+void ConvolutionFilter::reset()
+{
+    std::fill(this->history.begin(), this->history.end(), 0.0);
+    this->position = 0;
+}
+
+void ConvolutionFilter::process(Wave::SampleContainer& samples)
+{
+    TRACE_SCOPE("ConvolutionFilter::process");
+
+    if(this->taps.empty())
+        return;
+
+    const size_t length = this->taps.size();
+    const SimT* const taps = this->taps.data();
+    SimT* const history = this->history.data();
+
+    for(auto& sample : samples)
+    {
+        // the newest sample is at position + length, the oldest at position + 1
+        history[this->position] = history[this->position + length] = sample;
+        const SimT* const window = history + this->position + 1;
+
+        SimT laneSums[laneCount] = {};
+        for(size_t i = 0; i < length; i += laneCount)
+        {
+            for(size_t lane = 0; lane < laneCount; lane++)
+                laneSums[lane] += taps[i + lane] * window[i + lane];
+        }
+
+        SimT sum = 0.0;
+        for(size_t lane = 0; lane < laneCount; lane++)
+            sum += laneSums[lane];
+
+        sample = sum;
+        this->position = (this->position + 1) % length;
+    }
+}
+
+void ConvolutionFilter::fill(const Wave::SampleContainer& samples)
+{
+    if(this->taps.empty())
+        return;
+
+    const size_t length = this->taps.size();
+    for(const SimT sample : samples)
+    {
+        this->history[this->position] = this->history[this->position + length] = sample;
+        this->position = (this->position + 1) % length;
+    }
+}
+
+void ConvolutionFilter::saveState(SnapshotWriter& writer) const
+{
+    writer.writeVector(this->taps);
+    writer.writeVector(this->history);
+    writer.writeSize(this->position);
+}
+
+bool ConvolutionFilter::loadState(SnapshotReader& reader)
+{
+    reader.readVector(this->taps);
+    reader.readVector(this->history);
+    reader.readSize(this->position);
+
+    const size_t length = this->taps.size();
+    if(length % laneCount != 0 || this->history.size() != 2 * length ||
+        (length != 0 && this->position >= length))
+        reader.fail();
+
+    return reader.isValid();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+bool saveImpulseResponse(const std::string& path, const uint32_t samplingRate,
+    const std::vector<SimT>& impulseResponse)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if(!file)
+    {
+        std::cerr << "cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    const auto write = [&file](const auto value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    constexpr uint16_t formatIeeeFloat = 3;
+    const uint32_t dataSize = static_cast<uint32_t>(impulseResponse.size() * sizeof(float));
+
+    file.write("RIFF", 4);
+    write(static_cast<uint32_t>(36 + dataSize));
+    file.write("WAVE", 4);
+
+    file.write("fmt ", 4);
+    write(static_cast<uint32_t>(16));
+    write(formatIeeeFloat);
+    write(static_cast<uint16_t>(1));
+    write(samplingRate);
+    write(static_cast<uint32_t>(samplingRate * sizeof(float)));
+    write(static_cast<uint16_t>(sizeof(float)));
+    write(static_cast<uint16_t>(sizeof(float) * 8));
+
+    file.write("data", 4);
+    write(dataSize);
+    for(const SimT sample : impulseResponse)
+        write(static_cast<float>(sample));
+
+    return static_cast<bool>(file);
+}
+
+bool loadImpulseResponse(const std::string& path, uint32_t& samplingRate,
+    std::vector<SimT>& impulseResponse)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        std::cerr << "cannot open " << path << std::endl;
+        return false;
+    }
+
+    const auto read = [&file](auto& value)
+    {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    };
+
+    char id[4];
+    uint32_t size;
+    if(!file.read(id, 4) || std::memcmp(id, "RIFF", 4) != 0 || !read(size) ||
+        !file.read(id, 4) || std::memcmp(id, "WAVE", 4) != 0)
+    {
+        std::cerr << path << " is not a wav file" << std::endl;
+        return false;
+    }
+
+    // chunks are walked until the data, the format has to come before it
+    uint16_t formatTag = 0, channelCount = 0, bitsPerSample = 0;
+    while(file.read(id, 4) && read(size))
+    {
+        if(std::memcmp(id, "fmt ", 4) == 0)
+        {
+            uint32_t byteRate;
+            uint16_t blockAlign;
+            if(!read(formatTag) || !read(channelCount) || !read(samplingRate) ||
+                !read(byteRate) || !read(blockAlign) || !read(bitsPerSample))
+                break;
+            file.seekg(size - 16, std::ios::cur);
+        }
+        else if(std::memcmp(id, "data", 4) == 0)
+        {
+            if(formatTag != 3 || bitsPerSample != 32 || channelCount == 0)
+            {
+                std::cerr << path << " is not a 32 bit float wav file" << std::endl;
+                return false;
+            }
+
+            std::vector<float> samples(size / sizeof(float));
+            file.read(reinterpret_cast<char*>(samples.data()), samples.size() * sizeof(float));
+            samples.resize(static_cast<size_t>(file.gcount()) / sizeof(float));
+
+            impulseResponse.clear();
+            for(size_t i = 0; i < samples.size(); i += channelCount)
+                impulseResponse.push_back(samples[i]);
+
+            return true;
+        }
+        else
+            file.seekg(size + (size & 1), std::ios::cur);
+    }
+
+    std::cerr << path << " has no data" << std::endl;
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include "wave.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// applies an impulse response to a stream by direct convolution;
+// the history is mirrored to twice the response length so that the taps run over contiguous
+// memory, and the taps are padded to lane count so that the dot product vectorizes
+class ConvolutionFilter
+{
+public:
+    static constexpr size_t laneCount = 8;
+public:
+    // an empty response passes the stream through
+    void setImpulseResponse(const std::vector<SimT>& impulseResponse);
+    size_t getLength() const { return this->taps.size(); }
+    bool isEmpty() const { return this->taps.empty(); }
+
+    // filters the samples in place
+    void process(Wave::SampleContainer& samples);
+    // pushes the samples to the history without filtering them
+    void fill(const Wave::SampleContainer& samples);
+    void reset();
+
+    // state and parameters for the snapshots of Simulation
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
+private:
+    // reversed and padded impulse response
+    std::vector<SimT> taps;
+    std::vector<SimT> history;
+    size_t position = 0;
+};
+
+// mono 32 bit float wav files of impulse responses
+bool saveImpulseResponse(const std::string& path, const uint32_t samplingRate,
+    const std::vector<SimT>& impulseResponse);
+// the first channel is read of multichannel files
+bool loadImpulseResponse(const std::string& path, uint32_t& samplingRate,
+    std::vector<SimT>& impulseResponse);
\ No newline at end of file
@@ -0,0 +1,689 @@
+#include "delayline.h"
+#include "simulation.h"
+#include "trace.h"
+#include "snapshot.h"
+#include <cmath>
+#include <numbers>
+#include <complex>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+
+// grows a delay line to a power of two for the reads up to the delay, the samples are moved to the
+// same distances behind the position
+void fitWaves(std::vector<SimT>& waves, const size_t position, const SimT maxDelay)
+{
+    size_t capacity = 1;
+    while(capacity < static_cast<size_t>(maxDelay) + FractionalDelay::maxOrder + 2)
+        capacity <<= 1;
+    if(capacity <= waves.size())
+        return;
+
+    std::vector<SimT> grown(capacity, 0.0);
+    const size_t oldMask = waves.size() - 1, mask = capacity - 1;
+    for(size_t i = 1; i <= waves.size(); i++)
+        grown[(position - i) & mask] = waves[(position - i) & oldMask];
+    waves = std::move(grown);
+}
+
+// whether the reads up to the delay fit in a delay line of a power of two
+bool isFittingWaves(const std::vector<SimT>& waves, const SimT delay)
+{
+    const size_t capacity = waves.size();
+    return capacity != 0 && (capacity & (capacity - 1)) == 0 &&
+        delay + FractionalDelay::maxOrder + 2 <= static_cast<SimT>(capacity);
+}
+
+}
+
+DelayLinePipe::DelayLinePipe(Simulation& simulation, Cylinder& cylinder, const Pipe& pipe) :
+    outWave(simulation),
+    simulation(simulation),
+    cylinder(cylinder),
+    pipe(pipe)
+{
+}
+
+DelayLinePipe::Loop DelayLinePipe::getLoop(const SimT samplingRate,
+    const SimT pipeLengthPhysical, const SimT pipeRadius, const size_t echoIterations)
+{
+    return getLoopFromTravelTimes(samplingRate, pipeLengthPhysical / waveSpeed,
+        endCorrectionFactor * pipeRadius / waveSpeed, echoIterations);
+}
+
+DelayLinePipe::Loop DelayLinePipe::getLoopFromTravelTimes(const SimT samplingRate,
+    const SimT travelTime, const SimT endCorrectionTime, const size_t echoIterations)
+{
+    Loop loop;
+    // same radiation as in Pipe::splitToRadiatedAndReflectedWaves
+    loop.radiationGain = std::min(endCorrectionTime * samplingRate, maxRadiationGain);
+    // the reflection -g (y[n] - y[n-1]) - y[n-1] delays low frequencies by 1 - g samples,
+    // which is taken off the delay line
+    const SimT sampleCount = (travelTime + endCorrectionTime) * samplingRate;
+    loop.exactDelay = sampleCount - 0.5 * (1.0 - loop.radiationGain);
+    loop.delay = static_cast<size_t>(std::max<SimT>(1.0, std::round(loop.exactDelay)));
+    // the echo model stops after the echo iterations
+    loop.loss = 1.0 - 1.0 / static_cast<SimT>(echoIterations);
+
+    return loop;
+}
+
+void DelayLinePipe::reset()
+{
+    std::fill(this->forwardWaves.begin(), this->forwardWaves.end(), 0.0);
+    for(auto& section : this->sections)
+    {
+        std::fill(section.forwardWaves.begin(), section.forwardWaves.end(), 0.0);
+        std::fill(section.backwardWaves.begin(), section.backwardWaves.end(), 0.0);
+    }
+    for(auto& state : this->branchStates)
+    {
+        std::fill(state.waves.begin(), state.waves.end(), 0.0);
+        state.arriving = state.s1 = state.s2 = 0.0;
+    }
+    this->wallLossState = {};
+    this->lastIncident = this->lastReturning = 0.0;
+}
+
+void DelayLinePipe::warmStart()
+{
+    if(!this->isFitted())
+        this->fitLoop();
+    if(!this->sections.empty())
+    {
+        this->warmStartSections();
+        return;
+    }
+
+    // the steady state is of the new length
+    this->incidentDelay = this->targetIncidentDelay;
+    this->returnDelay = this->targetReturnDelay;
+    FractionalDelay incidentRead, returnRead;
+    incidentRead.design(this->fittedFractionalDelayOrder, this->incidentDelay);
+    returnRead.design(this->fittedFractionalDelayOrder, this->returnDelay);
+
+    // F = X / (1 - loss R H I), where R = -g (1 - z^-1) - z^-1 is the reflection of the open end,
+    // H the wall loss filter, which is in the round trip with its latency, and I the read of the
+    // returning wave;
+    // the input is Im(x e^jwn), where n = 0 is the last sample of the cylinder
+    const SimT frequency = this->cylinder.getFrequency();
+    const SimT samplingRate = this->simulation.samplingRate;
+    const SimT step = 2.0 * std::numbers::pi * frequency / samplingRate;
+    const std::complex<SimT> input = std::polar(Cylinder::conversationAmplitude, this->cylinder.getPhase());
+    const std::complex<SimT> delay = std::polar(1.0, -step);
+    const std::complex<SimT> reflection = -this->loop.radiationGain * (1.0 - delay) - delay;
+    const size_t latency = this->fittedWallLoss ? WallLossFilter::latency : 0;
+    const std::complex<SimT> wallLoss = this->fittedWallLoss ? this->wallLossFilter.getResponse(frequency) : 1.0;
+    const std::complex<SimT> returnTrip = returnRead.getResponse(frequency, samplingRate);
+    const std::complex<SimT> roundTrip = returnTrip * std::polar(1.0, -step * static_cast<SimT>(latency));
+    std::complex<SimT> forward = input / (1.0 - this->loop.loss * reflection * wallLoss * roundTrip);
+    if(this->fittedWallLoss)
+        this->wallLossFilter.setSteadyState(this->wallLossState, reflection * forward * returnTrip, frequency);
+    this->lastReturning = std::imag(forward * returnTrip);
+    this->lastIncident = std::imag(forward * incidentRead.getResponse(frequency, samplingRate));
+
+    // the last written sample is one before the position, the older ones go backwards from it
+    const size_t mask = this->forwardWaves.size() - 1;
+    for(size_t i = 0; i < this->forwardWaves.size(); i++)
+    {
+        this->forwardWaves[(this->position - 1 - i) & mask] = std::imag(forward);
+        forward *= delay;
+    }
+}
+
+bool DelayLinePipe::isFitted() const
+{
+    return this->fittedLength == this->pipe.getPipePhysicalLength() &&
+        this->fittedRadius == this->pipe.getPipeRadius() &&
+        this->fittedEchoIterations == this->pipe.getEchoIterations() &&
+        this->fittedTemperatures == this->pipe.getTemperatures() &&
+        this->fittedWallLoss == this->pipe.isWallLoss() &&
+        this->fittedFractionalDelayOrder == this->pipe.getFractionalDelayOrder() &&
+        this->fittedSideBranches == this->pipe.getSideBranches();
+}
+
+void DelayLinePipe::fitLoop()
+{
+    // the delay of the wall loss filter is taken off both ways and its latency off the return
+    this->fittedWallLoss = this->pipe.isWallLoss();
+    this->wallLossFilter = this->pipe.getWallLossFilter();
+    const SimT filterDelay = this->fittedWallLoss ?
+        0.5 * this->wallLossFilter.getDelay() / this->simulation.samplingRate : 0.0;
+    this->loop = getLoopFromTravelTimes(this->simulation.samplingRate, this->pipe.getTravelTime() - filterDelay,
+        this->pipe.getEndCorrectionTime(), this->pipe.getEchoIterations());
+    const SimT latency = this->fittedWallLoss ? static_cast<SimT>(WallLossFilter::latency) : 0.0;
+
+    // the reads only go to the samples before the current one
+    this->fittedFractionalDelayOrder = this->pipe.getFractionalDelayOrder();
+    const SimT minDelay = 1.0 + FractionalDelay::getMinDelay(this->fittedFractionalDelayOrder);
+    this->targetIncidentDelay = std::max(minDelay, this->loop.exactDelay);
+    this->targetReturnDelay = std::max(minDelay, 2.0 * this->loop.exactDelay - latency);
+    this->incidentDelay = std::max(minDelay, this->incidentDelay);
+    this->returnDelay = std::max(minDelay, this->returnDelay);
+
+    // the first fit starts at the new delays, the later ones ramp to them over the next progress,
+    // so the oldest read is at the longer of the delays
+    if(this->forwardWaves.empty())
+    {
+        this->incidentDelay = this->targetIncidentDelay;
+        this->returnDelay = this->targetReturnDelay;
+    }
+    fitWaves(this->forwardWaves, this->position, std::max({this->incidentDelay, this->returnDelay,
+        this->targetIncidentDelay, this->targetReturnDelay}));
+
+    // a change of the branches starts from silence, as does a change between the loop and the
+    // sections
+    if(this->fittedSideBranches != this->pipe.getSideBranches())
+    {
+        this->fittedSideBranches = this->pipe.getSideBranches();
+        this->sections.clear();
+        this->branchElements.clear();
+        this->branchStates.clear();
+        this->reset();
+    }
+    if(!this->fittedSideBranches.empty())
+        this->fitSections(latency);
+
+    this->fittedLength = this->pipe.getPipePhysicalLength();
+    this->fittedRadius = this->pipe.getPipeRadius();
+    this->fittedEchoIterations = this->pipe.getEchoIterations();
+    this->fittedTemperatures = this->pipe.getTemperatures();
+}
+
+void DelayLinePipe::progressSimulation(const size_t sampleCount)
+{
+    TRACE_SCOPE("DelayLinePipe::progressSimulation");
+
+    if(!this->isFitted())
+        this->fitLoop();
+
+    const Wave::SampleContainer& in = this->cylinder.currentOutWave.samples;
+    assert(in.size() == sampleCount);
+
+    this->outWave.samples.resize(sampleCount);
+    if(!this->sections.empty())
+    {
+        this->progressSections(sampleCount);
+        return;
+    }
+
+    SimT* const forwardWaves = this->forwardWaves.data();
+    const size_t mask = this->forwardWaves.size() - 1;
+    const SimT gain = this->loop.radiationGain, loss = this->loop.loss;
+    const bool wallLoss = this->fittedWallLoss;
+    const size_t order = this->fittedFractionalDelayOrder;
+
+    // the valves replace the closed end in a loop of its own, so the closed loop stays as it was
+    const SimT* valveReflections = nullptr;
+    SimT* backPressures = nullptr;
+    if(!this->cylinder.getValveReflections().empty())
+    {
+        assert(this->cylinder.getValveReflections().size() == sampleCount);
+        valveReflections = this->cylinder.getValveReflections().data();
+        backPressures = this->cylinder.getBackPressures();
+    }
+
+    // the delays step from the last ones to the fitted ones in chunks;
+    // a chunk only reads samples that were written before it, so the reads of a chunk are
+    // interpolated together
+    const SimT fromIncidentDelay = this->incidentDelay, fromReturnDelay = this->returnDelay;
+    const bool ramping = fromIncidentDelay != this->targetIncidentDelay || fromReturnDelay != this->targetReturnDelay;
+    FractionalDelay incidentRead, returnRead;
+    incidentRead.design(order, std::min(fromIncidentDelay, this->targetIncidentDelay));
+    returnRead.design(order, std::min(fromReturnDelay, this->targetReturnDelay));
+    const size_t maxChunkSize = std::min({ramping ? rampStepSize : FractionalDelay::chunkSize,
+        incidentRead.getWholeDelay(), returnRead.getWholeDelay()});
+
+    // gathers the samples of a read from the delay line for the kernel
+    const auto read = [&](const FractionalDelay& delay, SimT* output, const size_t count)
+    {
+        SimT buffer[FractionalDelay::chunkSize + FractionalDelay::maxOrder];
+        const size_t start = this->position - delay.getWholeDelay() - order;
+        for(size_t i = 0; i < count + order; i++)
+            buffer[i] = forwardWaves[(start + i) & mask];
+        delay.interpolate(buffer, output, count);
+    };
+
+    for(size_t first = 0; first < sampleCount;)
+    {
+        const size_t count = std::min(maxChunkSize, sampleCount - first);
+        if(ramping)
+        {
+            const SimT weight = static_cast<SimT>(first + count) / static_cast<SimT>(sampleCount);
+            incidentRead.design(order, fromIncidentDelay + weight * (this->targetIncidentDelay - fromIncidentDelay));
+            returnRead.design(order, fromReturnDelay + weight * (this->targetReturnDelay - fromReturnDelay));
+        }
+
+        // wave at the open end and the wave that was reflected from it back to the closed end
+        SimT incident[FractionalDelay::chunkSize], returning[FractionalDelay::chunkSize];
+        read(incidentRead, incident, count);
+        read(returnRead, returning, count);
+
+        for(size_t i = 0; i < count; i++, this->position++)
+        {
+            SimT reflected = -gain * (returning[i] - this->lastReturning) - this->lastReturning;
+            this->lastReturning = returning[i];
+            if(wallLoss)
+                reflected = this->wallLossFilter.process(this->wallLossState, reflected);
+            if(valveReflections)
+            {
+                forwardWaves[this->position & mask] =
+                    in[first + i] + valveReflections[first + i] * loss * reflected;
+                backPressures[first + i] += (1.0 + valveReflections[first + i]) * loss * reflected;
+            }
+            else
+                forwardWaves[this->position & mask] = in[first + i] + loss * reflected;
+
+            this->outWave.samples[first + i] = -gain * (incident[i] - this->lastIncident);
+            this->lastIncident = incident[i];
+        }
+
+        first += count;
+    }
+
+    this->incidentDelay = this->targetIncidentDelay;
+    this->returnDelay = this->targetReturnDelay;
+}
+
+void DelayLinePipe::fitSections(const SimT latency)
+{
+    const SimT samplingRate = this->simulation.samplingRate;
+    const size_t order = this->fittedFractionalDelayOrder;
+    const SimT minDelay = 1.0 + FractionalDelay::getMinDelay(order);
+
+    // the junctions go from the closed end at the travel times to the branches, the last section
+    // has the rest of the loop
+    std::vector<SideBranch> branches = this->fittedSideBranches;
+    std::stable_sort(branches.begin(), branches.end(),
+        [](const SideBranch& a, const SideBranch& b) { return a.position < b.position; });
+    std::vector<SimT> junctionDelays;
+    std::vector<size_t> branchCounts;
+    this->branchElements.resize(branches.size());
+    for(size_t i = 0; i < branches.size(); i++)
+    {
+        const SimT delay = this->pipe.getTravelTime(branches[i].position) * samplingRate;
+        const SimT previous = junctionDelays.empty() ? 0.0 : junctionDelays.back();
+        if(!junctionDelays.empty() && delay - previous < minDelay)
+            branchCounts.back()++;
+        else
+        {
+            junctionDelays.push_back(std::max(previous + minDelay, delay));
+            branchCounts.push_back(1);
+        }
+        this->branchElements[i].design(branches[i], this->pipe, samplingRate, order);
+    }
+    junctionDelays.push_back(std::max(junctionDelays.back() + minDelay, this->loop.exactDelay));
+    branchCounts.push_back(0);
+
+    // a new layout of the junctions starts from silence, otherwise the delays ramp to the new ones
+    // like the loop without the branches
+    const size_t sectionCount = junctionDelays.size();
+    bool layoutChanged = this->sections.size() != sectionCount || this->branchStates.size() != branches.size();
+    for(size_t k = 0; k < sectionCount && !layoutChanged; k++)
+        layoutChanged = this->sections[k].branchCount != branchCounts[k];
+    if(layoutChanged)
+    {
+        this->sections.assign(sectionCount, Section {});
+        this->branchStates.assign(branches.size(), SideBranchElement::State {});
+        this->wallLossState = {};
+        this->lastIncident = this->lastReturning = 0.0;
+    }
+
+    for(size_t k = 0; k < sectionCount; k++)
+    {
+        Section& section = this->sections[k];
+        const SimT delay = junctionDelays[k] - (k == 0 ? 0.0 : junctionDelays[k - 1]);
+        section.targetForwardDelay = std::max(minDelay, delay);
+        section.targetBackwardDelay = std::max(minDelay, k + 1 == sectionCount ? delay - latency : delay);
+        section.branchCount = branchCounts[k];
+        if(layoutChanged)
+        {
+            section.forwardDelay = section.targetForwardDelay;
+            section.backwardDelay = section.targetBackwardDelay;
+        }
+        section.forwardDelay = std::max(minDelay, section.forwardDelay);
+        section.backwardDelay = std::max(minDelay, section.backwardDelay);
+
+        fitWaves(section.forwardWaves, this->position, std::max(section.forwardDelay, section.targetForwardDelay));
+        fitWaves(section.backwardWaves, this->position,
+            std::max(section.backwardDelay, section.targetBackwardDelay));
+    }
+    for(size_t i = 0; i < branches.size(); i++)
+        this->branchElements[i].fitState(this->branchStates[i]);
+
+    this->forwardReads.resize(sectionCount);
+    this->backwardReads.resize(sectionCount);
+    this->forwardArrivals.resize(sectionCount);
+    this->backwardArrivals.resize(sectionCount);
+}
+
+void DelayLinePipe::progressSections(const size_t sampleCount)
+{
+    const Wave::SampleContainer& in = this->cylinder.currentOutWave.samples;
+    const SimT gain = this->loop.radiationGain, loss = this->loop.loss;
+    const bool wallLoss = this->fittedWallLoss;
+    const size_t order = this->fittedFractionalDelayOrder;
+    const size_t sectionCount = this->sections.size();
+
+    const SimT* valveReflections = nullptr;
+    SimT* backPressures = nullptr;
+    if(!this->cylinder.getValveReflections().empty())
+    {
+        assert(this->cylinder.getValveReflections().size() == sampleCount);
+        valveReflections = this->cylinder.getValveReflections().data();
+        backPressures = this->cylinder.getBackPressures();
+    }
+
+    // the reads are a sample at a time, since the waves of a junction go to the next sections
+    // right away
+    const auto read = [&](const std::vector<SimT>& waves, const FractionalDelay& delay)
+    {
+        return delay.interpolate(waves.data(), waves.size() - 1, this->position - delay.getWholeDelay() - order);
+    };
+
+    bool ramping = false;
+    for(const auto& section : this->sections)
+    {
+        ramping = ramping || section.forwardDelay != section.targetForwardDelay ||
+            section.backwardDelay != section.targetBackwardDelay;
+    }
+
+    for(size_t first = 0; first < sampleCount;)
+    {
+        const size_t count = ramping ? std::min(rampStepSize, sampleCount - first) : sampleCount - first;
+        const SimT weight = ramping ? static_cast<SimT>(first + count) / static_cast<SimT>(sampleCount) : 1.0;
+        for(size_t k = 0; k < sectionCount; k++)
+        {
+            const Section& section = this->sections[k];
+            this->forwardReads[k].design(order,
+                section.forwardDelay + weight * (section.targetForwardDelay - section.forwardDelay));
+            this->backwardReads[k].design(order,
+                section.backwardDelay + weight * (section.targetBackwardDelay - section.backwardDelay));
+        }
+
+        for(size_t i = first; i < first + count; i++, this->position++)
+        {
+            for(size_t k = 0; k < sectionCount; k++)
+            {
+                this->forwardArrivals[k] = read(this->sections[k].forwardWaves, this->forwardReads[k]);
+                this->backwardArrivals[k] = read(this->sections[k].backwardWaves, this->backwardReads[k]);
+            }
+
+            // the closed end, or the valves
+            const SimT returning = loss * this->backwardArrivals[0];
+            std::vector<SimT>& firstWaves = this->sections[0].forwardWaves;
+            if(valveReflections)
+            {
+                firstWaves[this->position & (firstWaves.size() - 1)] = in[i] + valveReflections[i] * returning;
+                backPressures[i] += (1.0 + valveReflections[i]) * returning;
+            }
+            else
+                firstWaves[this->position & (firstWaves.size() - 1)] = in[i] + returning;
+
+            // the pressure of a junction is shared and the flows add up, which is
+            // p = (2 (a1 + a2) - sum h) / (2 + sum y) in relation to the admittance of the pipe
+            // for the waves a1 and a2 that come from the sections
+            size_t element = 0;
+            for(size_t k = 0; k + 1 < sectionCount; k++)
+            {
+                const SimT left = this->forwardArrivals[k], right = this->backwardArrivals[k + 1];
+                const size_t lastElement = element + this->sections[k].branchCount;
+                SimT source = 0.0, admittance = 2.0;
+                for(size_t j = element; j < lastElement; j++)
+                {
+                    source += this->branchElements[j].prepare(this->branchStates[j]);
+                    admittance += this->branchElements[j].getAdmittance();
+                }
+                const SimT pressure = (2.0 * (left + right) - source) / admittance;
+                for(; element < lastElement; element++)
+                    this->branchElements[element].process(this->branchStates[element], pressure);
+
+                std::vector<SimT>& backwardWaves = this->sections[k].backwardWaves;
+                std::vector<SimT>& forwardWaves = this->sections[k + 1].forwardWaves;
+                backwardWaves[this->position & (backwardWaves.size() - 1)] = pressure - left;
+                forwardWaves[this->position & (forwardWaves.size() - 1)] = pressure - right;
+            }
+
+            // the open end
+            const SimT incident = this->forwardArrivals[sectionCount - 1];
+            SimT reflected = -gain * (incident - this->lastIncident) - this->lastIncident;
+            this->outWave.samples[i] = -gain * (incident - this->lastIncident);
+            this->lastIncident = incident;
+            if(wallLoss)
+                reflected = this->wallLossFilter.process(this->wallLossState, reflected);
+            std::vector<SimT>& lastWaves = this->sections[sectionCount - 1].backwardWaves;
+            lastWaves[this->position & (lastWaves.size() - 1)] = reflected;
+        }
+
+        first += count;
+    }
+
+    for(auto& section : this->sections)
+    {
+        section.forwardDelay = section.targetForwardDelay;
+        section.backwardDelay = section.targetBackwardDelay;
+    }
+}
+
+void DelayLinePipe::warmStartSections()
+{
+    const size_t order = this->fittedFractionalDelayOrder;
+    const size_t sectionCount = this->sections.size();
+    const SimT frequency = this->cylinder.getFrequency();
+    const SimT samplingRate = this->simulation.samplingRate;
+    const SimT step = 2.0 * std::numbers::pi * frequency / samplingRate;
+    const std::complex<SimT> delay = std::polar(1.0, -step);
+
+    // round trips of the sections in the steady state of the new length
+    std::vector<std::complex<SimT>> forwardTrips(sectionCount), roundTrips(sectionCount);
+    for(size_t k = 0; k < sectionCount; k++)
+    {
+        Section& section = this->sections[k];
+        section.forwardDelay = section.targetForwardDelay;
+        section.backwardDelay = section.targetBackwardDelay;
+        FractionalDelay forwardRead, backwardRead;
+        forwardRead.design(order, section.forwardDelay);
+        backwardRead.design(order, section.backwardDelay);
+        forwardTrips[k] = forwardRead.getResponse(frequency, samplingRate);
+        roundTrips[k] = forwardTrips[k] * backwardRead.getResponse(frequency, samplingRate);
+    }
+
+    // G[k] is the wave that the open end side of section k sends back to the wave that comes to
+    // it; at a junction the wave from the next section is a2 = p G E / (1 + G E) for its round
+    // trip E, so p = 2 a1 / (2 + Y - 2 G E / (1 + G E)) for the admittance Y of the branches
+    const std::complex<SimT> reflection = -this->loop.radiationGain * (1.0 - delay) - delay;
+    const SimT latency = this->fittedWallLoss ? static_cast<SimT>(WallLossFilter::latency) : 0.0;
+    const std::complex<SimT> wallLoss = this->fittedWallLoss ?
+        this->wallLossFilter.getResponse(frequency) * std::polar(1.0, -step * latency) : 1.0;
+    std::vector<std::complex<SimT>> returns(sectionCount), pressureGains(sectionCount);
+    returns[sectionCount - 1] = reflection * wallLoss;
+    std::vector<size_t> firstElements(sectionCount, 0);
+    for(size_t k = 1; k < sectionCount; k++)
+        firstElements[k] = firstElements[k - 1] + this->sections[k - 1].branchCount;
+    for(size_t k = sectionCount - 1; k-- > 0;)
+    {
+        std::complex<SimT> admittance = 0.0;
+        for(size_t j = firstElements[k]; j < firstElements[k] + this->sections[k].branchCount; j++)
+            admittance += this->branchElements[j].getResponse(frequency);
+        const std::complex<SimT> echo = returns[k + 1] * roundTrips[k + 1];
+        pressureGains[k] = 2.0 / (2.0 + admittance - 2.0 * echo / (1.0 + echo));
+        returns[k] = pressureGains[k] - 1.0;
+    }
+
+    // the input is Im(x e^jwn), where n = 0 is the last sample of the cylinder;
+    // the last written sample is one before the position, the older ones go backwards from it
+    const auto fill = [&](std::vector<SimT>& waves, std::complex<SimT> wave)
+    {
+        const size_t mask = waves.size() - 1;
+        for(size_t i = 0; i < waves.size(); i++)
+        {
+            waves[(this->position - 1 - i) & mask] = std::imag(wave);
+            wave *= delay;
+        }
+    };
+    const std::complex<SimT> input = std::polar(Cylinder::conversationAmplitude, this->cylinder.getPhase());
+    std::complex<SimT> forward = input / (1.0 - this->loop.loss * returns[0] * roundTrips[0]);
+    for(size_t k = 0; k < sectionCount; k++)
+    {
+        const std::complex<SimT> arriving = forward * forwardTrips[k];
+        fill(this->sections[k].forwardWaves, forward);
+        fill(this->sections[k].backwardWaves, returns[k] * arriving);
+        if(k + 1 == sectionCount)
+        {
+            if(this->fittedWallLoss)
+                this->wallLossFilter.setSteadyState(this->wallLossState, reflection * arriving, frequency);
+            this->lastIncident = std::imag(arriving);
+            break;
+        }
+
+        const std::complex<SimT> pressure = pressureGains[k] * arriving;
+        for(size_t j = firstElements[k]; j < firstElements[k] + this->sections[k].branchCount; j++)
+            this->branchElements[j].setSteadyState(this->branchStates[j], pressure, frequency);
+        forward = pressure / (1.0 + returns[k + 1] * roundTrips[k + 1]);
+    }
+}
+
+void DelayLinePipe::saveState(SnapshotWriter& writer) const
+{
+    writer.writeSize(this->loop.delay);
+    writer.write(this->loop.exactDelay);
+    writer.write(this->loop.radiationGain);
+    writer.write(this->loop.loss);
+    writer.writeVector(this->forwardWaves);
+    writer.writeSize(this->position);
+    writer.write(this->fittedLength);
+    writer.write(this->fittedRadius);
+    writer.writeSize(this->fittedEchoIterations);
+    writer.writeVector(this->fittedTemperatures);
+    writer.write(this->fittedWallLoss);
+    writer.write(this->wallLossFilter);
+    writer.write(this->wallLossState);
+    writer.writeSize(this->fittedFractionalDelayOrder);
+    writer.write(this->incidentDelay);
+    writer.write(this->returnDelay);
+    writer.write(this->targetIncidentDelay);
+    writer.write(this->targetReturnDelay);
+    writer.write(this->lastIncident);
+    writer.write(this->lastReturning);
+
+    writer.writeVector(this->fittedSideBranches);
+    writer.writeSize(this->sections.size());
+    for(const auto& section : this->sections)
+    {
+        writer.writeVector(section.forwardWaves);
+        writer.writeVector(section.backwardWaves);
+        writer.write(section.forwardDelay);
+        writer.write(section.backwardDelay);
+        writer.write(section.targetForwardDelay);
+        writer.write(section.targetBackwardDelay);
+        writer.writeSize(section.branchCount);
+    }
+    writer.writeVector(this->branchElements);
+    writer.writeSize(this->branchStates.size());
+    for(const auto& state : this->branchStates)
+    {
+        writer.writeVector(state.waves);
+        writer.writeSize(state.position);
+        writer.write(state.arriving);
+        writer.write(state.s1);
+        writer.write(state.s2);
+    }
+}
+
+bool DelayLinePipe::loadState(SnapshotReader& reader)
+{
+    reader.readSize(this->loop.delay);
+    reader.read(this->loop.exactDelay);
+    reader.read(this->loop.radiationGain);
+    reader.read(this->loop.loss);
+    reader.readVector(this->forwardWaves);
+    reader.readSize(this->position);
+    reader.read(this->fittedLength);
+    reader.read(this->fittedRadius);
+    reader.readSize(this->fittedEchoIterations);
+    reader.readVector(this->fittedTemperatures);
+    reader.read(this->fittedWallLoss);
+    reader.read(this->wallLossFilter);
+    reader.read(this->wallLossState);
+    reader.readSize(this->fittedFractionalDelayOrder);
+    reader.read(this->incidentDelay);
+    reader.read(this->returnDelay);
+    reader.read(this->targetIncidentDelay);
+    reader.read(this->targetReturnDelay);
+    reader.read(this->lastIncident);
+    reader.read(this->lastReturning);
+
+    reader.readVector(this->fittedSideBranches);
+    size_t sectionCount = 0;
+    reader.readSize(sectionCount);
+    this->sections.clear();
+    for(size_t i = 0; i < sectionCount && reader.isValid(); i++)
+    {
+        Section section;
+        reader.readVector(section.forwardWaves);
+        reader.readVector(section.backwardWaves);
+        reader.read(section.forwardDelay);
+        reader.read(section.backwardDelay);
+        reader.read(section.targetForwardDelay);
+        reader.read(section.targetBackwardDelay);
+        reader.readSize(section.branchCount);
+        this->sections.push_back(std::move(section));
+    }
+    reader.readVector(this->branchElements);
+    size_t stateCount = 0;
+    reader.readSize(stateCount);
+    this->branchStates.clear();
+    for(size_t i = 0; i < stateCount && reader.isValid(); i++)
+    {
+        SideBranchElement::State state;
+        reader.readVector(state.waves);
+        reader.readSize(state.position);
+        reader.read(state.arriving);
+        reader.read(state.s1);
+        reader.read(state.s2);
+        this->branchStates.push_back(std::move(state));
+    }
+    this->forwardReads.resize(this->sections.size());
+    this->backwardReads.resize(this->sections.size());
+    this->forwardArrivals.resize(this->sections.size());
+    this->backwardArrivals.resize(this->sections.size());
+
+    // the positions wrap with a mask and the oldest read is the longest delay and the taps back;
+    // every read is at least a sample back; a line that was never fitted has no delays
+    const size_t capacity = this->forwardWaves.size();
+    const SimT minDelay = 1.0 + FractionalDelay::getMinDelay(this->fittedFractionalDelayOrder);
+    const SimT delays[] = {this->incidentDelay, this->returnDelay, this->targetIncidentDelay, this->targetReturnDelay};
+    if((capacity & (capacity - 1)) != 0 || this->fittedFractionalDelayOrder > FractionalDelay::maxOrder ||
+        std::any_of(std::begin(delays), std::end(delays), [&](const SimT delay)
+        {
+            return capacity != 0 &&
+                (!(delay >= minDelay) || !(delay + FractionalDelay::maxOrder + 2 <= static_cast<SimT>(capacity)));
+        }))
+        reader.fail();
+
+    // the same for the sections; the junctions between them have branches and the last section
+    // ends at the open end, every branch has its element and the samples of its reads
+    size_t branchCount = 0;
+    for(size_t k = 0; k < this->sections.size(); k++)
+    {
+        const Section& section = this->sections[k];
+        branchCount += section.branchCount;
+        if((section.branchCount == 0) != (k + 1 == this->sections.size()) ||
+            !(std::min({section.forwardDelay, section.backwardDelay,
+                section.targetForwardDelay, section.targetBackwardDelay}) >= minDelay) ||
+            !isFittingWaves(section.forwardWaves, std::max(section.forwardDelay, section.targetForwardDelay)) ||
+            !isFittingWaves(section.backwardWaves, std::max(section.backwardDelay, section.targetBackwardDelay)))
+            reader.fail();
+    }
+    if(branchCount != this->branchElements.size() || this->branchStates.size() != this->branchElements.size())
+        reader.fail();
+    for(size_t i = 0; i < this->branchElements.size() && reader.isValid(); i++)
+    {
+        if(!this->branchElements[i].isFitting(this->branchStates[i]))
+            reader.fail();
+    }
+
+    return reader.isValid();
+}
\ No newline at end of file
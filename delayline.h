@@ -0,0 +1,126 @@
+#pragma once
+#include "wave.h"
+#include "wallloss.h"
+#include "fractionaldelay.h"
+#include "sidebranch.h"
+#include <vector>
+
+class Simulation;
+class SnapshotWriter;
+class SnapshotReader;
+class Cylinder;
+class Pipe;
+
+// closed-open pipe as a delay loop of the forward wave at the closed end;
+// the open end has the radiation and the reflection of Pipe::splitToRadiatedAndReflectedWaves,
+// so this is the echo model with a fixed cost per sample:
+// f[n] = x[n] + loss * r(f[n - 2D]), out[n] = -g (f[n - D] - f[n - D - 1]);
+// the delays are read with the fractional delay of the order of Pipe, so D is continuous and a new
+// length ramps in over a progress;
+// with the valve coupling the returning wave is also scaled by the reflection of the valves;
+// with the wall losses of Pipe the returning wave goes through the wall loss filter, which is read
+// its latency earlier from the delay line;
+// with the side branches of Pipe the pipe is split to sections at the junctions of the branches,
+// each with a delay line both ways, and the junctions scatter the waves of the sections and the
+// branches at a fixed cost per branch and sample; the reflections of the ends are the same
+class DelayLinePipe
+{
+public:
+    // radiation gain of the open end in relation to one sample;
+    // the loop is stable up to 1, which is a radius of about 1.2 cm at 48 khz
+    static constexpr SimT maxRadiationGain = 1.0;
+    // samples between the steps of the delays while they ramp to a new length
+    static constexpr size_t rampStepSize = 32;
+
+    // delay loop parameters shared with the batched engine
+    struct Loop
+    {
+        // one way delay in whole samples
+        size_t delay;
+        // one way delay in samples before the rounding
+        SimT exactDelay;
+        SimT radiationGain;
+        // of a round trip
+        SimT loss;
+    };
+public:
+    // radiated pressure of the last progress
+    Wave outWave;
+
+    DelayLinePipe(Simulation& simulation, Cylinder& cylinder, const Pipe& pipe);
+
+    static Loop getLoop(const SimT samplingRate, const SimT pipeLengthPhysical,
+        const SimT pipeRadius, const size_t echoIterations);
+    // from the travel times of Pipe, for pipes that aren't at the reference temperature
+    static Loop getLoopFromTravelTimes(const SimT samplingRate, const SimT travelTime,
+        const SimT endCorrectionTime, const size_t echoIterations);
+    const Loop& getLoop() const { return this->loop; }
+    // of the last fit; branches closer than the shortest read share a junction
+    size_t getJunctionCount() const { return this->sections.empty() ? 0 : this->sections.size() - 1; }
+
+    // refits the loop if the geometry of the pipe has changed;
+    // the delay line keeps its contents
+    void progressSimulation(const size_t sampleCount);
+    void reset();
+    // fills the delay line with the steady state of the loop for the sine of the cylinder at its
+    // current phase
+    void warmStart();
+
+    // state and parameters for the snapshots of Simulation
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
+private:
+    // part of the pipe between the ends and the junctions
+    struct Section
+    {
+        // waves written at the closed end side to the open end and at the open end side back to the
+        // closed end, powers of two so that the positions wrap with a mask
+        std::vector<SimT> forwardWaves, backwardWaves;
+        // delays of the reads at the other side at the end of the last progress and of the fit;
+        // the backward delay of the last section is less the latency of the wall loss filter
+        SimT forwardDelay = 0.0, backwardDelay = 0.0;
+        SimT targetForwardDelay = 0.0, targetBackwardDelay = 0.0;
+        // at the junction on the open end side, the branches of the junctions are in their order in
+        // the branch elements
+        size_t branchCount = 0;
+    };
+
+    Simulation& simulation;
+    Cylinder& cylinder;
+    const Pipe& pipe;
+    Loop loop {};
+    WallLossFilter wallLossFilter;
+    WallLossFilter::State wallLossState;
+    // delays of the reads of the incident wave and the returning wave, 2D less the latency of the
+    // wall loss filter, at the end of the last progress and of the fit
+    SimT incidentDelay = 0.0, returnDelay = 0.0;
+    SimT targetIncidentDelay = 0.0, targetReturnDelay = 0.0;
+    // reads of the sample before the progress
+    SimT lastIncident = 0.0, lastReturning = 0.0;
+
+    // power of two so that the positions wrap with a mask
+    std::vector<SimT> forwardWaves;
+    size_t position = 0;
+
+    SimT fittedLength = 0.0, fittedRadius = 0.0;
+    size_t fittedEchoIterations = 0;
+    std::vector<SimT> fittedTemperatures;
+    bool fittedWallLoss = false;
+    size_t fittedFractionalDelayOrder = 0;
+    std::vector<SideBranch> fittedSideBranches;
+
+    // empty without side branches, the forward waves are the loop then
+    std::vector<Section> sections;
+    std::vector<SideBranchElement> branchElements;
+    std::vector<SideBranchElement::State> branchStates;
+    // reads of the sections and the waves that arrive at their ends in a sample
+    std::vector<FractionalDelay> forwardReads, backwardReads;
+    std::vector<SimT> forwardArrivals, backwardArrivals;
+
+    bool isFitted() const;
+    void fitLoop();
+    // the junctions where the branches are, the closer ones than a read share a junction
+    void fitSections(const SimT latency);
+    void progressSections(const size_t sampleCount);
+    void warmStartSections();
+};
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include "excitation.h"
+#include "fft.h"
+#include "snapshot.h"
+#include <complex>
+#include <mutex>
+#include <cmath>
+#include <numbers>
+#include <algorithm>
+#include <cassert>
+
+void NoiseGenerator::seed(const uint32_t seed)
+{
+    // xorshift never leaves zero, so the lanes are seeded from a hash of the lane
+    for(size_t lane = 0; lane < laneCount; lane++)
+    {
+        uint32_t state = seed + static_cast<uint32_t>(lane) * 0x9e3779b9u;
+        state = (state ^ (state >> 16)) * 0x85ebca6bu;
+        state = (state ^ (state >> 13)) * 0xc2b2ae35u;
+        state ^= state >> 16;
+        this->states[lane] = state ? state : 1;
+    }
+}
+
+void NoiseGenerator::step(SimT* samples)
+{
+    for(size_t lane = 0; lane < laneCount; lane++)
+    {
+        uint32_t state = this->states[lane];
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        this->states[lane] = state;
+        samples[lane] = static_cast<SimT>(static_cast<int32_t>(state)) * (1.0 / 2147483648.0);
+    }
+}
+
+void NoiseGenerator::fill(SimT* samples, const size_t count)
+{
+    size_t i = 0;
+    for(; i + laneCount <= count; i += laneCount)
+        this->step(samples + i);
+
+    // the rest of the last step is dropped
+    if(i < count)
+    {
+        SimT rest[laneCount];
+        this->step(rest);
+        std::copy(rest, rest + (count - i), samples + i);
+    }
+}
+
+void NoiseGenerator::saveState(SnapshotWriter& writer) const
+{
+    for(const uint32_t state : this->states)
+        writer.write(state);
+}
+
+bool NoiseGenerator::loadState(SnapshotReader& reader)
+{
+    for(uint32_t& state : this->states)
+        reader.read(state);
+    if(std::find(std::begin(this->states), std::end(this->states), 0u) != std::end(this->states))
+        return reader.fail();
+
+    return reader.isValid();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+void ExcitationShape::getPressure(const SimT cyclePosition, const SimT cycleFrequency,
+    SimT& blowdown, SimT& displacement) const
+{
+    blowdown = displacement = 0.0;
+    for(const SimT firingAngle : this->firingAngles)
+    {
+        const SimT angle = std::fmod(cyclePosition * 720.0 - firingAngle - this->valveOpenAngle + 1440.0, 720.0);
+        if(angle >= this->valveOpenDuration)
+            continue;
+
+        // the valve closes over the last quarter of the duration
+        const SimT open = angle / this->valveOpenDuration;
+        const SimT closing = open < 0.75 ? 1.0 : 0.5 + 0.5 * std::cos(std::numbers::pi * (open - 0.75) / 0.25);
+        const SimT time = angle / 720.0 / cycleFrequency;
+        blowdown += (1.0 - std::exp(-time / this->riseTime)) * std::exp(-time / this->blowdownTime) * closing;
+
+        const SimT stroke = std::sin(std::numbers::pi * open);
+        displacement += this->displacementLevel * stroke * stroke;
+    }
+}
+
+SimT ExcitationShape::getValveArea(const SimT cyclePosition) const
+{
+    SimT area = 0.0;
+    for(const SimT firingAngle : this->firingAngles)
+    {
+        const SimT angle = std::fmod(cyclePosition * 720.0 - firingAngle - this->valveOpenAngle + 1440.0, 720.0);
+        if(angle < this->valveOpenDuration)
+            area += this->valveAreaRatio * std::sin(std::numbers::pi * angle / this->valveOpenDuration);
+    }
+
+    return area;
+}
+
+void ExcitationShape::saveState(SnapshotWriter& writer) const
+{
+    writer.writeVector(this->firingAngles);
+    writer.write(this->valveOpenAngle);
+    writer.write(this->valveOpenDuration);
+    writer.write(this->riseTime);
+    writer.write(this->blowdownTime);
+    writer.write(this->displacementLevel);
+    writer.write(this->valveAreaRatio);
+}
+
+bool ExcitationShape::loadState(SnapshotReader& reader)
+{
+    reader.readVector(this->firingAngles);
+    reader.read(this->valveOpenAngle);
+    reader.read(this->valveOpenDuration);
+    reader.read(this->riseTime);
+    reader.read(this->blowdownTime);
+    reader.read(this->displacementLevel);
+    reader.read(this->valveAreaRatio);
+    if(this->riseTime <= 0.0 || this->blowdownTime <= 0.0 || this->valveOpenDuration <= 0.0 ||
+        this->valveAreaRatio < 0.0)
+        return reader.fail();
+
+    return reader.isValid();
+}
+
+namespace
+{
+
+struct ExcitationPreset
+{
+    const char* name;
+    std::vector<SimT> firingAngles;
+};
+
+// single bank of a cross plane v8 fires unevenly, which gives its burble
+const ExcitationPreset excitationPresets[] =
+{
+    {"single", {0.0}},
+    {"twin", {0.0, 360.0}},
+    {"vtwin", {0.0, 315.0}},
+    {"inline4", {0.0, 180.0, 360.0, 540.0}},
+    {"v8bank", {0.0, 180.0, 270.0, 450.0}},
+};
+
+}
+
+bool findExcitationPreset(const std::string& name, ExcitationShape& shape)
+{
+    for(const auto& preset : excitationPresets)
+    {
+        if(name == preset.name)
+        {
+            shape = ExcitationShape{};
+            shape.firingAngles = preset.firingAngles;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* getExcitationPresetNames()
+{
+    return "single|twin|vtwin|inline4|v8bank";
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+ExcitationTable::ExcitationTable(const ExcitationShape& shape, const SimT samplingRate) :
+    shape(shape),
+    samplingRate(samplingRate),
+    bands(bandCount),
+    valveReflections(tableLength + 1)
+{
+    assert(!shape.firingAngles.empty());
+
+    for(size_t i = 0; i < tableLength; i++)
+    {
+        const SimT area = shape.getValveArea(static_cast<SimT>(i) / static_cast<SimT>(tableLength));
+        this->valveReflections[i] = (1.0 - area) / (1.0 + area);
+    }
+    this->valveReflections[tableLength] = this->valveReflections[0];
+
+    for(size_t i = 0; i < bandCount; i++)
+    {
+        Band& band = this->bands[i];
+        band.frequency = minFrequency * std::exp2(static_cast<SimT>(i) / bandsPerOctave);
+        const SimT nextFrequency = minFrequency * std::exp2(static_cast<SimT>(i + 1) / bandsPerOctave);
+        band.harmonicCount = std::min(maxHarmonicCount,
+            static_cast<size_t>(0.5 * samplingRate / nextFrequency));
+
+        this->buildBand(band);
+    }
+}
+
+std::shared_ptr<const ExcitationTable> ExcitationTable::get(const ExcitationShape& shape, const SimT samplingRate)
+{
+    static std::mutex mutex;
+    static std::vector<std::weak_ptr<const ExcitationTable>> tables;
+
+    const std::lock_guard lock{mutex};
+    std::erase_if(tables, [](const std::weak_ptr<const ExcitationTable>& table) { return table.expired(); });
+    for(const auto& weakTable : tables)
+    {
+        std::shared_ptr<const ExcitationTable> table = weakTable.lock();
+        if(table && table->shape == shape && table->samplingRate == samplingRate)
+            return table;
+    }
+
+    auto table = std::make_shared<const ExcitationTable>(shape, samplingRate);
+    tables.push_back(table);
+    return table;
+}
+
+SimT ExcitationTable::getBandPosition(const SimT frequency) const
+{
+    return std::clamp(std::log2(std::max(frequency, minFrequency) / minFrequency) * bandsPerOctave,
+        0.0, static_cast<SimT>(bandCount - 1));
+}
+
+void ExcitationTable::findBands(const SimT frequency, size_t& band, SimT& weight) const
+{
+    const SimT position = this->getBandPosition(frequency);
+    band = std::min(static_cast<size_t>(position), bandCount - 2);
+    weight = position - static_cast<SimT>(band);
+}
+
+size_t ExcitationTable::getMemoryUsage() const
+{
+    size_t size = sizeof(*this) + this->valveReflections.size() * sizeof(SimT);
+    for(const auto& band : this->bands)
+    {
+        size += sizeof(band) + (band.blowdown.size() + band.displacement.size() + band.envelope.size()) *
+            sizeof(SimT);
+    }
+
+    return size;
+}
+
+void ExcitationTable::buildBand(Band& band) const
+{
+    // the harmonics are taken from the oversampled shape and the tables are synthesized from them,
+    // which leaves out the dc and everything over the harmonic count
+    const size_t sampleCount = tableLength * oversampling;
+    std::vector<std::complex<SimT>> blowdown(sampleCount), displacement(sampleCount);
+    band.envelope.resize(tableLength + 1);
+    SimT envelopePeak = 0.0;
+    for(size_t i = 0; i < sampleCount; i++)
+    {
+        SimT blowdownPressure, displacementPressure;
+        this->shape.getPressure(static_cast<SimT>(i) / static_cast<SimT>(sampleCount), band.frequency,
+            blowdownPressure, displacementPressure);
+        blowdown[i] = blowdownPressure;
+        displacement[i] = displacementPressure;
+
+        if(i % oversampling == 0)
+        {
+            band.envelope[i / oversampling] = blowdownPressure;
+            envelopePeak = std::max(envelopePeak, blowdownPressure);
+        }
+    }
+    fft(blowdown);
+    fft(displacement);
+
+    const auto synthesize = [&](const std::vector<std::complex<SimT>>& spectrum, std::vector<SimT>& table)
+    {
+        std::vector<std::complex<SimT>> harmonics(tableLength, 0.0);
+        for(size_t harmonic = 1; harmonic <= band.harmonicCount; harmonic++)
+        {
+            harmonics[harmonic] = spectrum[harmonic] / static_cast<SimT>(sampleCount);
+            harmonics[tableLength - harmonic] = std::conj(harmonics[harmonic]);
+        }
+        fft(harmonics, true);
+
+        table.resize(tableLength + 1);
+        for(size_t i = 0; i < tableLength; i++)
+            table[i] = harmonics[i].real();
+        table[tableLength] = table[0];
+    };
+    synthesize(blowdown, band.blowdown);
+    synthesize(displacement, band.displacement);
+
+    // by parseval, the mean square of a table is the sum of the harmonic powers
+    SimT power = 0.0;
+    for(size_t harmonic = 1; harmonic <= band.harmonicCount; harmonic++)
+        power += 2.0 * std::norm((blowdown[harmonic] + displacement[harmonic]) / static_cast<SimT>(sampleCount));
+
+    const SimT gain = power > 0.0 ? std::sqrt(0.5 / power) : 0.0;
+    for(size_t i = 0; i <= tableLength; i++)
+    {
+        band.blowdown[i] *= gain;
+        band.displacement[i] *= gain;
+    }
+
+    for(size_t i = 0; i < tableLength; i++)
+        band.envelope[i] = envelopePeak > 0.0 ? band.envelope[i] / envelopePeak : 0.0;
+    band.envelope[tableLength] = band.envelope[0];
+}
\ No newline at end of file
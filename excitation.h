@@ -0,0 +1,143 @@
+#pragma once
+#include "wave.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// uniform noise in range [-1, 1) from independent xorshift generators, one per lane;
+// the lanes are stepped together so that a block of noise vectorizes
+class NoiseGenerator
+{
+public:
+    static constexpr size_t laneCount = 8;
+public:
+    explicit NoiseGenerator(const uint32_t seed = 1) { this->seed(seed); }
+
+    void seed(const uint32_t seed);
+    void fill(SimT* samples, const size_t count);
+
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
+private:
+    uint32_t states[laneCount];
+
+    void step(SimT* samples);
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+// exhaust pressure of a four stroke engine over one cycle of 720 crank degrees;
+// at the exhaust valve opening the cylinder pressure blows down into the pipe and the piston then
+// displaces the rest of the gas until the valve closes;
+// the angles are measured from the firing of the first cylinder
+struct ExcitationShape
+{
+    // firing angles of the cylinders that share the pipe
+    std::vector<SimT> firingAngles = {0.0};
+    // exhaust valve opening after the firing and the duration that the valve is open
+    SimT valveOpenAngle = 130.0, valveOpenDuration = 240.0;
+    // seconds of the pressure rise at the valve opening and of the blowdown decay;
+    // being fixed in time, the pulses take more of the cycle at a higher rpm
+    SimT riseTime = 0.0002, blowdownTime = 0.0015;
+    // level of the displacement in relation to the blowdown at full load
+    SimT displacementLevel = 0.2;
+    // area of a fully open valve in relation to the cross section of the pipe
+    SimT valveAreaRatio = 0.5;
+
+    // blowdown at full load and displacement at the position in range [0, 1) of a cycle
+    void getPressure(const SimT cyclePosition, const SimT cycleFrequency,
+        SimT& blowdown, SimT& displacement) const;
+    // open area of the valves at the position in relation to the cross section of the pipe;
+    // the valves of cylinders that overlap add up
+    SimT getValveArea(const SimT cyclePosition) const;
+
+    bool operator==(const ExcitationShape& other) const = default;
+
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
+};
+
+// library of the firing orders;
+// returns false for an unknown name
+bool findExcitationPreset(const std::string& name, ExcitationShape& shape);
+// names of the presets separated by |
+const char* getExcitationPresetNames();
+
+// blowdown level at a load in range [0, 1];
+// the cylinder pressure at the valve opening doesn't go to zero without load
+inline SimT getBlowdownLevel(const SimT load) { return 0.25 + 0.75 * load; }
+
+// randomness between the cycles, in relation to the level and the period;
+// noise is the turbulence of the blowdown in relation to the level of the pulses
+struct ExcitationVariation
+{
+    SimT cycleLevel = 0.05, cyclePeriod = 0.005;
+    SimT noise = 0.05;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+// band limited wavetables of one cycle of a shape, precomputed per rpm band so that playing the
+// pulses costs a few table reads per sample;
+// a band is built at the rpm of its start and has the harmonics that stay below the nyquist
+// frequency up to the start of the next band, the playback crossfades between the two;
+// the blowdown and the displacement have tables of their own so that the load is a playback gain;
+// the tables are normalized so that full load has the rms of a sine of amplitude 1
+class ExcitationTable
+{
+public:
+    static constexpr size_t tableLength = 4096;
+    // keeps the linear interpolation of the tables accurate
+    static constexpr size_t maxHarmonicCount = tableLength / 4;
+    // shapes are sampled at this many times the table length for the harmonics
+    static constexpr size_t oversampling = 4;
+    // cycle frequencies of the bands, rpm / 120
+    static constexpr SimT minFrequency = 5.0;
+    static constexpr size_t bandsPerOctave = 2, bandCount = 22;
+
+    struct Band
+    {
+        SimT frequency;
+        size_t harmonicCount;
+        // one guard sample at the end for the interpolation
+        std::vector<SimT> blowdown, displacement;
+        // blowdown before the band limiting in range [0, 1], for the turbulence
+        std::vector<SimT> envelope;
+    };
+public:
+    const ExcitationShape shape;
+    const SimT samplingRate;
+
+    ExcitationTable(const ExcitationShape& shape, const SimT samplingRate);
+
+    // the tables are shared between the cylinders of the same shape and sampling rate and
+    // built on the first use
+    static std::shared_ptr<const ExcitationTable> get(const ExcitationShape& shape, const SimT samplingRate);
+
+    const Band& getBand(const size_t band) const { return this->bands[band]; }
+    // pressure reflection of the valves over the cycle, (1 - a) / (1 + a) for the area ratio a;
+    // one guard sample at the end for the interpolation
+    const std::vector<SimT>& getValveReflections() const { return this->valveReflections; }
+    // lower band of the crossfade at the cycle frequency and the weight of the upper one
+    void findBands(const SimT frequency, size_t& band, SimT& weight) const;
+    // position of the cycle frequency in the bands, the band and the weight of the upper one
+    SimT getBandPosition(const SimT frequency) const;
+    size_t getMemoryUsage() const;
+private:
+    std::vector<Band> bands;
+    std::vector<SimT> valveReflections;
+
+    void buildBand(Band& band) const;
+};
\ No newline at end of file
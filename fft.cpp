@@ -0,0 +1,33 @@
+#include "fft.h"
+#include <numbers>
+#include <utility>
+
+void fft(std::vector<std::complex<SimT>>& data, const bool inverse)
+{
+    const size_t n = data.size();
+    for(size_t i = 1, j = 0; i < n; i++)
+    {
+        size_t bit = n >> 1;
+        for(; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if(i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    for(size_t length = 2; length <= n; length <<= 1)
+    {
+        const std::complex<SimT> step = std::polar(1.0, (inverse ? 2.0 : -2.0) * std::numbers::pi / length);
+        for(size_t i = 0; i < n; i += length)
+        {
+            std::complex<SimT> w = 1.0;
+            for(size_t k = 0; k < length / 2; k++, w *= step)
+            {
+                const std::complex<SimT> even = data[i + k];
+                const std::complex<SimT> odd = data[i + k + length / 2] * w;
+                data[i + k] = even + odd;
+                data[i + k + length / 2] = even - odd;
+            }
+        }
+    }
+}
\ No newline at end of file
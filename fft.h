@@ -0,0 +1,8 @@
+#pragma once
+#include "wave.h"
+#include <vector>
+#include <complex>
+
+// in place radix 2 fft, the size is a power of 2;
+// the inverse is unscaled
+void fft(std::vector<std::complex<SimT>>& data, const bool inverse = false);
\ No newline at end of file
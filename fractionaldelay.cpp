@@ -0,0 +1,90 @@
+#include "fractionaldelay.h"
+#include <cmath>
+#include <numbers>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+
+// the order is a constant so that the taps unroll and the samples go to the lanes
+template<size_t order>
+void interpolateOrder(const SimT* input, const SimT* taps, SimT* output, const size_t sampleCount)
+{
+    for(size_t i = 0; i < sampleCount; i++)
+    {
+        SimT sum = 0.0;
+        for(size_t j = 0; j <= order; j++)
+            sum += taps[j] * input[i + j];
+        output[i] = sum;
+    }
+}
+
+}
+
+void FractionalDelay::design(const size_t order, const SimT delay)
+{
+    assert(order <= maxOrder);
+
+    this->order = order;
+    this->delay = delay;
+    this->wholeDelay = static_cast<size_t>(std::max<SimT>(0.0, std::floor(delay - getMinDelay(order))));
+    const SimT rest = delay - static_cast<SimT>(this->wholeDelay);
+
+    // the tap of the input k samples before the newest is the product of (rest - m) / (k - m)
+    // over the other taps m
+    std::fill(std::begin(this->taps), std::end(this->taps), 0.0);
+    for(size_t k = 0; k <= order; k++)
+    {
+        SimT tap = 1.0;
+        for(size_t m = 0; m <= order; m++)
+        {
+            if(m != k)
+                tap *= (rest - static_cast<SimT>(m)) / (static_cast<SimT>(k) - static_cast<SimT>(m));
+        }
+        this->taps[order - k] = tap;
+    }
+}
+
+std::complex<SimT> FractionalDelay::getResponse(const SimT frequency, const SimT samplingRate) const
+{
+    const SimT step = 2.0 * std::numbers::pi * frequency / samplingRate;
+    std::complex<SimT> response = 0.0;
+    for(size_t k = 0; k <= this->order; k++)
+        response += this->taps[this->order - k] * std::polar(1.0, -step * static_cast<SimT>(k));
+
+    return response * std::polar(1.0, -step * static_cast<SimT>(this->wholeDelay));
+}
+
+void FractionalDelay::interpolate(const SimT* input, SimT* output, const size_t sampleCount) const
+{
+    switch(this->order)
+    {
+    case 0: interpolateOrder<0>(input, this->taps, output, sampleCount); break;
+    case 1: interpolateOrder<1>(input, this->taps, output, sampleCount); break;
+    case 2: interpolateOrder<2>(input, this->taps, output, sampleCount); break;
+    case 3: interpolateOrder<3>(input, this->taps, output, sampleCount); break;
+    case 4: interpolateOrder<4>(input, this->taps, output, sampleCount); break;
+    case 5: interpolateOrder<5>(input, this->taps, output, sampleCount); break;
+    case 6: interpolateOrder<6>(input, this->taps, output, sampleCount); break;
+    default: interpolateOrder<7>(input, this->taps, output, sampleCount); break;
+    }
+}
+
+void FractionalDelay::process(State& state, SimT* samples, const size_t sampleCount) const
+{
+    assert(this->wholeDelay + this->order <= historyLength);
+
+    // the history and a chunk of the stream are put together for the kernel
+    SimT buffer[historyLength + chunkSize];
+    const SimT* const input = buffer + historyLength - this->wholeDelay - this->order;
+    for(size_t first = 0; first < sampleCount; first += chunkSize)
+    {
+        const size_t count = std::min(chunkSize, sampleCount - first);
+        std::copy(std::begin(state.inputs), std::end(state.inputs), buffer);
+        std::copy(samples + first, samples + first + count, buffer + historyLength);
+
+        this->interpolate(input, samples + first, count);
+        std::copy(buffer + count, buffer + count + historyLength, state.inputs);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include "wave.h"
+#include <complex>
+#include <cstddef>
+
+// delay of a fraction of a sample by lagrange interpolation, an fir of order + 1 taps;
+// the delay is split to whole samples and an interpolated rest in [(order - 1) / 2, (order + 1) / 2),
+// the middle of the taps where the interpolation is the flattest, so order 0 rounds to whole
+// samples;
+// unlike an allpass the fir has no state of its own, so the delay can be changed between any two
+// blocks without a transient
+class FractionalDelay
+{
+public:
+    static constexpr size_t maxOrder = 7, startOrder = 3;
+    // streams keep the last inputs for the taps and up to a whole sample of delay
+    static constexpr size_t historyLength = maxOrder + 1;
+    // samples interpolated per pass of the kernel
+    static constexpr size_t chunkSize = 256;
+
+    // state of a delayed stream
+    struct State
+    {
+        // last inputs, the newest last
+        SimT inputs[historyLength] = {};
+    };
+public:
+    void design(const size_t order, const SimT delay);
+    size_t getOrder() const { return this->order; }
+    SimT getDelay() const { return this->delay; }
+    size_t getWholeDelay() const { return this->wholeDelay; }
+    // smallest delay that keeps the interpolated rest in its range
+    static SimT getMinDelay(const size_t order) { return 0.5 * (static_cast<SimT>(order) - 1.0); }
+    // of the whole delay
+    std::complex<SimT> getResponse(const SimT frequency, const SimT samplingRate) const;
+
+    // output[i] is the input order - rest samples before input[i + order], without the whole delay;
+    // the input has sample count + order samples
+    void interpolate(const SimT* input, SimT* output, const size_t sampleCount) const;
+    // one output, for the loops that go a sample at a time;
+    // the input is a delay line of a power of two and start the index of the oldest tap
+    SimT interpolate(const SimT* waves, const size_t mask, const size_t start) const
+    {
+        SimT sum = 0.0;
+        for(size_t j = 0; j <= this->order; j++)
+            sum += this->taps[j] * waves[(start + j) & mask];
+        return sum;
+    }
+    // delays a stream in place by the whole delay and the rest, the whole delay is at most
+    // history length - order samples
+    void process(State& state, SimT* samples, const size_t sampleCount) const;
+private:
+    size_t order = 0, wholeDelay = 0;
+    SimT delay = 0.0;
+    // in the order of the inputs, the oldest first
+    alignas(64) SimT taps[maxOrder + 1] = {1.0};
+};
\ No newline at end of file
@@ -0,0 +1,997 @@
+#include "headless.h"
+#include "backends.h"
+#include "renderer.h"
+#include "realtime.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "benchmarks.h"
+#include "muffler.h"
+#include "convolution.h"
+#include "voices.h"
+#include "quality.h"
+#include "watchdog.h"
+#include "vehiclelog.h"
+#include "vehiclefeed.h"
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+#include <iostream>
+
+namespace
+{
+
+// ramp of a control from the start of the output
+struct RampOption
+{
+    SimT target, duration;
+    ParameterRamp::Shape shape;
+};
+
+// side branch tuned to a frequency once the pipe is set
+struct SideBranchOption
+{
+    SideBranch::Type type;
+    SimT position, frequency;
+};
+
+struct HeadlessOptions
+{
+    std::string backend = "wav";
+    std::string outputPath = "engine sound.wav";
+    AudioFormat format;
+    uint32_t periodFrameCount = 0;
+    SimT duration = 10.0;
+    bool paced = false;
+    bool measure = false;
+    RealtimeConfig realtime;
+    SimT telemetryInterval = 0.0;
+    TelemetryDumper::Format telemetryFormat = TelemetryDumper::Format::Text;
+    std::string telemetryPath;
+    std::string tracePath;
+
+    SimT inputSoundFrequency = Cylinder::startFrequency;
+    std::optional<ExcitationShape> excitation;
+    SimT load = 0.5;
+    // the rpm ramp is of the cycle rate like the frequency
+    std::optional<RampOption> frequencyRamp, loadRamp;
+    std::string vehicleLogPath;
+    uint16_t feedPort = 0;
+    PacketLayout feedLayout;
+    bool valveCoupling = false;
+    Simulation::PipeEngine pipeEngine = Simulation::PipeEngine::Echo;
+    size_t echoIterations = Pipe::startEchoIterations;
+    size_t modeCount = ModalPipe::startModeCount;
+    size_t detailTier = 0;
+    SimT cpuBudget = 0.0;
+    bool watchdog = false;
+    bool warmStart = false;
+    std::vector<HornPipe::ProfilePoint> hornProfile;
+    std::string mufflerPath;
+    std::string loadStatePath, saveStatePath;
+    SimT pipeLengthCm = Pipe::startPipeLengthPhysicalCm;
+    SimT pipeRadiusMm = Pipe::startPipeRadiusCm * 10.0;
+    std::vector<SimT> temperatures;
+    bool wallLoss = false;
+    size_t fractionalDelayOrder = FractionalDelay::startOrder;
+    std::vector<SideBranchOption> sideBranches;
+    SimT intakeLengthCm = Simulation::startIntakeLength * 100.0;
+    SimT intakeRadiusMm = Simulation::startIntakeRadius * 1000.0;
+    SimT exhaustGain = 1.0, intakeGain = 0.0;
+    // 0 renders the intake after the exhaust
+    size_t parallelIntakeSampleCount = 0;
+
+    size_t voiceCount = 0;
+    size_t voiceThreadCount = 1;
+};
+
+void printUsage()
+{
+    std::cout <<
+        "usage: engine sound [options]\n"
+        "       engine sound bench <name> [arguments]\n"
+        "       engine sound muffler [options]\n"
+        "       engine sound feed-send [options]\n"
+        "  --backend <null|wav|jack|wasapi>   audio output, default wav\n"
+        "  --output <path>                    wav file path\n"
+        "  --duration <seconds>               rendered duration, 0 runs until killed\n"
+        "  --sample-rate <hz>                 requested sampling rate\n"
+        "  --channels <count>                 requested channel count\n"
+        "  --period <frames>                  period of the null and wav backends\n"
+        "  --paced                            pace the null and wav backends to realtime\n"
+        "  --measure                          report cpu usage and wakeup jitter\n"
+        "  --realtime                         realtime scheduling and memory locking (linux)\n"
+        "  --rt-policy <fifo|rr>              realtime scheduling policy, default fifo\n"
+        "  --rt-priority <1-99>               realtime priority, default 80\n"
+        "  --rt-cpu <core>                    pin the render thread to a core\n"
+        "  --no-mlock                         don't lock and prefault memory\n"
+        "  --telemetry <seconds>              dump block telemetry periodically\n"
+        "  --telemetry-format <text|json>     telemetry dump format, default text\n"
+        "  --telemetry-output <path>          telemetry dump file, default stdout\n"
+        "  --trace <path>                     export chrome trace json of the stages\n"
+        "  --frequency <hz>                   input sound frequency, the cycle rate with pulses\n"
+        "  --rpm <rpm>                        cycle rate of a four stroke engine, rpm / 120 hz\n"
+        "  --excitation <sine|preset>         exhaust pulses of a firing order instead of the sine,\n"
+        "                                     single|twin|vtwin|inline4|v8bank\n"
+        "  --load <fraction>                  blowdown level of the pulses, default 0.5\n"
+        "  --rpm-ramp <rpm:seconds[:shape]>   ramp the rpm from the start, exp (default) or linear\n"
+        "  --load-ramp <load:seconds[:shape]> ramp the load from the start, linear (default) or exp\n"
+        "  --vehicle-log <path>               replay the rpm and throttle of a csv or binary drive log,\n"
+        "                                     the render ends with the log\n"
+        "  --feed-port <port>                 take the rpm and throttle from udp packets on the\n"
+        "                                     loopback, see feed-send\n"
+        "  --feed-layout <fields>             name:type@offset[*scale],..., default\n"
+        "                                     rpm:f32@0,throttle:f32@4\n"
+        "  --valve-coupling                   reflect the pipe at the valves of the pulses and\n"
+        "                                     feed its pressure back to the blowdown\n"
+        "  --engine <echo|modal|horn|delay>   pipe engine, default echo\n"
+        "  --echo-iterations <count>\n"
+        "  --modes <count>                    modes of the modal engine\n"
+        "  --detail <full|high|medium|low>    level of detail, default full\n"
+        "  --cpu-budget <fraction>            adapt the detail to a share of the period\n"
+        "  --watchdog                         play a loop of the last periods on a missed deadline\n"
+        "  --horn-profile <pos:scale,...>     radius scales along the pipe for the horn engine\n"
+        "  --muffler <path>                   impulse response wav applied after the pipe\n"
+        "  --load-state <path>                start from a saved state, forked to every voice\n"
+        "  --save-state <path>                save the state of the simulation after the run\n"
+        "  --warm-start                       start from the settled pipe instead of silence\n"
+        "  --pipe-length <cm>\n"
+        "  --pipe-radius <mm>\n"
+        "  --temperatures <c,...>             gas temperatures of equal segments from the cylinder\n"
+        "                                     to the open end, default 15\n"
+        "  --wall-loss                        viscothermal losses at the walls of the pipe\n"
+        "  --fractional-order <0-7>           interpolation of the pipe length, 0 rounds to samples,\n"
+        "                                     default 3\n"
+        "  --side-branches <type:pos:hz,...>  quarter wave tubes (quarter) and helmholtz resonators\n"
+        "                                     (helmholtz) tuned to the frequencies, delay engine only\n"
+        "  --intake-length <cm>               pipe of the intake tract, default 30\n"
+        "  --intake-radius <mm>               default 10\n"
+        "  --intake-gain <gain>               intake in the mix, default 0 leaves it out\n"
+        "  --parallel-intake <samples>        render the intake on a thread next to the exhaust in\n"
+        "                                     periods of at least this many samples, the crossover\n"
+        "                                     of bench intake; default 0 is off\n"
+        "  --exhaust-gain <gain>              exhaust in the mix, default 1\n"
+        "  --voices <count>                   render many engines with spread parameters\n"
+        "  --voice-threads <count>            render threads of the voices, default 1\n";
+}
+
+// comma separated position:scale pairs in increasing position
+bool parseProfile(const char* value, std::vector<HornPipe::ProfilePoint>& profile)
+{
+    profile.clear();
+    std::istringstream stream(value);
+    std::string point;
+    while(std::getline(stream, point, ','))
+    {
+        const size_t separator = point.find(':');
+        if(separator == std::string::npos)
+            return false;
+
+        const SimT position = std::atof(point.substr(0, separator).c_str());
+        const SimT radiusScale = std::atof(point.substr(separator + 1).c_str());
+        if(position < 0.0 || position > 1.0 || radiusScale <= 0.0 ||
+            (!profile.empty() && position < profile.back().position))
+            return false;
+
+        profile.push_back(HornPipe::ProfilePoint {position, radiusScale});
+    }
+
+    return !profile.empty();
+}
+
+// comma separated temperatures in celsius
+bool parseTemperatures(const char* value, std::vector<SimT>& temperatures)
+{
+    temperatures.clear();
+    std::istringstream stream(value);
+    std::string temperature;
+    while(std::getline(stream, temperature, ','))
+    {
+        temperatures.push_back(std::atof(temperature.c_str()));
+        if(!(temperatures.back() > -zeroCelsius))
+            return false;
+    }
+
+    return !temperatures.empty();
+}
+
+// comma separated type:position:frequency triplets
+bool parseSideBranches(const char* value, std::vector<SideBranchOption>& sideBranches)
+{
+    sideBranches.clear();
+    std::istringstream stream(value);
+    std::string branch;
+    while(std::getline(stream, branch, ','))
+    {
+        std::istringstream fields(branch);
+        std::string type, position, frequency;
+        if(!std::getline(fields, type, ':') || !std::getline(fields, position, ':') ||
+            !std::getline(fields, frequency))
+            return false;
+
+        SideBranchOption option;
+        if(type == "quarter")
+            option.type = SideBranch::Type::QuarterWave;
+        else if(type == "helmholtz")
+            option.type = SideBranch::Type::Helmholtz;
+        else
+            return false;
+        option.position = std::atof(position.c_str());
+        option.frequency = std::atof(frequency.c_str());
+        if(!(option.position >= 0.0 && option.position <= 1.0) || !(option.frequency > 0.0))
+            return false;
+
+        sideBranches.push_back(option);
+    }
+
+    return !sideBranches.empty();
+}
+
+// target:duration with an optional :linear or :exp
+bool parseRamp(const char* value, const ParameterRamp::Shape defaultShape, RampOption& ramp)
+{
+    std::istringstream stream(value);
+    std::string target, duration, shape;
+    if(!std::getline(stream, target, ':') || !std::getline(stream, duration, ':'))
+        return false;
+    std::getline(stream, shape);
+
+    ramp.target = std::atof(target.c_str());
+    ramp.duration = std::atof(duration.c_str());
+    if(shape.empty())
+        ramp.shape = defaultShape;
+    else if(shape == "linear")
+        ramp.shape = ParameterRamp::Shape::Linear;
+    else if(shape == "exp")
+        ramp.shape = ParameterRamp::Shape::Exponential;
+    else
+        return false;
+
+    return ramp.duration >= 0.0;
+}
+
+bool parseOptions(int argc, char* argv[], HeadlessOptions& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+
+        // flags
+        if(arg == "--paced")
+        {
+            options.paced = true;
+            continue;
+        }
+        if(arg == "--measure")
+        {
+            options.measure = true;
+            continue;
+        }
+        if(arg == "--watchdog")
+        {
+            options.watchdog = true;
+            continue;
+        }
+        if(arg == "--warm-start")
+        {
+            options.warmStart = true;
+            continue;
+        }
+        if(arg == "--valve-coupling")
+        {
+            options.valveCoupling = true;
+            continue;
+        }
+        if(arg == "--wall-loss")
+        {
+            options.wallLoss = true;
+            continue;
+        }
+        if(arg == "--realtime")
+        {
+            options.realtime.enabled = true;
+            continue;
+        }
+        if(arg == "--no-mlock")
+        {
+            options.realtime.lockMemory = false;
+            continue;
+        }
+
+        if(i + 1 >= argc)
+        {
+            std::cerr << "missing value for " << arg << std::endl;
+            return false;
+        }
+
+        const char* value = argv[++i];
+        if(arg == "--backend")
+            options.backend = value;
+        else if(arg == "--output")
+            options.outputPath = value;
+        else if(arg == "--duration")
+            options.duration = std::atof(value);
+        else if(arg == "--sample-rate")
+            options.format.sampleRate = static_cast<uint32_t>(std::atoi(value));
+        else if(arg == "--channels")
+            options.format.channelCount = static_cast<uint32_t>(std::atoi(value));
+        else if(arg == "--period")
+            options.periodFrameCount = static_cast<uint32_t>(std::atoi(value));
+        else if(arg == "--rt-policy")
+        {
+            if(std::strcmp(value, "fifo") != 0 && std::strcmp(value, "rr") != 0)
+            {
+                std::cerr << "unknown realtime policy " << value << std::endl;
+                return false;
+            }
+            options.realtime.policy = std::strcmp(value, "rr") == 0 ?
+                RealtimeConfig::Policy::RoundRobin : RealtimeConfig::Policy::Fifo;
+        }
+        else if(arg == "--rt-priority")
+            options.realtime.priority = std::atoi(value);
+        else if(arg == "--rt-cpu")
+            options.realtime.cpu = std::atoi(value);
+        else if(arg == "--telemetry")
+            options.telemetryInterval = std::atof(value);
+        else if(arg == "--telemetry-format")
+        {
+            if(std::strcmp(value, "text") != 0 && std::strcmp(value, "json") != 0)
+            {
+                std::cerr << "unknown telemetry format " << value << std::endl;
+                return false;
+            }
+            options.telemetryFormat = std::strcmp(value, "json") == 0 ?
+                TelemetryDumper::Format::Json : TelemetryDumper::Format::Text;
+        }
+        else if(arg == "--telemetry-output")
+            options.telemetryPath = value;
+        else if(arg == "--trace")
+            options.tracePath = value;
+        else if(arg == "--frequency")
+            options.inputSoundFrequency = std::atof(value);
+        else if(arg == "--rpm")
+            options.inputSoundFrequency = std::atof(value) / 120.0;
+        else if(arg == "--excitation")
+        {
+            ExcitationShape shape;
+            if(std::strcmp(value, "sine") == 0)
+                options.excitation.reset();
+            else if(findExcitationPreset(value, shape))
+                options.excitation = shape;
+            else
+            {
+                std::cerr << "unknown excitation " << value << ", " << getExcitationPresetNames() << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--load")
+            options.load = std::clamp(std::atof(value), 0.0, 1.0);
+        else if(arg == "--rpm-ramp" || arg == "--load-ramp")
+        {
+            const bool rpm = arg == "--rpm-ramp";
+            RampOption ramp;
+            if(!parseRamp(value, rpm ? ParameterRamp::Shape::Exponential : ParameterRamp::Shape::Linear, ramp))
+            {
+                std::cerr << "invalid ramp " << value << std::endl;
+                return false;
+            }
+
+            if(rpm)
+            {
+                ramp.target /= 120.0;
+                options.frequencyRamp = ramp;
+            }
+            else
+            {
+                ramp.target = std::clamp(ramp.target, 0.0, 1.0);
+                options.loadRamp = ramp;
+            }
+        }
+        else if(arg == "--vehicle-log")
+            options.vehicleLogPath = value;
+        else if(arg == "--feed-port")
+            options.feedPort = static_cast<uint16_t>(std::atoi(value));
+        else if(arg == "--feed-layout")
+        {
+            if(!options.feedLayout.parse(value))
+            {
+                std::cerr << "invalid feed layout " << value << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--engine")
+        {
+            if(std::strcmp(value, "echo") == 0)
+                options.pipeEngine = Simulation::PipeEngine::Echo;
+            else if(std::strcmp(value, "modal") == 0)
+                options.pipeEngine = Simulation::PipeEngine::Modal;
+            else if(std::strcmp(value, "horn") == 0)
+                options.pipeEngine = Simulation::PipeEngine::Horn;
+            else if(std::strcmp(value, "delay") == 0)
+                options.pipeEngine = Simulation::PipeEngine::DelayLine;
+            else
+            {
+                std::cerr << "unknown engine " << value << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--modes")
+            options.modeCount = static_cast<size_t>(std::atoi(value));
+        else if(arg == "--detail")
+        {
+            const auto tier = std::find_if(std::begin(Simulation::detailTiers), std::end(Simulation::detailTiers),
+                [value](const DetailTier& tier) { return std::strcmp(tier.name, value) == 0; });
+            if(tier == std::end(Simulation::detailTiers))
+            {
+                std::cerr << "unknown detail tier " << value << std::endl;
+                return false;
+            }
+            options.detailTier = static_cast<size_t>(tier - std::begin(Simulation::detailTiers));
+        }
+        else if(arg == "--cpu-budget")
+            options.cpuBudget = std::atof(value);
+        else if(arg == "--horn-profile")
+        {
+            if(!parseProfile(value, options.hornProfile))
+            {
+                std::cerr << "invalid horn profile " << value << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--muffler")
+            options.mufflerPath = value;
+        else if(arg == "--load-state")
+            options.loadStatePath = value;
+        else if(arg == "--save-state")
+            options.saveStatePath = value;
+        else if(arg == "--echo-iterations")
+            options.echoIterations = static_cast<size_t>(std::atoi(value));
+        else if(arg == "--pipe-length")
+            options.pipeLengthCm = std::atof(value);
+        else if(arg == "--pipe-radius")
+            options.pipeRadiusMm = std::atof(value);
+        else if(arg == "--temperatures")
+        {
+            if(!parseTemperatures(value, options.temperatures))
+            {
+                std::cerr << "invalid temperatures " << value << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--fractional-order")
+            options.fractionalDelayOrder = static_cast<size_t>(std::atoi(value));
+        else if(arg == "--side-branches")
+        {
+            if(!parseSideBranches(value, options.sideBranches))
+            {
+                std::cerr << "invalid side branches " << value << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--intake-length")
+            options.intakeLengthCm = std::atof(value);
+        else if(arg == "--intake-radius")
+            options.intakeRadiusMm = std::atof(value);
+        else if(arg == "--intake-gain")
+            options.intakeGain = std::atof(value);
+        else if(arg == "--parallel-intake")
+            options.parallelIntakeSampleCount = static_cast<size_t>(std::atoi(value));
+        else if(arg == "--exhaust-gain")
+            options.exhaustGain = std::atof(value);
+        else if(arg == "--voices")
+            options.voiceCount = static_cast<size_t>(std::atoi(value));
+        else if(arg == "--voice-threads")
+            options.voiceThreadCount = static_cast<size_t>(std::atoi(value));
+        else
+        {
+            std::cerr << "unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if(options.format.sampleRate == 0 || options.format.channelCount == 0 ||
+        options.echoIterations == 0 || options.modeCount == 0 || options.pipeLengthCm <= 0.0 || options.pipeRadiusMm <= 0.0 ||
+        options.voiceThreadCount == 0 || options.cpuBudget < 0.0 || options.cpuBudget >= 1.0 ||
+        options.fractionalDelayOrder > FractionalDelay::maxOrder ||
+        options.intakeLengthCm <= 0.0 || options.intakeRadiusMm <= 0.0)
+    {
+        std::cerr << "invalid option value" << std::endl;
+        return false;
+    }
+
+    // the other engines don't model the branches, so they would be left out without a word
+    if(!options.sideBranches.empty() && options.pipeEngine != Simulation::PipeEngine::DelayLine)
+    {
+        std::cerr << "--side-branches needs --engine delay" << std::endl;
+        return false;
+    }
+    // the voices are rendered in parallel already, their intakes stay on the thread of the voice
+    if(options.parallelIntakeSampleCount && options.voiceCount)
+    {
+        std::cerr << "--parallel-intake doesn't apply to --voices" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void configureSimulation(Simulation& simulation, const HeadlessOptions& options,
+    const SimT frequency, const SimT pipeLengthCm, const std::vector<SimT>& impulseResponse)
+{
+    simulation.cylinder.setFrequency(frequency);
+    simulation.cylinder.setExcitation(options.excitation ? &*options.excitation : nullptr);
+    simulation.cylinder.setLoad(options.load);
+    simulation.cylinder.setValveCoupling(options.valveCoupling);
+    simulation.pipe.setEchoIterationsAndReset(options.echoIterations);
+    simulation.pipe.setPipeRadiusAndReset(options.pipeRadiusMm / 1000.0);
+    simulation.pipe.setPipePhysicalLengthAndReset(pipeLengthCm / 100.0);
+    simulation.pipe.setTemperatures(options.temperatures);
+    simulation.pipe.setWallLoss(options.wallLoss);
+    simulation.pipe.setFractionalDelayOrder(options.fractionalDelayOrder);
+    // tuned in the gas of the pipe of the voice
+    std::vector<SideBranch> sideBranches(options.sideBranches.size());
+    for(size_t i = 0; i < sideBranches.size(); i++)
+    {
+        sideBranches[i].type = options.sideBranches[i].type;
+        sideBranches[i].position = options.sideBranches[i].position;
+        if(sideBranches[i].type == SideBranch::Type::Helmholtz)
+            sideBranches[i].length = 0.05;
+        sideBranches[i].tune(simulation.pipe, options.sideBranches[i].frequency);
+    }
+    simulation.pipe.setSideBranches(sideBranches);
+    simulation.setPipeEngine(options.pipeEngine);
+    simulation.setIntakeGeometry(options.intakeLengthCm / 100.0, options.intakeRadiusMm / 1000.0);
+    simulation.setMixGains(options.exhaustGain, options.intakeGain);
+    simulation.modalPipe.setModeCount(options.modeCount);
+    simulation.hornPipe.setProfile(options.hornProfile);
+    simulation.setDetailTier(options.detailTier);
+    if(!impulseResponse.empty())
+        simulation.outputFilter.setImpulseResponse(impulseResponse);
+}
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file)
+    {
+        std::cerr << "cannot open " << path << std::endl;
+        return false;
+    }
+
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+bool writeFile(const std::string& path, const std::vector<uint8_t>& data)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if(!file)
+    {
+        std::cerr << "cannot write " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// cpu accounting of the voices after the run
+void printVoiceStats(const VoiceManager& voices, const size_t voiceCount, std::ostream& stream)
+{
+    SimT totalCpuUsage = 0.0, maxCpuUsage = 0.0;
+    uint64_t skippedBlockCount = 0;
+    for(VoiceManager::VoiceId voice = 0; voice < voiceCount; voice++)
+    {
+        const VoiceStats stats = voices.getStats(voice);
+        totalCpuUsage += stats.cpuUsage;
+        maxCpuUsage = std::max(maxCpuUsage, stats.cpuUsage);
+        skippedBlockCount += stats.skippedBlockCount;
+    }
+
+    stream << "voice cpu usage: total " << totalCpuUsage * 100.0 << " %, mean " <<
+        totalCpuUsage / static_cast<SimT>(voiceCount) * 100.0 << " %, max " <<
+        maxCpuUsage * 100.0 << " %" << std::endl;
+    stream << "skipped voice blocks: " << skippedBlockCount << ", stolen jobs: " <<
+        voices.getPool().getStealCount() << std::endl;
+}
+
+// applies the realtime config to the workers of a pool that the render thread waits on;
+// the report is written in one piece so that the workers don't interleave it
+WorkStealingPool::ThreadInit makeRealtimeWorkerInit(const RealtimeConfig& realtime, const char* name)
+{
+    if(!realtime.enabled)
+        return {};
+
+    return [realtime, name](const size_t worker)
+    {
+        std::ostringstream report;
+        report << name << " " << worker << " ";
+        applyRealtimeConfig(getWorkerRealtimeConfig(realtime, worker)).print(report);
+        std::cout << report.str() << std::flush;
+    };
+}
+
+std::unique_ptr<AudioBackend> createBackend(const HeadlessOptions& options)
+{
+    if(options.backend == "null")
+    {
+        return std::make_unique<NullBackend>(options.periodFrameCount ?
+            options.periodFrameCount : NullBackend::defaultPeriodFrameCount, options.paced);
+    }
+    if(options.backend == "wav")
+    {
+        return std::make_unique<WavFileBackend>(options.outputPath, options.periodFrameCount ?
+            options.periodFrameCount : WavFileBackend::defaultPeriodFrameCount, options.paced);
+    }
+#ifdef ENGINE_SOUND_WITH_JACK
+    if(options.backend == "jack")
+        return std::make_unique<JackBackend>();
+#endif
+#ifdef _WIN32
+    if(options.backend == "wasapi")
+        return std::make_unique<WasapiBackend>();
+#endif
+
+    std::cerr << "backend " << options.backend << " is not available in this build" << std::endl;
+    return nullptr;
+}
+
+}
+
+int runHeadless(int argc, char* argv[])
+{
+    HeadlessOptions options;
+    if(argc > 1 && std::strcmp(argv[1], "bench") == 0)
+        return runBenchmark(argc - 2, argv + 2);
+    if(argc > 1 && std::strcmp(argv[1], "muffler") == 0)
+        return runMufflerTool(argc - 2, argv + 2);
+    if(argc > 1 && std::strcmp(argv[1], "feed-send") == 0)
+        return runFeedSender(argc - 2, argv + 2);
+    if(argc > 1 && (std::strcmp(argv[1], "--help") == 0 || std::strcmp(argv[1], "-h") == 0))
+    {
+        printUsage();
+        return 0;
+    }
+    if(!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    // rings for the main, the render, the watchdog, the intake worker and the voice threads, so that
+    // the threads don't allocate them at their first span
+    if(!options.tracePath.empty())
+        Tracer::get().reserveBuffers(4 + options.voiceThreadCount);
+
+    // the log replaces the rpm and the load from its first point on
+    std::optional<VehicleLog> vehicleLog;
+    if(!options.vehicleLogPath.empty())
+    {
+        vehicleLog.emplace();
+        if(!vehicleLog->open(options.vehicleLogPath))
+            return 1;
+
+        const VehicleLogPoint point = vehicleLog->getPoint(0.0);
+        options.inputSoundFrequency = point.rpm / 120.0;
+        options.load = std::clamp(point.throttle, 0.0, 1.0);
+        std::cout << "vehicle log: " << (vehicleLog->isBinary() ? "binary" : "csv") << " " <<
+            options.vehicleLogPath << std::endl;
+    }
+
+    std::unique_ptr<AudioBackend> backend = createBackend(options);
+    if(!backend)
+        return 1;
+
+    Renderer renderer{*backend};
+    if(!renderer.open(options.format))
+        return 1;
+
+    const AudioFormat& format = backend->getFormat();
+    std::cout << "backend: " << backend->getName() <<
+        ", " << format.sampleRate << " hz, " << format.channelCount << " channels" << std::endl;
+    std::cout << "period: " << backend->getPeriodFrameCount() << " frames (" <<
+        backend->getPeriodDuration() * 1000.0 << " ms), latency: " <<
+        backend->getLatency() * 1000.0 << " ms" << std::endl;
+
+    std::vector<SimT> impulseResponse;
+    if(!options.mufflerPath.empty())
+    {
+        uint32_t samplingRate;
+        if(!loadImpulseResponse(options.mufflerPath, samplingRate, impulseResponse))
+            return 1;
+        if(samplingRate != format.sampleRate)
+        {
+            std::cerr << options.mufflerPath << " is at " << samplingRate << " hz, the output is at " <<
+                format.sampleRate << " hz" << std::endl;
+            return 1;
+        }
+    }
+
+    configureSimulation(renderer.getSimulation(), options, options.inputSoundFrequency,
+        options.pipeLengthCm, impulseResponse);
+
+    // the render thread is worker 0 of the pool and the intake is handed to the other one
+    std::optional<WorkStealingPool> intakePool;
+    if(options.parallelIntakeSampleCount)
+    {
+        intakePool.emplace(2, makeRealtimeWorkerInit(options.realtime, "intake worker"));
+        renderer.getSimulation().setIntakePool(&*intakePool, options.parallelIntakeSampleCount);
+        std::cout << "parallel intake: periods of " << options.parallelIntakeSampleCount <<
+            " samples or more" << std::endl;
+    }
+
+    // the saved state replaces the configuration
+    std::vector<uint8_t> snapshot;
+    if(!options.loadStatePath.empty())
+    {
+        if(!readFile(options.loadStatePath, snapshot))
+            return 1;
+        if(!renderer.getSimulation().restoreSnapshot(snapshot.data(), snapshot.size()))
+        {
+            std::cerr << options.loadStatePath << " is not a valid state for " <<
+                renderer.getSimulation().samplingRate << " hz" << std::endl;
+            return 1;
+        }
+
+        std::cout << "state: " << snapshot.size() << " bytes from " << options.loadStatePath << std::endl;
+    }
+
+    // the voices are spread around the options so that they don't sound in unison
+    std::optional<VoiceManager> voices;
+    if(options.voiceCount)
+    {
+        // the render thread waits on the workers, so they run in the realtime scheduling too
+        voices.emplace(renderer.getSimulation().samplingRate, options.voiceThreadCount,
+            makeRealtimeWorkerInit(options.realtime, "voice worker"));
+
+        std::mt19937 generator{1234};
+        std::uniform_real_distribution<SimT> spread(0.8, 1.25);
+        for(size_t i = 0; i < options.voiceCount; i++)
+        {
+            const VoiceManager::VoiceId voice = voices->addVoice();
+            const SimT frequencySpread = spread(generator), lengthSpread = spread(generator);
+            Simulation& simulation = voices->getSimulation(voice);
+            if(snapshot.empty())
+            {
+                configureSimulation(simulation, options, options.inputSoundFrequency * frequencySpread,
+                    options.pipeLengthCm * lengthSpread, impulseResponse);
+            }
+            else
+            {
+                // a forked voice keeps the pipe of the state, only the frequency is spread
+                simulation.restoreSnapshot(snapshot.data(), snapshot.size());
+                simulation.cylinder.setFrequency(simulation.cylinder.getFrequency() * frequencySpread);
+            }
+            simulation.cylinder.seedExcitation(static_cast<uint32_t>(voice) + 2);
+            voices->setGain(voice, 1.0 / std::sqrt(static_cast<SimT>(options.voiceCount)));
+        }
+        renderer.setVoices(&*voices);
+
+        std::cout << "voices: " << options.voiceCount << " on " << options.voiceThreadCount <<
+            " threads" << std::endl;
+    }
+
+    // the simulations are run ahead in the periods that they are rendered in
+    if(options.warmStart)
+    {
+        const size_t blockSize = std::max<size_t>(1, backend->getPeriodFrameCount());
+        const auto start = std::chrono::steady_clock::now();
+
+        size_t aheadSampleCount = renderer.getSimulation().warmStart(blockSize);
+        if(voices)
+        {
+            for(size_t voice = 0; voice < options.voiceCount; voice++)
+                aheadSampleCount = std::max(aheadSampleCount, voices->getSimulation(voice).warmStart(blockSize));
+        }
+
+        std::cout << "warm start: " << aheadSampleCount << " samples ahead in " <<
+            std::chrono::duration<SimT, std::milli>(std::chrono::steady_clock::now() - start).count() <<
+            " ms" << std::endl;
+    }
+
+    // the ramps start with the output, after the warm start;
+    // the voices ramp to the target in the spread of their frequency
+    const auto startRamps = [&options](Simulation& simulation, const SimT frequencySpread)
+    {
+        if(options.frequencyRamp)
+        {
+            simulation.cylinder.rampFrequency(options.frequencyRamp->target * frequencySpread,
+                options.frequencyRamp->duration, options.frequencyRamp->shape);
+        }
+        if(options.loadRamp)
+            simulation.cylinder.rampLoad(options.loadRamp->target, options.loadRamp->duration, options.loadRamp->shape);
+    };
+    const SimT mainFrequency = renderer.getSimulation().cylinder.getFrequency();
+    std::vector<SimT> voiceFrequencyScales(options.voiceCount, 1.0);
+    startRamps(renderer.getSimulation(), 1.0);
+    for(size_t voice = 0; voice < options.voiceCount; voice++)
+    {
+        Simulation& simulation = voices->getSimulation(voice);
+        if(mainFrequency > 0.0)
+            voiceFrequencyScales[voice] = simulation.cylinder.getFrequency() / mainFrequency;
+        startRamps(simulation, voiceFrequencyScales[voice]);
+    }
+
+    const uint64_t targetFrameCount = static_cast<uint64_t>(
+        std::llround(options.duration * format.sampleRate));
+
+    // the headless render thread is the calling thread
+    if(options.realtime.enabled)
+    {
+        applyRealtimeConfig(options.realtime, backend->rendersOnCallingThread()).print(std::cout);
+    }
+
+    BlockTelemetry telemetry;
+    std::ofstream telemetryFile;
+    std::optional<TelemetryDumper> telemetryDumper;
+    if(options.telemetryInterval > 0.0)
+    {
+        if(!options.telemetryPath.empty())
+        {
+            telemetryFile.open(options.telemetryPath);
+            if(!telemetryFile)
+            {
+                std::cerr << "cannot open " << options.telemetryPath << " for writing" << std::endl;
+                return 1;
+            }
+        }
+
+        renderer.setTelemetry(&telemetry);
+        telemetryDumper.emplace(telemetry, options.telemetryPath.empty() ?
+            std::cout : telemetryFile, options.telemetryInterval, options.telemetryFormat);
+    }
+
+    std::optional<QualityController> qualityController;
+    if(options.cpuBudget > 0.0)
+    {
+        QualityConfig config;
+        config.budget = options.cpuBudget;
+        config.spikeLoad = std::max(config.spikeLoad, options.cpuBudget);
+        qualityController.emplace(config);
+        renderer.setQualityController(&*qualityController);
+    }
+
+    std::optional<DeadlineWatchdog> watchdog;
+    if(options.watchdog)
+    {
+        // the render runs in the realtime scheduling of the backend thread, one priority below it so
+        // that the backend thread preempts a late render at the deadline to play the fallback
+        DeadlineWatchdog::ThreadInit threadInit;
+        if(options.realtime.enabled)
+        {
+            threadInit = [realtime = options.realtime]()
+            {
+                RealtimeConfig config = realtime;
+                config.lockMemory = false;
+                config.priority = std::max(1, config.priority - 1);
+
+                std::ostringstream report;
+                report << "watchdog ";
+                applyRealtimeConfig(config).print(report);
+                std::cout << report.str() << std::flush;
+            };
+        }
+        watchdog.emplace(renderer.getSimulation().samplingRate, threadInit);
+        renderer.setWatchdog(&*watchdog);
+    }
+
+    std::optional<VehicleFeedReceiver> feed;
+    if(options.feedPort)
+    {
+        feed.emplace(options.feedLayout);
+        if(!feed->open(options.feedPort))
+            return 1;
+        std::cout << "feed: udp port " << options.feedPort << std::endl;
+    }
+
+    renderer.setMeasuring(options.measure);
+    renderer.run([&](Simulation& simulation, const uint64_t simulatedSampleCount)
+    {
+        if(feed && feed->update())
+        {
+            if(voices)
+            {
+                for(size_t voice = 0; voice < options.voiceCount; voice++)
+                    feed->apply(voices->getSimulation(voice).cylinder, voiceFrequencyScales[voice]);
+            }
+            else
+                feed->apply(simulation.cylinder);
+        }
+
+        // the log is followed over the period being rendered, in the time of the simulation so that
+        // the fallback periods of the watchdog don't skip a part of it
+        if(vehicleLog)
+        {
+            const SimT time = static_cast<SimT>(simulatedSampleCount) / simulation.samplingRate;
+            const SimT duration = static_cast<SimT>(backend->getPeriodFrameCount()) / simulation.samplingRate;
+            if(voices)
+            {
+                for(size_t voice = 0; voice < options.voiceCount; voice++)
+                {
+                    vehicleLog->apply(voices->getSimulation(voice).cylinder, time, duration,
+                        voiceFrequencyScales[voice]);
+                }
+            }
+            else
+                vehicleLog->apply(simulation.cylinder, time, duration);
+
+            if(vehicleLog->isFinished(time + duration))
+                backend->stop();
+        }
+
+        // the period being rendered is the last one
+        if(targetFrameCount && renderer.getRenderedFrameCount() +
+            backend->getPeriodFrameCount() >= targetFrameCount)
+            backend->stop();
+    });
+    telemetryDumper.reset();
+    if(feed)
+    {
+        feed->close();
+        feed->getStats().print(std::cout, backend->getLatency());
+    }
+
+    if(!options.saveStatePath.empty())
+    {
+        std::vector<uint8_t> state;
+        (voices ? voices->getSimulation(0) : renderer.getSimulation()).saveSnapshot(state);
+        if(!writeFile(options.saveStatePath, state))
+            return 1;
+        std::cout << "state: " << state.size() << " bytes to " << options.saveStatePath << std::endl;
+    }
+    renderer.close();
+
+    std::cout << "rendered " << renderer.getRenderedFrameCount() << " frames" << std::endl;
+    if(voices)
+        printVoiceStats(*voices, options.voiceCount, std::cout);
+    if(qualityController)
+    {
+        std::vector<QualityChange> changes;
+        qualityController->drainChanges(changes);
+        std::cout << "quality changes: " << changes.size() << ", final tier " <<
+            Simulation::detailTiers[qualityController->getTier()].name << std::endl;
+        for(const auto& change : changes)
+            change.print(std::cout);
+    }
+    if(watchdog)
+    {
+        std::vector<WatchdogEvent> events;
+        watchdog->drainEvents(events);
+        std::cout << "watchdog misses: " << watchdog->getMissCount() << std::endl;
+        for(const auto& event : events)
+            event.print(std::cout);
+        if(watchdog->getDroppedEventCount())
+            std::cout << "dropped events: " << watchdog->getDroppedEventCount() << std::endl;
+    }
+
+    if(!options.tracePath.empty())
+    {
+#ifndef ENGINE_SOUND_TRACING
+        std::cerr << "tracing is not compiled in, define ENGINE_SOUND_TRACING" << std::endl;
+#endif
+        std::ofstream traceFile(options.tracePath);
+        if(!traceFile)
+        {
+            std::cerr << "cannot open " << options.tracePath << " for writing" << std::endl;
+            return 1;
+        }
+        Tracer::get().exportChromeTrace(traceFile);
+        std::cout << "trace overhead: " << Tracer::get().measureOverhead() <<
+            " ns per span" << std::endl;
+    }
+    if(options.measure)
+        renderer.getMeasurement().print(std::cout);
+
+    return 0;
+}
\ No newline at end of file
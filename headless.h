@@ -0,0 +1,5 @@
+#pragma once
+
+// runs the simulation from the command line without the gui;
+// returns the process exit code
+int runHeadless(int argc, char* argv[]);
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include "horn.h"
+#include "simulation.h"
+#include "trace.h"
+#include "snapshot.h"
+#include <cmath>
+#include <numbers>
+#include <complex>
+#include <algorithm>
+#include <cassert>
+
+HornPipe::HornPipe(Simulation& simulation, Cylinder& cylinder, const Pipe& pipe) :
+    outWave(simulation),
+    simulation(simulation),
+    cylinder(cylinder),
+    pipe(pipe)
+{
+}
+
+void HornPipe::setProfile(const std::vector<ProfilePoint>& profile)
+{
+    assert(std::is_sorted(profile.begin(), profile.end(),
+        [](const ProfilePoint& a, const ProfilePoint& b) { return a.position < b.position; }));
+
+    this->profile = profile;
+    this->profileChanged = true;
+}
+
+SimT HornPipe::getRadius(const SimT position) const
+{
+    const SimT radius = this->pipe.getPipeRadius();
+    if(this->profile.empty())
+        return radius;
+
+    // the last point of a step wins
+    const auto next = std::upper_bound(this->profile.begin(), this->profile.end(), position,
+        [](const SimT position, const ProfilePoint& point) { return position < point.position; });
+    if(next == this->profile.begin())
+        return radius * next->radiusScale;
+    if(next == this->profile.end())
+        return radius * this->profile.back().radiusScale;
+
+    const ProfilePoint& previous = *(next - 1);
+    const SimT t = (position - previous.position) / (next->position - previous.position);
+    return radius * (previous.radiusScale + t * (next->radiusScale - previous.radiusScale));
+}
+
+void HornPipe::reset()
+{
+    std::fill(this->pressures.begin(), this->pressures.end(), 0.0);
+    std::fill(this->flows.begin(), this->flows.end(), 0.0);
+    this->endVelocity = this->massVelocity = 0.0;
+}
+
+void HornPipe::warmStart()
+{
+    using Complex = std::complex<SimT>;
+
+    if(!this->isFitted())
+        this->fitGrid();
+
+    // the input is Im(x e^jwn), where n = 0 is the last sample of the cylinder;
+    // a value of the previous step is the phasor times z^-1, and every step also scales
+    // the old value by the loss, so l = loss z^-1
+    const SimT step = 2.0 * std::numbers::pi * this->cylinder.getFrequency() / this->simulation.samplingRate;
+    const Complex input = std::polar(Cylinder::conversationAmplitude, this->cylinder.getPhase());
+    const Complex delay = std::polar(1.0, -step);
+    const Complex l = this->loss * delay;
+
+    // flow i: F_i = a_i (P_i - P_i-1), a_i = -fc_i z^-1 / (1 - l)
+    const size_t cellCount = this->pressures.size();
+    std::vector<Complex> flowGains(cellCount + 1);
+    for(size_t i = 1; i < cellCount; i++)
+        flowGains[i] = -this->flowCoefficients[i] * delay / (1.0 - l);
+
+    // open end from the previous pressure of the last cell q = z^-1 P_N-1:
+    // pm = R (l E - l M + ec q / 2), E = l E + ec (q - pm), M = l M + em pm
+    const SimT r = this->endResistanceGain, ec = this->endCellGain, em = this->endMassGain;
+    const Complex massDenominator = 1.0 + r * l * em / (1.0 - l);
+    const Complex endGain = ec * (1.0 - 0.5 * ec * r / massDenominator) /
+        ((1.0 - l) + ec * r * l / massDenominator);
+    // F_N = g P_N-1
+    const Complex openEndGain = this->openEndArea * endGain * delay;
+
+    // pressure i: (1 - l) P_i + pc_i (F_i+1 - F_i) = 0, with F_0 = sg x;
+    // solved with the thomas algorithm
+    std::vector<Complex> diagonal(cellCount), upper(cellCount), rhs(cellCount);
+    std::vector<Complex> solution(cellCount);
+    for(size_t i = 0; i < cellCount; i++)
+    {
+        const SimT pc = this->pressureCoefficients[i];
+        Complex lower = 0.0;
+        diagonal[i] = 1.0 - l;
+        upper[i] = 0.0;
+        rhs[i] = 0.0;
+        if(i > 0)
+        {
+            lower = pc * flowGains[i];
+            diagonal[i] -= pc * flowGains[i];
+        }
+        else
+            rhs[i] = pc * this->sourceGain * input;
+        if(i + 1 < cellCount)
+        {
+            upper[i] = pc * flowGains[i + 1];
+            diagonal[i] -= pc * flowGains[i + 1];
+        }
+        else
+            diagonal[i] += pc * openEndGain;
+
+        if(i > 0)
+        {
+            const Complex factor = lower / diagonal[i - 1];
+            diagonal[i] -= factor * upper[i - 1];
+            rhs[i] -= factor * rhs[i - 1];
+        }
+    }
+    for(size_t i = cellCount; i-- > 0;)
+    {
+        solution[i] = (rhs[i] - (i + 1 < cellCount ? upper[i] * solution[i + 1] : Complex{})) /
+            diagonal[i];
+    }
+
+    for(size_t i = 0; i < cellCount; i++)
+        this->pressures[i] = std::imag(solution[i]);
+    this->flows[0] = std::imag(this->sourceGain * input);
+    for(size_t i = 1; i < cellCount; i++)
+        this->flows[i] = std::imag(flowGains[i] * (solution[i] - solution[i - 1]));
+
+    const Complex endVelocity = endGain * delay * solution[cellCount - 1];
+    const Complex mouthPressure = r * (l * endVelocity + 0.5 * ec * delay * solution[cellCount - 1]) /
+        massDenominator;
+    this->endVelocity = std::imag(endVelocity);
+    this->massVelocity = std::imag(em * mouthPressure / (1.0 - l));
+    this->flows[cellCount] = this->openEndArea * this->endVelocity;
+}
+
+bool HornPipe::isFitted() const
+{
+    return !this->profileChanged &&
+        this->fittedLength == this->pipe.getPipePhysicalLength() &&
+        this->fittedRadius == this->pipe.getPipeRadius() &&
+        this->fittedEchoIterations == this->pipe.getEchoIterations() &&
+        this->fittedTemperatures == this->pipe.getTemperatures();
+}
+
+void HornPipe::fitGrid()
+{
+    const SimT timeStep = 1.0 / this->simulation.samplingRate;
+    const SimT length = this->pipe.getPipePhysicalLength();
+
+    // the scheme is stable for c dt / dx <= 1 and free of dispersion at 1;
+    // the cell count is the largest one that is stable in the hottest segment, so the grid runs
+    // as close to the limit as the length allows
+    const std::vector<SimT>& temperatures = this->pipe.getTemperatures();
+    const SimT maxWaveSpeed = getWaveSpeed(temperatures.empty() ?
+        referenceTemperature : *std::max_element(temperatures.begin(), temperatures.end()));
+    const size_t cellCount = std::max<size_t>(2,
+        static_cast<size_t>(std::floor(length / (maxWaveSpeed * timeStep))));
+    const SimT cellLength = length / static_cast<SimT>(cellCount);
+    this->courantNumber = maxWaveSpeed * timeStep / cellLength;
+    assert(this->courantNumber <= 1.0 + 1e-9);
+
+    const auto getArea = [this](const SimT position)
+    {
+        const SimT radius = this->getRadius(position);
+        return std::numbers::pi * radius * radius;
+    };
+
+    // the state is kept for geometry changes that keep the grid
+    this->pressures.resize(cellCount, 0.0);
+    this->flows.resize(cellCount + 1, 0.0);
+    this->pressureCoefficients.resize(cellCount);
+    this->flowCoefficients.resize(cellCount + 1);
+
+    // dp/dt = -rho c^2 / S dU/dx
+    // dU/dt = -S / rho dp/dx
+    // the area of a cell is the mean of its faces, which keeps the limit at c dt / dx <= 1
+    // also for steps in the profile;
+    // the density of a face is the mean of its cells, so a face between segments sees both
+    // temperatures
+    std::vector<SimT> faceAreas(cellCount + 1), cellDensities(cellCount);
+    for(size_t i = 0; i < cellCount; i++)
+        cellDensities[i] = this->pipe.getDensity((static_cast<SimT>(i) + 0.5) / cellCount);
+    for(size_t i = 0; i <= cellCount; i++)
+    {
+        const SimT density = 0.5 * (cellDensities[i > 0 ? i - 1 : 0] + cellDensities[std::min(i, cellCount - 1)]);
+        faceAreas[i] = getArea(static_cast<SimT>(i) / cellCount);
+        this->flowCoefficients[i] = faceAreas[i] * timeStep / (density * cellLength);
+    }
+    for(size_t i = 0; i < cellCount; i++)
+    {
+        const SimT area = 0.5 * (faceAreas[i] + faceAreas[i + 1]);
+        const SimT cellWaveSpeed = this->pipe.getWaveSpeed((static_cast<SimT>(i) + 0.5) / cellCount);
+        this->pressureCoefficients[i] =
+            cellDensities[i] * cellWaveSpeed * cellWaveSpeed * timeStep / (area * cellLength);
+    }
+
+    // the closed end is a flow source that launches the cylinder wave into the pipe
+    this->sourceGain = getArea(0.0) / (this->pipe.getDensity(0.0) * this->pipe.getWaveSpeed(0.0));
+
+    // the open end has the mass of the end correction like in Pipe, in parallel with the
+    // radiation resistance;
+    // R = 1.44 rho c gives the low frequency resistance (ka)^2 / 4 of an unflanged pipe
+    const SimT endRadius = this->getRadius(1.0);
+    const SimT endDensity = this->pipe.getDensity(1.0), endWaveSpeed = this->pipe.getWaveSpeed(1.0);
+    const SimT endResistance = 1.44 * endDensity * endWaveSpeed;
+    this->openEndArea = getArea(1.0);
+    this->endCellGain = timeStep / (endDensity * 0.5 * cellLength);
+    this->endMassGain = timeStep / (endDensity * endCorrectionFactor * endRadius);
+    this->endResistanceGain =
+        endResistance / (1.0 + 0.5 * endResistance * (this->endCellGain + this->endMassGain));
+
+    // the echo model stops after the echo iterations;
+    // the same decay per round trip is spread over the time steps
+    const SimT roundTripSampleCount =
+        2.0 * (this->pipe.getTravelTime() + endCorrectionFactor * endRadius / endWaveSpeed) / timeStep;
+    this->loss = std::pow(
+        1.0 - 1.0 / static_cast<SimT>(this->pipe.getEchoIterations()), 1.0 / roundTripSampleCount);
+
+    this->fittedLength = length;
+    this->fittedRadius = this->pipe.getPipeRadius();
+    this->fittedEchoIterations = this->pipe.getEchoIterations();
+    this->fittedTemperatures = this->pipe.getTemperatures();
+    this->profileChanged = false;
+}
+
+SimT HornPipe::progressOpenEnd(const SimT pressure)
+{
+    // the velocity of the end face is driven by the last cell over half a cell;
+    // the mouth pressure is shared by the end correction mass and the resistance:
+    // rho dx / 2 du/dt = p - pm
+    // m du_m/dt = pm
+    // pm = R (u - u_m)
+    // solved with the trapezoidal rule, which keeps the boundary passive
+    const SimT endVelocity = this->loss * this->endVelocity;
+    const SimT massVelocity = this->loss * this->massVelocity;
+
+    const SimT mouthPressure = this->endResistanceGain *
+        (endVelocity - massVelocity + 0.5 * this->endCellGain * pressure);
+
+    this->endVelocity = endVelocity + this->endCellGain * (pressure - mouthPressure);
+    this->massVelocity = massVelocity + this->endMassGain * mouthPressure;
+
+    return mouthPressure;
+}
+
+void HornPipe::progressSimulation(const size_t sampleCount)
+{
+    TRACE_SCOPE("HornPipe::progressSimulation");
+
+    if(!this->isFitted())
+        this->fitGrid();
+
+    const Wave::SampleContainer& in = this->cylinder.currentOutWave.samples;
+    assert(in.size() == sampleCount);
+
+    this->outWave.samples.resize(sampleCount);
+
+    const size_t cellCount = this->pressures.size();
+    SimT* const pressures = this->pressures.data();
+    SimT* const flows = this->flows.data();
+    const SimT* const pressureCoefficients = this->pressureCoefficients.data();
+    const SimT* const flowCoefficients = this->flowCoefficients.data();
+    const SimT loss = this->loss;
+
+    for(size_t n = 0; n < sampleCount; n++)
+    {
+        // leapfrog; the flows are updated from the pressures and then the pressures from the
+        // flows, so both loops are free of dependencies between the cells
+        flows[0] = this->sourceGain * in[n];
+        for(size_t i = 1; i < cellCount; i++)
+            flows[i] = loss * flows[i] - flowCoefficients[i] * (pressures[i] - pressures[i - 1]);
+
+        const SimT mouthPressure = this->progressOpenEnd(pressures[cellCount - 1]);
+        flows[cellCount] = this->openEndArea * this->endVelocity;
+
+        for(size_t i = 0; i < cellCount; i++)
+            pressures[i] = loss * pressures[i] - pressureCoefficients[i] * (flows[i + 1] - flows[i]);
+
+        // the mouth pressure is of the full flow of the open end, which is twice the flow of
+        // the incident wave that Pipe radiates from
+        this->outWave.samples[n] = -0.5 * mouthPressure;
+    }
+}
+
+void HornPipe::saveState(SnapshotWriter& writer) const
+{
+    writer.writeVector(this->profile);
+    writer.write(this->profileChanged);
+    writer.writeVector(this->pressures);
+    writer.writeVector(this->flows);
+    writer.writeVector(this->pressureCoefficients);
+    writer.writeVector(this->flowCoefficients);
+    writer.write(this->courantNumber);
+    writer.write(this->loss);
+    writer.write(this->openEndArea);
+    writer.write(this->sourceGain);
+    writer.write(this->endVelocity);
+    writer.write(this->massVelocity);
+    writer.write(this->endCellGain);
+    writer.write(this->endMassGain);
+    writer.write(this->endResistanceGain);
+    writer.write(this->fittedLength);
+    writer.write(this->fittedRadius);
+    writer.writeSize(this->fittedEchoIterations);
+    writer.writeVector(this->fittedTemperatures);
+}
+
+bool HornPipe::loadState(SnapshotReader& reader)
+{
+    reader.readVector(this->profile);
+    reader.read(this->profileChanged);
+    reader.readVector(this->pressures);
+    reader.readVector(this->flows);
+    reader.readVector(this->pressureCoefficients);
+    reader.readVector(this->flowCoefficients);
+    reader.read(this->courantNumber);
+    reader.read(this->loss);
+    reader.read(this->openEndArea);
+    reader.read(this->sourceGain);
+    reader.read(this->endVelocity);
+    reader.read(this->massVelocity);
+    reader.read(this->endCellGain);
+    reader.read(this->endMassGain);
+    reader.read(this->endResistanceGain);
+    reader.read(this->fittedLength);
+    reader.read(this->fittedRadius);
+    reader.readSize(this->fittedEchoIterations);
+    reader.readVector(this->fittedTemperatures);
+
+    // the faces are one more than the cells
+    const size_t cellCount = this->pressures.size();
+    if(this->pressureCoefficients.size() != cellCount ||
+        this->flows.size() != (cellCount ? cellCount + 1 : 0) ||
+        this->flowCoefficients.size() != this->flows.size())
+        reader.fail();
+
+    return reader.isValid();
+}
\ No newline at end of file
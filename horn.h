@@ -0,0 +1,85 @@
+#pragma once
+#include "wave.h"
+#include <vector>
+
+class Simulation;
+class SnapshotWriter;
+class SnapshotReader;
+class Cylinder;
+class Pipe;
+
+// closed-open pipe of variable cross section solved with finite differences of the
+// webster horn equation;
+// pressures are at the cell centers and volume flows at the faces of a staggered grid,
+// the open end is loaded with the same end correction mass as in Pipe plus a
+// radiation resistance;
+// the length, the radius and the temperatures are read from Pipe, the profile scales the radius
+// along the pipe; every cell has the speed of sound and the density of its segment
+class HornPipe
+{
+public:
+    // radius at relative position in [0, 1] along the pipe from the closed end,
+    // in relation to the pipe radius;
+    // steps are made with two points at the same position
+    struct ProfilePoint
+    {
+        SimT position;
+        SimT radiusScale;
+
+        bool operator==(const ProfilePoint&) const = default;
+    };
+public:
+    // radiated pressure of the last progress
+    Wave outWave;
+
+    HornPipe(Simulation& simulation, Cylinder& cylinder, const Pipe& pipe);
+
+    // points are sorted by position;
+    // an empty profile is a uniform pipe
+    void setProfile(const std::vector<ProfilePoint>& profile);
+    const std::vector<ProfilePoint>& getProfile() const { return this->profile; }
+    SimT getRadius(const SimT position) const;
+
+    size_t getCellCount() const { return this->pressures.size(); }
+    // largest c dt / dx of the cells, at most 1
+    SimT getCourantNumber() const { return this->courantNumber; }
+
+    // refits the grid if the geometry has changed;
+    // the state is kept if the cell count stays the same
+    void progressSimulation(const size_t sampleCount);
+    void reset();
+    // solves the grid for the steady state of the sine of the cylinder at its current phase;
+    // the update is linear, so every pressure and flow is the input phasor times a complex gain,
+    // which is a tridiagonal system over the cell pressures
+    void warmStart();
+
+    // state and parameters for the snapshots of Simulation
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
+private:
+    Simulation& simulation;
+    Cylinder& cylinder;
+    const Pipe& pipe;
+    std::vector<ProfilePoint> profile;
+    bool profileChanged = true;
+
+    // cell pressures and face volume flows;
+    // the first face is the closed end driven by the cylinder, the last is the open end
+    std::vector<SimT> pressures, flows;
+    std::vector<SimT> pressureCoefficients, flowCoefficients;
+    SimT courantNumber = 0.0, loss = 1.0;
+    // open end
+    SimT openEndArea = 0.0, sourceGain = 0.0;
+    SimT endVelocity = 0.0, massVelocity = 0.0;
+    SimT endCellGain = 0.0, endMassGain = 0.0, endResistanceGain = 0.0;
+
+    SimT fittedLength = 0.0, fittedRadius = 0.0;
+    size_t fittedEchoIterations = 0;
+    std::vector<SimT> fittedTemperatures;
+
+    bool isFitted() const;
+    void fitGrid();
+    // solves the open end boundary for the next end velocity;
+    // returns the pressure at the mouth
+    SimT progressOpenEnd(const SimT pressure);
+};
\ No newline at end of file
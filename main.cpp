@@ -1,8 +1,14 @@
+#ifdef _WIN32
 #include "window.h"
+#endif
+#include "headless.h"
+#include "wave.h"
+#include <limits>
 #include <iostream>
 
 static_assert(std::numeric_limits<SimT>::is_iec559);
 
+#ifdef _WIN32
 inline void CHECK_HR(const HRESULT hr) 
 {
     if(FAILED(hr)) 
@@ -14,9 +20,15 @@ inline void CHECK_HR(const HRESULT hr)
 }
 
 CAppModule module_;
+#endif
 
-int main()
+int main(int argc, char* argv[])
 {
+#ifdef _WIN32
+    // command line arguments run the simulation without the gui
+    if(argc > 1)
+        return runHeadless(argc, argv);
+
     HRESULT hr = S_OK;
 
     // initialize COM
@@ -40,4 +52,7 @@ int main()
     CoUninitialize();
 
     return 0;
+#else
+    return runHeadless(argc, argv);
+#endif
 }
\ No newline at end of file
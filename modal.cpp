@@ -0,0 +1,245 @@
+#include "modal.h"
+#include "simulation.h"
+#include "trace.h"
+#include "snapshot.h"
+#include <cmath>
+#include <numbers>
+#include <complex>
+#include <algorithm>
+#include <cassert>
+
+ModalPipe::ModalPipe(Simulation& simulation, Cylinder& cylinder, const Pipe& pipe) :
+    outWave(simulation),
+    simulation(simulation),
+    cylinder(cylinder),
+    pipe(pipe)
+{
+}
+
+void ModalPipe::setModeCount(const size_t modeCount)
+{
+    assert(modeCount > 0);
+    this->modeCount = modeCount;
+}
+
+void ModalPipe::setModeLimit(const size_t modeLimit)
+{
+    assert(modeLimit > 0);
+    this->modeLimit = modeLimit;
+}
+
+SimT ModalPipe::getModeFrequency(const size_t mode) const
+{
+    const SimT travelTime = this->pipe.getTravelTime() + this->pipe.getEndCorrectionTime();
+    return static_cast<SimT>(2 * mode + 1) / (4.0 * travelTime);
+}
+
+void ModalPipe::reset()
+{
+    std::fill(this->y1.begin(), this->y1.end(), 0.0);
+    std::fill(this->y2.begin(), this->y2.end(), 0.0);
+    this->x1 = this->sum1 = 0.0;
+}
+
+void ModalPipe::warmStart()
+{
+    if(!this->isFitted())
+        this->fitModes();
+
+    // the input is Im(x e^jwn), where n = 0 is the last sample of the cylinder
+    const SimT step = 2.0 * std::numbers::pi * this->cylinder.getFrequency() / this->simulation.samplingRate;
+    const std::complex<SimT> input = std::polar(Cylinder::conversationAmplitude, this->cylinder.getPhase());
+    const std::complex<SimT> delay = std::polar(1.0, -step);
+
+    this->sum1 = 0.0;
+    for(size_t mode = 0; mode < this->a1.size(); mode++)
+    {
+        const std::complex<SimT> response = (this->b0[mode] + this->b1[mode] * delay) /
+            (1.0 - this->a1[mode] * delay + this->a2[mode] * delay * delay);
+        this->y1[mode] = std::imag(response * input);
+        this->y2[mode] = std::imag(response * input * delay);
+        this->sum1 += this->y1[mode];
+    }
+    this->x1 = std::imag(input);
+}
+
+bool ModalPipe::isFitted() const
+{
+    return this->fittedModeCount == std::min(this->modeCount, this->modeLimit) &&
+        this->fittedLength == this->pipe.getPipePhysicalLength() &&
+        this->fittedRadius == this->pipe.getPipeRadius() &&
+        this->fittedEchoIterations == this->pipe.getEchoIterations() &&
+        this->fittedTemperatures == this->pipe.getTemperatures() &&
+        this->fittedWallLossAttenuation == this->pipe.getWallLossFilter().getAttenuation();
+}
+
+void ModalPipe::fitModes()
+{
+    const SimT samplingRate = this->simulation.samplingRate;
+    const SimT radius = this->pipe.getPipeRadius();
+    const SimT travelTime = this->pipe.getTravelTime() + this->pipe.getEndCorrectionTime();
+    const SimT endWaveSpeed = this->pipe.getWaveSpeed(1.0);
+    const WallLossFilter& wallLossFilter = this->pipe.getWallLossFilter();
+
+    // the echo model is a delay loop of round trip length;
+    // the partial fractions of 1 / (1 + R z^-N) are N first order modes of gain 1 / N,
+    // which are combined here to conjugate pairs
+    const SimT roundTripSampleCount = 2.0 * travelTime * samplingRate;
+    const SimT maxReflection = 1.0 - 1.0 / static_cast<SimT>(this->pipe.getEchoIterations());
+
+    const size_t modeCount = std::min(this->modeCount, this->modeLimit);
+    const size_t paddedModeCount = (modeCount + laneCount - 1) / laneCount * laneCount;
+    this->a1.assign(paddedModeCount, 0.0);
+    this->a2.assign(paddedModeCount, 0.0);
+    this->b0.assign(paddedModeCount, 0.0);
+    this->b1.assign(paddedModeCount, 0.0);
+    // the states of the modes that still exist are kept
+    this->y1.resize(paddedModeCount, 0.0);
+    this->y2.resize(paddedModeCount, 0.0);
+
+    this->activeModeCount = 0;
+    for(size_t mode = 0; mode < modeCount; mode++)
+    {
+        const SimT frequency = this->getModeFrequency(mode);
+        if(frequency >= 0.5 * samplingRate)
+            break;
+
+        // levine-schwinger approximation of the reflection of an unflanged open end,
+        // the same end that gives the 0.6 end correction;
+        // |R| = exp(-(ka)^2 / 2);
+        // the echo model has no loss at low frequencies and instead stops after the echo
+        // iterations, so the peak height 1 / (1 - |R|) is limited to the same echo count;
+        // the wall loss of the round trip is a part of the reflection here;
+        // the loss is spread over the round trip
+        const SimT ka = 2.0 * std::numbers::pi * frequency / endWaveSpeed * radius;
+        const SimT reflection = std::min(std::exp(-0.5 * ka * ka) * wallLossFilter.getTargetMagnitude(frequency),
+            maxReflection);
+        const SimT poleRadius = std::pow(reflection, 1.0 / roundTripSampleCount);
+        const SimT poleAngle = 2.0 * std::numbers::pi * frequency / samplingRate;
+
+        this->a1[mode] = 2.0 * poleRadius * std::cos(poleAngle);
+        this->a2[mode] = poleRadius * poleRadius;
+        this->b0[mode] = 2.0 / roundTripSampleCount;
+        this->b1[mode] = -this->a1[mode] / roundTripSampleCount;
+        this->activeModeCount++;
+    }
+
+    // silent modes don't ring out
+    for(size_t mode = this->activeModeCount; mode < paddedModeCount; mode++)
+        this->y1[mode] = this->y2[mode] = 0.0;
+
+    // same radiation as in Pipe::splitToRadiatedAndReflectedWaves
+    this->radiationGain = this->pipe.getEndCorrectionTime() * samplingRate;
+
+    this->fittedLength = this->pipe.getPipePhysicalLength();
+    this->fittedRadius = radius;
+    this->fittedModeCount = modeCount;
+    this->fittedEchoIterations = this->pipe.getEchoIterations();
+    this->fittedTemperatures = this->pipe.getTemperatures();
+    this->fittedWallLossAttenuation = wallLossFilter.getAttenuation();
+}
+
+void ModalPipe::progressSimulation(const size_t sampleCount)
+{
+    TRACE_SCOPE("ModalPipe::progressSimulation");
+
+    if(!this->isFitted())
+        this->fitModes();
+
+    const Wave::SampleContainer& in = this->cylinder.currentOutWave.samples;
+    assert(in.size() == sampleCount);
+
+    this->outWave.samples.resize(sampleCount);
+
+    const size_t paddedModeCount = this->a1.size();
+    SimT* const y1 = this->y1.data();
+    SimT* const y2 = this->y2.data();
+    const SimT* const a1 = this->a1.data();
+    const SimT* const a2 = this->a2.data();
+    const SimT* const b0 = this->b0.data();
+    const SimT* const b1 = this->b1.data();
+
+    for(size_t i = 0; i < sampleCount; i++)
+    {
+        const SimT x = in[i];
+
+        // the modes are independent, so the inner loop runs across the lanes;
+        // the sum is kept per lane so that the loop doesn't depend on reassociation
+        SimT laneSums[laneCount] = {};
+        for(size_t group = 0; group < paddedModeCount; group += laneCount)
+        {
+            for(size_t lane = 0; lane < laneCount; lane++)
+            {
+                const size_t mode = group + lane;
+                const SimT y = b0[mode] * x + b1[mode] * this->x1 +
+                    a1[mode] * y1[mode] - a2[mode] * y2[mode];
+                y2[mode] = y1[mode];
+                y1[mode] = y;
+                laneSums[lane] += y;
+            }
+        }
+
+        SimT sum = 0.0;
+        for(size_t lane = 0; lane < laneCount; lane++)
+            sum += laneSums[lane];
+
+        // pressure at the open end to radiated pressure
+        this->outWave.samples[i] = -this->radiationGain * (sum - this->sum1);
+        this->sum1 = sum;
+        this->x1 = x;
+    }
+}
+
+void ModalPipe::saveState(SnapshotWriter& writer) const
+{
+    writer.writeSize(this->modeCount);
+    writer.writeSize(this->modeLimit);
+    writer.writeSize(this->activeModeCount);
+    writer.writeVector(this->a1);
+    writer.writeVector(this->a2);
+    writer.writeVector(this->b0);
+    writer.writeVector(this->b1);
+    writer.writeVector(this->y1);
+    writer.writeVector(this->y2);
+    writer.write(this->x1);
+    writer.write(this->sum1);
+    writer.write(this->radiationGain);
+    writer.write(this->fittedLength);
+    writer.write(this->fittedRadius);
+    writer.writeSize(this->fittedModeCount);
+    writer.writeSize(this->fittedEchoIterations);
+    writer.writeVector(this->fittedTemperatures);
+    writer.write(this->fittedWallLossAttenuation);
+}
+
+bool ModalPipe::loadState(SnapshotReader& reader)
+{
+    reader.readSize(this->modeCount);
+    reader.readSize(this->modeLimit);
+    reader.readSize(this->activeModeCount);
+    reader.readVector(this->a1);
+    reader.readVector(this->a2);
+    reader.readVector(this->b0);
+    reader.readVector(this->b1);
+    reader.readVector(this->y1);
+    reader.readVector(this->y2);
+    reader.read(this->x1);
+    reader.read(this->sum1);
+    reader.read(this->radiationGain);
+    reader.read(this->fittedLength);
+    reader.read(this->fittedRadius);
+    reader.readSize(this->fittedModeCount);
+    reader.readSize(this->fittedEchoIterations);
+    reader.readVector(this->fittedTemperatures);
+    reader.read(this->fittedWallLossAttenuation);
+
+    // the bank is processed in whole groups over all of the vectors
+    const size_t paddedModeCount = this->a1.size();
+    if(paddedModeCount % laneCount != 0 || this->activeModeCount > paddedModeCount ||
+        this->a2.size() != paddedModeCount || this->b0.size() != paddedModeCount ||
+        this->b1.size() != paddedModeCount || this->y1.size() != paddedModeCount ||
+        this->y2.size() != paddedModeCount)
+        reader.fail();
+
+    return reader.isValid();
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include "wave.h"
+#include <vector>
+#include <cstdint>
+
+class Simulation;
+class SnapshotWriter;
+class SnapshotReader;
+class Cylinder;
+class Pipe;
+
+// closed-open pipe rendered as a bank of two-pole resonators;
+// the resonances are at odd multiples of 1 / 4T, where T is the travel time of the sound through
+// the pipe with the end correction, which is L / c at a uniform temperature, and decay by the radiation loss at the open end;
+// alternative to the echo bookkeeping of Pipe, the geometry is read from it
+class ModalPipe
+{
+public:
+    static constexpr size_t startModeCount = 32;
+    // the bank is processed in groups of lane count modes
+    static constexpr size_t laneCount = 8;
+public:
+    // radiated pressure of the last progress
+    Wave outWave;
+
+    ModalPipe(Simulation& simulation, Cylinder& cylinder, const Pipe& pipe);
+
+    // amount of modes is the quality knob;
+    // modes above the nyquist frequency are left out
+    void setModeCount(const size_t modeCount);
+    size_t getModeCount() const { return this->modeCount; }
+    // caps the mode count for the level of detail;
+    // the states of the remaining modes are kept
+    void setModeLimit(const size_t modeLimit);
+    size_t getActiveModeCount() const { return this->activeModeCount; }
+    SimT getModeFrequency(const size_t mode) const;
+
+    // refits the modes if the geometry of the pipe has changed;
+    // the resonator states are kept so that geometry changes don't reset the sound
+    void progressSimulation(const size_t sampleCount);
+    void reset();
+    // sets the resonators to the steady state of the sine of the cylinder at its current phase,
+    // which the bank would ring at after the build-up
+    void warmStart();
+
+    // state and parameters for the snapshots of Simulation
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
+private:
+    Simulation& simulation;
+    Cylinder& cylinder;
+    const Pipe& pipe;
+    size_t modeCount = startModeCount, modeLimit = SIZE_MAX, activeModeCount = 0;
+
+    // resonator coefficients and states in structure of arrays layout,
+    // padded to lane count with silent modes;
+    // y[n] = b0 x[n] + b1 x[n-1] + a1 y[n-1] - a2 y[n-2]
+    std::vector<SimT> a1, a2, b0, b1;
+    std::vector<SimT> y1, y2;
+    SimT x1 = 0.0, sum1 = 0.0;
+    SimT radiationGain = 0.0;
+
+    SimT fittedLength = 0.0, fittedRadius = 0.0, fittedWallLossAttenuation = 0.0;
+    size_t fittedModeCount = 0, fittedEchoIterations = 0;
+    std::vector<SimT> fittedTemperatures;
+
+    bool isFitted() const;
+    void fitModes();
+};
\ No newline at end of file
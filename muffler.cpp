@@ -0,0 +1,606 @@
+#include "muffler.h"
+#include "convolution.h"
+#include <thread>
+#include <barrier>
+#include <chrono>
+#include <fstream>
+#include <numbers>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <cassert>
+
+#include <iostream>
+#include <iomanip>
+
+bool MufflerGeometry::loadVoxels(const std::string& path)
+{
+    std::ifstream file(path);
+    if(!file)
+    {
+        std::cerr << "cannot open " << path << std::endl;
+        return false;
+    }
+
+    if(!(file >> this->voxelCountX >> this->voxelCountY >> this->voxelCountZ) ||
+        this->voxelCountX == 0 || this->voxelCountY == 0 || this->voxelCountZ == 0)
+    {
+        std::cerr << path << " has no voxel dimensions" << std::endl;
+        return false;
+    }
+
+    this->voxels.clear();
+    this->voxels.reserve(this->voxelCountX * this->voxelCountY * this->voxelCountZ);
+    char voxel;
+    while(this->voxels.size() < this->voxels.capacity() && file >> voxel)
+        this->voxels.push_back(voxel == '#' ? 1 : 0);
+
+    if(this->voxels.size() != this->voxelCountX * this->voxelCountY * this->voxelCountZ)
+    {
+        std::cerr << path << " has too few voxels" << std::endl;
+        this->voxels.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool MufflerGeometry::isSolid(const SimT x, const SimT y, const SimT z) const
+{
+    if(this->voxels.empty())
+        return false;
+
+    const auto getVoxel = [](const SimT position, const SimT size, const size_t count)
+    {
+        return std::min(count - 1, static_cast<size_t>(std::max(0.0, position / size * count)));
+    };
+    const size_t voxelX = getVoxel(x, this->length, this->voxelCountX);
+    const size_t voxelY = getVoxel(y, this->width, this->voxelCountY);
+    const size_t voxelZ = getVoxel(z, this->height, this->voxelCountZ);
+
+    return this->voxels[voxelX + this->voxelCountX * (voxelY + this->voxelCountY * voxelZ)] != 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+namespace
+{
+
+// lambda^2 = 1 / 3 rounded down;
+// the nearest float is above the limit, which makes the uniform mode grow
+constexpr float lambdaSquared = 0.333333313f;
+
+// bulk update of a row of cells;
+// next holds the previous pressures and is overwritten
+void updateRow(float* __restrict next, const float* __restrict current, const size_t count,
+    const ptrdiff_t rowStride, const ptrdiff_t planeStride)
+{
+    for(size_t x = 0; x < count; x++)
+    {
+        next[x] = lambdaSquared * (current[x - 1] + current[x + 1] +
+            current[x - rowStride] + current[x + rowStride] +
+            current[x - planeStride] + current[x + planeStride]) - next[x];
+    }
+}
+
+}
+
+MufflerSolver::MufflerSolver(const MufflerGeometry& geometry, const SimT cellSize,
+    const size_t threadCount) :
+    threadCount(std::max<size_t>(threadCount, 1)),
+    cellSize(cellSize)
+{
+    assert(cellSize > 0.0);
+
+    this->timeStep = courantNumber * cellSize / waveSpeed;
+    this->countX = std::max<size_t>(1, static_cast<size_t>(std::lround(geometry.length / cellSize))) + 2;
+    this->countY = std::max<size_t>(1, static_cast<size_t>(std::lround(geometry.width / cellSize))) + 2;
+    this->countZ = std::max<size_t>(1, static_cast<size_t>(std::lround(geometry.height / cellSize))) + 2;
+
+    // left uninitialized so that the slabs are first touched by the threads that update them
+    this->pressures.reset(new float[this->getCellCount()]);
+    this->previousPressures.reset(new float[this->getCellCount()]);
+
+    // air of the interior cells; the halo is solid
+    std::vector<uint8_t> air(this->getCellCount(), 0);
+    for(size_t z = 1; z < this->countZ - 1; z++)
+    {
+        for(size_t y = 1; y < this->countY - 1; y++)
+        {
+            for(size_t x = 1; x < this->countX - 1; x++)
+            {
+                air[this->getIndex(x, y, z)] = !geometry.isSolid((x - 0.5) * cellSize,
+                    (y - 0.5) * cellSize, (z - 0.5) * cellSize);
+            }
+        }
+    }
+
+    const auto isInPort = [&](const size_t y, const size_t z, const SimT radius,
+        const SimT offsetY, const SimT offsetZ)
+    {
+        const SimT distanceY = (y - 0.5) * cellSize - (0.5 * geometry.width + offsetY);
+        const SimT distanceZ = (z - 0.5) * cellSize - (0.5 * geometry.height + offsetZ);
+        return distanceY * distanceY + distanceZ * distanceZ <= radius * radius;
+    };
+
+    const size_t interiorCountZ = this->countZ - 2;
+    const size_t slabCount = std::min(this->threadCount, interiorCountZ);
+    this->slabs.resize(slabCount);
+    for(size_t slab = 0; slab < slabCount; slab++)
+    {
+        this->slabs[slab].firstZ = 1 + slab * interiorCountZ / slabCount;
+        this->slabs[slab].lastZ = 1 + (slab + 1) * interiorCountZ / slabCount;
+    }
+
+    const ptrdiff_t strides[6] = {-1, 1,
+        -static_cast<ptrdiff_t>(this->countX), static_cast<ptrdiff_t>(this->countX),
+        -static_cast<ptrdiff_t>(this->countX * this->countY),
+        static_cast<ptrdiff_t>(this->countX * this->countY)};
+    for(auto& slab : this->slabs)
+    {
+        for(size_t z = slab.firstZ; z < slab.lastZ; z++)
+        {
+            for(size_t y = 1; y < this->countY - 1; y++)
+            {
+                for(size_t x = 1; x < this->countX - 1; x++)
+                {
+                    const size_t index = this->getIndex(x, y, z);
+                    if(!air[index])
+                        continue;
+
+                    uint8_t neighbors = 0;
+                    uint32_t wallFaces = 0, inletFaces = 0, outletFaces = 0;
+                    for(size_t face = 0; face < 6; face++)
+                    {
+                        if(air[index + strides[face]])
+                            neighbors |= 1 << face;
+                        else if(face == 0 && x == 1 && isInPort(y, z, geometry.inletRadius,
+                            geometry.inletOffsetY, geometry.inletOffsetZ))
+                            inletFaces++;
+                        else if(face == 1 && x == this->countX - 2 && isInPort(y, z,
+                            geometry.outletRadius, geometry.outletOffsetY, geometry.outletOffsetZ))
+                            outletFaces++;
+                        else
+                            wallFaces++;
+                    }
+                    if(neighbors == 0x3f)
+                        continue;
+
+                    const SimT damping = 0.5 * courantNumber *
+                        (inletFaces + outletFaces + geometry.wallAdmittance * wallFaces);
+                    slab.boundaryCells.push_back(BoundaryCell {index, neighbors,
+                        static_cast<float>(damping), static_cast<float>(courantNumber * inletFaces)});
+
+                    if(outletFaces)
+                    {
+                        this->outletCells.emplace_back(index, outletFaces);
+                        this->outletFaceCount += outletFaces;
+                    }
+                }
+            }
+        }
+        slab.savedPressures.resize(slab.boundaryCells.size());
+    }
+}
+
+size_t MufflerSolver::getBoundaryCellCount() const
+{
+    size_t count = 0;
+    for(const auto& slab : this->slabs)
+        count += slab.boundaryCells.size();
+
+    return count;
+}
+
+void MufflerSolver::runSlab(Slab& slab, const float* const current, float* const next,
+    const SimT sourceDifference) const
+{
+    // the bulk update overwrites the previous pressures of the boundary cells
+    for(size_t i = 0; i < slab.boundaryCells.size(); i++)
+        slab.savedPressures[i] = next[slab.boundaryCells[i].index];
+
+    // tiles of rows so that the three planes of a tile stay in the cache
+    const ptrdiff_t rowStride = static_cast<ptrdiff_t>(this->countX);
+    const ptrdiff_t planeStride = static_cast<ptrdiff_t>(this->countX * this->countY);
+    const size_t tileRowCount = std::max<size_t>(1, (256 * 1024) / (3 * this->countX * sizeof(float)));
+    for(size_t firstY = 1; firstY < this->countY - 1; firstY += tileRowCount)
+    {
+        const size_t lastY = std::min(this->countY - 1, firstY + tileRowCount);
+        for(size_t z = slab.firstZ; z < slab.lastZ; z++)
+        {
+            for(size_t y = firstY; y < lastY; y++)
+            {
+                const size_t index = this->getIndex(1, y, z);
+                updateRow(next + index, current + index, this->countX - 2, rowStride, planeStride);
+            }
+        }
+    }
+
+    // p+ (1 + a) = (2 - l^2 K) p + l^2 sum - (1 - a) p- + source
+    const ptrdiff_t strides[6] = {-1, 1, -rowStride, rowStride, -planeStride, planeStride};
+    for(size_t i = 0; i < slab.boundaryCells.size(); i++)
+    {
+        const BoundaryCell& cell = slab.boundaryCells[i];
+        float sum = 0.0f;
+        int airCount = 0;
+        for(size_t face = 0; face < 6; face++)
+        {
+            if(cell.neighbors & (1 << face))
+            {
+                sum += current[cell.index + strides[face]];
+                airCount++;
+            }
+        }
+
+        next[cell.index] = ((2.0f - lambdaSquared * airCount) * current[cell.index] +
+            lambdaSquared * sum - (1.0f - cell.damping) * slab.savedPressures[i] +
+            cell.sourceGain * static_cast<float>(sourceDifference)) / (1.0f + cell.damping);
+    }
+}
+
+std::vector<SimT> MufflerSolver::run(const size_t stepCount)
+{
+    std::vector<SimT> output;
+    output.reserve(stepCount);
+
+    float* current = this->pressures.get();
+    float* next = this->previousPressures.get();
+    size_t step = 0;
+
+    // the inlet signal is a unit impulse at the first step;
+    // the source is driven by its central difference
+    const auto getSourceDifference = [](const size_t step)
+    {
+        return (step == 0 ? 1.0 : 0.0) - (step == 2 ? 1.0 : 0.0);
+    };
+
+    // runs on one thread after all the slabs have finished the step;
+    // the first phase is the initialization
+    bool initializing = true;
+    const auto finishStep = [&]() noexcept
+    {
+        if(initializing)
+        {
+            initializing = false;
+            return;
+        }
+
+        SimT sum = 0.0;
+        for(const auto& [index, faceCount] : this->outletCells)
+            sum += next[index] * faceCount;
+        output.push_back(this->outletFaceCount ? sum / this->outletFaceCount : 0.0);
+
+        std::swap(current, next);
+        step++;
+    };
+    std::barrier barrier(static_cast<ptrdiff_t>(this->slabs.size()), finishStep);
+
+    // the halo planes are touched by the first and the last slab
+    const size_t planeSize = this->countX * this->countY;
+    const auto slabEntryPoint = [&](const size_t slabIndex)
+    {
+        Slab& slab = this->slabs[slabIndex];
+        const size_t first = slabIndex == 0 ? 0 : slab.firstZ;
+        const size_t last = slabIndex + 1 == this->slabs.size() ? this->countZ : slab.lastZ;
+        std::fill(current + first * planeSize, current + last * planeSize, 0.0f);
+        std::fill(next + first * planeSize, next + last * planeSize, 0.0f);
+        barrier.arrive_and_wait();
+
+        while(step < stepCount)
+        {
+            this->runSlab(slab, current, next, getSourceDifference(step));
+            barrier.arrive_and_wait();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(size_t slab = 1; slab < this->slabs.size(); slab++)
+        threads.emplace_back(slabEntryPoint, slab);
+    slabEntryPoint(0);
+    for(auto& thread : threads)
+        thread.join();
+
+    return output;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+namespace
+{
+
+struct MufflerOptions
+{
+    MufflerGeometry geometry;
+    SimT maxCellSize = 0.005;
+    SimT duration = 0.1;
+    uint32_t samplingRate = 48000;
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::string outputPath = "muffler.wav";
+    bool scaling = false;
+    size_t scalingStepCount = 100;
+    // the response is applied by direct convolution, so its length is the cost
+    SimT maxResponseLength = 0.05;
+};
+
+void printMufflerUsage()
+{
+    std::cout <<
+        "usage: engine sound muffler [options]\n"
+        "  --box <l,w,h>                      chamber size in cm, default 30,12,12\n"
+        "  --inlet-radius <mm>                default 10\n"
+        "  --outlet-radius <mm>               default 10\n"
+        "  --inlet-offset <y,z>               port center from the face center in cm\n"
+        "  --outlet-offset <y,z>              port center from the face center in cm\n"
+        "  --voxels <path>                    solid voxels inside the box\n"
+        "  --wall-admittance <value>          0 is rigid, default 0\n"
+        "  --cell-size <mm>                   largest cell size, default 5\n"
+        "  --duration <seconds>               simulated duration, default 0.1\n"
+        "  --sample-rate <hz>                 sampling rate of the response, default 48000\n"
+        "  --threads <count>                  default is the hardware concurrency\n"
+        "  --output <path>                    response wav, default muffler.wav\n"
+        "  --max-length <seconds>             longest written response, default 0.05\n"
+        "  --scaling                          measure the thread scaling instead\n"
+        "  --scaling-steps <count>            steps per scaling run, default 100\n";
+}
+
+// comma separated values
+bool parseValues(const char* value, SimT* const values, const size_t count)
+{
+    char* end = const_cast<char*>(value);
+    for(size_t i = 0; i < count; i++)
+    {
+        values[i] = std::strtod(end, &end);
+        if(i + 1 < count && *end++ != ',')
+            return false;
+    }
+
+    return *end == '\0';
+}
+
+bool parseMufflerOptions(int argc, char* argv[], MufflerOptions& options)
+{
+    MufflerGeometry& geometry = options.geometry;
+    for(int i = 0; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(arg == "--scaling")
+        {
+            options.scaling = true;
+            continue;
+        }
+
+        if(i + 1 >= argc)
+        {
+            std::cerr << "missing value for " << arg << std::endl;
+            return false;
+        }
+
+        const char* value = argv[++i];
+        SimT values[3];
+        if(arg == "--box")
+        {
+            if(!parseValues(value, values, 3))
+                return false;
+            geometry.length = values[0] / 100.0;
+            geometry.width = values[1] / 100.0;
+            geometry.height = values[2] / 100.0;
+        }
+        else if(arg == "--inlet-radius")
+            geometry.inletRadius = std::atof(value) / 1000.0;
+        else if(arg == "--outlet-radius")
+            geometry.outletRadius = std::atof(value) / 1000.0;
+        else if(arg == "--inlet-offset" || arg == "--outlet-offset")
+        {
+            if(!parseValues(value, values, 2))
+                return false;
+            (arg == "--inlet-offset" ? geometry.inletOffsetY : geometry.outletOffsetY) =
+                values[0] / 100.0;
+            (arg == "--inlet-offset" ? geometry.inletOffsetZ : geometry.outletOffsetZ) =
+                values[1] / 100.0;
+        }
+        else if(arg == "--voxels")
+        {
+            if(!geometry.loadVoxels(value))
+                return false;
+        }
+        else if(arg == "--wall-admittance")
+            geometry.wallAdmittance = std::atof(value);
+        else if(arg == "--cell-size")
+            options.maxCellSize = std::atof(value) / 1000.0;
+        else if(arg == "--duration")
+            options.duration = std::atof(value);
+        else if(arg == "--sample-rate")
+            options.samplingRate = static_cast<uint32_t>(std::atoi(value));
+        else if(arg == "--threads")
+            options.threadCount = static_cast<size_t>(std::atoi(value));
+        else if(arg == "--output")
+            options.outputPath = value;
+        else if(arg == "--max-length")
+            options.maxResponseLength = std::atof(value);
+        else if(arg == "--scaling-steps")
+            options.scalingStepCount = static_cast<size_t>(std::atoi(value));
+        else
+        {
+            std::cerr << "unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if(geometry.length <= 0.0 || geometry.width <= 0.0 || geometry.height <= 0.0 ||
+        options.maxCellSize <= 0.0 || options.duration <= 0.0 || options.samplingRate == 0 ||
+        options.threadCount == 0 || geometry.wallAdmittance < 0.0 || options.maxResponseLength <= 0.0)
+    {
+        std::cerr << "invalid option value" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// lowpass filters and decimates the response of the grid to the output rate;
+// the windowed sinc is centered so that the response isn't delayed
+std::vector<SimT> decimate(const std::vector<SimT>& response, const size_t factor)
+{
+    constexpr size_t halfLength = 32;
+    const ptrdiff_t halfTapCount = static_cast<ptrdiff_t>(halfLength * factor);
+    const SimT cutoff = 0.45 / static_cast<SimT>(factor);
+
+    std::vector<SimT> taps(2 * halfTapCount + 1);
+    SimT tapSum = 0.0;
+    for(ptrdiff_t i = -halfTapCount; i <= halfTapCount; i++)
+    {
+        const SimT sinc = i == 0 ? 2.0 * cutoff :
+            std::sin(2.0 * std::numbers::pi * cutoff * i) / (std::numbers::pi * i);
+        // blackman
+        const SimT phase = std::numbers::pi * (i + halfTapCount) / halfTapCount;
+        const SimT window = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+        taps[i + halfTapCount] = sinc * window;
+        tapSum += taps[i + halfTapCount];
+    }
+
+    // unit gain at dc, and the response of a unit impulse of the grid is spread over factor
+    // samples of the output rate
+    const SimT gain = static_cast<SimT>(factor) / tapSum;
+    std::vector<SimT> decimated(response.size() / factor);
+    for(size_t m = 0; m < decimated.size(); m++)
+    {
+        SimT sum = 0.0;
+        for(ptrdiff_t i = -halfTapCount; i <= halfTapCount; i++)
+        {
+            const ptrdiff_t index = static_cast<ptrdiff_t>(m * factor) - i;
+            if(index >= 0 && index < static_cast<ptrdiff_t>(response.size()))
+                sum += taps[i + halfTapCount] * response[index];
+        }
+        decimated[m] = gain * sum;
+    }
+
+    return decimated;
+}
+
+// cuts the tail below -60 db of the total energy or at the max length and fades out the end
+void trimTail(std::vector<SimT>& response, const size_t maxLength)
+{
+    SimT energy = 0.0;
+    for(const SimT sample : response)
+        energy += sample * sample;
+
+    SimT tailEnergy = 0.0;
+    size_t length = response.size();
+    while(length > 1 && tailEnergy + response[length - 1] * response[length - 1] < 1e-6 * energy)
+    {
+        tailEnergy += response[length - 1] * response[length - 1];
+        length--;
+    }
+    length = std::min(length, maxLength);
+    response.resize(length);
+
+    const size_t fadeLength = std::min<size_t>(64, length / 4);
+    for(size_t i = 0; i < fadeLength; i++)
+    {
+        response[length - 1 - i] *=
+            0.5 - 0.5 * std::cos(std::numbers::pi * static_cast<SimT>(i) / fadeLength);
+    }
+}
+
+}
+
+int runMufflerTool(int argc, char* argv[])
+{
+    MufflerOptions options;
+    if(argc >= 1 && (std::strcmp(argv[0], "--help") == 0 || std::strcmp(argv[0], "-h") == 0))
+    {
+        printMufflerUsage();
+        return 0;
+    }
+    if(!parseMufflerOptions(argc, argv, options))
+    {
+        printMufflerUsage();
+        return 1;
+    }
+
+    // the grid runs at an integer multiple of the output rate so that the response can be
+    // decimated without resampling
+    const size_t rateFactor = static_cast<size_t>(std::ceil(waveSpeed /
+        (MufflerSolver::courantNumber * options.samplingRate * options.maxCellSize)));
+    const SimT cellSize =
+        waveSpeed / (MufflerSolver::courantNumber * options.samplingRate * rateFactor);
+    const size_t stepCount = static_cast<size_t>(
+        std::ceil(options.duration * options.samplingRate)) * rateFactor;
+
+    const auto printGrid = [&](const MufflerSolver& solver)
+    {
+        std::cout << "grid: " << solver.getCountX() << " x " << solver.getCountY() << " x " <<
+            solver.getCountZ() << " cells of " << cellSize * 1000.0 << " mm, " <<
+            solver.getCellCount() / 1e6 << " million with the halo, " <<
+            solver.getBoundaryCellCount() << " boundary cells, " <<
+            2.0 * solver.getCellCount() * sizeof(float) / (1024.0 * 1024.0) << " mb" << std::endl;
+        std::cout << "time step: " << solver.getTimeStep() * 1e6 << " us, " << rateFactor <<
+            " x " << options.samplingRate << " hz" << std::endl;
+    };
+
+    if(options.scaling)
+    {
+        std::vector<size_t> threadCounts;
+        for(size_t threadCount = 1; threadCount < options.threadCount; threadCount *= 2)
+            threadCounts.push_back(threadCount);
+        threadCounts.push_back(options.threadCount);
+
+        SimT baseTime = 0.0;
+        for(const size_t threadCount : threadCounts)
+        {
+            MufflerSolver solver{options.geometry, cellSize, threadCount};
+            if(baseTime == 0.0)
+            {
+                printGrid(solver);
+                std::cout << std::setw(8) << "threads" << std::setw(12) << "seconds" <<
+                    std::setw(16) << "mcells/s" << std::setw(10) << "speedup" <<
+                    std::setw(13) << "efficiency" << std::endl;
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            solver.run(options.scalingStepCount);
+            const SimT elapsed =
+                std::chrono::duration<SimT>(std::chrono::steady_clock::now() - start).count();
+            if(baseTime == 0.0)
+                baseTime = elapsed * threadCount;
+
+            std::cout << std::setw(8) << threadCount << std::fixed << std::setprecision(3) <<
+                std::setw(12) << elapsed << std::setprecision(1) <<
+                std::setw(16) << solver.getCellCount() * options.scalingStepCount / elapsed / 1e6 <<
+                std::setprecision(2) << std::setw(10) << baseTime / elapsed <<
+                std::setw(13) << baseTime / elapsed / threadCount << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+
+        return 0;
+    }
+
+    MufflerSolver solver{options.geometry, cellSize, options.threadCount};
+    printGrid(solver);
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<SimT> response = solver.run(stepCount);
+    const SimT elapsed =
+        std::chrono::duration<SimT>(std::chrono::steady_clock::now() - start).count();
+    std::cout << stepCount << " steps in " << elapsed << " s with " << options.threadCount <<
+        " threads, " << solver.getCellCount() * stepCount / elapsed / 1e6 << " mcells/s" << std::endl;
+
+    std::vector<SimT> impulseResponse = decimate(response, rateFactor);
+    trimTail(impulseResponse, static_cast<size_t>(options.maxResponseLength * options.samplingRate));
+    if(!saveImpulseResponse(options.outputPath, options.samplingRate, impulseResponse))
+        return 1;
+
+    std::cout << "wrote " << impulseResponse.size() << " samples to " << options.outputPath <<
+        std::endl;
+
+    return 0;
+}
\ No newline at end of file
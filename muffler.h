@@ -0,0 +1,96 @@
+#pragma once
+#include "wave.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+// muffler chamber between an inlet and an outlet port;
+// x runs from the inlet face to the outlet face of the box, SI units
+struct MufflerGeometry
+{
+    SimT length = 0.3, width = 0.12, height = 0.12;
+    SimT inletRadius = 0.01, outletRadius = 0.01;
+    // port centers in relation to the centers of the end faces
+    SimT inletOffsetY = 0.0, inletOffsetZ = 0.0;
+    SimT outletOffsetY = 0.0, outletOffsetZ = 0.0;
+    // normalized admittance of the walls, 0 is rigid and 1 absorbs a normal plane wave
+    SimT wallAdmittance = 0.0;
+
+    // optional solid voxels inside the box for baffles and extended tubes;
+    // stretched over the box, x fastest, nonzero is solid
+    std::vector<uint8_t> voxels;
+    size_t voxelCountX = 0, voxelCountY = 0, voxelCountZ = 0;
+
+    // text file of "nx ny nz" followed by nx * ny * nz characters, '#' is solid and '.' is air;
+    // whitespace is skipped
+    bool loadVoxels(const std::string& path);
+    bool isSolid(const SimT x, const SimT y, const SimT z) const;
+};
+
+// offline 3d fdtd solver of the chamber;
+// the standard leapfrog scheme runs at its stability limit c dt / dx = 1 / sqrt(3), where the
+// update of a cell that has only air around it reduces to p+ = (sum of the 6 neighbors) / 3 - p-;
+// cells next to walls and ports are kept in a list and corrected after the bulk update;
+// the ports are matched to plane waves, so the result is the transfer from an anechoic
+// inlet to an anechoic outlet
+class MufflerSolver
+{
+public:
+    static constexpr SimT courantNumber = 0.57735026918962576;
+public:
+    // the cells are split to z slabs, one per thread
+    MufflerSolver(const MufflerGeometry& geometry, const SimT cellSize, const size_t threadCount);
+
+    size_t getCellCount() const { return this->countX * this->countY * this->countZ; }
+    size_t getCountX() const { return this->countX - 2; }
+    size_t getCountY() const { return this->countY - 2; }
+    size_t getCountZ() const { return this->countZ - 2; }
+    size_t getBoundaryCellCount() const;
+    SimT getTimeStep() const { return this->timeStep; }
+
+    // runs step count steps from silence with a unit impulse at the inlet;
+    // returns the mean outlet pressure of every step
+    std::vector<SimT> run(const size_t stepCount);
+private:
+    struct BoundaryCell
+    {
+        size_t index;
+        // bit per air neighbor in the order -x, +x, -y, +y, -z, +z
+        uint8_t neighbors;
+        // lambda / 2 times the admittances of the open faces
+        float damping;
+        // lambda times the inlet faces
+        float sourceGain;
+    };
+    struct Slab
+    {
+        size_t firstZ, lastZ;
+        std::vector<BoundaryCell> boundaryCells;
+        // previous pressures of the boundary cells before the bulk update
+        std::vector<float> savedPressures;
+    };
+
+    const size_t threadCount;
+    const SimT cellSize;
+    SimT timeStep;
+    // including the solid halo around the box
+    size_t countX, countY, countZ;
+
+    std::unique_ptr<float[]> pressures, previousPressures;
+    std::vector<Slab> slabs;
+    // index and open face count of the outlet cells
+    std::vector<std::pair<size_t, uint32_t>> outletCells;
+    uint32_t outletFaceCount = 0;
+
+    size_t getIndex(const size_t x, const size_t y, const size_t z) const
+    { return x + this->countX * (y + this->countY * z); }
+
+    void runSlab(Slab& slab, const float* current, float* next,
+        const SimT sourceDifference) const;
+};
+
+// offline tool that computes the impulse response of a muffler chamber at the output sampling
+// rate and writes it to a wav file for ConvolutionFilter;
+// returns the process exit code
+int runMufflerTool(int argc, char* argv[]);
\ No newline at end of file
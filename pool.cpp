@@ -0,0 +1,110 @@
+#include "pool.h"
+#include "trace.h"
+#include <cassert>
+
+namespace
+{
+
+thread_local bool inJob = false;
+
+}
+
+WorkStealingPool::WorkStealingPool(const size_t workerCount, const ThreadInit& threadInit) :
+    queues(workerCount)
+{
+    assert(workerCount > 0);
+
+    for(size_t worker = 1; worker < workerCount; worker++)
+        this->threads.emplace_back(&WorkStealingPool::threadEntryPoint, this, worker, threadInit);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    this->stopping.store(true, std::memory_order_relaxed);
+    this->generation.fetch_add(1, std::memory_order_release);
+    this->generation.notify_all();
+
+    for(auto& thread : this->threads)
+        thread.join();
+}
+
+void WorkStealingPool::run(const size_t jobCount, const Job& job)
+{
+    TRACE_SCOPE("WorkStealingPool::run");
+
+    // contiguous ranges keep the jobs of a worker next to each other in memory
+    const size_t workerCount = this->queues.size();
+    for(size_t worker = 0; worker < workerCount; worker++)
+    {
+        Queue& queue = this->queues[worker];
+        queue.next.store(jobCount * worker / workerCount, std::memory_order_relaxed);
+        queue.end = jobCount * (worker + 1) / workerCount;
+    }
+    this->job = &job;
+
+    if(workerCount > 1)
+    {
+        this->busyWorkerCount.store(workerCount - 1, std::memory_order_relaxed);
+        this->generation.fetch_add(1, std::memory_order_release);
+        this->generation.notify_all();
+    }
+
+    this->work(0);
+
+    // the threads may still be running the last jobs of their ranges
+    for(size_t busy = this->busyWorkerCount.load(std::memory_order_acquire); busy != 0;
+        busy = this->busyWorkerCount.load(std::memory_order_acquire))
+    {
+        this->busyWorkerCount.wait(busy, std::memory_order_acquire);
+    }
+}
+
+void WorkStealingPool::work(const size_t worker)
+{
+    const size_t workerCount = this->queues.size();
+
+    // own range first, then the others starting from the next worker
+    for(size_t i = 0; i < workerCount; i++)
+    {
+        const size_t victim = (worker + i) % workerCount;
+        Queue& queue = this->queues[victim];
+        for(size_t index = queue.next.fetch_add(1, std::memory_order_relaxed); index < queue.end;
+            index = queue.next.fetch_add(1, std::memory_order_relaxed))
+        {
+            if(victim != worker)
+                this->stealCount.fetch_add(1, std::memory_order_relaxed);
+
+            // the flag of a nested dispatch is restored by it to the one of the outer job
+            const bool outerInJob = inJob;
+            inJob = true;
+            (*this->job)(index, worker);
+            inJob = outerInJob;
+        }
+    }
+}
+
+bool WorkStealingPool::isInJob()
+{
+    return inJob;
+}
+
+void WorkStealingPool::threadEntryPoint(const size_t worker, const ThreadInit threadInit)
+{
+    TRACE_THREAD();
+    if(threadInit)
+        threadInit(worker);
+
+    uint64_t seenGeneration = 0;
+    for(;;)
+    {
+        this->generation.wait(seenGeneration, std::memory_order_acquire);
+        seenGeneration = this->generation.load(std::memory_order_acquire);
+        if(this->stopping.load(std::memory_order_relaxed))
+            break;
+
+        this->work(worker);
+
+        if(this->busyWorkerCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            this->busyWorkerCount.notify_one();
+    }
+}
\ No newline at end of file
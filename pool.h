@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// fixed set of worker threads that run a batch of indexed jobs per dispatch;
+// the jobs are split to one range per worker, a worker takes jobs from the front of its own
+// range and steals from the ranges of the others when it runs out;
+// the calling thread is worker 0, so a pool of one worker has no threads;
+// dispatching doesn't allocate or lock, the idle workers sleep on an atomic wait
+class WorkStealingPool
+{
+public:
+    // job index and index of the worker that runs it
+    using Job = std::function<void(size_t job, size_t worker)>;
+    // called at the start of every worker thread with its index, e.g. for the realtime setup
+    using ThreadInit = std::function<void(size_t worker)>;
+public:
+    explicit WorkStealingPool(const size_t workerCount, const ThreadInit& threadInit = {});
+    ~WorkStealingPool();
+
+    size_t getWorkerCount() const { return this->queues.size(); }
+    // runs the job for every index in [0, jobCount) and returns when all of them are done;
+    // the jobs are handed out in increasing index order within a range
+    void run(const size_t jobCount, const Job& job);
+
+    // jobs that were run by some other worker than the owner of the range
+    uint64_t getStealCount() const { return this->stealCount.load(std::memory_order_relaxed); }
+    // whether the calling thread is running a job of some pool, where a nested dispatch would add
+    // threads to the ones that are already busy or wait on the workers of the outer jobs
+    static bool isInJob();
+private:
+    // padded so that the workers don't share cache lines
+    struct alignas(64) Queue
+    {
+        std::atomic<size_t> next = 0;
+        size_t end = 0;
+    };
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> threads;
+
+    const Job* job = nullptr;
+    std::atomic<uint64_t> generation = 0;
+    std::atomic<size_t> busyWorkerCount = 0;
+    std::atomic<bool> stopping = false;
+    std::atomic<uint64_t> stealCount = 0;
+
+    void work(const size_t worker);
+    void threadEntryPoint(const size_t worker, const ThreadInit threadInit);
+};
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "quality.h"
+#include <cassert>
+
+void QualityChange::print(std::ostream& stream) const
+{
+    stream << this->time << " s: " << Simulation::detailTiers[this->fromTier].name << " -> " <<
+        Simulation::detailTiers[this->toTier].name << ", " << this->reason <<
+        ", load " << this->smoothedLoad << ", block " << this->blockLoad;
+    if(this->predictedLoad > 0.0)
+        stream << ", predicted " << this->predictedLoad;
+    stream << std::endl;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+QualityController::QualityController(const QualityConfig& config) :
+    config(config),
+    changes(changeCapacity)
+{
+    assert(config.budget > 0.0 && config.smoothing > 0.0 && config.smoothing <= 1.0);
+}
+
+size_t QualityController::update(const uint64_t renderTimeNs, const uint64_t deadlineNs,
+    const SimT* tierCosts)
+{
+    assert(deadlineNs > 0);
+
+    const SimT blockLoad = static_cast<SimT>(renderTimeNs) / static_cast<SimT>(deadlineNs);
+    this->smoothedLoad = this->measured ?
+        this->smoothedLoad + this->config.smoothing * (blockLoad - this->smoothedLoad) : blockLoad;
+    this->measured = true;
+    this->time += static_cast<SimT>(deadlineNs) * 1e-9;
+
+    // the transition of the last change is still being rendered
+    const SimT sinceChange = this->time - this->changeTime;
+    if(sinceChange < this->config.settleDuration)
+        return this->tier;
+
+    if(this->tier + 1 < Simulation::detailTierCount)
+    {
+        if(blockLoad > this->config.spikeLoad)
+        {
+            this->change(this->tier + 1, blockLoad, 0.0, "spike");
+            return this->tier;
+        }
+        if(this->smoothedLoad > this->config.budget)
+        {
+            this->change(this->tier + 1, blockLoad, 0.0, "over budget");
+            return this->tier;
+        }
+    }
+
+    if(this->tier > 0 && sinceChange >= this->config.upgradeHoldDuration)
+    {
+        // without the costs the higher tier is assumed to be twice as expensive
+        const SimT costRatio = tierCosts && tierCosts[this->tier] > 0.0 && tierCosts[this->tier - 1] > 0.0 ?
+            tierCosts[this->tier - 1] / tierCosts[this->tier] : 2.0;
+        const SimT predictedLoad = this->smoothedLoad * costRatio;
+        if(predictedLoad < this->config.budget * this->config.upgradeMargin)
+            this->change(this->tier - 1, blockLoad, predictedLoad, "headroom");
+    }
+
+    return this->tier;
+}
+
+void QualityController::change(const size_t newTier, const SimT blockLoad,
+    const SimT predictedLoad, const char* reason)
+{
+    const QualityChange entry {this->time, this->tier, newTier, blockLoad, this->smoothedLoad,
+        predictedLoad, reason};
+    this->tier = newTier;
+    this->changeTime = this->time;
+
+    const size_t head = this->head.load(std::memory_order_relaxed);
+    const size_t next = (head + 1) % this->changes.size();
+    if(next == this->tail.load(std::memory_order_acquire))
+    {
+        this->droppedChangeCount.store(
+            this->droppedChangeCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    this->changes[head] = entry;
+    this->head.store(next, std::memory_order_release);
+}
+
+void QualityController::drainChanges(std::vector<QualityChange>& changes)
+{
+    const size_t head = this->head.load(std::memory_order_acquire);
+    size_t tail = this->tail.load(std::memory_order_relaxed);
+    for(; tail != head; tail = (tail + 1) % this->changes.size())
+        changes.push_back(this->changes[tail]);
+
+    this->tail.store(tail, std::memory_order_release);
+}
\ No newline at end of file
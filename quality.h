@@ -0,0 +1,70 @@
+#pragma once
+#include "simulation.h"
+#include <atomic>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+struct QualityConfig
+{
+    // fraction of the block duration that the rendering may use on average
+    SimT budget = 0.7;
+    // a single block over this is taken as a sign of an underrun to come
+    SimT spikeLoad = 0.9;
+    // a higher tier is taken when its predicted load is under this fraction of the budget
+    SimT upgradeMargin = 0.75;
+    // weight of a new block in the smoothed load
+    SimT smoothing = 0.1;
+    // seconds to wait after a change before the next one, covers the transition of the tiers
+    // during which both of them are rendered
+    SimT settleDuration = 0.5;
+    // seconds at a tier before a higher one is tried
+    SimT upgradeHoldDuration = 2.0;
+};
+
+// quality change and the measurement that triggered it
+struct QualityChange
+{
+    // seconds of rendered audio
+    SimT time;
+    size_t fromTier, toTier;
+    // render time in relation to the block duration
+    SimT blockLoad, smoothedLoad, predictedLoad;
+    const char* reason;
+
+    void print(std::ostream& stream) const;
+};
+
+// picks the detail tier from the measured render times of the blocks;
+// lowers the tier when the smoothed load goes over the budget or a single block comes close to
+// the deadline, and raises it again when the measured cost of the higher tier fits in the budget
+// with a margin;
+// updated from the render thread, the changes are logged to a ring that any one thread can drain
+class QualityController
+{
+public:
+    static constexpr size_t changeCapacity = 256;
+public:
+    explicit QualityController(const QualityConfig& config = {});
+
+    // returns the tier for the next block;
+    // tier costs are the measured costs of Simulation::getDetailCost or nullptr, 0 is unknown
+    size_t update(const uint64_t renderTimeNs, const uint64_t deadlineNs, const SimT* tierCosts);
+    size_t getTier() const { return this->tier; }
+    SimT getSmoothedLoad() const { return this->smoothedLoad; }
+
+    void drainChanges(std::vector<QualityChange>& changes);
+    uint64_t getDroppedChangeCount() const { return this->droppedChangeCount.load(std::memory_order_relaxed); }
+private:
+    const QualityConfig config;
+    size_t tier = 0;
+    SimT smoothedLoad = 0.0;
+    SimT time = 0.0, changeTime = 0.0;
+    bool measured = false;
+
+    std::vector<QualityChange> changes;
+    std::atomic<size_t> head = 0, tail = 0;
+    std::atomic<uint64_t> droppedChangeCount = 0;
+
+    void change(const size_t newTier, const SimT blockLoad, const SimT predictedLoad, const char* reason);
+};
\ No newline at end of file
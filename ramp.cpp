@@ -0,0 +1,129 @@
+#include "ramp.h"
+#include "snapshot.h"
+#include <cmath>
+#include <algorithm>
+
+void ParameterRamp::setValue(const SimT value)
+{
+    this->value = this->target = value;
+    this->remainingDuration = 0.0;
+}
+
+void ParameterRamp::rampTo(const SimT target, const SimT duration, const Shape shape)
+{
+    if(duration <= 0.0)
+    {
+        this->setValue(target);
+        return;
+    }
+
+    this->target = target;
+    this->remainingDuration = duration;
+    this->shape = shape;
+}
+
+void ParameterRamp::render(SimT* values, const size_t sampleCount, const SimT sampleDuration)
+{
+    const size_t remainingSampleCount = this->getRampSampleCount(sampleDuration);
+    const size_t rampSampleCount = std::min(sampleCount, remainingSampleCount);
+
+    if(rampSampleCount)
+    {
+        const SimT value = this->value;
+        if(this->isExponential())
+        {
+            // the lanes are geometric series of every laneCount'th value, which keeps the multiplies
+            // of the lanes independent
+            const SimT ratio = std::pow(this->target / value, 1.0 / static_cast<SimT>(remainingSampleCount));
+            const SimT stride = std::pow(ratio, static_cast<SimT>(laneCount));
+            SimT lanes[laneCount];
+            lanes[0] = value * ratio;
+            for(size_t lane = 1; lane < laneCount; lane++)
+                lanes[lane] = lanes[lane - 1] * ratio;
+
+            size_t i = 0;
+            for(; i + laneCount <= rampSampleCount; i += laneCount)
+            {
+                for(size_t lane = 0; lane < laneCount; lane++)
+                {
+                    values[i + lane] = lanes[lane];
+                    lanes[lane] *= stride;
+                }
+            }
+            for(size_t lane = 0; i < rampSampleCount; i++, lane++)
+                values[i] = lanes[lane];
+        }
+        else
+        {
+            const SimT increment = (this->target - value) / static_cast<SimT>(remainingSampleCount);
+            for(size_t i = 0; i < rampSampleCount; i++)
+                values[i] = value + increment * static_cast<SimT>(i + 1);
+        }
+
+        if(rampSampleCount == remainingSampleCount)
+            values[rampSampleCount - 1] = this->target;
+        this->finishBlock(rampSampleCount, remainingSampleCount, values[rampSampleCount - 1], sampleDuration);
+    }
+
+    std::fill(values + rampSampleCount, values + sampleCount, this->value);
+}
+
+void ParameterRamp::advance(const size_t sampleCount, const SimT sampleDuration)
+{
+    const size_t remainingSampleCount = this->getRampSampleCount(sampleDuration);
+    const size_t rampSampleCount = std::min(sampleCount, remainingSampleCount);
+    if(!rampSampleCount)
+        return;
+
+    const SimT position = static_cast<SimT>(rampSampleCount) / static_cast<SimT>(remainingSampleCount);
+    const SimT value = this->isExponential() ?
+        this->value * std::pow(this->target / this->value, position) :
+        this->value + position * (this->target - this->value);
+    this->finishBlock(rampSampleCount, remainingSampleCount, value, sampleDuration);
+}
+
+void ParameterRamp::saveState(SnapshotWriter& writer) const
+{
+    writer.write(this->value);
+    writer.write(this->target);
+    writer.write(this->remainingDuration);
+    writer.write(this->shape);
+}
+
+bool ParameterRamp::loadState(SnapshotReader& reader)
+{
+    reader.read(this->value);
+    reader.read(this->target);
+    reader.read(this->remainingDuration);
+    reader.read(this->shape);
+    if(this->remainingDuration < 0.0 || (this->shape != Shape::Linear && this->shape != Shape::Exponential))
+        return reader.fail();
+
+    return reader.isValid();
+}
+
+size_t ParameterRamp::getRampSampleCount(const SimT sampleDuration) const
+{
+    if(!this->isRamping())
+        return 0;
+
+    return std::max<size_t>(1, static_cast<size_t>(std::llround(this->remainingDuration / sampleDuration)));
+}
+
+bool ParameterRamp::isExponential() const
+{
+    return this->shape == Shape::Exponential && this->value > 0.0 && this->target > 0.0;
+}
+
+void ParameterRamp::finishBlock(const size_t rampSampleCount, const size_t remainingSampleCount,
+    const SimT value, const SimT sampleDuration)
+{
+    if(rampSampleCount == remainingSampleCount)
+        this->setValue(this->target);
+    else
+    {
+        this->value = value;
+        this->remainingDuration = std::max(0.0,
+            this->remainingDuration - static_cast<SimT>(rampSampleCount) * sampleDuration);
+    }
+}
\ No newline at end of file
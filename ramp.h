@@ -0,0 +1,50 @@
+#pragma once
+#include "wave.h"
+#include <cstdint>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// control that moves to a target over a duration, rendered to a value per sample;
+// a block is split to the part that ramps and the constant part after it, so that neither of
+// the loops branches on whether the ramp is in progress
+class ParameterRamp
+{
+public:
+    // exponential ramps change by a constant ratio per second, which sounds even for the rpm;
+    // they fall back to linear when either end isn't positive
+    enum class Shape : uint32_t { Linear, Exponential };
+    // the exponential ramp is rendered in this many interleaved geometric series
+    static constexpr size_t laneCount = 8;
+public:
+    explicit ParameterRamp(const SimT value = 0.0) : value(value), target(value) {}
+
+    // jumps to the value and ends the ramp
+    void setValue(const SimT value);
+    // ramps from the current value, a duration of 0 jumps
+    void rampTo(const SimT target, const SimT duration, const Shape shape = Shape::Linear);
+    SimT getValue() const { return this->value; }
+    SimT getTarget() const { return this->target; }
+    SimT getRemainingDuration() const { return this->remainingDuration; }
+    bool isRamping() const { return this->remainingDuration > 0.0; }
+
+    // values of the next sample count samples, the first one is a sample after the current value;
+    // the ramp advances past them and ends exactly at the target
+    void render(SimT* values, const size_t sampleCount, const SimT sampleDuration);
+    // advances the ramp as if the samples were rendered
+    void advance(const size_t sampleCount, const SimT sampleDuration);
+
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
+private:
+    SimT value, target;
+    SimT remainingDuration = 0.0;
+    Shape shape = Shape::Linear;
+
+    // samples to the end of the ramp, at least 1 while ramping
+    size_t getRampSampleCount(const SimT sampleDuration) const;
+    bool isExponential() const;
+    // moves the state by the rendered samples of the ramp, value being the last of them
+    void finishBlock(const size_t rampSampleCount, const size_t remainingSampleCount,
+        const SimT value, const SimT sampleDuration);
+};
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "realtime.h"
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <alloca.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+
+#ifdef __linux__
+
+std::string describeLimit(const int resource, const char* name)
+{
+    rlimit limit;
+    if(getrlimit(resource, &limit) != 0)
+        return {};
+
+    const std::string value = limit.rlim_cur == RLIM_INFINITY ?
+        "unlimited" : std::to_string(limit.rlim_cur);
+    return std::string(" (") + name + " " + value + ")";
+}
+
+// keeps freed memory in the heap arena so that the prefaulted pages stay mapped
+void prefaultHeap(const size_t size)
+{
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    std::unique_ptr<char[]> heap(new char[size]);
+    prefaultMemory(heap.get(), size);
+}
+
+// never inlined so that the stack frame is actually allocated
+__attribute__((noinline)) void prefaultStack(const size_t size)
+{
+    volatile char* stack = static_cast<volatile char*>(alloca(size));
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    for(size_t i = 0; i < size; i += pageSize)
+        stack[i] = 0;
+}
+
+#endif
+
+}
+
+void RealtimeReport::print(std::ostream& stream) const
+{
+    stream << "realtime: scheduling " << (this->scheduling ? "on" : "off") <<
+        ", memory locked " << (this->memoryLocked ? "yes" : "no") <<
+        ", pinned " << (this->pinned ? "yes" : "no") << std::endl;
+    for(const auto& warning : this->warnings)
+        stream << "realtime warning: " << warning << std::endl;
+}
+
+RealtimeReport applyRealtimeConfig(const RealtimeConfig& config, const bool configureThread)
+{
+    RealtimeReport report;
+    if(!config.enabled)
+        return report;
+
+#ifdef __linux__
+    if(config.lockMemory)
+    {
+        if(mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+        {
+            report.memoryLocked = true;
+            prefaultHeap(config.prefaultHeapSize);
+            prefaultStack(config.prefaultStackSize);
+        }
+        else
+        {
+            report.warnings.push_back(std::string("mlockall failed: ") + std::strerror(errno) +
+                describeLimit(RLIMIT_MEMLOCK, "memlock limit"));
+        }
+    }
+
+    if(!configureThread)
+    {
+        report.warnings.push_back(
+            "the backend renders in its own thread, only memory locking is applied");
+        return report;
+    }
+
+    const int policy = config.policy == RealtimeConfig::Policy::Fifo ? SCHED_FIFO : SCHED_RR;
+    sched_param param {};
+    param.sched_priority = std::clamp(config.priority,
+        sched_get_priority_min(policy), sched_get_priority_max(policy));
+    if(const int error = pthread_setschedparam(pthread_self(), policy, &param); error == 0)
+        report.scheduling = true;
+    else
+    {
+        report.warnings.push_back(std::string("realtime scheduling failed: ") +
+            std::strerror(error) + describeLimit(RLIMIT_RTPRIO, "rtprio limit") +
+            ", running with the default scheduling");
+    }
+
+    if(config.cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.cpu, &set);
+        if(const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            error == 0)
+            report.pinned = true;
+        else
+        {
+            report.warnings.push_back("pinning to cpu " + std::to_string(config.cpu) +
+                " failed: " + std::strerror(error));
+        }
+    }
+#else
+    report.warnings.push_back("realtime setup is only supported on linux");
+#endif
+
+    return report;
+}
+
+RealtimeConfig getWorkerRealtimeConfig(const RealtimeConfig& config, const size_t worker)
+{
+    RealtimeConfig workerConfig = config;
+    workerConfig.lockMemory = false;
+    if(config.cpu >= 0)
+    {
+        const int cpuCount = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+        workerConfig.cpu = (config.cpu + static_cast<int>(worker)) % cpuCount;
+    }
+    return workerConfig;
+}
+
+void prefaultMemory(void* data, const size_t size)
+{
+#ifdef __linux__
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    const size_t pageSize = 4096;
+#endif
+
+    // writing keeps copy on write pages from being shared
+    volatile char* bytes = static_cast<volatile char*>(data);
+    for(size_t i = 0; i < size; i += pageSize)
+        bytes[i] = bytes[i];
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+// opt-in realtime setup of the render thread;
+// only supported on linux, other platforms report it as unavailable
+struct RealtimeConfig
+{
+    enum class Policy { Fifo, RoundRobin };
+
+    bool enabled = false;
+    Policy policy = Policy::Fifo;
+    int priority = 80;
+    // locks current and future pages and prefaults the heap arena and the stack
+    bool lockMemory = true;
+    size_t prefaultHeapSize = 16 * 1024 * 1024;
+    size_t prefaultStackSize = 256 * 1024;
+    // core to pin the render thread to, -1 leaves the affinity alone
+    int cpu = -1;
+};
+
+// what was actually applied;
+// a failed step is reported as a warning and the thread continues without it
+struct RealtimeReport
+{
+    bool scheduling = false, memoryLocked = false, pinned = false;
+    std::vector<std::string> warnings;
+
+    void print(std::ostream& stream) const;
+};
+
+// applies the config to the calling thread and memory locking to the whole process;
+// the thread is left alone if configureThread is false
+RealtimeReport applyRealtimeConfig(const RealtimeConfig& config, const bool configureThread = true);
+
+// config of the worker threads that the render thread waits on, so that they don't invert its
+// priority: the scheduling of the render thread, the pinned core moved by the worker index so that
+// the workers don't share it, and no memory locking, which is done once for the process
+RealtimeConfig getWorkerRealtimeConfig(const RealtimeConfig& config, const size_t worker);
+
+// touches every page of the memory so that the realtime thread doesn't page fault on it
+void prefaultMemory(void* data, const size_t size);
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "renderer.h"
+#include "trace.h"
+#include <cmath>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+
+#undef max
+#undef min
+#else
+#include <time.h>
+#endif
+
+namespace
+{
+
+// cpu time consumed by all the threads of the process, in seconds
+SimT getProcessCpuTime()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+
+    const auto toSeconds = [](const FILETIME& time)
+    {
+        // filetime is in 100 nanosecond units
+        return static_cast<SimT>(
+            (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1e-7;
+    };
+    return toSeconds(kernelTime) + toSeconds(userTime);
+#else
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return static_cast<SimT>(time.tv_sec) + static_cast<SimT>(time.tv_nsec) * 1e-9;
+#endif
+}
+
+SimT toSeconds(const std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<SimT>(duration).count();
+}
+
+}
+
+void RenderMeasurement::print(std::ostream& stream) const
+{
+    stream << "periods: " << this->periodCount <<
+        ", period " << this->periodDuration * 1000.0 << " ms" << std::endl;
+    stream << "cpu usage: " << this->getCpuUsage() * 100.0 << " % (" <<
+        this->cpuTime << " s cpu in " << this->wallTime << " s)" << std::endl;
+    stream << "render time: mean " << this->meanRenderTime * 1000.0 <<
+        " ms, max " << this->maxRenderTime * 1000.0 << " ms" << std::endl;
+    stream << "wakeup jitter: mean " << this->meanJitter * 1000.0 <<
+        " ms, stddev " << this->jitterStdDev * 1000.0 <<
+        " ms, max " << this->maxJitter * 1000.0 << " ms" << std::endl;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+Renderer::Renderer(AudioBackend& backend) : backend(backend)
+{
+    this->watchdogJob = [this](const size_t sampleCount) -> const Wave::SampleContainer&
+    {
+        return this->renderSamples(sampleCount);
+    };
+}
+
+bool Renderer::open(const AudioFormat& requestedFormat)
+{
+    if(!this->backend.open(requestedFormat))
+        return false;
+
+    this->simulation = std::make_unique<Simulation>(
+        static_cast<SimT>(this->backend.getFormat().sampleRate * simSampleRateRatio));
+
+    return true;
+}
+
+void Renderer::run(const ParameterCallback& applyParameters)
+{
+    this->measurement = RenderMeasurement {};
+    this->measurement.periodDuration = this->backend.getPeriodDuration();
+    this->renderTimeSum = this->jitterSum = this->jitterSquareSum = 0.0;
+
+    this->applyParameters = &applyParameters;
+
+    // the tiers are switched between the periods, so their copies are created ahead
+    if(this->qualityController)
+    {
+        if(this->voices)
+        {
+            this->voices->prepareDetailTiers();
+            this->voices->setDetailCostMeasuring(true);
+        }
+        else
+        {
+            this->simulation->prepareDetailTiers();
+            this->simulation->setDetailCostMeasuring(true);
+        }
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+    const SimT startCpuTime = getProcessCpuTime();
+    this->lastWakeup = startTime;
+
+    this->backend.run([&](float* buffer, uint32_t frameCount)
+    {
+        return this->renderPeriod(buffer, frameCount);
+    });
+
+    // the simulation may still be rendering a late period
+    if(this->watchdog)
+        this->watchdog->finish();
+    this->applyParameters = nullptr;
+
+    if(this->measuring)
+    {
+        this->finishMeasurement(toSeconds(std::chrono::steady_clock::now() - startTime),
+            getProcessCpuTime() - startCpuTime);
+    }
+}
+
+void Renderer::close()
+{
+    this->backend.close();
+    this->simulation.reset();
+}
+
+bool Renderer::renderPeriod(float* buffer, const uint32_t frameCount)
+{
+    const bool timing = this->measuring || this->telemetry || this->qualityController;
+    std::chrono::steady_clock::time_point wakeup;
+    if(timing)
+        wakeup = std::chrono::steady_clock::now();
+
+    TRACE_SCOPE("Renderer::renderPeriod");
+
+    const size_t sampleCount = frameCount * simSampleRateRatio;
+    const Wave::SampleContainer& samples = this->watchdog ?
+        this->watchdog->render(this->watchdogJob, sampleCount) : this->renderSamples(sampleCount);
+    const bool silence =
+        populateAudioBuffer(samples, buffer, frameCount, this->backend.getFormat().channelCount);
+
+    this->renderedFrameCount.fetch_add(frameCount, std::memory_order_relaxed);
+
+    if(!timing)
+        return silence;
+
+    // a late period of the watchdog may still be rendering the simulation
+    const bool idle = !this->watchdog || !this->watchdog->isBusy();
+
+    const auto renderDuration = std::chrono::steady_clock::now() - wakeup;
+    const uint64_t deadlineNs = static_cast<uint64_t>(frameCount) * 1000000000ull /
+        this->backend.getFormat().sampleRate;
+    // the fallback of a missed period took little time but the period was as good as an underrun
+    const uint64_t renderTimeNs = this->watchdog && this->watchdog->isFallback() ?
+        std::max(deadlineNs, static_cast<uint64_t>(std::chrono::nanoseconds(renderDuration).count())) :
+        static_cast<uint64_t>(std::chrono::nanoseconds(renderDuration).count());
+
+    if(this->qualityController)
+        this->updateQuality(renderTimeNs, deadlineNs, idle);
+
+    if(this->telemetry)
+    {
+        if(idle)
+        {
+            this->pipeWaveCount = this->simulation->pipe.pipeWaves.size();
+            this->radiatedWaveCount = this->simulation->getRadiatedWaveCount();
+        }
+        this->telemetry->recordBlock(
+            renderTimeNs,
+            deadlineNs,
+            this->pipeWaveCount,
+            this->radiatedWaveCount);
+        this->telemetry->setUnderrunCount(this->backend.getUnderrunCount());
+    }
+
+    if(this->measuring)
+    {
+        const SimT renderTime = toSeconds(renderDuration);
+        this->renderTimeSum += renderTime;
+        this->measurement.maxRenderTime = std::max(this->measurement.maxRenderTime, renderTime);
+        this->measureWakeup(wakeup);
+    }
+
+    return silence;
+}
+
+const Wave::SampleContainer& Renderer::renderSamples(const size_t sampleCount)
+{
+    if(*this->applyParameters)
+    {
+        TRACE_SCOPE("Renderer::applyParameters");
+        (*this->applyParameters)(*this->simulation, this->simulatedSampleCount);
+    }
+    this->simulatedSampleCount += sampleCount;
+
+    return this->voices ?
+        this->voices->render(sampleCount) :
+        this->simulation->progressSimulation(static_cast<SimT>(sampleCount)).samples;
+}
+
+void Renderer::updateQuality(const uint64_t renderTimeNs, const uint64_t deadlineNs, const bool idle)
+{
+    if(!idle)
+    {
+        this->qualityController->update(renderTimeNs, deadlineNs, nullptr);
+        return;
+    }
+
+    SimT tierCosts[Simulation::detailTierCount];
+    for(size_t tier = 0; tier < Simulation::detailTierCount; tier++)
+    {
+        tierCosts[tier] = this->voices ?
+            this->voices->getDetailCost(tier) : this->simulation->getDetailCost(tier);
+    }
+
+    const size_t tier = this->qualityController->update(renderTimeNs, deadlineNs, tierCosts);
+    if(this->voices)
+        this->voices->setDetailTier(tier);
+    else
+        this->simulation->setDetailTier(tier);
+}
+
+void Renderer::measureWakeup(const std::chrono::steady_clock::time_point wakeup)
+{
+    // the first interval includes the device startup so it's not counted
+    if(this->measurement.periodCount++ == 0)
+    {
+        this->lastWakeup = wakeup;
+        return;
+    }
+
+    const SimT interval = toSeconds(wakeup - this->lastWakeup);
+    const SimT jitter = std::abs(interval - this->measurement.periodDuration);
+    this->lastWakeup = wakeup;
+
+    this->jitterSum += jitter;
+    this->jitterSquareSum += jitter * jitter;
+    this->measurement.maxJitter = std::max(this->measurement.maxJitter, jitter);
+}
+
+void Renderer::finishMeasurement(const SimT wallTime, const SimT cpuTime)
+{
+    RenderMeasurement& m = this->measurement;
+    m.wallTime = wallTime;
+    m.cpuTime = cpuTime;
+
+    if(m.periodCount == 0)
+        return;
+
+    m.meanRenderTime = this->renderTimeSum / static_cast<SimT>(m.periodCount);
+
+    if(m.periodCount < 2)
+        return;
+
+    const SimT intervalCount = static_cast<SimT>(m.periodCount - 1);
+    m.meanJitter = this->jitterSum / intervalCount;
+    m.jitterStdDev = std::sqrt(std::max(0.0,
+        this->jitterSquareSum / intervalCount - m.meanJitter * m.meanJitter));
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+#include "backends.h"
+#include "simulation.h"
+#include "telemetry.h"
+#include "voices.h"
+#include "quality.h"
+#include "watchdog.h"
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <ostream>
+
+// cpu usage and wakeup timing of the render thread;
+// jitter is the deviation of the interval between two callbacks from the period duration
+struct RenderMeasurement
+{
+    uint64_t periodCount = 0;
+    SimT periodDuration = 0.0;
+    SimT wallTime = 0.0, cpuTime = 0.0;
+    SimT meanRenderTime = 0.0, maxRenderTime = 0.0;
+    SimT meanJitter = 0.0, jitterStdDev = 0.0, maxJitter = 0.0;
+
+    // process cpu time in relation to the elapsed time
+    SimT getCpuUsage() const { return this->wallTime > 0.0 ? this->cpuTime / this->wallTime : 0.0; }
+    void print(std::ostream& stream) const;
+};
+
+// drives the simulation from the render callback of an audio backend;
+// the simulation is created when the backend has negotiated the sampling rate
+class Renderer
+{
+public:
+    // applies the pending parameter changes before each period;
+    // the position is the samples of the simulation rendered before the period, which falls behind
+    // the output by the fallback periods of the watchdog;
+    // called from the render thread
+    using ParameterCallback = std::function<void(Simulation&, uint64_t simulatedSampleCount)>;
+public:
+    explicit Renderer(AudioBackend& backend);
+
+    bool open(const AudioFormat& requestedFormat);
+    // renders until the backend is stopped
+    void run(const ParameterCallback& applyParameters);
+    void close();
+
+    AudioBackend& getBackend() { return this->backend; }
+    // valid between open and close
+    Simulation& getSimulation() { return *this->simulation; }
+    // frames of the output, including the fallback periods of the watchdog;
+    // can be read from any thread
+    uint64_t getRenderedFrameCount() const { return this->renderedFrameCount.load(std::memory_order_relaxed); }
+
+    // measuring adds two clock reads per period
+    void setMeasuring(const bool measuring) { this->measuring = measuring; }
+    // valid after run has returned
+    const RenderMeasurement& getMeasurement() const { return this->measurement; }
+
+    // records every period to the telemetry, nullptr disables it;
+    // set before run
+    void setTelemetry(BlockTelemetry* telemetry) { this->telemetry = telemetry; }
+    // renders the master bus of the voices instead of the simulation, nullptr switches back;
+    // the voices have to run at the sampling rate of the simulation;
+    // set before run
+    void setVoices(VoiceManager* voices) { this->voices = voices; }
+    // picks the detail tier of the simulation or the voices after every period from its
+    // render time, nullptr disables it;
+    // run prepares the tiers and turns on the measuring of their costs;
+    // set before run
+    void setQualityController(QualityController* controller) { this->qualityController = controller; }
+    // renders the periods on the thread of the watchdog and plays its fallback when they miss the
+    // deadline, nullptr renders them on the render thread;
+    // the parameters are applied on the thread of the watchdog too;
+    // set before run
+    void setWatchdog(DeadlineWatchdog* watchdog) { this->watchdog = watchdog; }
+private:
+    AudioBackend& backend;
+    std::unique_ptr<Simulation> simulation;
+    std::atomic<uint64_t> renderedFrameCount = 0;
+    // written by the thread that renders the simulation
+    uint64_t simulatedSampleCount = 0;
+    BlockTelemetry* telemetry = nullptr;
+    VoiceManager* voices = nullptr;
+    QualityController* qualityController = nullptr;
+    DeadlineWatchdog* watchdog = nullptr;
+
+    // state of the run in progress;
+    // the job is created once so that dispatching it doesn't allocate
+    const ParameterCallback* applyParameters = nullptr;
+    DeadlineWatchdog::Job watchdogJob;
+    // counts of the last period that the simulation was free to be read
+    size_t pipeWaveCount = 0, radiatedWaveCount = 0;
+
+    bool measuring = false;
+    RenderMeasurement measurement;
+    std::chrono::steady_clock::time_point lastWakeup;
+    // running sums for the mean and the deviation
+    SimT renderTimeSum = 0.0, jitterSum = 0.0, jitterSquareSum = 0.0;
+
+    bool renderPeriod(float* buffer, const uint32_t frameCount);
+    const Wave::SampleContainer& renderSamples(const size_t sampleCount);
+    // the tier is applied only when the simulation is idle
+    void updateQuality(const uint64_t renderTimeNs, const uint64_t deadlineNs, const bool idle);
+    void measureWakeup(const std::chrono::steady_clock::time_point wakeup);
+    void finishMeasurement(const SimT wallTime, const SimT cpuTime);
+};
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "sidebranch.h"
+#include "simulators.h"
+#include <cmath>
+#include <numbers>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+
+// the air in the mouth of a tube or in the ends of a neck moves with it
+SimT getTubeLength(const SideBranch& branch)
+{
+    return branch.length + endCorrectionFactor * branch.radius;
+}
+
+SimT getNeckLength(const SideBranch& branch)
+{
+    return branch.length + 2.0 * endCorrectionFactor * branch.radius;
+}
+
+}
+
+bool SideBranch::isValid() const
+{
+    return (this->type == Type::QuarterWave || this->type == Type::Helmholtz) &&
+        this->position >= 0.0 && this->position <= 1.0 && this->length > 0.0 && this->radius > 0.0 &&
+        this->quality > 0.0 && (this->type != Type::Helmholtz || this->volume > 0.0);
+}
+
+SimT SideBranch::getResonance(const Pipe& pipe) const
+{
+    const SimT speed = pipe.getWaveSpeed(this->position);
+    if(this->type == Type::QuarterWave)
+        return speed / (4.0 * getTubeLength(*this));
+
+    const SimT neckArea = std::numbers::pi * this->radius * this->radius;
+    return speed / (2.0 * std::numbers::pi) * std::sqrt(neckArea / (this->volume * getNeckLength(*this)));
+}
+
+void SideBranch::tune(const Pipe& pipe, const SimT frequency)
+{
+    assert(frequency > 0.0);
+
+    const SimT speed = pipe.getWaveSpeed(this->position);
+    if(this->type == Type::QuarterWave)
+    {
+        // a tube can't be shorter than its end correction, so high frequencies get a short stub
+        this->length = std::max<SimT>(1e-3, speed / (4.0 * frequency) - endCorrectionFactor * this->radius);
+        return;
+    }
+
+    const SimT neckArea = std::numbers::pi * this->radius * this->radius;
+    const SimT wavenumber = 2.0 * std::numbers::pi * frequency / speed;
+    this->volume = neckArea / (getNeckLength(*this) * wavenumber * wavenumber);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+void SideBranchElement::design(const SideBranch& branch, const Pipe& pipe, const SimT samplingRate,
+    const size_t order)
+{
+    assert(branch.isValid());
+
+    this->type = branch.type;
+    this->samplingRate = samplingRate;
+    const SimT speed = pipe.getWaveSpeed(branch.position);
+    const SimT density = pipe.getDensity(branch.position);
+
+    if(branch.type == SideBranch::Type::QuarterWave)
+    {
+        // the tube has the gas of the pipe, so its admittance is of the ratio of the areas;
+        // the amplitude of a resonance falls by exp(-pi f / Q) per second, which is
+        // exp(-pi / 2 Q) per round trip
+        const SimT radiusRatio = branch.radius / pipe.getPipeRadius();
+        this->admittance = radiusRatio * radiusRatio;
+        this->reflection = std::exp(-0.5 * std::numbers::pi / branch.quality);
+        const SimT delay = 2.0 * getTubeLength(branch) / speed * samplingRate;
+        this->roundTrip.design(order, std::max(1.0 + FractionalDelay::getMinDelay(order), delay));
+        return;
+    }
+
+    // the neck is a mass m = rho l / S and the cavity a compliance c = V / rho c^2 in series with
+    // the resistance sqrt(m / c) / Q, so y(s) = s c / (s^2 m c + s r c + 1) times the impedance of
+    // the pipe
+    const SimT neckArea = std::numbers::pi * branch.radius * branch.radius;
+    const SimT pipeArea = std::numbers::pi * pipe.getPipeRadius() * pipe.getPipeRadius();
+    const SimT mass = density * getNeckLength(branch) / neckArea;
+    const SimT compliance = branch.volume / (density * speed * speed);
+    const SimT resistance = std::sqrt(mass / compliance) / branch.quality;
+    const SimT impedance = density * speed / pipeArea;
+
+    // prewarped to the resonance while it's well under the nyquist frequency
+    const SimT resonance = 1.0 / std::sqrt(mass * compliance);
+    const SimT warp = resonance < 0.9 * std::numbers::pi * samplingRate ?
+        resonance / std::tan(0.5 * resonance / samplingRate) : 2.0 * samplingRate;
+    const SimT massTerm = mass * compliance * warp * warp, resistanceTerm = resistance * compliance * warp;
+    const SimT a0 = massTerm + resistanceTerm + 1.0;
+    this->admittance = compliance * warp * impedance / a0;
+    this->b2 = -this->admittance;
+    this->a1 = 2.0 * (1.0 - massTerm) / a0;
+    this->a2 = (massTerm - resistanceTerm + 1.0) / a0;
+}
+
+std::complex<SimT> SideBranchElement::getResponse(const SimT frequency) const
+{
+    if(this->type == SideBranch::Type::QuarterWave)
+    {
+        // the wave a that comes back is r D (p - a), and u = y (p - 2 a)
+        const std::complex<SimT> echo = this->reflection * this->roundTrip.getResponse(frequency, this->samplingRate);
+        return this->admittance * (1.0 - echo) / (1.0 + echo);
+    }
+
+    const std::complex<SimT> z = std::polar(1.0, -2.0 * std::numbers::pi * frequency / this->samplingRate);
+    return (this->admittance + this->b2 * z * z) / (1.0 + this->a1 * z + this->a2 * z * z);
+}
+
+SimT SideBranchElement::prepare(State& state) const
+{
+    if(this->type == SideBranch::Type::Helmholtz)
+        return state.s1;
+
+    // the read only goes to the samples before the current one
+    const size_t start = state.position - this->roundTrip.getWholeDelay() - this->roundTrip.getOrder();
+    state.arriving = this->reflection * this->roundTrip.interpolate(state.waves.data(), state.waves.size() - 1, start);
+
+    return -2.0 * this->admittance * state.arriving;
+}
+
+void SideBranchElement::process(State& state, const SimT pressure) const
+{
+    if(this->type == SideBranch::Type::Helmholtz)
+    {
+        const SimT flow = this->admittance * pressure + state.s1;
+        state.s1 = -this->a1 * flow + state.s2;
+        state.s2 = this->b2 * pressure - this->a2 * flow;
+        return;
+    }
+
+    state.waves[state.position & (state.waves.size() - 1)] = pressure - state.arriving;
+    state.position++;
+}
+
+void SideBranchElement::fitState(State& state) const
+{
+    if(this->type == SideBranch::Type::Helmholtz)
+        return;
+
+    size_t capacity = 1;
+    while(capacity < this->roundTrip.getWholeDelay() + this->roundTrip.getOrder() + 2)
+        capacity <<= 1;
+    if(capacity <= state.waves.size())
+        return;
+
+    std::vector<SimT> waves(capacity, 0.0);
+    const size_t oldMask = state.waves.size() - 1, mask = capacity - 1;
+    for(size_t i = 1; i <= state.waves.size(); i++)
+        waves[(state.position - i) & mask] = state.waves[(state.position - i) & oldMask];
+    state.waves = std::move(waves);
+}
+
+bool SideBranchElement::isFitting(const State& state) const
+{
+    if(this->type == SideBranch::Type::Helmholtz)
+        return true;
+
+    const size_t capacity = state.waves.size();
+    return this->roundTrip.getOrder() <= FractionalDelay::maxOrder && (capacity & (capacity - 1)) == 0 &&
+        this->roundTrip.getWholeDelay() + this->roundTrip.getOrder() + 1 <= capacity;
+}
+
+void SideBranchElement::setSteadyState(State& state, const std::complex<SimT> pressure, const SimT frequency) const
+{
+    const std::complex<SimT> delay = std::polar(1.0, -2.0 * std::numbers::pi * frequency / this->samplingRate);
+    if(this->type == SideBranch::Type::Helmholtz)
+    {
+        // s2[n] = b2 p[n] - a2 u[n], s1[n] = -a1 u[n] + s2[n-1]
+        const std::complex<SimT> flow = this->getResponse(frequency) * pressure;
+        const std::complex<SimT> s2 = this->b2 * pressure - this->a2 * flow;
+        state.s1 = std::imag(-this->a1 * flow + s2 * delay);
+        state.s2 = std::imag(s2);
+        return;
+    }
+
+    // the last sent sample is one before the position, the older ones go backwards from it
+    const std::complex<SimT> echo = this->reflection * this->roundTrip.getResponse(frequency, this->samplingRate);
+    std::complex<SimT> sent = pressure / (1.0 + echo);
+    const size_t mask = state.waves.size() - 1;
+    for(size_t i = 0; i < state.waves.size(); i++)
+    {
+        state.waves[(state.position - 1 - i) & mask] = std::imag(sent);
+        sent *= delay;
+    }
+}
\ No newline at end of file
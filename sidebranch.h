@@ -0,0 +1,93 @@
+#pragma once
+#include "wave.h"
+#include "fractionaldelay.h"
+#include <complex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class Pipe;
+
+// resonator on the side of a pipe, e.g. tuned to cancel a drone of the pipe;
+// SI units
+struct SideBranch
+{
+    enum class Type : uint32_t
+    {
+        // tube that is closed at the far end, resonates where it is a quarter of a wavelength
+        QuarterWave,
+        // cavity behind a neck, the air in the neck is a mass on the spring of the cavity
+        Helmholtz,
+    };
+
+    Type type = Type::QuarterWave;
+    // relative position in [0, 1] along the pipe from the closed end
+    SimT position = 0.5;
+    // of the tube, or of the neck of a helmholtz resonator
+    SimT length = 0.1, radius = 0.01;
+    // of the cavity of a helmholtz resonator
+    SimT volume = 0.0;
+    // of the resonance, the losses of the branch
+    SimT quality = 20.0;
+
+    bool operator==(const SideBranch& other) const = default;
+
+    bool isValid() const;
+    // in the gas at the position in the pipe
+    SimT getResonance(const Pipe& pipe) const;
+    // sets the length of a quarter wave tube or the volume of a helmholtz resonator so that it
+    // resonates at the frequency
+    void tune(const Pipe& pipe, const SimT frequency);
+};
+
+// side branch as a port of a junction in a pipe, where the pressure p is shared and the volume
+// flows add up;
+// the flow into the branch is u = y p + h in relation to the admittance of the pipe, where y is
+// fixed and h follows from the past of the branch, so the junction is solved without iterating;
+// a quarter wave tube is a delay line of its round trip that reflects at the closed end, a
+// helmholtz resonator a biquad of its admittance, bilinear and prewarped to the resonance;
+// both are a fixed cost per sample
+class SideBranchElement
+{
+public:
+    // state of a branch
+    struct State
+    {
+        // waves sent into the tube, a power of two so that the positions wrap with a mask
+        std::vector<SimT> waves;
+        size_t position = 0;
+        // wave that comes back from the tube at the current sample
+        SimT arriving = 0.0;
+        // transposed direct form 2 of the resonator
+        SimT s1 = 0.0, s2 = 0.0;
+    };
+public:
+    // the round trip of a tube is read with the fractional delay of the order
+    void design(const SideBranch& branch, const Pipe& pipe, const SimT samplingRate, const size_t order);
+    SideBranch::Type getType() const { return this->type; }
+    // y, of the current sample
+    SimT getAdmittance() const { return this->admittance; }
+    // flow of the branch to the pressure in relation to the admittance of the pipe
+    std::complex<SimT> getResponse(const SimT frequency) const;
+
+    // h of the current sample
+    SimT prepare(State& state) const;
+    // takes the pressure of the junction at the current sample and steps to the next one
+    void process(State& state, const SimT pressure) const;
+    // grows the waves of the state for the round trip, the samples stay at their distances behind
+    // the position
+    void fitState(State& state) const;
+    // whether the state has the samples for the reads of the design, for the snapshots
+    bool isFitting(const State& state) const;
+    // the state after the last pressure Im(p e^jwn) at n = 0
+    void setSteadyState(State& state, const std::complex<SimT> pressure, const SimT frequency) const;
+private:
+    SideBranch::Type type = SideBranch::Type::QuarterWave;
+    SimT samplingRate = 0.0;
+    SimT admittance = 0.0;
+    // of the tube
+    SimT reflection = 0.0;
+    FractionalDelay roundTrip;
+    // of the resonator, normalized by a0; b0 is the admittance and b1 is 0
+    SimT b2 = 0.0, a1 = 0.0, a2 = 0.0;
+};
\ No newline at end of file
@@ -1,31 +1,750 @@
 #include "simulation.h"
+#include "trace.h"
+#include "snapshot.h"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
 
 #include <iostream>
 
+namespace
+{
+
+// "ESSN" in little endian
+constexpr uint32_t snapshotMagic = 0x4e535345;
+
+}
+
 Simulation::Simulation(const SimT samplingRate) : 
     samplingRate(samplingRate), 
     outWave(*this),
     cylinder(*this),
-    pipe(*this, this->cylinder)
+    pipe(*this, this->cylinder),
+    modalPipe(*this, this->cylinder, this->pipe),
+    hornPipe(*this, this->cylinder, this->pipe),
+    delayLinePipe(*this, this->cylinder, this->pipe)
+{
+}
+
+Simulation::~Simulation() = default;
+
+void Simulation::setPipeEngine(const PipeEngine engine)
+{
+    if(engine == this->pipeEngine)
+        return;
+
+    this->pipeEngine = engine;
+    this->resetEngines();
+}
+
+void Simulation::resetEngines()
+{
+    this->pipe.reset();
+    this->modalPipe.reset();
+    this->hornPipe.reset();
+    this->delayLinePipe.reset();
+    if(this->intake)
+        this->intake->resetEngines();
+}
+
+void Simulation::setMixGains(const SimT exhaustGain, const SimT intakeGain)
+{
+    // the intake starts from silence when it's turned on
+    if(this->intakeGain == 0.0 && intakeGain != 0.0 && this->intake)
+        this->intake->resetEngines();
+
+    this->exhaustGain = exhaustGain;
+    this->intakeGain = intakeGain;
+}
+
+void Simulation::setIntakePool(WorkStealingPool* pool, const size_t minSampleCount)
 {
+    assert(!pool || pool->getWorkerCount() >= 2);
+    this->intakePool = pool;
+    this->parallelIntakeSampleCount = minSampleCount;
+    if(pool && !this->intakeJob)
+    {
+        this->intakeJob = [this](const size_t job, const size_t)
+        {
+            if(job == 0)
+                this->progressExhaust(this->intakeSampleCount);
+            else
+                this->progressIntake(this->intakeSampleCount);
+        };
+    }
+}
+
+void Simulation::setIntakeGeometry(const SimT length, const SimT radius)
+{
+    assert(length > 0.0 && radius > 0.0);
+    this->intakeLength = length;
+    this->intakeRadius = radius;
+}
+
+size_t Simulation::warmStart(const size_t blockSize)
+{
+    TRACE_SCOPE("Simulation::warmStart");
+
+    assert(blockSize > 0);
+
+    // a transition would start the tier from silence, so the slot of the tier is switched to
+    const DetailTier& tier = detailTiers[this->detailTier];
+    if(tier.rateDivisor != this->getSlotRateDivisor(this->activeSlot))
+        this->activeSlot = this->acquireSlot(tier.rateDivisor);
+    this->targetSlot = this->activeSlot;
+
+    Simulation& active = this->getSlotSimulation(this->activeSlot);
+    const size_t rateDivisor = this->getSlotRateDivisor(this->activeSlot);
+    this->blockControls = this->cylinder.getControls();
+    if(this->activeSlot != mainSlot)
+    {
+        this->syncCopy(active);
+        DetailCopy& copy = this->detailCopies[this->activeSlot];
+        copy.sampleCount = static_cast<size_t>(this->oldSampleCount) / copy.rateDivisor;
+        copy.lastSample = 0.0;
+    }
+
+    active.echoLimit = static_cast<SimT>(std::min(this->pipe.getEchoIterations(), tier.echoLimit));
+    active.modeLimit = static_cast<SimT>(std::min(this->modalPipe.getModeCount(), tier.modeLimit));
+    active.pipe.setEchoLimit(static_cast<size_t>(active.echoLimit));
+    active.modalPipe.setModeLimit(static_cast<size_t>(active.modeLimit));
+    active.cylinder.setFastOscillator(tier.fastOscillator);
+
+    // the run ahead is outside of the time of the output, so the ramps don't move during it
+    size_t sampleCount = active.warmStartEngine(std::max<size_t>(1, blockSize / rateDivisor)) * rateDivisor;
+    this->cylinder.setControls(this->blockControls);
+
+    // the output filter starts from the steady state too, and a copy gets its last sample for
+    // the interpolation
+    const size_t primeBlockCount = std::max<size_t>(1, (this->outputFilter.getLength() + blockSize - 1) / blockSize);
+    for(size_t block = 0; block < primeBlockCount; block++)
+    {
+        this->blockControls = this->cylinder.getControls();
+        this->renderSlot(this->activeSlot, blockSize);
+        if(this->activeSlot != mainSlot)
+            this->cylinder.advanceControls(blockSize);
+        this->outputFilter.fill(this->outWave.samples);
+        this->oldSampleCount += static_cast<SimT>(blockSize);
+    }
+    sampleCount += primeBlockCount * blockSize;
+
+    return sampleCount;
+}
+
+size_t Simulation::warmStartEngine(const size_t blockSize)
+{
+    this->cylinder.skipStartSmoothing();
+    if(!this->cylinder.isRunning())
+    {
+        this->resetEngines();
+        return 0;
+    }
+
+    if(this->intakeGain != 0.0)
+        this->syncIntake();
+
+    // the steady states are solved for the sine, the pulses are run ahead like the echo model
+    if(!this->cylinder.getExcitation() && this->pipeEngine != PipeEngine::Echo)
+    {
+        switch(this->pipeEngine)
+        {
+        case PipeEngine::Echo:
+            break;
+        case PipeEngine::Modal:
+            this->modalPipe.warmStart();
+            break;
+        case PipeEngine::Horn:
+            this->hornPipe.warmStart();
+            break;
+        case PipeEngine::DelayLine:
+            this->delayLinePipe.warmStart();
+            break;
+        }
+
+        // the intake is solved for the same sine
+        if(this->intakeGain != 0.0)
+        {
+            this->intake->cylinder.setControls(this->cylinder.getControls());
+            this->intake->cylinder.setPhase(this->cylinder.getPhase());
+            this->intake->warmStartEngine(blockSize);
+        }
+        return 0;
+    }
+
+    // the echo model keeps a wave for the echo iterations, so it's settled after as many
+    // round trips of the longer pipe, and the other engines take their loss from the echo
+    // iterations;
+    // the radiated waves of the echo model are dropped instead of summed
+    const auto getRoundTripSampleCount = [this](const Pipe& pipe)
+    {
+        return 2.0 * (pipe.getTravelTime() + pipe.getEndCorrectionTime()) * this->samplingRate;
+    };
+    SimT roundTripSampleCount = getRoundTripSampleCount(this->pipe);
+    if(this->intakeGain != 0.0)
+        roundTripSampleCount = std::max(roundTripSampleCount, getRoundTripSampleCount(this->intake->pipe));
+    const size_t blockCount = static_cast<size_t>(std::ceil(
+        roundTripSampleCount * static_cast<SimT>(this->pipe.getActiveEchoIterations()) /
+        static_cast<SimT>(blockSize)));
+
+    this->resetEngines();
+    for(size_t block = 0; block < blockCount; block++)
+    {
+        const SimT newSampleCount = this->oldSampleCount + static_cast<SimT>(blockSize);
+        this->cylinder.progressSimulation(this->oldSampleCount, newSampleCount);
+        if(this->pipeEngine == PipeEngine::Echo)
+        {
+            this->pipe.progressSimulation(this->oldSampleCount, newSampleCount, static_cast<SimT>(blockSize));
+            this->pipe.clearRadiatedWaves();
+            if(this->intakeGain != 0.0)
+                this->progressIntake(blockSize);
+        }
+        else
+            this->progressEngine(blockSize);
+        this->oldSampleCount = newSampleCount;
+    }
+
+    return blockCount * blockSize;
+}
+
+void Simulation::setDetailTier(const size_t tier)
+{
+    assert(tier < detailTierCount);
+    this->detailTier = tier;
+
+    // the transition picks the same slot at the next progress
+    if(this->activeSlot == this->targetSlot && this->isTransitionNeeded())
+        this->acquireSlot(detailTiers[tier].rateDivisor);
+}
+
+void Simulation::prepareDetailTiers()
+{
+    // a transition renders in a copy of the rate other than the active slot, so a lower rate
+    // needs two copies and the full rate one next to this;
+    // the full rate copy is for the echo model that is switched to more echoes
+    for(const DetailTier& tier : detailTiers)
+    {
+        const size_t wantedCount = tier.rateDivisor == 1 ? 1 : 2;
+        const size_t count = static_cast<size_t>(std::count_if(this->detailCopies.begin(),
+            this->detailCopies.end(), [&tier](const DetailCopy& copy)
+            {
+                return copy.rateDivisor == tier.rateDivisor;
+            }));
+        for(size_t i = count; i < wantedCount; i++)
+        {
+            DetailCopy& copy = this->detailCopies.emplace_back();
+            copy.rateDivisor = tier.rateDivisor;
+            copy.simulation = this->createDetailCopy(tier.rateDivisor);
+        }
+    }
+}
+
+SimT Simulation::getDetailCost(const size_t tier) const
+{
+    assert(tier < detailTierCount);
+    if(this->detailSampleCounts[tier] == 0)
+        return 0.0;
+
+    return this->detailRenderTimes[tier] * this->samplingRate /
+        static_cast<SimT>(this->detailSampleCounts[tier]);
+}
+
+bool Simulation::isTransitionNeeded() const
+{
+    const DetailTier& tier = detailTiers[this->detailTier];
+    const size_t echoTarget = std::min(this->pipe.getEchoIterations(), tier.echoLimit);
+
+    // a higher echo count would let the echo model process waves that it has dropped,
+    // so it's rendered from a reset
+    const Simulation& active = this->getSlotSimulation(this->activeSlot);
+    const bool moreEchoes = this->pipeEngine == PipeEngine::Echo &&
+        static_cast<SimT>(echoTarget) > active.echoLimit && active.echoLimit != 0.0;
+    return tier.rateDivisor != this->getSlotRateDivisor(this->activeSlot) || moreEchoes;
+}
+
+void Simulation::progressDetail()
+{
+    const DetailTier& tier = detailTiers[this->detailTier];
+    const size_t echoTarget = std::min(this->pipe.getEchoIterations(), tier.echoLimit);
+    const size_t modeTarget = std::min(this->modalPipe.getModeCount(), tier.modeLimit);
+
+    Simulation& active = this->getSlotSimulation(this->activeSlot);
+    if(this->activeSlot == this->targetSlot && this->isTransitionNeeded())
+    {
+        this->targetSlot = this->acquireSlot(tier.rateDivisor);
+        this->transitionPosition = 0;
+
+        // the tier starts from silence with the phase of the current oscillator
+        Simulation& target = this->getSlotSimulation(this->targetSlot);
+        target.resetEngines();
+        target.cylinder.setPhase(active.cylinder.getPhase());
+        target.echoLimit = target.modeLimit = 0.0;
+        if(this->targetSlot != mainSlot)
+        {
+            DetailCopy& copy = this->detailCopies[this->targetSlot];
+            copy.sampleCount = static_cast<size_t>(this->oldSampleCount) / copy.rateDivisor;
+            copy.lastSample = 0.0;
+        }
+    }
+
+    // the caps go down by one per progress, which the echo model follows without clicks;
+    // the tier that is being left keeps its caps
+    const auto ramp = [](SimT& limit, const size_t target)
+    {
+        if(limit == 0.0 || static_cast<SimT>(target) > limit)
+            limit = static_cast<SimT>(target);
+        else
+            limit = std::max(static_cast<SimT>(target), limit - 1.0);
+
+        return static_cast<size_t>(limit);
+    };
+    Simulation& target = this->getSlotSimulation(this->targetSlot);
+    target.pipe.setEchoLimit(ramp(target.echoLimit, echoTarget));
+    target.modalPipe.setModeLimit(ramp(target.modeLimit, modeTarget));
+    target.cylinder.setFastOscillator(tier.fastOscillator);
+}
+
+Simulation& Simulation::getSlotSimulation(const size_t slot)
+{
+    return slot == mainSlot ? *this : *this->detailCopies[slot].simulation;
+}
+
+const Simulation& Simulation::getSlotSimulation(const size_t slot) const
+{
+    return slot == mainSlot ? *this : *this->detailCopies[slot].simulation;
+}
+
+size_t Simulation::getSlotRateDivisor(const size_t slot) const
+{
+    return slot == mainSlot ? 1 : this->detailCopies[slot].rateDivisor;
+}
+
+size_t Simulation::acquireSlot(const size_t rateDivisor)
+{
+    if(rateDivisor == 1 && this->activeSlot != mainSlot)
+        return mainSlot;
+
+    for(size_t slot = 0; slot < this->detailCopies.size(); slot++)
+    {
+        if(this->detailCopies[slot].rateDivisor == rateDivisor && slot != this->activeSlot)
+            return slot;
+    }
+
+    DetailCopy& copy = this->detailCopies.emplace_back();
+    copy.rateDivisor = rateDivisor;
+    copy.simulation = this->createDetailCopy(rateDivisor);
+    return this->detailCopies.size() - 1;
+}
+
+std::unique_ptr<Simulation> Simulation::createDetailCopy(const size_t rateDivisor) const
+{
+    auto copy = std::make_unique<Simulation>(this->samplingRate / static_cast<SimT>(rateDivisor));
+    copy->detailCopy = true;
+    return copy;
+}
+
+void Simulation::syncCopy(Simulation& copy) const
+{
+    copy.cylinder.setControls(this->blockControls);
+    copy.cylinder.shareExcitation(this->cylinder);
+    copy.cylinder.setExcitationVariation(this->cylinder.getExcitationVariation());
+    copy.cylinder.setValveCoupling(this->cylinder.isValveCoupling());
+    if(copy.cylinder.isRunning() != this->cylinder.isRunning())
+    {
+        if(this->cylinder.isRunning())
+            copy.cylinder.start();
+        else
+            copy.cylinder.stop();
+    }
+
+    // the geometry setters reset, so they are only called on a change
+    if(copy.pipe.getEchoIterations() != this->pipe.getEchoIterations())
+        copy.pipe.setEchoIterationsAndReset(this->pipe.getEchoIterations());
+    if(copy.pipe.getPipeRadius() != this->pipe.getPipeRadius())
+        copy.pipe.setPipeRadiusAndReset(this->pipe.getPipeRadius());
+    if(copy.pipe.getPipePhysicalLength() != this->pipe.getPipePhysicalLength())
+        copy.pipe.setPipePhysicalLengthAndReset(this->pipe.getPipePhysicalLength());
+    if(copy.pipe.getTemperatures() != this->pipe.getTemperatures())
+        copy.pipe.setTemperatures(this->pipe.getTemperatures());
+    if(copy.pipe.isWallLoss() != this->pipe.isWallLoss())
+        copy.pipe.setWallLoss(this->pipe.isWallLoss());
+    if(copy.pipe.getFractionalDelayOrder() != this->pipe.getFractionalDelayOrder())
+        copy.pipe.setFractionalDelayOrder(this->pipe.getFractionalDelayOrder());
+    if(copy.pipe.getSideBranches() != this->pipe.getSideBranches())
+        copy.pipe.setSideBranches(this->pipe.getSideBranches());
+
+    copy.setPipeEngine(this->pipeEngine);
+    copy.modalPipe.setModeCount(this->modalPipe.getModeCount());
+    if(copy.hornPipe.getProfile() != this->hornPipe.getProfile())
+        copy.hornPipe.setProfile(this->hornPipe.getProfile());
+
+    copy.setMixGains(this->exhaustGain, this->intakeGain);
+    copy.setIntakeGeometry(this->intakeLength, this->intakeRadius);
+    if(copy.intakePool != this->intakePool || copy.parallelIntakeSampleCount != this->parallelIntakeSampleCount)
+        copy.setIntakePool(this->intakePool, this->parallelIntakeSampleCount);
+}
+
+void Simulation::syncIntake()
+{
+    if(!this->intake)
+        this->intake = std::make_unique<Simulation>(this->samplingRate);
+    Simulation& intake = *this->intake;
+
+    // the geometry setters reset, so they are only called on a change
+    if(intake.pipe.getEchoIterations() != this->pipe.getEchoIterations())
+        intake.pipe.setEchoIterationsAndReset(this->pipe.getEchoIterations());
+    if(intake.pipe.getPipeRadius() != this->intakeRadius)
+        intake.pipe.setPipeRadiusAndReset(this->intakeRadius);
+    if(intake.pipe.getPipePhysicalLength() != this->intakeLength)
+        intake.pipe.setPipePhysicalLengthAndReset(this->intakeLength);
+    if(intake.pipe.isWallLoss() != this->pipe.isWallLoss())
+        intake.pipe.setWallLoss(this->pipe.isWallLoss());
+    if(intake.pipe.getFractionalDelayOrder() != this->pipe.getFractionalDelayOrder())
+        intake.pipe.setFractionalDelayOrder(this->pipe.getFractionalDelayOrder());
+
+    intake.setPipeEngine(this->pipeEngine);
+    intake.modalPipe.setModeCount(this->modalPipe.getModeCount());
+    // the caps of the detail follow the exhaust
+    if(this->echoLimit != 0.0)
+    {
+        intake.pipe.setEchoLimit(static_cast<size_t>(this->echoLimit));
+        intake.modalPipe.setModeLimit(static_cast<size_t>(this->modeLimit));
+    }
+}
+
+void Simulation::renderSlot(const size_t slot, const size_t sampleCount)
+{
+    const SimT newSampleCount = this->oldSampleCount + static_cast<SimT>(sampleCount);
+    if(slot == mainSlot)
+    {
+        this->cylinder.progressSimulation(this->oldSampleCount, newSampleCount);
+        this->progressEngine(sampleCount);
+        return;
+    }
+
+    DetailCopy& copy = this->detailCopies[slot];
+    Simulation& simulation = *copy.simulation;
+    this->syncCopy(simulation);
+
+    // output sample n is interpolated between the samples n / d - 1 and n / d of the copy,
+    // which delays the output by up to d samples
+    const size_t rateDivisor = copy.rateDivisor;
+    const size_t first = static_cast<size_t>(this->oldSampleCount);
+    const size_t copyEnd = (first + sampleCount - 1) / rateDivisor + 1;
+    const size_t copyCount = copyEnd - copy.sampleCount;
+
+    const SimT copyNewSampleCount = simulation.oldSampleCount + static_cast<SimT>(copyCount);
+    simulation.cylinder.progressSimulation(simulation.oldSampleCount, copyNewSampleCount);
+    simulation.progressEngine(copyCount);
+    simulation.oldSampleCount = copyNewSampleCount;
+    const Wave::SampleContainer& samples = simulation.outWave.samples;
+
+    this->outWave.samples.resize(sampleCount);
+    for(size_t i = 0; i < sampleCount; i++)
+    {
+        const size_t index = (first + i) / rateDivisor - copy.sampleCount;
+        const SimT fraction = static_cast<SimT>((first + i) % rateDivisor) / static_cast<SimT>(rateDivisor);
+        const SimT previous = index == 0 ? copy.lastSample : samples[index - 1];
+        this->outWave.samples[i] = previous + fraction * (samples[index] - previous);
+    }
+
+    copy.sampleCount = copyEnd;
+    copy.lastSample = samples.back();
+    this->radiatedWaveCount = simulation.radiatedWaveCount;
 }
 
 const Wave& Simulation::progressSimulation(const SimT sampleCountProgress)
 {
-    const SimT newSampleCount = this->oldSampleCount + sampleCountProgress;
+    TRACE_SCOPE("Simulation::progressSimulation");
+
+    std::chrono::steady_clock::time_point start;
+    if(this->detailCostMeasuring)
+        start = std::chrono::steady_clock::now();
+    const size_t sampleCount = static_cast<size_t>(sampleCountProgress);
+
+    this->progressDetail();
+    this->blockControls = this->cylinder.getControls();
+
+    const bool transition = this->activeSlot != this->targetSlot;
+    const bool mainRendered = this->activeSlot == mainSlot || this->targetSlot == mainSlot;
+    if(!transition)
+        this->renderSlot(this->activeSlot, sampleCount);
+    else
+    {
+        TRACE_SCOPE("Simulation::detailTransition");
+
+        this->renderSlot(this->activeSlot, sampleCount);
+        this->fadeSamples.swap(this->outWave.samples);
+        this->renderSlot(this->targetSlot, sampleCount);
+
+        const SimT warmupSampleCount = transitionWarmupDuration * this->samplingRate;
+        const SimT crossfadeSampleCount = transitionCrossfadeDuration * this->samplingRate;
+        for(size_t i = 0; i < sampleCount; i++)
+        {
+            const SimT position = static_cast<SimT>(this->transitionPosition + i);
+            const SimT weight = std::clamp((position - warmupSampleCount) / crossfadeSampleCount, 0.0, 1.0);
+            this->outWave.samples[i] = this->fadeSamples[i] + weight * (this->outWave.samples[i] - this->fadeSamples[i]);
+        }
+
+        this->transitionPosition += sampleCount;
+        if(static_cast<SimT>(this->transitionPosition) >= warmupSampleCount + crossfadeSampleCount)
+            this->activeSlot = this->targetSlot;
+    }
+
+    if(!mainRendered)
+        this->cylinder.advanceControls(sampleCount);
+
+    this->outputFilter.process(this->outWave.samples);
+    this->oldSampleCount += sampleCountProgress;
+
+    if(this->detailCostMeasuring && !transition)
+    {
+        this->detailRenderTimes[this->detailTier] +=
+            std::chrono::duration<SimT>(std::chrono::steady_clock::now() - start).count();
+        this->detailSampleCounts[this->detailTier] += sampleCount;
+    }
+
+    return this->outWave;
+}
+
+const Wave& Simulation::progressPipe(const SimT sampleCountProgress)
+{
+    this->progressEngine(static_cast<size_t>(sampleCountProgress));
+    this->outputFilter.process(this->outWave.samples);
+    this->oldSampleCount += sampleCountProgress;
+
+    return this->outWave;
+}
+
+void Simulation::progressEngine(const size_t sampleCount)
+{
+    if(this->intakeGain == 0.0)
+    {
+        this->progressExhaust(sampleCount);
+        if(this->exhaustGain != 1.0)
+        {
+            for(auto& sample : this->outWave.samples)
+                sample *= this->exhaustGain;
+        }
+        return;
+    }
+
+    this->syncIntake();
+    if(this->intakePool && sampleCount >= this->parallelIntakeSampleCount && !WorkStealingPool::isInJob())
+    {
+        this->intakeSampleCount = sampleCount;
+        this->intakePool->run(2, this->intakeJob);
+    }
+    else
+    {
+        this->progressExhaust(sampleCount);
+        this->progressIntake(sampleCount);
+    }
+
+    const Wave::SampleContainer& intakeSamples = this->intake->outWave.samples;
+    assert(intakeSamples.size() == sampleCount && this->outWave.samples.size() == sampleCount);
+    for(size_t i = 0; i < sampleCount; i++)
+        this->outWave.samples[i] = this->exhaustGain * this->outWave.samples[i] - this->intakeGain * intakeSamples[i];
+}
+
+void Simulation::progressIntake(const size_t sampleCount)
+{
+    TRACE_SCOPE("Simulation::progressIntake");
+
+    this->intake->cylinder.currentOutWave.samples = this->cylinder.currentOutWave.samples;
+    this->intake->progressPipe(static_cast<SimT>(sampleCount));
+}
+
+void Simulation::progressExhaust(const size_t sampleCount)
+{
+    const SimT newSampleCount = this->oldSampleCount + static_cast<SimT>(sampleCount);
 
-    this->cylinder.progressSimulation(this->oldSampleCount, newSampleCount);
-    this->pipe.progressSimulation(this->oldSampleCount, newSampleCount, sampleCountProgress);
+    switch(this->pipeEngine)
+    {
+    case PipeEngine::Echo:
+        this->pipe.progressSimulation(this->oldSampleCount, newSampleCount, static_cast<SimT>(sampleCount));
 
-    this->outWave = this->pipe.sumRadiatedWaves(static_cast<size_t>(sampleCountProgress));
-    this->pipe.clearRadiatedWaves();
+        this->outWave = this->pipe.sumRadiatedWaves(sampleCount);
+        this->radiatedWaveCount = this->pipe.radiatedWaves.size();
+        this->pipe.clearRadiatedWaves();
+        break;
+    case PipeEngine::Modal:
+        this->modalPipe.progressSimulation(sampleCount);
+
+        this->outWave = this->modalPipe.outWave;
+        this->radiatedWaveCount = 0;
+        break;
+    case PipeEngine::Horn:
+        this->hornPipe.progressSimulation(sampleCount);
+
+        this->outWave = this->hornPipe.outWave;
+        this->radiatedWaveCount = 0;
+        break;
+    case PipeEngine::DelayLine:
+        this->delayLinePipe.progressSimulation(sampleCount);
+
+        this->outWave = this->delayLinePipe.outWave;
+        this->radiatedWaveCount = 0;
+        break;
+    }
 
     /*this->outWave = this->cylinder.currentOutWave;*/
 
     /*system("cls");*/
     /*this->outWave.print();*/
+}
+
+void Simulation::saveSnapshot(std::vector<uint8_t>& snapshot) const
+{
+    TRACE_SCOPE("Simulation::saveSnapshot");
 
-    this->oldSampleCount = newSampleCount;
+    SnapshotWriter writer{snapshot};
+    writer.write(snapshotMagic);
+    writer.write(snapshotVersion);
+    writer.write(this->samplingRate);
+    this->saveState(writer);
+}
 
-    return this->outWave;
+bool Simulation::restoreSnapshot(const uint8_t* data, const size_t size)
+{
+    TRACE_SCOPE("Simulation::restoreSnapshot");
+
+    SnapshotReader reader{data, size};
+    uint32_t magic = 0, version = 0;
+    SimT samplingRate = 0.0;
+    reader.read(magic);
+    reader.read(version);
+    reader.read(samplingRate);
+    if(!reader.isValid() || magic != snapshotMagic || version != snapshotVersion ||
+        samplingRate != this->samplingRate)
+        return false;
+
+    if(!this->loadState(reader) || !reader.isAtEnd())
+    {
+        this->resetEngines();
+        this->outputFilter.reset();
+        this->detailCopies.clear();
+        this->activeSlot = this->targetSlot = mainSlot;
+        return false;
+    }
+
+    return true;
+}
+
+void Simulation::saveState(SnapshotWriter& writer) const
+{
+    writer.write(static_cast<uint32_t>(this->pipeEngine));
+    writer.write(this->oldSampleCount);
+    writer.writeSize(this->radiatedWaveCount);
+
+    writer.writeSize(this->detailTier);
+    writer.write(this->echoLimit);
+    writer.write(this->modeLimit);
+    writer.writeSize(this->activeSlot);
+    writer.writeSize(this->targetSlot);
+    writer.writeSize(this->transitionPosition);
+
+    this->cylinder.saveState(writer);
+    this->pipe.saveState(writer);
+    this->modalPipe.saveState(writer);
+    this->hornPipe.saveState(writer);
+    this->delayLinePipe.saveState(writer);
+    this->outputFilter.saveState(writer);
+
+    writer.write(this->exhaustGain);
+    writer.write(this->intakeGain);
+    writer.write(this->intakeLength);
+    writer.write(this->intakeRadius);
+    writer.write(this->intake != nullptr);
+    if(this->intake)
+        this->intake->saveState(writer);
+
+    writer.writeSize(this->detailCopies.size());
+    for(const auto& copy : this->detailCopies)
+    {
+        writer.writeSize(copy.rateDivisor);
+        writer.writeSize(copy.sampleCount);
+        writer.write(copy.lastSample);
+        copy.simulation->saveState(writer);
+    }
+}
+
+bool Simulation::loadState(SnapshotReader& reader)
+{
+    uint32_t pipeEngine = 0;
+    reader.read(pipeEngine);
+    if(pipeEngine > static_cast<uint32_t>(PipeEngine::DelayLine))
+        return reader.fail();
+    this->pipeEngine = static_cast<PipeEngine>(pipeEngine);
+    reader.read(this->oldSampleCount);
+    reader.readSize(this->radiatedWaveCount);
+
+    reader.readSize(this->detailTier);
+    reader.read(this->echoLimit);
+    reader.read(this->modeLimit);
+    reader.readSize(this->activeSlot);
+    reader.readSize(this->targetSlot);
+    reader.readSize(this->transitionPosition);
+    if(this->detailTier >= detailTierCount)
+        return reader.fail();
+
+    if(!this->cylinder.loadState(reader) ||
+        !this->pipe.loadState(reader) ||
+        !this->modalPipe.loadState(reader) ||
+        !this->hornPipe.loadState(reader) ||
+        !this->delayLinePipe.loadState(reader) ||
+        !this->outputFilter.loadState(reader))
+        return false;
+
+    bool hasIntake = false;
+    reader.read(this->exhaustGain);
+    reader.read(this->intakeGain);
+    reader.read(this->intakeLength);
+    reader.read(this->intakeRadius);
+    reader.read(hasIntake);
+    if(!reader.isValid() || !(this->intakeLength > 0.0) || !(this->intakeRadius > 0.0))
+        return reader.fail();
+    if(hasIntake)
+    {
+        if(!this->intake)
+            this->intake = std::make_unique<Simulation>(this->samplingRate);
+        if(!this->intake->loadState(reader))
+            return false;
+    }
+    else if(this->intake)
+        this->intake->resetEngines();
+
+    // the copies of the same rate are reused so that restoring doesn't reallocate them;
+    // the prepared tiers keep up to two copies of a rate, the full rate one for more echoes
+    size_t copyCount = 0;
+    reader.readSize(copyCount);
+    if(!reader.isValid() || copyCount > 2 * detailTierCount)
+        return reader.fail();
+    this->detailCopies.resize(copyCount);
+    for(auto& copy : this->detailCopies)
+    {
+        size_t rateDivisor = 0;
+        reader.readSize(rateDivisor);
+        if(!reader.isValid() || rateDivisor == 0)
+            return reader.fail();
+        if(!copy.simulation || copy.rateDivisor != rateDivisor)
+        {
+            copy.rateDivisor = rateDivisor;
+            copy.simulation = this->createDetailCopy(rateDivisor);
+        }
+
+        reader.readSize(copy.sampleCount);
+        reader.read(copy.lastSample);
+        if(!copy.simulation->loadState(reader))
+            return false;
+    }
+
+    const auto isSlot = [this](const size_t slot)
+    {
+        return slot == mainSlot || slot < this->detailCopies.size();
+    };
+    if(!isSlot(this->activeSlot) || !isSlot(this->targetSlot))
+        return reader.fail();
+
+    return reader.isValid();
 }
\ No newline at end of file
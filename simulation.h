@@ -2,25 +2,217 @@
 
 #include "wave.h"
 #include "simulators.h"
+#include "modal.h"
+#include "horn.h"
+#include "delayline.h"
+#include "convolution.h"
+#include "pool.h"
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <cstdint>
+
+// level of detail of a simulation, the lower tiers are cheaper
+struct DetailTier
+{
+    const char* name;
+    // caps of the echo iterations of the echo model and of the modes of the modal engine
+    size_t echoLimit, modeLimit;
+    // the engine runs at the sampling rate divided by this, the output is interpolated back
+    size_t rateDivisor;
+    bool fastOscillator;
+};
 
 // contains the simulators of different parts of the engine simulation;
 // runs the simulators in correct order to preserve causality of different parts of the simulation;
 // SI units are used
 class Simulation
 {
+public:
+    // model that turns the cylinder wave to the radiated wave;
+    // the pipe geometry is owned by Pipe for all the engines
+    enum class PipeEngine { Echo, Modal, Horn, DelayLine };
+
+    static constexpr DetailTier detailTiers[] =
+    {
+        {"full", SIZE_MAX, SIZE_MAX, 1, false},
+        {"high", 50, 16, 1, false},
+        {"medium", 25, 8, 2, true},
+        {"low", 10, 4, 4, true},
+    };
+    static constexpr size_t detailTierCount = std::size(detailTiers);
+    // a transition renders both tiers for the warmup before the crossfade;
+    // the echo model settles in about 250 ms after a reset
+    static constexpr SimT transitionWarmupDuration = 0.3, transitionCrossfadeDuration = 0.05;
+    // snapshots of other layout versions are refused
+    static constexpr uint32_t snapshotVersion = 9;
+    // of the intake tract, from the intake valves to the air box
+    static constexpr SimT startIntakeLength = 0.3, startIntakeRadius = 0.01;
 public:
     const SimT samplingRate;
     Wave outWave;
 
     Cylinder cylinder;
     Pipe pipe;
+    ModalPipe modalPipe;
+    HornPipe hornPipe;
+    DelayLinePipe delayLinePipe;
+    // applied to the output of every engine, e.g. the response of a muffler
+    ConvolutionFilter outputFilter;
 
     Simulation(const SimT samplingRate);
+    ~Simulation();
+
+    // the engine that is switched to starts from silence
+    void setPipeEngine(const PipeEngine engine);
+    PipeEngine getPipeEngine() const { return this->pipeEngine; }
+
+    // switches the level of detail without resetting the sound, only applies to progressSimulation;
+    // lower caps are ramped down a step per progress, other changes render the new tier next to
+    // the current one for the warmup and then crossfade to it;
+    // the copy that the transition renders in is created here if it doesn't exist yet
+    void setDetailTier(const size_t tier);
+    size_t getDetailTier() const { return this->detailTier; }
+    // creates the copies of every transition between the tiers, so that switching the tier from
+    // the render thread doesn't allocate
+    void prepareDetailTiers();
+    // measuring adds two clock reads per progress, off by default
+    void setDetailCostMeasuring(const bool measuring) { this->detailCostMeasuring = measuring; }
+    // measured render time of the tier in relation to the rendered duration,
+    // 0 if the tier hasn't been rendered yet with the measuring on;
+    // the transitions are not counted
+    SimT getDetailCost(const size_t tier) const;
 
     // amount of samples to be processed;
     // returns the generated wave of sample count
     const Wave& progressSimulation(const SimT sampleCountProgress);
+    // progresses only the pipe with the current out wave of the cylinder;
+    // used when the excitation is generated outside of the cylinder
+    const Wave& progressPipe(const SimT sampleCountProgress);
+
+    // puts the engine into the steady state of the current frequency and geometry so that the
+    // next progress sounds settled instead of building up from silence;
+    // the modal, horn and delay line engines are solved for the steady state of the sine directly,
+    // the echo model is run ahead without output for the round trips that it keeps;
+    // the waves of the echo model depend on the blocks that it's rendered in, so it's run ahead
+    // in the block size of the progresses to come;
+    // the tier is switched to without a transition, the start smoothing of the cylinder is skipped
+    // and the last blocks are rendered normally to fill the output filter;
+    // returns the samples that the simulation was run ahead
+    size_t warmStart(const size_t blockSize);
+
+    // gains of the exhaust and the intake tract in the output, the intake is off while its gain is 0;
+    // the intake takes the same excitation as the exhaust, but the valves draw the gas in where the
+    // exhaust blows it out, so the intake is mixed with the opposite sign
+    void setMixGains(const SimT exhaustGain, const SimT intakeGain);
+    SimT getExhaustGain() const { return this->exhaustGain; }
+    SimT getIntakeGain() const { return this->intakeGain; }
+    // pipe of the intake tract that radiates from an open end of its own, in the air at the
+    // reference temperature and with the engine, the echo iterations, the wall losses and the
+    // fractional delay of the exhaust pipe;
+    // the side branches and the horn profile are of the exhaust only;
+    // a change resets the intake at the next progress
+    void setIntakeGeometry(const SimT length, const SimT radius);
+    SimT getIntakeLength() const { return this->intakeLength; }
+    SimT getIntakeRadius() const { return this->intakeRadius; }
+    // renders the intake as a job next to the exhaust on the pool in the blocks of at least min
+    // sample count samples, nullptr renders it after the exhaust;
+    // the pool is the host's and has two workers or more that are idle while this renders;
+    // the handoff is skipped inside a job of some pool, e.g. when the simulation is a voice;
+    // the block size from which the handoff pays off depends on the machine, see the intake
+    // benchmark;
+    // the output is the same either way
+    void setIntakePool(WorkStealingPool* pool, const size_t minSampleCount);
+    WorkStealingPool* getIntakePool() const { return this->intakePool; }
+
+    // amount of waves that were radiated during the last progress
+    size_t getRadiatedWaveCount() const { return this->radiatedWaveCount; }
+    // whether this renders a lower tier of another simulation
+    bool isDetailCopy() const { return this->detailCopy; }
+
+    // appends a binary snapshot of the whole state to the data: the parameters, the contents of
+    // the pipes of every engine, the oscillator phase, the sample counters, the detail copies
+    // and the output filter;
+    // the output of the last progress and the measured tier costs are not included
+    void saveSnapshot(std::vector<uint8_t>& snapshot) const;
+    // restores a snapshot of a simulation of the same sampling rate, after which this renders
+    // the same samples as the saved one would have;
+    // returns false if the snapshot is not valid, the engines are reset then but the parameters
+    // may have been restored in part
+    bool restoreSnapshot(const uint8_t* data, const size_t size);
 
 private:
+    // copy of the simulation for a tier that the engines can't switch to in place,
+    // at a lower rate or with more echoes; the parameters are synced from this one
+    struct DetailCopy
+    {
+        size_t rateDivisor;
+        std::unique_ptr<Simulation> simulation;
+        // samples rendered at the rate of the copy and the last of them
+        size_t sampleCount = 0;
+        SimT lastSample = 0.0;
+    };
+    // the engines of this simulation, the other slots are the copies
+    static constexpr size_t mainSlot = SIZE_MAX;
+
+    PipeEngine pipeEngine = PipeEngine::Echo;
+    bool detailCopy = false;
     SimT oldSampleCount = 0;
+    size_t radiatedWaveCount = 0;
+
+    size_t detailTier = 0;
+    // caps of the slot that the simulation is in, ramped towards the tier;
+    // 0 before the first progress
+    SimT echoLimit = 0.0, modeLimit = 0.0;
+    // a transition is in progress when the slots differ
+    size_t activeSlot = mainSlot, targetSlot = mainSlot;
+    size_t transitionPosition = 0;
+    std::vector<DetailCopy> detailCopies;
+    Wave::SampleContainer fadeSamples;
+    // controls of the cylinder at the start of the block, the copies render the block from them;
+    // the controls of this one advance over the block even when only the copies render
+    Cylinder::Controls blockControls;
+    bool detailCostMeasuring = false;
+    SimT detailRenderTimes[detailTierCount] = {};
+    uint64_t detailSampleCounts[detailTierCount] = {};
+
+    SimT exhaustGain = 1.0, intakeGain = 0.0;
+    SimT intakeLength = startIntakeLength, intakeRadius = startIntakeRadius;
+    // renders the pipe of the intake from the excitation of this one, created at the first
+    // progress with the intake on
+    std::unique_ptr<Simulation> intake;
+    // job 0 renders the exhaust and job 1 the intake;
+    // the job is created with the pool so that dispatching it doesn't allocate
+    WorkStealingPool* intakePool = nullptr;
+    size_t parallelIntakeSampleCount = 0;
+    WorkStealingPool::Job intakeJob;
+    size_t intakeSampleCount = 0;
+
+    // renders the engines of the exhaust and the intake and mixes them to the out wave without the
+    // output filter
+    void progressEngine(const size_t sampleCount);
+    void progressExhaust(const size_t sampleCount);
+    // renders the intake with the current out wave of the cylinder
+    void progressIntake(const size_t sampleCount);
+    // creates the intake and brings its parameters to the ones of this
+    void syncIntake();
+    void resetEngines();
+    // steady state of the engines of this simulation, without the detail or the output filter
+    size_t warmStartEngine(const size_t blockSize);
+    // ramps the caps of the active slot and starts a transition if the tier asks for it
+    void progressDetail();
+    // whether the tier can't be switched to in the active slot
+    bool isTransitionNeeded() const;
+    Simulation& getSlotSimulation(const size_t slot);
+    const Simulation& getSlotSimulation(const size_t slot) const;
+    size_t getSlotRateDivisor(const size_t slot) const;
+    // slot of the rate other than the active one, a copy is created if there is none
+    size_t acquireSlot(const size_t rateDivisor);
+    // renders the cylinder and the engine of the slot to the out wave
+    void renderSlot(const size_t slot, const size_t sampleCount);
+    std::unique_ptr<Simulation> createDetailCopy(const size_t rateDivisor) const;
+    void syncCopy(Simulation& copy) const;
+    // state without the header, the copies are saved recursively
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
 };
\ No newline at end of file
@@ -1,8 +1,11 @@
 ﻿#include "simulators.h"
 #include "simulation.h"
+#include "trace.h"
+#include "snapshot.h"
 #include <cmath>
 #include <algorithm>
 #include <numbers>
+#include <limits>
 #include <cassert>
 
 #include <iostream>
@@ -29,8 +32,69 @@ void Cylinder::restart()
     this->_restart = true;
 }
 
+void Cylinder::skipStartSmoothing()
+{
+    this->sampleCountStartPosition = -std::numeric_limits<SimT>::infinity();
+    this->_restart = false;
+}
+
+void Cylinder::setExcitation(const ExcitationShape* shape)
+{
+    if(!shape)
+    {
+        this->excitation = nullptr;
+        this->detailExcitations.clear();
+        return;
+    }
+    if(this->excitation && this->excitation->shape == *shape)
+        return;
+
+    this->excitation = ExcitationTable::get(*shape, this->simulation.samplingRate);
+
+    // building a table takes longer than a block, so the copies don't build theirs when they
+    // are synced on the render thread
+    this->detailExcitations.clear();
+    if(this->simulation.isDetailCopy())
+        return;
+    for(const DetailTier& tier : Simulation::detailTiers)
+    {
+        const SimT samplingRate = this->simulation.samplingRate / static_cast<SimT>(tier.rateDivisor);
+        const bool built = std::any_of(this->detailExcitations.begin(), this->detailExcitations.end(),
+            [samplingRate](const std::shared_ptr<const ExcitationTable>& table)
+            {
+                return table->samplingRate == samplingRate;
+            });
+        if(tier.rateDivisor > 1 && !built)
+            this->detailExcitations.push_back(ExcitationTable::get(*shape, samplingRate));
+    }
+}
+
+void Cylinder::shareExcitation(const Cylinder& other)
+{
+    const SimT samplingRate = this->simulation.samplingRate;
+    if(!other.excitation)
+        this->excitation = nullptr;
+    else if(!this->excitation || this->excitation->shape != other.excitation->shape)
+    {
+        this->excitation = nullptr;
+        if(other.excitation->samplingRate == samplingRate)
+            this->excitation = other.excitation;
+        for(const auto& table : other.detailExcitations)
+        {
+            if(table->samplingRate == samplingRate)
+                this->excitation = table;
+        }
+
+        // a rate that no tier has
+        if(!this->excitation)
+            this->excitation = ExcitationTable::get(other.excitation->shape, samplingRate);
+    }
+}
+
 void Cylinder::progressSimulation(SimT oldSampleCount, SimT newSampleCount)
 {
+    TRACE_SCOPE("Cylinder::progressSimulation");
+
     if(!this->running || this->_restart)
     {
         this->sampleCountStartPosition = oldSampleCount;
@@ -44,16 +108,25 @@ void Cylinder::progressSimulation(SimT oldSampleCount, SimT newSampleCount)
     const SimT smoothingDuration = 0.1 / this->currentOutWave.getSampleDuration();
     const int sampleCount = static_cast<int>(newSampleCount - oldSampleCount);
 
+    // the pressure that the pipe put on the valves during the last progress
+    for(size_t i = 0; i < this->backPressures.size(); i++)
+    {
+        const SimT transmission = 1.0 - this->valveReflections[i];
+        this->scavengingSum += transmission * this->backPressures[i];
+        this->scavengingWeight += transmission;
+    }
+    this->valveReflections.clear();
+    this->backPressures.clear();
+
     this->currentOutWave.samples.clear();
+    if(this->excitation)
+        this->renderPulses(static_cast<size_t>(std::max(sampleCount, 0)));
+    else
+        this->renderSine(static_cast<size_t>(std::max(sampleCount, 0)));
 
     for(int i = 0; i < sampleCount; i++)
     {
-        this->counter += (this->frequency * 2 * std::numbers::pi) / this->simulation.samplingRate;
-
-        // avg peak sound pressure level amplitude in conversations
-        constexpr SimT conversationAmplitude = 0.02f;
-
-        SimT val = std::sin(this->counter) * conversationAmplitude;
+        SimT& val = this->currentOutWave.samples[i];
 
         // start&stop linear smoothing
         if(this->running && oldSampleCount - this->sampleCountStartPosition + i < smoothingDuration)
@@ -62,9 +135,259 @@ void Cylinder::progressSimulation(SimT oldSampleCount, SimT newSampleCount)
             val *= 1.0 - (oldSampleCount - this->sampleCountStopPosition + i) / smoothingDuration;
         else if(!this->running)
             val = 0.0;
+    }
+}
+
+void Cylinder::advanceControls(const size_t sampleCount)
+{
+    const SimT sampleDuration = this->currentOutWave.getSampleDuration();
+    this->controls.frequency.advance(sampleCount, sampleDuration);
+    this->controls.load.advance(sampleCount, sampleDuration);
+}
+
+void Cylinder::renderSteps(const size_t sampleCount)
+{
+    this->steps.resize(sampleCount);
+    SimT* const steps = this->steps.data();
+    this->controls.frequency.render(steps, sampleCount, this->currentOutWave.getSampleDuration());
+
+    const SimT samplingRate = this->simulation.samplingRate;
+    for(size_t i = 0; i < sampleCount; i++)
+        steps[i] = (steps[i] * 2 * std::numbers::pi) / samplingRate;
+}
+
+void Cylinder::renderSine(const size_t sampleCount)
+{
+    this->renderSteps(sampleCount);
+    const SimT* const steps = this->steps.data();
+
+    this->currentOutWave.samples.resize(sampleCount);
+    SimT* const samples = this->currentOutWave.samples.data();
+    SimT counter = this->counter;
+
+    if(!this->fastOscillator)
+    {
+        for(size_t i = 0; i < sampleCount; i++)
+        {
+            counter += steps[i];
+            samples[i] = std::sin(counter) * conversationAmplitude;
+        }
+
+        this->counter = counter;
+        return;
+    }
+
+    // the rotation of each step is taken from the taylor series of the half step, which keeps
+    // the loop free of calls so that it vectorizes;
+    // the rotation uses cos - 1 of the step, which keeps its precision for low frequencies;
+    // the series are accurate to the double precision up to steps of about 1 radian
+    this->stepSines.resize(sampleCount);
+    this->stepCosineDeltas.resize(sampleCount);
+    SimT* const stepSines = this->stepSines.data();
+    SimT* const stepCosineDeltas = this->stepCosineDeltas.data();
+    for(size_t i = 0; i < sampleCount; i++)
+    {
+        const SimT half = 0.5 * steps[i], square = half * half;
+        const SimT halfSine = half * (1.0 + square * (-1.0 / 6.0 + square * (1.0 / 120.0 +
+            square * (-1.0 / 5040.0 + square * (1.0 / 362880.0 + square * (-1.0 / 39916800.0 +
+            square * (1.0 / 6227020800.0)))))));
+        const SimT halfCosine = 1.0 + square * (-1.0 / 2.0 + square * (1.0 / 24.0 +
+            square * (-1.0 / 720.0 + square * (1.0 / 40320.0 + square * (-1.0 / 3628800.0 +
+            square * (1.0 / 479001600.0))))));
+        stepSines[i] = 2.0 * halfSine * halfCosine;
+        stepCosineDeltas[i] = -2.0 * halfSine * halfSine;
+    }
 
-        this->currentOutWave.samples.push_back(val);
+    SimT cosine = std::cos(counter), sine = std::sin(counter);
+    for(size_t i = 0; i < sampleCount; i++)
+    {
+        const SimT nextCosine = cosine + (cosine * stepCosineDeltas[i] - sine * stepSines[i]);
+        sine += cosine * stepSines[i] + sine * stepCosineDeltas[i];
+        cosine = nextCosine;
+        counter += steps[i];
+        samples[i] = sine * conversationAmplitude;
     }
+
+    this->counter = counter;
+}
+
+void Cylinder::renderPulses(const size_t sampleCount)
+{
+    if(!sampleCount)
+        return;
+
+    const ExcitationTable& table = *this->excitation;
+    this->renderSteps(sampleCount);
+    this->loads.resize(sampleCount);
+    this->controls.load.render(this->loads.data(), sampleCount, this->currentOutWave.getSampleDuration());
+
+    // the bands are taken at the higher frequency of the block so that nothing of it aliases,
+    // and the crossfade follows the frequency over the block;
+    // at a lower frequency than the lower band the weight stays at 0, which is the same as
+    // the upper end of the band below it
+    const SimT firstFrequency = this->steps.front() * this->simulation.samplingRate / (2 * std::numbers::pi);
+    const SimT lastFrequency = this->steps.back() * this->simulation.samplingRate / (2 * std::numbers::pi);
+    size_t band;
+    SimT upperWeight;
+    table.findBands(std::max(firstFrequency, lastFrequency), band, upperWeight);
+    const SimT firstWeight = std::clamp(table.getBandPosition(firstFrequency) - static_cast<SimT>(band), 0.0, 1.0);
+    const SimT lastWeight = std::clamp(table.getBandPosition(lastFrequency) - static_cast<SimT>(band), 0.0, 1.0);
+    const SimT weightStep = sampleCount > 1 ?
+        (lastWeight - firstWeight) / static_cast<SimT>(sampleCount - 1) : 0.0;
+
+    if(this->variation.noise > 0.0)
+    {
+        this->noiseSamples.resize(sampleCount);
+        this->noise.fill(this->noiseSamples.data(), sampleCount);
+    }
+    else
+        this->noiseSamples.assign(sampleCount, 0.0);
+
+    if(this->valveCoupling)
+    {
+        this->valveReflections.resize(sampleCount);
+        this->backPressures.assign(sampleCount, 0.0);
+    }
+
+    // the tables and the state are read to locals so that the stores of the samples don't make
+    // the compiler reload them
+    const SimT* const lowerBlowdown = table.getBand(band).blowdown.data();
+    const SimT* const lowerDisplacement = table.getBand(band).displacement.data();
+    const SimT* const upperBlowdown = table.getBand(band + 1).blowdown.data();
+    const SimT* const upperDisplacement = table.getBand(band + 1).displacement.data();
+    const SimT* const envelope = table.getBand(band).envelope.data();
+    const SimT* const tableReflections = table.getValveReflections().data();
+    const SimT* const noiseSamples = this->noiseSamples.data();
+    const SimT* const steps = this->steps.data();
+    SimT* const blowdownLevels = this->loads.data();
+    SimT* const valveReflections = this->valveCoupling ? this->valveReflections.data() : nullptr;
+    const SimT noise = this->variation.noise;
+
+    for(size_t i = 0; i < sampleCount; i++)
+        blowdownLevels[i] = getBlowdownLevel(blowdownLevels[i]);
+
+    this->currentOutWave.samples.resize(sampleCount);
+    SimT* const samples = this->currentOutWave.samples.data();
+
+    // the counter is the phase of the cycles in radians like the phase of the sine
+    SimT counter = this->counter, cycleCount = this->cycleCount;
+    for(size_t i = 0; i < sampleCount; i++)
+    {
+        counter += steps[i] / this->cyclePeriod;
+
+        const SimT cycles = counter / (2 * std::numbers::pi);
+        const SimT cycle = std::floor(cycles);
+        if(cycle != cycleCount)
+        {
+            SimT random[2];
+            this->noise.fill(random, 2);
+            cycleCount = cycle;
+            this->cycleLevel = this->nextCycleLevel;
+            this->nextCycleLevel = 1.0 + this->variation.cycleLevel * random[0];
+            this->cyclePeriod = 1.0 + this->variation.cyclePeriod * random[1];
+
+            if(this->scavengingWeight > 0.0)
+            {
+                const SimT backPressure = this->scavengingSum / this->scavengingWeight / conversationAmplitude;
+                this->nextCycleLevel *= std::clamp(1.0 - scavengingGain * backPressure, minScavenging, maxScavenging);
+            }
+            this->scavengingSum = this->scavengingWeight = 0.0;
+        }
+
+        const SimT cyclePosition = cycles - cycle;
+        const SimT position = cyclePosition * ExcitationTable::tableLength;
+        const size_t index = std::min(static_cast<size_t>(position), ExcitationTable::tableLength - 1);
+        const SimT fraction = position - static_cast<SimT>(index);
+        const auto read = [index, fraction](const SimT* const values)
+        {
+            return values[index] + fraction * (values[index + 1] - values[index]);
+        };
+
+        const SimT blowdownLevel = blowdownLevels[i];
+        const SimT weight = firstWeight + weightStep * static_cast<SimT>(i);
+        const SimT lowerPressure = blowdownLevel * read(lowerBlowdown) + read(lowerDisplacement);
+        const SimT upperPressure = blowdownLevel * read(upperBlowdown) + read(upperDisplacement);
+        const SimT val = lowerPressure + weight * (upperPressure - lowerPressure) +
+            noise * blowdownLevel * read(envelope) * noiseSamples[i];
+
+        const SimT level = this->cycleLevel + cyclePosition * (this->nextCycleLevel - this->cycleLevel);
+        samples[i] = val * level * conversationAmplitude;
+
+        if(valveReflections)
+            valveReflections[i] = read(tableReflections);
+    }
+
+    this->counter = counter;
+    this->cycleCount = cycleCount;
+}
+
+void Cylinder::saveState(SnapshotWriter& writer) const
+{
+    writer.write(this->sampleCountStartPosition);
+    writer.write(this->sampleCountStopPosition);
+    writer.write(this->running);
+    writer.write(this->_restart);
+    writer.write(this->fastOscillator);
+    this->controls.frequency.saveState(writer);
+    this->controls.load.saveState(writer);
+    writer.write(this->counter);
+    writer.write(this->amplitude);
+
+    writer.write(this->excitation != nullptr);
+    if(this->excitation)
+        this->excitation->shape.saveState(writer);
+    writer.write(this->variation);
+    this->noise.saveState(writer);
+    writer.write(this->cycleLevel);
+    writer.write(this->nextCycleLevel);
+    writer.write(this->cyclePeriod);
+    writer.write(this->cycleCount);
+
+    writer.write(this->valveCoupling);
+    writer.writeVector(this->valveReflections);
+    writer.writeVector(this->backPressures);
+    writer.write(this->scavengingSum);
+    writer.write(this->scavengingWeight);
+}
+
+bool Cylinder::loadState(SnapshotReader& reader)
+{
+    reader.read(this->sampleCountStartPosition);
+    reader.read(this->sampleCountStopPosition);
+    reader.read(this->running);
+    reader.read(this->_restart);
+    reader.read(this->fastOscillator);
+    this->controls.frequency.loadState(reader);
+    this->controls.load.loadState(reader);
+    reader.read(this->counter);
+    reader.read(this->amplitude);
+
+    bool excited = false;
+    reader.read(excited);
+    if(excited)
+    {
+        ExcitationShape shape;
+        if(!shape.loadState(reader))
+            return false;
+        this->setExcitation(&shape);
+    }
+    else
+        this->setExcitation(nullptr);
+    reader.read(this->variation);
+    this->noise.loadState(reader);
+    reader.read(this->cycleLevel);
+    reader.read(this->nextCycleLevel);
+    reader.read(this->cyclePeriod);
+    reader.read(this->cycleCount);
+    reader.read(this->valveCoupling);
+    reader.readVector(this->valveReflections);
+    reader.readVector(this->backPressures);
+    reader.read(this->scavengingSum);
+    reader.read(this->scavengingWeight);
+    if(this->cyclePeriod <= 0.0 || this->valveReflections.size() != this->backPressures.size())
+        return reader.fail();
+
+    return reader.isValid();
 }
 
 
@@ -73,6 +396,20 @@ void Cylinder::progressSimulation(SimT oldSampleCount, SimT newSampleCount)
 /////////////////////////////////////////////////////////////////////////////////
 
 
+namespace
+{
+
+SimT getMeanSquare(const Wave::SampleContainer& samples)
+{
+    SimT sum = 0.0;
+    for(const SimT sample : samples)
+        sum += sample * sample;
+
+    return samples.empty() ? 0.0 : sum / static_cast<SimT>(samples.size());
+}
+
+}
+
 Pipe::Pipe(Simulation& simulation, Cylinder& cylinder) :
     simulation(simulation),
     cylinder(cylinder),
@@ -86,6 +423,8 @@ Pipe::Pipe(Simulation& simulation, Cylinder& cylinder) :
 
 Wave Pipe::sumRadiatedWaves(const size_t sampleCount) const
 {
+    TRACE_SCOPE("Pipe::sumRadiatedWaves");
+
     Wave sumWave{this->simulation, 
         Wave::SampleContainer {sampleCount, 
         0.0, Wave::SampleContainer::allocator_type()}};
@@ -115,18 +454,25 @@ void Pipe::clearRadiatedWaves()
 void Pipe::progressSimulation(
     const SimT oldSampleCount, const SimT newSampleCount, const SimT deltaSampleCount)
 {
-    // add the new wave
+    TRACE_SCOPE("Pipe::progressSimulation");
+
+    // add the new wave;
+    // it starts a quarter of a sample in, away from the sample boundaries, see fitLength
     Wave newInWave = this->cylinder.currentOutWave;
+    newInWave.position = Wave::getLength(0.25, 1.0 / this->simulation.samplingRate);
     this->addPipeWave(std::move(newInWave), this->pipeWaves.begin());
+    this->waveEnergies.resize(std::max<size_t>(1, this->waveEnergies.size()));
+    this->waveEnergies[0] = getMeanSquare(this->cylinder.currentOutWave.samples);
 
     // handle the pipe exit wave interactions
     {
         size_t i = 0;
+        const size_t echoIterations = this->getActiveEchoIterations();
         for(auto it = this->pipeWaves.begin();
-            it != this->pipeWaves.end() && i < this->echoIterations;
+            it != this->pipeWaves.end() && i < echoIterations;
             it++, i++)
         {
-            this->progressPipeWave(it);
+            this->progressPipeWave(it, i);
         }
     }
 
@@ -134,14 +480,31 @@ void Pipe::progressSimulation(
     this->prunePipeWaves();
 }
 
-void Pipe::progressPipeWave(const std::list<Wave>::iterator waveIt)
+void Pipe::progressPipeWave(const std::list<Wave>::iterator waveIt, const size_t index)
 {
+    TRACE_SCOPE("Pipe::progressPipeWave");
+
     assert(waveIt != this->pipeWaves.end());
 
     const SimT exceedingLength = waveIt->position + waveIt->getLength() - this->pipeLength;
-    const size_t sampleCount = waveIt->getSampleCountForLength(exceedingLength);
+    size_t sampleCount = waveIt->getSampleCountForLength(exceedingLength);
     if(waveIt->leftToRightDirection && sampleCount >= 2)
     {
+        const SimT straddlingLength = exceedingLength -
+            Wave::getLength(sampleCount, 1.0 / this->simulation.samplingRate);
+        assert(straddlingLength < Wave::getLength(1.0, 1.0 / this->simulation.samplingRate));
+        assert(straddlingLength >= 0);
+
+        // a pipe that got shorter, e.g. hotter, pushes the samples of before the progress past the
+        // open end; they are dropped like the samples that a shorter delay line skips
+        const size_t progressSampleCount = this->cylinder.currentOutWave.getSampleCount();
+        if(sampleCount > progressSampleCount + 1)
+        {
+            const size_t droppedSampleCount = sampleCount - progressSampleCount - 1;
+            waveIt->samples.erase(waveIt->samples.begin(), waveIt->samples.begin() + droppedSampleCount);
+            sampleCount -= droppedSampleCount;
+        }
+
         // handle open end wave reflection;
         // there has to be two or more samples so that the rate of change can be calculated
         // (velocity)
@@ -151,10 +514,20 @@ void Pipe::progressPipeWave(const std::list<Wave>::iterator waveIt)
         auto [radiatedWave, reflectedWave] =
             this->splitToRadiatedAndReflectedWaves(waveToBePartiallyReflected);
 
-        const SimT straddlingLength = exceedingLength -
-            Wave::getLength(sampleCount, 1.0 / this->simulation.samplingRate);
-        assert(straddlingLength < Wave::getLength(1.0, 1.0 / this->simulation.samplingRate));
-        assert(straddlingLength >= 0);
+        // the losses and the fraction of a sample of the round trip are taken at the open end,
+        // where the wave turns back
+        if(this->wallLoss)
+        {
+            if(this->wallLossStates.size() <= index)
+                this->wallLossStates.resize(index + 1);
+            this->wallLossFilter.process(this->wallLossStates[index],
+                reflectedWave.samples.data(), reflectedWave.getSampleCount());
+        }
+        if(this->fractionalDelayStates.size() <= index)
+            this->fractionalDelayStates.resize(index + 1);
+        this->fractionalDelay.process(this->fractionalDelayStates[index],
+            reflectedWave.samples.data(), reflectedWave.getSampleCount());
+        this->setWaveEnergy(index + 1, reflectedWave.samples);
 
         reflectedWave.position = straddlingLength;
 
@@ -168,6 +541,8 @@ void Pipe::progressPipeWave(const std::list<Wave>::iterator waveIt)
         // handle reflection
         Wave waveToBeReflected = waveIt->cutWaveBySampleCount(sampleCount - 1);
         Wave reflectedWave{this->simulation, std::move(waveToBeReflected.samples)};
+        this->reflectAtValves(reflectedWave.samples);
+        this->setWaveEnergy(index + 1, reflectedWave.samples);
 
         const SimT straddlingLength = exceedingLength -
             Wave::getLength(sampleCount, 1.0 / this->simulation.samplingRate);
@@ -182,13 +557,35 @@ void Pipe::progressPipeWave(const std::list<Wave>::iterator waveIt)
 
 void Pipe::prunePipeWaves()
 {
-    // TODO: implement properly
-
-    // TODO: probably the sound wave needs to lose its energy when it bounces in the pipe
+    TRACE_SCOPE("Pipe::prunePipeWaves");
+
+    // the waves over the echo limit are removed;
+    // with the wall losses the waves lose their energy as they bounce, and the last waves are
+    // removed as long as their energy is under the threshold;
+    // the last kept wave makes a new wave at every progress, which is kept once it's louder than
+    // the threshold, so the echoes grow back by one per progress when the sound gets louder
+    size_t waveCount = std::min(this->pipeWaves.size(), this->getActiveEchoIterations());
+    if(this->wallLoss)
+    {
+        const SimT threshold = std::max(pruneEnergyRatio * this->waveEnergies[0], minPruneEnergy);
+        while(waveCount > 1 && this->waveEnergies[waveCount - 1] < threshold)
+            waveCount--;
+    }
 
-    // for now, just remove pipe waves at a certain threshold
-    while(this->pipeWaves.size() > this->echoIterations)
+    while(this->pipeWaves.size() > waveCount)
         this->pipeWaves.pop_back();
+    this->waveEnergies.resize(waveCount);
+    if(this->wallLossStates.size() > waveCount)
+        this->wallLossStates.resize(waveCount);
+    if(this->fractionalDelayStates.size() > waveCount)
+        this->fractionalDelayStates.resize(waveCount);
+}
+
+void Pipe::setWaveEnergy(const size_t index, const Wave::SampleContainer& samples)
+{
+    if(this->waveEnergies.size() <= index)
+        this->waveEnergies.resize(index + 1, 0.0);
+    this->waveEnergies[index] = getMeanSquare(samples);
 }
 
 std::pair<Wave, Wave> Pipe::splitToRadiatedAndReflectedWaves(const Wave& wave) const
@@ -213,11 +610,12 @@ std::pair<Wave, Wave> Pipe::splitToRadiatedAndReflectedWaves(const Wave& wave) c
         /*const SimT flowVelocity =
             ((pressure2 - pressure1) / (-airAdiabaticFactor * pressure1)) /
             wave.getSampleDuration();*/
-        // F = ma <=> a = F/m
+        // F = ma <=> a = F/m;
+        // the air at the open end is at the temperature of the last segment
         const SimT flowAcceleration = 
             (pressure2 - pressure1) 
             / 
-            (Wave::getLength(1.0, wave.getSampleDuration()) * -airDensity);
+            (this->endWaveSpeed * wave.getSampleDuration() * -this->endDensity);
         /*const SimT volumeFlow = this->pipeCrossSectionalArea * flowVelocity;*/
 
         // F = ma
@@ -230,7 +628,7 @@ std::pair<Wave, Wave> Pipe::splitToRadiatedAndReflectedWaves(const Wave& wave) c
 
         // p> + p< = prad
         const SimT radiationPressure = 
-            airDensity * endCorrectionFactor * this->pipeRadius * flowAcceleration;
+            this->endDensity * endCorrectionFactor * this->pipeRadius * flowAcceleration;
         const SimT reflectionPressure = radiationPressure - pressure1;
 
         radiatedWave.samples[i] = radiationPressure;
@@ -240,6 +638,35 @@ std::pair<Wave, Wave> Pipe::splitToRadiatedAndReflectedWaves(const Wave& wave) c
     return {std::move(radiatedWave), std::move(reflectedWave)};
 }
 
+void Pipe::reflectAtValves(Wave::SampleContainer& samples)
+{
+    const Wave::SampleContainer& reflections = this->cylinder.getValveReflections();
+    if(reflections.empty())
+        return;
+
+    // the samples are aligned to the end of the progress like the radiated waves, the ones
+    // before it are reflected at its first sample;
+    // the pressure at the valves is the sum of the returning and the reflected waves
+    const size_t sampleCount = reflections.size();
+    const size_t early = samples.size() > sampleCount ? samples.size() - sampleCount : 0;
+    SimT* const backPressures = this->cylinder.getBackPressures();
+    for(size_t i = 0; i < early; i++)
+    {
+        backPressures[0] += (1.0 + reflections[0]) * samples[i];
+        samples[i] *= reflections[0];
+    }
+
+    const size_t count = samples.size() - early;
+    SimT* const aligned = samples.data() + early;
+    const SimT* const alignedReflections = reflections.data() + sampleCount - count;
+    SimT* const alignedBackPressures = backPressures + sampleCount - count;
+    for(size_t i = 0; i < count; i++)
+    {
+        alignedBackPressures[i] += (1.0 + alignedReflections[i]) * aligned[i];
+        aligned[i] *= alignedReflections[i];
+    }
+}
+
 void Pipe::addRadiatedWave(Wave&& radiatedWave)
 {
     this->radiatedWaves.push_back(std::move(radiatedWave));
@@ -267,6 +694,9 @@ void Pipe::reset()
 {
     this->clearRadiatedWaves();
     this->pipeWaves.clear();
+    this->wallLossStates.clear();
+    this->fractionalDelayStates.clear();
+    this->waveEnergies.clear();
 }
 
 void Pipe::setEchoIterationsAndReset(const size_t echoIterations)
@@ -275,15 +705,19 @@ void Pipe::setEchoIterationsAndReset(const size_t echoIterations)
     this->reset();
 }
 
+void Pipe::setEchoLimit(const size_t echoLimit)
+{
+    assert(echoLimit > 0);
+    this->echoLimit = echoLimit;
+}
+
 void Pipe::setPipePhysicalLengthAndReset(const SimT pipeLengthPhysical)
 {
     assert(pipeLengthPhysical > 0.0);
     assert(this->pipeRadius > 0.0);
 
     this->pipeLengthPhysical = pipeLengthPhysical;
-    this->pipeLength = 
-        this->pipeLengthPhysical + endCorrectionFactor * this->pipeRadius - 
-        Wave::getLength(1.0, 1.0 / this->simulation.samplingRate);
+    this->fitLength();
 
     this->reset();
 }
@@ -294,4 +728,180 @@ void Pipe::setPipeRadiusAndReset(const SimT pipeRadius)
 
     this->pipeRadius = pipeRadius;
     this->setPipePhysicalLengthAndReset(this->pipeLengthPhysical);
+}
+
+void Pipe::setTemperatures(const std::vector<SimT>& temperatures)
+{
+    assert(std::all_of(temperatures.begin(), temperatures.end(),
+        [](const SimT temperature) { return temperature > -zeroCelsius; }));
+
+    // the waves in the pipe keep going, the ones that are past the new length reflect at the
+    // next progress
+    this->temperatures = temperatures;
+    this->fitLength();
+}
+
+void Pipe::setWallLoss(const bool wallLoss)
+{
+    this->wallLoss = wallLoss;
+    this->wallLossStates.clear();
+    this->fitLength();
+
+    // the copies of the lower rate tiers are synced on the render thread, so their fits are
+    // done here
+    if(wallLoss && !this->simulation.isDetailCopy())
+    {
+        for(const DetailTier& tier : Simulation::detailTiers)
+            WallLossFilter::prepare(this->simulation.samplingRate / static_cast<SimT>(tier.rateDivisor));
+    }
+}
+
+void Pipe::setFractionalDelayOrder(const size_t order)
+{
+    assert(order <= FractionalDelay::maxOrder);
+
+    this->fractionalDelayOrder = order;
+    this->fractionalDelayStates.clear();
+    this->fitLength();
+}
+
+void Pipe::setSideBranches(const std::vector<SideBranch>& sideBranches)
+{
+    assert(std::all_of(sideBranches.begin(), sideBranches.end(),
+        [](const SideBranch& sideBranch) { return sideBranch.isValid(); }));
+
+    this->sideBranches = sideBranches;
+}
+
+SimT Pipe::getTemperature(const SimT position) const
+{
+    if(this->temperatures.empty())
+        return referenceTemperature;
+
+    const size_t segmentCount = this->temperatures.size();
+    const size_t segment = static_cast<size_t>(std::max(0.0, position) * static_cast<SimT>(segmentCount));
+    return this->temperatures[std::min(segment, segmentCount - 1)];
+}
+
+SimT Pipe::getTravelTime(const SimT position) const
+{
+    // the segments before the position and the part of the one it's in
+    const size_t segmentCount = std::max<size_t>(1, this->temperatures.size());
+    const SimT segmentLength = this->pipeLengthPhysical / static_cast<SimT>(segmentCount);
+    const SimT scaled = std::clamp(position, 0.0, 1.0) * static_cast<SimT>(segmentCount);
+    SimT travelTime = 0.0;
+    for(size_t i = 0; i < segmentCount && static_cast<SimT>(i) < scaled; i++)
+    {
+        const SimT segmentPosition = (static_cast<SimT>(i) + 0.5) / static_cast<SimT>(segmentCount);
+        const SimT part = std::min<SimT>(1.0, scaled - static_cast<SimT>(i));
+        travelTime += part * segmentLength / this->getWaveSpeed(segmentPosition);
+    }
+
+    return travelTime;
+}
+
+void Pipe::fitLength()
+{
+    const size_t segmentCount = std::max<size_t>(1, this->temperatures.size());
+    const SimT segmentLength = this->pipeLengthPhysical / static_cast<SimT>(segmentCount);
+    this->travelTime = 0.0;
+    for(size_t i = 0; i < segmentCount; i++)
+    {
+        const SimT position = (static_cast<SimT>(i) + 0.5) / static_cast<SimT>(segmentCount);
+        this->travelTime += segmentLength / this->getWaveSpeed(position);
+    }
+    this->endWaveSpeed = this->getWaveSpeed(1.0);
+    this->endDensity = this->getDensity(1.0);
+    this->wallLossFilter.design(this->simulation.samplingRate,
+        this->wallLoss ? WallLossFilter::getAttenuation(*this) : 0.0,
+        0.25 / (this->travelTime + this->getEndCorrectionTime()));
+
+    // a wave is cut at an end a sample after it has crossed it, so a round trip is 2 L + 2 samples
+    // for a length of L samples;
+    // with L of a whole and a half samples and the waves of the cylinder a quarter of a sample in,
+    // the straddling lengths are a quarter and three quarters of a sample in turns, far from the
+    // sample boundaries, so that every round trip is the same;
+    // the reflection of the open end is g samples early, see DelayLinePipe, and the wall loss filter
+    // is late by its latency and its delay;
+    // the fractional delay takes the rest of the round trip, which is over an odd count of samples
+    const SimT samplingRate = this->simulation.samplingRate;
+    const SimT radiationGain = this->getEndCorrectionTime() * samplingRate;
+    const SimT filterDelay = this->wallLoss ?
+        static_cast<SimT>(WallLossFilter::latency) + this->wallLossFilter.getDelay() : 0.0;
+    const SimT roundTrip =
+        2.0 * (this->travelTime + this->getEndCorrectionTime()) * samplingRate + radiationGain - filterDelay;
+    const SimT halfCount = std::max<SimT>(1.0, std::floor(0.5 *
+        (roundTrip - FractionalDelay::getMinDelay(this->fractionalDelayOrder) - 1.0)));
+    this->fractionalDelay.design(this->fractionalDelayOrder, roundTrip - (2.0 * halfCount + 1.0));
+    this->pipeLength = Wave::getLength(halfCount - 0.5, 1.0 / samplingRate);
+}
+
+void Pipe::saveState(SnapshotWriter& writer) const
+{
+    writer.writeSize(this->echoIterations);
+    writer.writeSize(this->echoLimit);
+    writer.write(this->pipeLengthPhysical);
+    writer.write(this->pipeLength);
+    writer.write(this->pipeRadius);
+    writer.writeVector(this->temperatures);
+    writer.write(this->wallLoss);
+    writer.writeVector(this->wallLossStates);
+    writer.writeSize(this->fractionalDelayOrder);
+    writer.writeVector(this->fractionalDelayStates);
+    writer.writeVector(this->sideBranches);
+    writer.writeVector(this->waveEnergies);
+
+    // the radiated waves are cleared after every progress, so only the pipe waves have state
+    writer.writeSize(this->pipeWaves.size());
+    for(const auto& wave : this->pipeWaves)
+    {
+        writer.write(wave.position);
+        writer.write(wave.leftToRightDirection);
+        writer.writeVector(wave.samples);
+    }
+}
+
+bool Pipe::loadState(SnapshotReader& reader)
+{
+    reader.readSize(this->echoIterations);
+    reader.readSize(this->echoLimit);
+    reader.read(this->pipeLengthPhysical);
+    reader.read(this->pipeLength);
+    reader.read(this->pipeRadius);
+    reader.readVector(this->temperatures);
+    reader.read(this->wallLoss);
+    reader.readVector(this->wallLossStates);
+    reader.readSize(this->fractionalDelayOrder);
+    reader.readVector(this->fractionalDelayStates);
+    reader.readVector(this->sideBranches);
+    reader.readVector(this->waveEnergies);
+    if(this->echoIterations == 0 || this->echoLimit == 0 ||
+        this->fractionalDelayOrder > FractionalDelay::maxOrder ||
+        !std::all_of(this->sideBranches.begin(), this->sideBranches.end(),
+            [](const SideBranch& sideBranch) { return sideBranch.isValid(); }) ||
+        this->pipeLengthPhysical <= 0.0 || this->pipeRadius <= 0.0 ||
+        std::any_of(this->temperatures.begin(), this->temperatures.end(),
+            [](const SimT temperature) { return !(temperature > -zeroCelsius); }))
+        reader.fail();
+    else
+        this->fitLength();
+
+    this->clearRadiatedWaves();
+    this->pipeWaves.clear();
+
+    size_t waveCount = 0;
+    reader.readSize(waveCount);
+    for(size_t i = 0; i < waveCount && reader.isValid(); i++)
+    {
+        Wave wave{this->simulation};
+        reader.read(wave.position);
+        reader.read(wave.leftToRightDirection);
+        reader.readVector(wave.samples);
+        this->pipeWaves.push_back(std::move(wave));
+    }
+    // every wave has its energy for the pruning
+    if(this->waveEnergies.size() < this->pipeWaves.size())
+        reader.fail();
+
+    return reader.isValid();
 }
\ No newline at end of file
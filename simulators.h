@@ -1,20 +1,57 @@
 #pragma once
 #include "wave.h"
+#include "excitation.h"
+#include "ramp.h"
+#include "wallloss.h"
+#include "fractionaldelay.h"
+#include "sidebranch.h"
 #include <vector>
 #include <list>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
 
 class Simulation;
+class SnapshotWriter;
+class SnapshotReader;
 
 constexpr SimT atmPressure = 101325.0;
 constexpr SimT airDensity = 1.225; // at 15 c
 //constexpr SimT airAdiabaticFactor = 1.4;
 constexpr SimT endCorrectionFactor = 0.6;
 
-// creates the initial sound wave
+// density at the temperature in celsius, which falls with the absolute temperature at the
+// atmospheric pressure
+inline SimT getAirDensity(const SimT temperature)
+{ return airDensity * (referenceTemperature + zeroCelsius) / (temperature + zeroCelsius); }
+constexpr SimT airViscosity = 1.789e-5; // at 15 c
+// dynamic viscosity at the temperature in celsius by the law of sutherland
+inline SimT getAirViscosity(const SimT temperature)
+{
+    constexpr SimT sutherlandTemperature = 110.4;
+    const SimT ratio = (temperature + zeroCelsius) / (referenceTemperature + zeroCelsius);
+    return airViscosity * ratio * std::sqrt(ratio) * (referenceTemperature + zeroCelsius + sutherlandTemperature) /
+        (temperature + zeroCelsius + sutherlandTemperature);
+}
+
+// creates the initial sound wave;
+// either a sine or the exhaust pulses of an excitation shape
 class Cylinder
 {
 public:
     static constexpr SimT startFrequency = 500.0;
+    // avg peak sound pressure level amplitude in conversations
+    static constexpr SimT conversationAmplitude = 0.02f;
+    // change of the blowdown per back pressure at the valves in relation to the amplitude;
+    // a low pressure at the open valves scavenges the cylinder, which makes the next cycle stronger
+    static constexpr SimT scavengingGain = 0.5;
+    static constexpr SimT minScavenging = 0.5, maxScavenging = 1.5;
+
+    // the controls that ramp per sample
+    struct Controls
+    {
+        ParameterRamp frequency{startFrequency}, load{0.5};
+    };
 public:
     // wave that has been generated between oldSampleCount and newSampleCount
     Wave currentOutWave;
@@ -24,18 +61,105 @@ public:
     void start();
     void stop();
     void restart();
-    void setFrequency(const SimT newFrequency) { this->frequency = newFrequency; }
-    SimT getFrequency() const { return this->frequency; }
+    bool isRunning() const { return this->running; }
+    // the frequency and the load are set per sample, the setters jump and the ramps move from
+    // the current value to the target over the duration;
+    // the ramps are timed in seconds, so they keep the same pace at any sampling rate
+    void setFrequency(const SimT newFrequency) { this->controls.frequency.setValue(newFrequency); }
+    void rampFrequency(const SimT target, const SimT duration,
+        const ParameterRamp::Shape shape = ParameterRamp::Shape::Exponential)
+    {
+        this->controls.frequency.rampTo(target, duration, shape);
+    }
+    SimT getFrequency() const { return this->controls.frequency.getValue(); }
     void setAmplitude(const SimT newAmplitude);
+    // the fast oscillator rotates a phasor instead of calling sin for every sample;
+    // the phasor is restarted from the exact phase at every progress, so switching is seamless
+    void setFastOscillator(const bool fast) { this->fastOscillator = fast; }
+    bool isFastOscillator() const { return this->fastOscillator; }
+    // phase of the oscillator in radians, for handing the sound over to another simulation
+    SimT getPhase() const { return this->counter; }
+    void setPhase(const SimT phase) { this->counter = phase; }
+    // the next progress starts at the full level instead of the start smoothing
+    void skipStartSmoothing();
+
+    // plays the pulses of the shape instead of the sine, nullptr goes back to the sine;
+    // with the pulses the frequency is the rate of the engine cycles, rpm / 120, and the fast
+    // oscillator doesn't apply;
+    // the tables of the shape are built on the first use of it, also the ones of the lower rates
+    // of the detail tiers unless the simulation is a detail copy
+    void setExcitation(const ExcitationShape* shape);
+    // plays the excitation of the other cylinder with the table of the rate of this one, which
+    // the other one has built ahead if this is a detail copy of its simulation
+    void shareExcitation(const Cylinder& other);
+    const ExcitationShape* getExcitation() const { return this->excitation ? &this->excitation->shape : nullptr; }
+    // load in range [0, 1], the level of the blowdown
+    void setLoad(const SimT load) { this->controls.load.setValue(load); }
+    void rampLoad(const SimT target, const SimT duration,
+        const ParameterRamp::Shape shape = ParameterRamp::Shape::Linear)
+    {
+        this->controls.load.rampTo(target, duration, shape);
+    }
+    SimT getLoad() const { return this->controls.load.getValue(); }
+    // the state of the ramps, for rendering the same controls in another simulation
+    const Controls& getControls() const { return this->controls; }
+    void setControls(const Controls& controls) { this->controls = controls; }
+    // moves the ramps over the samples without rendering them
+    void advanceControls(const size_t sampleCount);
+    void setExcitationVariation(const ExcitationVariation& variation) { this->variation = variation; }
+    const ExcitationVariation& getExcitationVariation() const { return this->variation; }
+    // engines that play together need seeds of their own so that they don't vary in unison
+    void seedExcitation(const uint32_t seed) { this->noise.seed(seed); }
+
+    // the echo and delay line engines reflect the returning waves at the valves instead of
+    // the closed end and put the pressure at the valves back on the cylinder, which scales the
+    // blowdown of the next cycle;
+    // only the pulses have valves, the sine keeps the closed end
+    void setValveCoupling(const bool coupling) { this->valveCoupling = coupling; }
+    bool isValveCoupling() const { return this->valveCoupling; }
+    // reflection of the closed end per sample of the last progress, empty for a closed end
+    const Wave::SampleContainer& getValveReflections() const { return this->valveReflections; }
+    // pressure at the closed end, added to by the engines per sample of the last progress
+    SimT* getBackPressures() { return this->backPressures.data(); }
 
     void progressSimulation(SimT oldSampleCount, SimT newSampleCount);
+
+    // state and parameters for the snapshots of Simulation
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
 private:
     Simulation& simulation;
     SimT sampleCountStartPosition = 0.0, sampleCountStopPosition = 0.0;
     bool running = true, _restart = false;
+    bool fastOscillator = false;
     
-    SimT frequency = startFrequency, counter = 0.0;
+    Controls controls;
+    SimT counter = 0.0;
     SimT amplitude = 0.02;
+    // per sample frequencies of the progress turned to steps of the counter, and the loads
+    Wave::SampleContainer steps, loads;
+    // rotation of the fast oscillator per sample
+    Wave::SampleContainer stepSines, stepCosineDeltas;
+
+    std::shared_ptr<const ExcitationTable> excitation;
+    // tables of the same shape at the rates of the detail copies
+    std::vector<std::shared_ptr<const ExcitationTable>> detailExcitations;
+    ExcitationVariation variation;
+    NoiseGenerator noise;
+    Wave::SampleContainer noiseSamples;
+    // the level is ramped from the cycle to the next over a cycle, so the variation doesn't click;
+    // the period scales the step of the current cycle
+    SimT cycleLevel = 1.0, nextCycleLevel = 1.0, cyclePeriod = 1.0;
+    SimT cycleCount = 0.0;
+
+    bool valveCoupling = false;
+    Wave::SampleContainer valveReflections, backPressures;
+    // back pressure at the open valves weighted by their transmission, since the last cycle
+    SimT scavengingSum = 0.0, scavengingWeight = 0.0;
+
+    void renderSteps(const size_t sampleCount);
+    void renderSine(const size_t sampleCount);
+    void renderPulses(const size_t sampleCount);
 };
 
 
@@ -45,13 +169,17 @@ private:
 
 
 // closed-open pipe that reflects some of the wave;
-// left side is closed
+// left side is closed, or the valves of the cylinder with the valve coupling
 class Pipe
 {
 public:
     static constexpr size_t startEchoIterations = 100;
     static constexpr SimT startPipeLengthPhysicalCm = 50;
     static constexpr SimT startPipeRadiusCm = 1;
+    // with the wall losses the echoes are pruned under this energy in relation to the energy from
+    // the cylinder, and under the threshold of hearing when the cylinder is silent
+    static constexpr SimT pruneEnergyRatio = 1e-6;
+    static constexpr SimT minPruneEnergy = 20e-6 * 20e-6;
 public:
     std::vector<Wave> radiatedWaves;
     std::list<Wave> pipeWaves; // list used for lax iterator invalidation rules
@@ -60,10 +188,52 @@ public:
 
     void setEchoIterationsAndReset(const size_t echoIterations);
     size_t getEchoIterations() const { return this->echoIterations; }
+    // caps the echo iterations without a reset, the waves over the limit are pruned;
+    // the other engines still read their loss from the echo iterations
+    void setEchoLimit(const size_t echoLimit);
+    size_t getActiveEchoIterations() const { return std::min(this->echoIterations, this->echoLimit); }
     void setPipePhysicalLengthAndReset(const SimT pipeLengthPhysical);
     SimT getPipePhysicalLength() const { return this->pipeLengthPhysical; }
     void setPipeRadiusAndReset(const SimT pipeRadius);
     SimT getPipeRadius() const { return this->pipeRadius; }
+    // temperatures in celsius of segments of equal length from the closed end to the open end,
+    // e.g. of the exhaust gas that cools along the pipe;
+    // empty is the reference temperature everywhere;
+    // the temperatures change without a reset, the engines refit their coefficients to the
+    // speeds of sound and the densities of the segments at the next progress;
+    // the echo, modal and delay line engines take the travel time through the segments and the
+    // radiation at the open end, only the horn engine reflects at the changes of the impedance
+    // between them
+    void setTemperatures(const std::vector<SimT>& temperatures);
+    const std::vector<SimT>& getTemperatures() const { return this->temperatures; }
+    // of the segment at relative position in [0, 1] along the pipe from the closed end
+    SimT getTemperature(const SimT position) const;
+    SimT getWaveSpeed(const SimT position) const { return ::getWaveSpeed(this->getTemperature(position)); }
+    SimT getDensity(const SimT position) const { return getAirDensity(this->getTemperature(position)); }
+    // time of the sound from the closed end to the open end, without the end correction
+    SimT getTravelTime() const { return this->travelTime; }
+    // time of the sound from the closed end to the relative position
+    SimT getTravelTime(const SimT position) const;
+    // time of the sound over the end correction, which is at the temperature of the open end
+    SimT getEndCorrectionTime() const { return endCorrectionFactor * this->pipeRadius / this->endWaveSpeed; }
+    // viscothermal losses of the walls, filtered from the waves once per round trip at the open end;
+    // the damped echoes are pruned once their energy falls under the threshold, so the echo count
+    // follows the damping up to the echo limit;
+    // switched without a reset, the filters of the waves start from silence
+    void setWallLoss(const bool wallLoss);
+    bool isWallLoss() const { return this->wallLoss; }
+    // designed for the geometry and the temperatures, a pass through while the losses are off
+    const WallLossFilter& getWallLossFilter() const { return this->wallLossFilter; }
+    // order of the lagrange interpolation of the fractions of a sample in the round trip, which makes
+    // the length continuous; 0 rounds the round trip to whole samples;
+    // changed without a reset, the fractional delays of the waves start from silence
+    void setFractionalDelayOrder(const size_t order);
+    size_t getFractionalDelayOrder() const { return this->fractionalDelayOrder; }
+    // resonators and side branches at junctions along the pipe, see DelayLinePipe;
+    // only the delay line engine has the junctions, the others leave the branches out;
+    // changed without a reset, the delay line engine restarts from silence
+    void setSideBranches(const std::vector<SideBranch>& sideBranches);
+    const std::vector<SideBranch>& getSideBranches() const { return this->sideBranches; }
 
     // sums radiated waves with atmospheric pressure
     Wave sumRadiatedWaves(const size_t sampleCount) const;
@@ -71,22 +241,50 @@ public:
 
     void progressSimulation(
         const SimT oldSampleCount, const SimT newSampleCount, const SimT deltaSampleCount);
+
+    void reset();
+
+    // state and parameters for the snapshots of Simulation
+    void saveState(SnapshotWriter& writer) const;
+    bool loadState(SnapshotReader& reader);
 private:
     Simulation& simulation;
     Cylinder& cylinder;
     size_t radiatedSampleCount = 0;
     size_t echoIterations = startEchoIterations;
+    size_t echoLimit = SIZE_MAX;
 
     SimT pipeLengthPhysical;
+    // length at the reference temperature that the waves move in whole and a half samples, the
+    // rest of the travel time is in the fractional delay; the waves move at the reference speed
     SimT pipeLength;
     SimT pipeRadius;
+    std::vector<SimT> temperatures;
+    SimT travelTime = 0.0;
+    SimT endWaveSpeed = waveSpeed, endDensity = airDensity;
+    bool wallLoss = false;
+    WallLossFilter wallLossFilter;
+    // of the pipe waves in their order, the filter of a wave takes the samples that it reflects at
+    // the open end
+    std::vector<WallLossFilter::State> wallLossStates;
+    size_t fractionalDelayOrder = FractionalDelay::startOrder;
+    // of the round trip, taken at the open end like the wall losses
+    FractionalDelay fractionalDelay;
+    std::vector<FractionalDelay::State> fractionalDelayStates;
+    std::vector<SideBranch> sideBranches;
+    // mean square of the samples that came to the pipe waves in the last progress
+    std::vector<SimT> waveEnergies;
 
-    void progressPipeWave(const std::list<Wave>::iterator waveIt);
+    // travel time and length of the geometry and the temperatures
+    void fitLength();
+    // the index is the order of the wave in the pipe waves
+    void progressPipeWave(const std::list<Wave>::iterator waveIt, const size_t index);
     void prunePipeWaves();
+    void setWaveEnergy(const size_t index, const Wave::SampleContainer& samples);
     std::pair<Wave, Wave> splitToRadiatedAndReflectedWaves(const Wave& wave) const;
+    // reflects the samples that arrived at the closed end during the progress at the valves
+    void reflectAtValves(Wave::SampleContainer& samples);
     // adds wave to slot indicated by pos
     void addRadiatedWave(Wave&& radiatedWave);
     void addPipeWave(Wave&& pipeWave, const std::list<Wave>::iterator pos);
-
-    void reset();
 };
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+// binary encoding of the snapshots of the simulation state;
+// the values are stored in the byte order of the machine without padding, so the snapshots
+// are for restoring on the same architecture;
+// sizes are stored as 64 bit, vectors as a 64 bit element count followed by the elements
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(std::vector<uint8_t>& data) : data(data) {}
+
+    template<typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        this->append(&value, sizeof(T));
+    }
+
+    void writeSize(const size_t size)
+    {
+        this->write(size == SIZE_MAX ? UINT64_MAX : static_cast<uint64_t>(size));
+    }
+
+    template<typename T>
+    void writeVector(const std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        this->writeSize(values.size());
+        this->append(values.data(), values.size() * sizeof(T));
+    }
+private:
+    std::vector<uint8_t>& data;
+
+    void append(const void* bytes, const size_t size)
+    {
+        const size_t offset = this->data.size();
+        this->data.resize(offset + size);
+        if(size)
+            std::memcpy(this->data.data() + offset, bytes, size);
+    }
+};
+
+// reading past the end fails the reader and leaves the values as they were;
+// the reads after a failure fail too, so the result can be checked once at the end
+class SnapshotReader
+{
+public:
+    SnapshotReader(const uint8_t* data, const size_t size) : data(data), size(size) {}
+
+    template<typename T>
+    bool read(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        // any other byte than 0 or 1 would be undefined as a bool
+        if constexpr(std::is_same_v<T, bool>)
+        {
+            uint8_t byte = 0;
+            if(!this->read(byte) || byte > 1)
+                return this->fail();
+            value = byte != 0;
+            return true;
+        }
+        else
+            return this->extract(&value, sizeof(T));
+    }
+
+    // the largest size stands for SIZE_MAX, the unlimited caps
+    bool readSize(size_t& size)
+    {
+        uint64_t value = 0;
+        if(!this->read(value))
+            return false;
+        if(value != UINT64_MAX && value > SIZE_MAX)
+            return this->fail();
+
+        size = value == UINT64_MAX ? SIZE_MAX : static_cast<size_t>(value);
+        return true;
+    }
+
+    template<typename T>
+    bool readVector(std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<T> && !std::is_same_v<T, bool>);
+
+        uint64_t count = 0;
+        if(!this->read(count) || count > (this->size - this->position) / sizeof(T))
+            return this->fail();
+
+        values.resize(static_cast<size_t>(count));
+        return this->extract(values.data(), values.size() * sizeof(T));
+    }
+
+    bool isValid() const { return !this->failed; }
+    bool isAtEnd() const { return this->position == this->size; }
+    // marks the snapshot invalid, for the checks of the restored values
+    bool fail()
+    {
+        this->failed = true;
+        return false;
+    }
+private:
+    const uint8_t* data;
+    size_t size, position = 0;
+    bool failed = false;
+
+    bool extract(void* bytes, const size_t size)
+    {
+        if(this->failed || size > this->size - this->position)
+            return this->fail();
+
+        if(size)
+            std::memcpy(bytes, this->data + this->position, size);
+        this->position += size;
+        return true;
+    }
+};
\ No newline at end of file
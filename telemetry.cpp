@@ -0,0 +1,267 @@
+#include "telemetry.h"
+#include <bit>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+
+uint64_t HistogramSnapshot::getPercentile(const SimT percentile) const
+{
+    if(this->count == 0)
+        return 0;
+
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(
+        std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<SimT>(this->count) + 0.5));
+
+    uint64_t accumulated = 0;
+    for(size_t i = 0; i < this->counts.size(); i++)
+    {
+        accumulated += this->counts[i];
+        if(accumulated >= rank)
+            return std::clamp(Histogram::getBucketValue(i), this->min, this->max);
+    }
+
+    return this->max;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+Histogram::Histogram()
+{
+    this->reset();
+}
+
+size_t Histogram::getBucketIndex(const uint64_t value)
+{
+    // the first sub bucket count values are exact
+    if(value < subBucketCount)
+        return static_cast<size_t>(value);
+
+    // each following power of two range is split into subBucketHalfCount linear buckets
+    const unsigned magnitude = static_cast<unsigned>(std::bit_width(value)) - subBucketBits;
+    const uint64_t subBucket = (value >> magnitude) - subBucketHalfCount;
+    return static_cast<size_t>(subBucketCount + (magnitude - 1) * subBucketHalfCount + subBucket);
+}
+
+uint64_t Histogram::getBucketValue(const size_t index)
+{
+    if(index < subBucketCount)
+        return index;
+
+    const unsigned magnitude = static_cast<unsigned>((index - subBucketCount) / subBucketHalfCount) + 1;
+    const uint64_t subBucket = (index - subBucketCount) % subBucketHalfCount + subBucketHalfCount;
+    return (subBucket << magnitude) + ((1ull << magnitude) >> 1);
+}
+
+void Histogram::record(const uint64_t value)
+{
+    // single writer, so plain loads and stores are enough and no locked instructions are needed
+    constexpr auto order = std::memory_order_relaxed;
+    std::atomic<uint64_t>& bucket = this->counts[getBucketIndex(value)];
+    bucket.store(bucket.load(order) + 1, order);
+    this->sum.store(this->sum.load(order) + value, order);
+    if(value < this->min.load(order))
+        this->min.store(value, order);
+    if(value > this->max.load(order))
+        this->max.store(value, order);
+    // published last so that a reader doesn't see a count without a value
+    this->count.store(this->count.load(order) + 1, std::memory_order_release);
+}
+
+void Histogram::reset()
+{
+    for(auto& count : this->counts)
+        count.store(0, std::memory_order_relaxed);
+    this->count = 0;
+    this->sum = 0;
+    this->min = UINT64_MAX;
+    this->max = 0;
+}
+
+HistogramSnapshot Histogram::getSnapshot() const
+{
+    constexpr auto order = std::memory_order_relaxed;
+
+    HistogramSnapshot snapshot;
+    snapshot.count = this->count.load(std::memory_order_acquire);
+    snapshot.sum = this->sum.load(order);
+    snapshot.min = snapshot.count ? this->min.load(order) : 0;
+    snapshot.max = this->max.load(order);
+    snapshot.counts.resize(bucketCount);
+    for(size_t i = 0; i < bucketCount; i++)
+        snapshot.counts[i] = this->counts[i].load(order);
+
+    return snapshot;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+namespace
+{
+
+void printHistogramText(
+    std::ostream& stream, const char* name, const HistogramSnapshot& histogram, const SimT scale,
+    const char* unit)
+{
+    stream << name << ": mean " << histogram.getMean() * scale <<
+        ", p50 " << histogram.getPercentile(50.0) * scale <<
+        ", p99 " << histogram.getPercentile(99.0) * scale <<
+        ", p99.9 " << histogram.getPercentile(99.9) * scale <<
+        ", max " << histogram.max * scale << " " << unit << std::endl;
+}
+
+void printHistogramJson(std::ostream& stream, const char* name, const HistogramSnapshot& histogram)
+{
+    stream << "\"" << name << "\":{\"count\":" << histogram.count <<
+        ",\"mean\":" << histogram.getMean() <<
+        ",\"min\":" << histogram.min <<
+        ",\"p50\":" << histogram.getPercentile(50.0) <<
+        ",\"p90\":" << histogram.getPercentile(90.0) <<
+        ",\"p99\":" << histogram.getPercentile(99.0) <<
+        ",\"p999\":" << histogram.getPercentile(99.9) <<
+        ",\"max\":" << histogram.max << "}";
+}
+
+}
+
+SimT TelemetrySnapshot::getRealtimeFactor() const
+{
+    return this->renderTime.sum ?
+        static_cast<SimT>(this->deadline.sum) / static_cast<SimT>(this->renderTime.sum) : 0.0;
+}
+
+void TelemetrySnapshot::printText(std::ostream& stream) const
+{
+    constexpr SimT nsToMs = 1e-6;
+
+    stream << "blocks: " << this->blockCount <<
+        ", deadline misses: " << this->deadlineMissCount <<
+        ", underruns: " << this->underrunCount <<
+        ", realtime factor: " << this->getRealtimeFactor() << std::endl;
+    printHistogramText(stream, "render time", this->renderTime, nsToMs, "ms");
+    printHistogramText(stream, "deadline", this->deadline, nsToMs, "ms");
+    printHistogramText(stream, "headroom", this->headroom, nsToMs, "ms");
+    printHistogramText(stream, "pipe waves", this->pipeWaveCount, 1.0, "");
+    printHistogramText(stream, "radiated waves", this->radiatedWaveCount, 1.0, "");
+}
+
+void TelemetrySnapshot::printJson(std::ostream& stream) const
+{
+    stream << "{\"blocks\":" << this->blockCount <<
+        ",\"deadlineMisses\":" << this->deadlineMissCount <<
+        ",\"underruns\":" << this->underrunCount <<
+        ",\"realtimeFactor\":" << this->getRealtimeFactor() << ",";
+    printHistogramJson(stream, "renderTimeNs", this->renderTime);
+    stream << ",";
+    printHistogramJson(stream, "deadlineNs", this->deadline);
+    stream << ",";
+    printHistogramJson(stream, "headroomNs", this->headroom);
+    stream << ",";
+    printHistogramJson(stream, "pipeWaves", this->pipeWaveCount);
+    stream << ",";
+    printHistogramJson(stream, "radiatedWaves", this->radiatedWaveCount);
+    stream << "}" << std::endl;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+void BlockTelemetry::recordBlock(const uint64_t renderTimeNs, const uint64_t deadlineNs,
+    const size_t pipeWaveCount, const size_t radiatedWaveCount)
+{
+    this->renderTime.record(renderTimeNs);
+    this->deadline.record(deadlineNs);
+    this->headroom.record(deadlineNs > renderTimeNs ? deadlineNs - renderTimeNs : 0);
+    this->pipeWaveCount.record(pipeWaveCount);
+    this->radiatedWaveCount.record(radiatedWaveCount);
+
+    constexpr auto order = std::memory_order_relaxed;
+    if(renderTimeNs > deadlineNs)
+        this->deadlineMissCount.store(this->deadlineMissCount.load(order) + 1, order);
+    this->blockCount.store(this->blockCount.load(order) + 1, std::memory_order_release);
+}
+
+TelemetrySnapshot BlockTelemetry::getSnapshot() const
+{
+    TelemetrySnapshot snapshot;
+    snapshot.blockCount = this->blockCount.load(std::memory_order_acquire);
+    snapshot.deadlineMissCount = this->deadlineMissCount.load(std::memory_order_relaxed);
+    snapshot.underrunCount = this->underrunCount.load(std::memory_order_relaxed);
+    snapshot.renderTime = this->renderTime.getSnapshot();
+    snapshot.deadline = this->deadline.getSnapshot();
+    snapshot.headroom = this->headroom.getSnapshot();
+    snapshot.pipeWaveCount = this->pipeWaveCount.getSnapshot();
+    snapshot.radiatedWaveCount = this->radiatedWaveCount.getSnapshot();
+
+    return snapshot;
+}
+
+void BlockTelemetry::reset()
+{
+    this->renderTime.reset();
+    this->deadline.reset();
+    this->headroom.reset();
+    this->pipeWaveCount.reset();
+    this->radiatedWaveCount.reset();
+    this->blockCount = 0;
+    this->deadlineMissCount = 0;
+    this->underrunCount = 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+TelemetryDumper::TelemetryDumper(const BlockTelemetry& telemetry, std::ostream& stream,
+    const SimT interval, const Format format) :
+    telemetry(telemetry),
+    stream(stream),
+    interval(interval),
+    format(format)
+{
+    assert(interval > 0.0);
+    this->thread = std::thread {&TelemetryDumper::threadEntryPoint, this};
+}
+
+TelemetryDumper::~TelemetryDumper()
+{
+    {
+        std::lock_guard lock(this->mutex);
+        this->stopping = true;
+    }
+    this->stopCondition.notify_one();
+    this->thread.join();
+
+    this->dump();
+}
+
+void TelemetryDumper::dump()
+{
+    const TelemetrySnapshot snapshot = this->telemetry.getSnapshot();
+    if(this->format == Format::Json)
+        snapshot.printJson(this->stream);
+    else
+        snapshot.printText(this->stream);
+}
+
+void TelemetryDumper::threadEntryPoint()
+{
+    std::unique_lock lock(this->mutex);
+    while(!this->stopCondition.wait_for(lock, std::chrono::duration<SimT>(this->interval),
+        [this] { return this->stopping; }))
+    {
+        this->dump();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+#include "wave.h"
+#include <atomic>
+#include <vector>
+#include <array>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include <cstdint>
+
+// copy of a histogram at some point in time
+struct HistogramSnapshot
+{
+    std::vector<uint64_t> counts;
+    uint64_t count = 0, sum = 0, min = 0, max = 0;
+
+    SimT getMean() const { return this->count ? static_cast<SimT>(this->sum) / this->count : 0.0; }
+    // percentile in range [0, 100];
+    // the result is within the precision of the bucket
+    uint64_t getPercentile(const SimT percentile) const;
+};
+
+// hdr style histogram of non negative integers with a log-linear bucket layout;
+// the relative error of a recorded value is at most 1 / subBucketHalfCount;
+// recording is lock free and wait free for a single writer, snapshots can be taken from any thread
+class Histogram
+{
+public:
+    static constexpr unsigned subBucketBits = 6;
+    static constexpr uint64_t subBucketCount = 1ull << subBucketBits;
+    static constexpr uint64_t subBucketHalfCount = subBucketCount / 2;
+    static constexpr size_t bucketCount = subBucketCount + (64 - subBucketBits) * subBucketHalfCount;
+public:
+    Histogram();
+
+    void record(const uint64_t value);
+    void reset();
+    HistogramSnapshot getSnapshot() const;
+
+    static size_t getBucketIndex(const uint64_t value);
+    // middle of the range of values that fall in the bucket
+    static uint64_t getBucketValue(const size_t index);
+private:
+    std::array<std::atomic<uint64_t>, bucketCount> counts;
+    std::atomic<uint64_t> count, sum, min, max;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+struct TelemetrySnapshot
+{
+    // nanoseconds
+    HistogramSnapshot renderTime, deadline, headroom;
+    // per block
+    HistogramSnapshot pipeWaveCount, radiatedWaveCount;
+    uint64_t blockCount = 0;
+    // blocks that took longer to render than their duration
+    uint64_t deadlineMissCount = 0;
+    // underruns reported by the audio device
+    uint64_t underrunCount = 0;
+
+    // rendered duration in relation to the render time;
+    // has to stay above 1 for realtime output
+    SimT getRealtimeFactor() const;
+
+    void printText(std::ostream& stream) const;
+    void printJson(std::ostream& stream) const;
+};
+
+// per block render telemetry of the render thread;
+// the render thread is the only writer
+class BlockTelemetry
+{
+public:
+    // deadline is the duration of the block
+    void recordBlock(const uint64_t renderTimeNs, const uint64_t deadlineNs,
+        const size_t pipeWaveCount, const size_t radiatedWaveCount);
+    void setUnderrunCount(const uint64_t underrunCount) { this->underrunCount = underrunCount; }
+
+    TelemetrySnapshot getSnapshot() const;
+    void reset();
+private:
+    Histogram renderTime, deadline, headroom;
+    Histogram pipeWaveCount, radiatedWaveCount;
+    std::atomic<uint64_t> blockCount = 0, deadlineMissCount = 0, underrunCount = 0;
+};
+
+// prints telemetry snapshots periodically from its own thread
+class TelemetryDumper
+{
+public:
+    enum class Format { Text, Json };
+public:
+    TelemetryDumper(const BlockTelemetry& telemetry, std::ostream& stream,
+        const SimT interval, const Format format);
+    // prints the last snapshot
+    ~TelemetryDumper();
+private:
+    const BlockTelemetry& telemetry;
+    std::ostream& stream;
+    const SimT interval;
+    const Format format;
+
+    std::mutex mutex;
+    std::condition_variable stopCondition;
+    bool stopping = false;
+    std::thread thread;
+
+    void dump();
+    void threadEntryPoint();
+};
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "trace.h"
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+
+namespace
+{
+
+uint64_t getSteadyClockNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+}
+
+TraceBuffer::TraceBuffer(const size_t capacity, const uint32_t threadId) :
+    events(capacity),
+    threadId(threadId)
+{
+    assert(capacity > 0);
+}
+
+void TraceBuffer::push(const TraceEvent& event)
+{
+    const size_t head = this->head.load(std::memory_order_relaxed);
+    const size_t next = (head + 1) % this->events.size();
+    if(next == this->tail.load(std::memory_order_acquire))
+    {
+        this->droppedCount.store(
+            this->droppedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    this->events[head] = event;
+    this->head.store(next, std::memory_order_release);
+}
+
+void TraceBuffer::reset(const uint32_t threadId)
+{
+    this->threadId = threadId;
+    this->head.store(0, std::memory_order_relaxed);
+    this->tail.store(0, std::memory_order_relaxed);
+    this->droppedCount.store(0, std::memory_order_relaxed);
+}
+
+void TraceBuffer::drain(std::vector<TraceEvent>& events)
+{
+    const size_t head = this->head.load(std::memory_order_acquire);
+    size_t tail = this->tail.load(std::memory_order_relaxed);
+    for(; tail != head; tail = (tail + 1) % this->events.size())
+        events.push_back(this->events[tail]);
+
+    this->tail.store(tail, std::memory_order_release);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+Tracer::Tracer() : epoch(getSteadyClockNs())
+{
+}
+
+Tracer& Tracer::get()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::reserveBuffers(const size_t count)
+{
+    std::lock_guard lock(this->mutex);
+    while(this->freeBuffers.size() < count)
+    {
+        this->buffers.push_back(std::make_unique<TraceBuffer>(bufferCapacity, 0));
+        this->freeBuffers.push_back(this->buffers.back().get());
+    }
+}
+
+TraceBuffer& Tracer::getThreadBuffer()
+{
+    // returns the ring when the thread exits
+    struct ThreadBuffer
+    {
+        TraceBuffer* buffer = nullptr;
+        ~ThreadBuffer()
+        {
+            if(this->buffer)
+                Tracer::get().releaseBuffer(*this->buffer);
+        }
+    };
+    thread_local ThreadBuffer threadBuffer;
+
+    if(!threadBuffer.buffer)
+    {
+        std::lock_guard lock(this->mutex);
+        if(this->freeBuffers.empty())
+        {
+            this->buffers.push_back(std::make_unique<TraceBuffer>(bufferCapacity, 0));
+            this->freeBuffers.push_back(this->buffers.back().get());
+        }
+        threadBuffer.buffer = this->freeBuffers.back();
+        this->freeBuffers.pop_back();
+        threadBuffer.buffer->reset(++this->threadCount);
+    }
+
+    return *threadBuffer.buffer;
+}
+
+void Tracer::releaseBuffer(TraceBuffer& buffer)
+{
+    // the spans of the thread are kept for the export
+    std::lock_guard lock(this->mutex);
+    RetiredSpans& spans = this->retiredSpans.emplace_back();
+    spans.threadId = buffer.getThreadId();
+    buffer.drain(spans.events);
+    spans.droppedCount = buffer.getDroppedCount();
+    this->freeBuffers.push_back(&buffer);
+}
+
+uint64_t Tracer::now() const
+{
+    return getSteadyClockNs() - this->epoch;
+}
+
+SimT Tracer::measureOverhead() const
+{
+    // same work as a scope, into a private ring so that the export isn't polluted
+    constexpr size_t spanCount = 100000;
+    TraceBuffer buffer{spanCount + 1, 0};
+
+    const uint64_t start = this->now();
+    for(size_t i = 0; i < spanCount; i++)
+    {
+        const uint64_t spanStart = this->now();
+        buffer.push(TraceEvent {"overhead", spanStart, this->now() - spanStart});
+    }
+
+    return static_cast<SimT>(this->now() - start) / spanCount;
+}
+
+void Tracer::exportChromeTrace(std::ostream& stream)
+{
+    const SimT overheadNs = this->measureOverhead();
+
+    std::lock_guard lock(this->mutex);
+
+    uint64_t spanCount = 0, droppedCount = 0;
+    std::vector<TraceEvent> events;
+
+    const auto flags = stream.flags();
+    const auto precision = stream.precision();
+    stream << std::fixed << std::setprecision(3);
+
+    stream << "{\"traceEvents\":[";
+    bool first = true;
+    const auto writeEvents = [&](const std::vector<TraceEvent>& threadEvents, const uint32_t threadId)
+    {
+        // chrome trace timestamps are in microseconds
+        spanCount += threadEvents.size();
+        for(const auto& event : threadEvents)
+        {
+            stream << (first ? "" : ",") << "\n{\"name\":\"" << event.name <<
+                "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadId <<
+                ",\"ts\":" << static_cast<SimT>(event.start) / 1000.0 <<
+                ",\"dur\":" << static_cast<SimT>(event.duration) / 1000.0 << "}";
+            first = false;
+        }
+    };
+    for(const auto& spans : this->retiredSpans)
+    {
+        droppedCount += spans.droppedCount;
+        writeEvents(spans.events, spans.threadId);
+    }
+    this->retiredSpans.clear();
+    // the free rings have been drained when they were returned
+    for(const auto& buffer : this->buffers)
+    {
+        if(std::find(this->freeBuffers.begin(), this->freeBuffers.end(), buffer.get()) != this->freeBuffers.end())
+            continue;
+        events.clear();
+        buffer->drain(events);
+        droppedCount += buffer->getDroppedCount();
+        writeEvents(events, buffer->getThreadId());
+    }
+
+    stream << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{" <<
+        "\"spans\":" << spanCount <<
+        ",\"droppedSpans\":" << droppedCount <<
+        ",\"overheadNsPerSpan\":" << overheadNs <<
+        ",\"estimatedOverheadMs\":" << overheadNs * static_cast<SimT>(spanCount) * 1e-6 <<
+        "}}" << std::endl;
+
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+TraceScope::~TraceScope()
+{
+    this->buffer.push(TraceEvent {this->name, this->start, Tracer::get().now() - this->start});
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+#include "wave.h"
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <cstdint>
+
+// scoped spans of the simulation stages, exported as chrome trace json
+// (chrome://tracing, ui.perfetto.dev);
+// compiled out unless ENGINE_SOUND_TRACING is defined
+#ifdef ENGINE_SOUND_TRACING
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+// name has to be a string literal
+#define TRACE_SCOPE(name) const TraceScope TRACE_CONCAT(traceScope, __LINE__) {name}
+// takes the ring of the calling thread ahead of its first span, at the start of a thread
+#define TRACE_THREAD() Tracer::get().getThreadBuffer()
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD() ((void)0)
+#endif
+
+struct TraceEvent
+{
+    const char* name;
+    // nanoseconds since the tracer was created
+    uint64_t start, duration;
+};
+
+// single producer single consumer ring of the spans of one thread;
+// the owning thread writes, the exporter reads;
+// spans are dropped when the ring is full
+class TraceBuffer
+{
+public:
+    TraceBuffer(const size_t capacity, const uint32_t threadId);
+
+    void push(const TraceEvent& event);
+    // moves the buffered spans to events
+    void drain(std::vector<TraceEvent>& events);
+
+    uint32_t getThreadId() const { return this->threadId; }
+    uint64_t getDroppedCount() const { return this->droppedCount; }
+    // hands a drained ring to another thread
+    void reset(const uint32_t threadId);
+private:
+    std::vector<TraceEvent> events;
+    uint32_t threadId;
+    std::atomic<size_t> head = 0, tail = 0;
+    std::atomic<uint64_t> droppedCount = 0;
+};
+
+class Tracer
+{
+public:
+    static constexpr size_t bufferCapacity = 1 << 18;
+public:
+    static Tracer& get();
+
+    // creates rings for the threads to come, so that the threads take them instead of allocating
+    // their own; the rings are written through once so that their pages are in memory
+    void reserveBuffers(const size_t count);
+    // the ring of the calling thread, taken from the reserved rings on first use or created when
+    // there are none left;
+    // the ring is drained and returned to the reserve when the thread exits
+    TraceBuffer& getThreadBuffer();
+    uint64_t now() const;
+
+    // time of an empty span in nanoseconds;
+    // measured in the calling thread
+    SimT measureOverhead() const;
+    // drains all the rings;
+    // the measured overhead is written to the metadata
+    void exportChromeTrace(std::ostream& stream);
+private:
+    // spans of a thread that has exited
+    struct RetiredSpans
+    {
+        uint32_t threadId;
+        std::vector<TraceEvent> events;
+        uint64_t droppedCount;
+    };
+
+    const uint64_t epoch;
+    std::mutex mutex;
+    // every ring, and the ones that no thread has
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::vector<TraceBuffer*> freeBuffers;
+    std::vector<RetiredSpans> retiredSpans;
+    uint32_t threadCount = 0;
+
+    Tracer();
+    void releaseBuffer(TraceBuffer& buffer);
+};
+
+class TraceScope
+{
+public:
+    // the ring is looked up first so that its creation isn't part of the span
+    explicit TraceScope(const char* name) :
+        buffer(Tracer::get().getThreadBuffer()), name(name), start(Tracer::get().now())
+    {
+    }
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+private:
+    TraceBuffer& buffer;
+    const char* name;
+    const uint64_t start;
+};
\ No newline at end of file
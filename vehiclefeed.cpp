@@ -0,0 +1,550 @@
+#include "vehiclefeed.h"
+#include "simulators.h"
+#include "trace.h"
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <numbers>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+#undef max
+#undef min
+#else
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+constexpr uintptr_t invalidSocket = INVALID_SOCKET;
+
+void closeSocket(const uintptr_t socket) { closesocket(static_cast<SOCKET>(socket)); }
+
+// winsock is started once for the process
+bool startSockets()
+{
+    static const bool started = []
+    {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+#else
+using SocketHandle = int;
+constexpr uintptr_t invalidSocket = static_cast<uintptr_t>(-1);
+
+void closeSocket(const uintptr_t socket) { ::close(static_cast<int>(socket)); }
+bool startSockets() { return true; }
+#endif
+
+// the sockets are kept as uintptr_t outside of this file, which fits the handles of both
+SocketHandle getHandle(const uintptr_t socket) { return static_cast<SocketHandle>(socket); }
+
+uintptr_t openSocket()
+{
+    if(!startSockets())
+        return invalidSocket;
+
+    const auto handle = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#ifdef _WIN32
+    return handle == INVALID_SOCKET ? invalidSocket : static_cast<uintptr_t>(handle);
+#else
+    return handle < 0 ? invalidSocket : static_cast<uintptr_t>(handle);
+#endif
+}
+
+sockaddr_in getAddress(const uint16_t port, const bool anyInterface)
+{
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(anyInterface ? INADDR_ANY : INADDR_LOOPBACK);
+    return address;
+}
+
+uint64_t getTimeNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+}
+
+size_t PacketField::getSize() const
+{
+    switch(this->type)
+    {
+    case Type::F32: return 4;
+    case Type::F64: return 8;
+    case Type::U8: return 1;
+    case Type::U16: return 2;
+    case Type::U32: return 4;
+    case Type::I16: return 2;
+    case Type::I32: return 4;
+    }
+
+    return 0;
+}
+
+SimT PacketField::read(const uint8_t* packet) const
+{
+    // the bytes are put in the order of the machine first, which is assumed little endian
+    uint8_t bytes[8];
+    const size_t size = this->getSize();
+    std::memcpy(bytes, packet + this->offset, size);
+    if(this->bigEndian)
+        std::reverse(bytes, bytes + size);
+
+    const auto get = [&bytes]<typename T>(T value)
+    {
+        std::memcpy(&value, bytes, sizeof(T));
+        return static_cast<SimT>(value);
+    };
+    SimT value = 0.0;
+    switch(this->type)
+    {
+    case Type::F32: value = get(float{}); break;
+    case Type::F64: value = get(double{}); break;
+    case Type::U8: value = get(uint8_t{}); break;
+    case Type::U16: value = get(uint16_t{}); break;
+    case Type::U32: value = get(uint32_t{}); break;
+    case Type::I16: value = get(int16_t{}); break;
+    case Type::I32: value = get(int32_t{}); break;
+    }
+
+    return value * this->scale;
+}
+
+void PacketField::write(uint8_t* packet, const SimT value) const
+{
+    uint8_t bytes[8];
+    const auto put = [&bytes]<typename T>(const T value) { std::memcpy(bytes, &value, sizeof(T)); };
+    const SimT scaled = value / this->scale;
+    switch(this->type)
+    {
+    case Type::F32: put(static_cast<float>(scaled)); break;
+    case Type::F64: put(static_cast<double>(scaled)); break;
+    case Type::U8: put(static_cast<uint8_t>(std::lround(scaled))); break;
+    case Type::U16: put(static_cast<uint16_t>(std::lround(scaled))); break;
+    case Type::U32: put(static_cast<uint32_t>(std::llround(scaled))); break;
+    case Type::I16: put(static_cast<int16_t>(std::lround(scaled))); break;
+    case Type::I32: put(static_cast<int32_t>(std::lround(scaled))); break;
+    }
+
+    const size_t size = this->getSize();
+    if(this->bigEndian)
+        std::reverse(bytes, bytes + size);
+    std::memcpy(packet + this->offset, bytes, size);
+}
+
+bool PacketLayout::parse(const std::string& text)
+{
+    static const std::pair<const char*, PacketField::Type> types[] =
+    {
+        {"f32", PacketField::Type::F32}, {"f64", PacketField::Type::F64}, {"u8", PacketField::Type::U8},
+        {"u16", PacketField::Type::U16}, {"u32", PacketField::Type::U32}, {"i16", PacketField::Type::I16},
+        {"i32", PacketField::Type::I32},
+    };
+
+    std::istringstream stream(text);
+    std::string item;
+    bool hasRpm = false, hasThrottle = false;
+    while(std::getline(stream, item, ','))
+    {
+        const size_t colon = item.find(':'), at = item.find('@');
+        if(colon == std::string::npos || at == std::string::npos || at < colon)
+            return false;
+
+        const std::string name = item.substr(0, colon);
+        std::string type = item.substr(colon + 1, at - colon - 1);
+        PacketField field;
+        field.bigEndian = type.size() > 2 && type.ends_with("be");
+        if(field.bigEndian)
+            type.resize(type.size() - 2);
+
+        const auto found = std::find_if(std::begin(types), std::end(types),
+            [&type](const auto& entry) { return type == entry.first; });
+        if(found == std::end(types))
+            return false;
+        field.type = found->second;
+
+        // strtoul takes a sign and wraps a negative number, so the offset must start with a digit
+        const char* const offset = item.c_str() + at + 1;
+        if(!std::isdigit(static_cast<unsigned char>(*offset)))
+            return false;
+        char* end = nullptr;
+        const unsigned long long value = std::strtoull(offset, &end, 10);
+        if(value > maxPacketSize - field.getSize())
+            return false;
+        field.offset = static_cast<size_t>(value);
+        if(*end == '*')
+            field.scale = std::strtod(end + 1, &end);
+        if(*end != '\0' || field.scale == 0.0)
+            return false;
+
+        if(name == "rpm")
+        {
+            this->rpm = field;
+            hasRpm = true;
+        }
+        else if(name == "throttle")
+        {
+            this->throttle = field;
+            hasThrottle = true;
+        }
+        else
+            return false;
+    }
+
+    return hasRpm && hasThrottle;
+}
+
+size_t PacketLayout::getPacketSize() const
+{
+    return std::max(this->rpm.offset + this->rpm.getSize(), this->throttle.offset + this->throttle.getSize());
+}
+
+void VehicleFeedStats::print(std::ostream& stream, const SimT outputLatency) const
+{
+    constexpr SimT nsToMs = 1e-6;
+
+    stream << "feed: " << this->receivedCount << " packets, " << this->appliedCount << " applied, " <<
+        this->droppedCount << " dropped, " << this->malformedCount << " malformed, interval " <<
+        this->packetInterval * 1000.0 << " ms, jitter " << this->intervalJitter * 1000.0 << " ms" << std::endl;
+    stream << "packet to audio: mean " << this->latency.getMean() * nsToMs + outputLatency * 1000.0 <<
+        ", p50 " << static_cast<SimT>(this->latency.getPercentile(50.0)) * nsToMs + outputLatency * 1000.0 <<
+        ", p99 " << static_cast<SimT>(this->latency.getPercentile(99.0)) * nsToMs + outputLatency * 1000.0 <<
+        ", max " << static_cast<SimT>(this->latency.max) * nsToMs + outputLatency * 1000.0 <<
+        " ms with " << outputLatency * 1000.0 << " ms of output latency" << std::endl;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+VehicleFeedReceiver::VehicleFeedReceiver(const PacketLayout& layout) :
+    layout(layout),
+    socket(invalidSocket),
+    packets(packetCapacity)
+{
+}
+
+VehicleFeedReceiver::~VehicleFeedReceiver()
+{
+    this->close();
+}
+
+bool VehicleFeedReceiver::open(const uint16_t port, const bool anyInterface)
+{
+    this->close();
+
+    this->socket = openSocket();
+    if(this->socket == invalidSocket)
+    {
+        std::cerr << "cannot create a udp socket" << std::endl;
+        return false;
+    }
+
+    const sockaddr_in address = getAddress(port, anyInterface);
+    if(bind(getHandle(this->socket),
+        reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        std::cerr << "cannot bind udp port " << port << std::endl;
+        closeSocket(this->socket);
+        this->socket = invalidSocket;
+        return false;
+    }
+
+    // the timeout lets the thread notice the stop
+#ifdef _WIN32
+    const DWORD timeout = receiveTimeout;
+#else
+    const timeval timeout = {0, receiveTimeout * 1000};
+#endif
+    setsockopt(getHandle(this->socket), SOL_SOCKET, SO_RCVTIMEO,
+        reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+
+    this->stopping.store(false, std::memory_order_relaxed);
+    this->thread = std::thread(&VehicleFeedReceiver::threadEntryPoint, this);
+    return true;
+}
+
+void VehicleFeedReceiver::close()
+{
+    if(this->thread.joinable())
+    {
+        this->stopping.store(true, std::memory_order_relaxed);
+        this->thread.join();
+    }
+    if(this->socket != invalidSocket)
+    {
+        closeSocket(this->socket);
+        this->socket = invalidSocket;
+    }
+}
+
+bool VehicleFeedReceiver::update()
+{
+    TRACE_SCOPE("VehicleFeedReceiver::update");
+
+    const size_t head = this->head.load(std::memory_order_acquire);
+    size_t tail = this->tail.load(std::memory_order_relaxed);
+    if(tail == head)
+        return false;
+
+    for(; tail != head; tail = (tail + 1) % this->packets.size())
+    {
+        const Packet& packet = this->packets[tail];
+
+        // the first interval starts the smoothing
+        if(this->lastArrivalNs)
+        {
+            const SimT interval = static_cast<SimT>(packet.arrivalNs - this->lastArrivalNs) * 1e-9;
+            if(this->packetInterval == 0.0)
+                this->packetInterval = interval;
+            this->intervalJitter += intervalSmoothing * (std::abs(interval - this->packetInterval) - this->intervalJitter);
+            this->packetInterval += intervalSmoothing * (interval - this->packetInterval);
+        }
+        this->lastArrivalNs = packet.arrivalNs;
+        this->newest = packet;
+    }
+    this->tail.store(tail, std::memory_order_release);
+
+    const uint64_t now = getTimeNs();
+    this->latency.record(now > this->newest.arrivalNs ? now - this->newest.arrivalNs : 0);
+    this->appliedCount.store(this->appliedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    this->sharedInterval.store(this->packetInterval, std::memory_order_relaxed);
+    this->sharedJitter.store(this->intervalJitter, std::memory_order_relaxed);
+    return true;
+}
+
+void VehicleFeedReceiver::apply(Cylinder& cylinder, const SimT frequencyScale) const
+{
+    if(!this->hasPacket())
+        return;
+
+    const SimT duration = std::clamp(this->packetInterval, minRampDuration, maxRampDuration);
+    cylinder.rampFrequency(this->newest.rpm / 120.0 * frequencyScale, duration, ParameterRamp::Shape::Linear);
+    cylinder.rampLoad(std::clamp(this->newest.throttle, 0.0, 1.0), duration, ParameterRamp::Shape::Linear);
+}
+
+VehicleFeedStats VehicleFeedReceiver::getStats() const
+{
+    VehicleFeedStats stats;
+    stats.receivedCount = this->receivedCount.load(std::memory_order_relaxed);
+    stats.appliedCount = this->appliedCount.load(std::memory_order_relaxed);
+    stats.droppedCount = this->droppedCount.load(std::memory_order_relaxed);
+    stats.malformedCount = this->malformedCount.load(std::memory_order_relaxed);
+    stats.packetInterval = this->sharedInterval.load(std::memory_order_relaxed);
+    stats.intervalJitter = this->sharedJitter.load(std::memory_order_relaxed);
+    stats.latency = this->latency.getSnapshot();
+    return stats;
+}
+
+void VehicleFeedReceiver::threadEntryPoint()
+{
+    const size_t packetSize = this->layout.getPacketSize();
+    uint8_t buffer[PacketLayout::maxPacketSize];
+    while(!this->stopping.load(std::memory_order_relaxed))
+    {
+        const auto size = recv(getHandle(this->socket),
+            reinterpret_cast<char*>(buffer), sizeof(buffer), 0);
+        if(size <= 0)
+            continue;
+
+        const uint64_t arrivalNs = getTimeNs();
+        this->receivedCount.fetch_add(1, std::memory_order_relaxed);
+        if(static_cast<size_t>(size) < packetSize)
+        {
+            this->malformedCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        const Packet packet {this->layout.rpm.read(buffer), this->layout.throttle.read(buffer), arrivalNs};
+        if(!std::isfinite(packet.rpm) || !std::isfinite(packet.throttle) || packet.rpm < 0.0)
+        {
+            this->malformedCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        const size_t head = this->head.load(std::memory_order_relaxed);
+        const size_t next = (head + 1) % this->packets.size();
+        if(next == this->tail.load(std::memory_order_acquire))
+        {
+            this->droppedCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        this->packets[head] = packet;
+        this->head.store(next, std::memory_order_release);
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+namespace
+{
+
+struct SenderOptions
+{
+    uint16_t port = 20777;
+    SimT rate = 120.0;
+    // uniform jitter of the send times, in relation to the interval
+    SimT jitter = 0.0;
+    SimT duration = 10.0;
+    // the rpm sweeps between the ends over the period, the throttle follows it
+    SimT fromRpm = 1000.0, toRpm = 6000.0, sweepPeriod = 4.0;
+    PacketLayout layout;
+};
+
+void printSenderUsage()
+{
+    std::cout <<
+        "usage: engine sound feed-send [options]\n"
+        "  --port <port>                      udp port on the loopback, default 20777\n"
+        "  --rate <hz>                        packets per second, default 120\n"
+        "  --jitter <fraction>                random send time shift of the interval, default 0\n"
+        "  --duration <seconds>               default 10, 0 sends until killed\n"
+        "  --rpm <from:to>                    ends of the sweep, default 1000:6000\n"
+        "  --sweep <seconds>                  period of the sweep, default 4\n"
+        "  --layout <fields>                  name:type@offset[*scale],..., default\n"
+        "                                     rpm:f32@0,throttle:f32@4\n";
+}
+
+bool parseSenderOptions(int argc, char* argv[], SenderOptions& options)
+{
+    for(int i = 0; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(i + 1 >= argc)
+        {
+            std::cerr << "missing value of " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if(arg == "--port")
+            options.port = static_cast<uint16_t>(std::atoi(value));
+        else if(arg == "--rate")
+            options.rate = std::atof(value);
+        else if(arg == "--jitter")
+            options.jitter = std::clamp(std::atof(value), 0.0, 1.0);
+        else if(arg == "--duration")
+            options.duration = std::atof(value);
+        else if(arg == "--rpm")
+        {
+            char* end = nullptr;
+            options.fromRpm = std::strtod(value, &end);
+            if(*end != ':')
+            {
+                std::cerr << "invalid rpm range " << value << std::endl;
+                return false;
+            }
+            options.toRpm = std::strtod(end + 1, nullptr);
+        }
+        else if(arg == "--sweep")
+            options.sweepPeriod = std::atof(value);
+        else if(arg == "--layout")
+        {
+            if(!options.layout.parse(value))
+            {
+                std::cerr << "invalid layout " << value << std::endl;
+                return false;
+            }
+        }
+        else
+        {
+            std::cerr << "unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if(options.rate <= 0.0 || options.sweepPeriod <= 0.0 || options.duration < 0.0)
+    {
+        std::cerr << "invalid option value" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+int runFeedSender(int argc, char* argv[])
+{
+    SenderOptions options;
+    if(argc >= 1 && (std::strcmp(argv[0], "--help") == 0 || std::strcmp(argv[0], "-h") == 0))
+    {
+        printSenderUsage();
+        return 0;
+    }
+    if(!parseSenderOptions(argc, argv, options))
+    {
+        printSenderUsage();
+        return 1;
+    }
+
+    const uintptr_t socket = openSocket();
+    if(socket == invalidSocket)
+    {
+        std::cerr << "cannot create a udp socket" << std::endl;
+        return 1;
+    }
+    const sockaddr_in address = getAddress(options.port, false);
+
+    std::cout << "sending " << options.rate << " packets/s to 127.0.0.1:" << options.port << ", " <<
+        options.fromRpm << " to " << options.toRpm << " rpm over " << options.sweepPeriod << " s" << std::endl;
+
+    // the packets are sent on a fixed schedule, the jitter moves each one around its slot
+    std::mt19937 generator{1234};
+    std::uniform_real_distribution<SimT> jitter(-0.5 * options.jitter, 0.5 * options.jitter);
+    std::vector<uint8_t> packet(options.layout.getPacketSize(), 0);
+    const SimT interval = 1.0 / options.rate;
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t sentCount = 0;
+    for(uint64_t index = 0; options.duration == 0.0 || static_cast<SimT>(index) * interval < options.duration; index++)
+    {
+        const SimT time = static_cast<SimT>(index) * interval;
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<SimT>(std::max(0.0, time + jitter(generator) * interval))));
+
+        const SimT sweep = 0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * time / options.sweepPeriod);
+        options.layout.rpm.write(packet.data(), options.fromRpm + sweep * (options.toRpm - options.fromRpm));
+        options.layout.throttle.write(packet.data(), 0.2 + 0.8 * sweep);
+        if(sendto(getHandle(socket), reinterpret_cast<const char*>(packet.data()),
+            static_cast<int>(packet.size()), 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) > 0)
+            sentCount++;
+    }
+
+    closeSocket(socket);
+    std::cout << "sent " << sentCount << " packets" << std::endl;
+    return 0;
+}
\ No newline at end of file
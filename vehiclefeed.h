@@ -0,0 +1,119 @@
+#pragma once
+#include "wave.h"
+#include "telemetry.h"
+#include <atomic>
+#include <vector>
+#include <string>
+#include <thread>
+#include <ostream>
+#include <cstdint>
+
+class Cylinder;
+
+// where a value is in a packet;
+// the value is multiplied by the scale, e.g. 0.01 for a throttle in percent
+struct PacketField
+{
+    enum class Type { F32, F64, U8, U16, U32, I16, I32 };
+
+    Type type = Type::F32;
+    size_t offset = 0;
+    bool bigEndian = false;
+    SimT scale = 1.0;
+
+    size_t getSize() const;
+    SimT read(const uint8_t* packet) const;
+    void write(uint8_t* packet, const SimT value) const;
+};
+
+// layout of the packets of a driving simulator, little endian floats of rpm and throttle by default
+struct PacketLayout
+{
+    // of the receive buffer; the fields must end in it
+    static constexpr size_t maxPacketSize = 2048;
+
+    PacketField rpm {PacketField::Type::F32, 0}, throttle {PacketField::Type::F32, 4};
+
+    // comma separated name:type@offset with an optional *scale, e.g. rpm:f32@0,throttle:u8@8*0.00392;
+    // the types are f32, f64, u8, u16, u32, i16 and i32 with be appended for big endian
+    bool parse(const std::string& text);
+    size_t getPacketSize() const;
+};
+
+// statistics of the received packets
+struct VehicleFeedStats
+{
+    uint64_t receivedCount = 0, appliedCount = 0, droppedCount = 0, malformedCount = 0;
+    // seconds, smoothed
+    SimT packetInterval = 0.0, intervalJitter = 0.0;
+    // nanoseconds from the arrival of a packet to the start of the render of the block that
+    // applies it
+    HistogramSnapshot latency;
+
+    // the output latency of the device is added to the latency for the time to the audio
+    void print(std::ostream& stream, const SimT outputLatency) const;
+};
+
+// receives the rpm and the throttle from a driving simulator over udp on a thread of its own;
+// the packets go to the render thread through a lock free ring and the render thread ramps the
+// cylinder to the newest one over the smoothed interval of the packets, so the values arrive
+// when the next packet is expected and the jitter of the arrivals doesn't step the sound;
+// the packets that come within a block are superseded by the newest of them
+class VehicleFeedReceiver
+{
+public:
+    static constexpr size_t packetCapacity = 1024;
+    // weight of a new interval in the smoothed interval and jitter
+    static constexpr SimT intervalSmoothing = 0.05;
+    // the ramps stay in this range whatever the packets do, seconds
+    static constexpr SimT minRampDuration = 0.001, maxRampDuration = 0.1;
+    // the thread checks for the stop this often while no packets come, milliseconds
+    static constexpr int receiveTimeout = 100;
+public:
+    explicit VehicleFeedReceiver(const PacketLayout& layout);
+    ~VehicleFeedReceiver();
+
+    // binds to the port on the loopback or on every interface and starts the thread
+    bool open(const uint16_t port, const bool anyInterface = false);
+    void close();
+
+    // takes the packets that have arrived;
+    // returns whether there was a new one;
+    // called from the render thread before a block
+    bool update();
+    // ramps the cylinder to the newest packet, the frequency scale spreads the rpm of the voices
+    void apply(Cylinder& cylinder, const SimT frequencyScale = 1.0) const;
+    bool hasPacket() const { return this->appliedCount != 0; }
+
+    VehicleFeedStats getStats() const;
+private:
+    struct Packet
+    {
+        SimT rpm, throttle;
+        uint64_t arrivalNs;
+    };
+
+    const PacketLayout layout;
+    uintptr_t socket;
+    std::thread thread;
+    std::atomic<bool> stopping = false;
+
+    std::vector<Packet> packets;
+    std::atomic<size_t> head = 0, tail = 0;
+    std::atomic<uint64_t> receivedCount = 0, droppedCount = 0, malformedCount = 0;
+
+    // state of the render thread
+    Packet newest = {};
+    uint64_t lastArrivalNs = 0;
+    SimT packetInterval = 0.0, intervalJitter = 0.0;
+    std::atomic<uint64_t> appliedCount = 0;
+    std::atomic<SimT> sharedInterval = 0.0, sharedJitter = 0.0;
+    Histogram latency;
+
+    void threadEntryPoint();
+};
+
+// sends packets of an rpm sweep to the receiver for testing, with an optional jitter of the
+// send times;
+// returns the process exit code
+int runFeedSender(int argc, char* argv[]);
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "vehiclelog.h"
+#include "simulators.h"
+#include <fstream>
+#include <charconv>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+
+#undef max
+#undef min
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string& path)
+{
+    this->close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+    this->file = file;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        this->close();
+        return false;
+    }
+    this->size = static_cast<size_t>(size.QuadPart);
+
+    // an empty file can't be mapped, it's left without data
+    if(this->size)
+    {
+        this->mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(this->mapping)
+            this->data = static_cast<const uint8_t*>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+        if(!this->data)
+        {
+            this->close();
+            return false;
+        }
+    }
+#else
+    this->descriptor = ::open(path.c_str(), O_RDONLY);
+    if(this->descriptor < 0)
+        return false;
+
+    struct stat status;
+    if(fstat(this->descriptor, &status) != 0)
+    {
+        this->close();
+        return false;
+    }
+    this->size = static_cast<size_t>(status.st_size);
+
+    if(this->size)
+    {
+        void* data = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, this->descriptor, 0);
+        if(data == MAP_FAILED)
+        {
+            this->close();
+            return false;
+        }
+        madvise(data, this->size, MADV_SEQUENTIAL);
+        this->data = static_cast<const uint8_t*>(data);
+    }
+#endif
+
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if(this->data)
+        UnmapViewOfFile(this->data);
+    if(this->mapping)
+        CloseHandle(this->mapping);
+    if(this->file)
+        CloseHandle(this->file);
+#else
+    if(this->data)
+        munmap(const_cast<uint8_t*>(this->data), this->size);
+    if(this->descriptor >= 0)
+        ::close(this->descriptor);
+#endif
+
+    this->data = nullptr;
+    this->size = 0;
+    this->file = this->mapping = nullptr;
+    this->descriptor = -1;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+bool VehicleLog::open(const std::string& path)
+{
+    this->path = path;
+    this->position = 0;
+    this->pointCount = 0;
+    this->previous = this->next = VehicleLogPoint{};
+    this->atEnd = true;
+
+    if(!this->file.open(path))
+    {
+        std::cerr << "cannot open " << path << std::endl;
+        return false;
+    }
+    if(!this->readHeader())
+        return false;
+
+    // the replay starts between the first two points
+    if(!this->readPoint(this->next))
+    {
+        std::cerr << path << " has no points" << std::endl;
+        return false;
+    }
+    this->previous = this->next;
+    this->atEnd = !this->readPoint(this->next);
+    if(this->atEnd)
+        this->next = this->previous;
+
+    return true;
+}
+
+bool VehicleLog::writeBinary(const std::string& path, const std::vector<VehicleLogPoint>& points)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(binaryMagic, sizeof(binaryMagic));
+    file.write(reinterpret_cast<const char*>(&binaryVersion), sizeof(binaryVersion));
+    for(const VehicleLogPoint& point : points)
+    {
+        const double values[] = {point.time, point.rpm, point.throttle, point.speed};
+        file.write(reinterpret_cast<const char*>(values), sizeof(values));
+    }
+
+    if(!file)
+    {
+        std::cerr << "cannot write " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+VehicleLogPoint VehicleLog::getPoint(const SimT time)
+{
+    while(!this->atEnd && this->next.time < time)
+    {
+        VehicleLogPoint point;
+        if(!this->readPoint(point))
+            this->atEnd = true;
+        else
+        {
+            this->previous = this->next;
+            this->next = point;
+        }
+    }
+
+    const SimT span = this->next.time - this->previous.time;
+    const SimT weight = span > 0.0 ? std::clamp((time - this->previous.time) / span, 0.0, 1.0) : 1.0;
+    const auto lerp = [weight](const SimT from, const SimT to) { return from + weight * (to - from); };
+
+    return VehicleLogPoint {time, lerp(this->previous.rpm, this->next.rpm),
+        lerp(this->previous.throttle, this->next.throttle), lerp(this->previous.speed, this->next.speed)};
+}
+
+void VehicleLog::apply(Cylinder& cylinder, const SimT time, const SimT duration, const SimT frequencyScale)
+{
+    const VehicleLogPoint point = this->getPoint(time + duration);
+    cylinder.rampFrequency(point.rpm / 120.0 * frequencyScale, duration, ParameterRamp::Shape::Linear);
+    cylinder.rampLoad(std::clamp(point.throttle, 0.0, 1.0), duration, ParameterRamp::Shape::Linear);
+}
+
+bool VehicleLog::readHeader()
+{
+    const char* const data = reinterpret_cast<const char*>(this->file.getData());
+    const size_t size = this->file.getSize();
+
+    if(size >= sizeof(binaryMagic) && std::memcmp(data, binaryMagic, sizeof(binaryMagic)) == 0)
+    {
+        uint32_t version = 0;
+        if(size >= sizeof(binaryMagic) + sizeof(version))
+            std::memcpy(&version, data + sizeof(binaryMagic), sizeof(version));
+        if(version != binaryVersion)
+        {
+            std::cerr << this->path << " is of an unknown binary version" << std::endl;
+            return false;
+        }
+
+        this->binary = true;
+        this->position = sizeof(binaryMagic) + sizeof(version);
+        return true;
+    }
+
+    // the names are matched without case and the spaces around them
+    this->binary = false;
+    this->columns = Columns{};
+    const char* const end = data + size;
+    const char* const lineEnd = std::find(data, end, '\n');
+    for(const char* field = data;; field++)
+    {
+        const char* const fieldEnd = std::find(field, lineEnd, ',');
+        std::string name;
+        for(const char* c = field; c != fieldEnd; c++)
+        {
+            if(!std::isspace(static_cast<unsigned char>(*c)))
+                name.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(*c))));
+        }
+
+        if(name == "time")
+            this->columns.time = this->columns.count;
+        else if(name == "rpm")
+            this->columns.rpm = this->columns.count;
+        else if(name == "throttle")
+            this->columns.throttle = this->columns.count;
+        else if(name == "speed")
+            this->columns.speed = this->columns.count;
+
+        this->columns.count++;
+        field = fieldEnd;
+        if(field == lineEnd)
+            break;
+    }
+
+    if(this->columns.time == SIZE_MAX || this->columns.rpm == SIZE_MAX || this->columns.throttle == SIZE_MAX)
+    {
+        std::cerr << this->path << " has no time, rpm and throttle columns" << std::endl;
+        return false;
+    }
+
+    this->position = static_cast<size_t>(std::min(lineEnd + 1, end) - data);
+    return true;
+}
+
+bool VehicleLog::readPoint(VehicleLogPoint& point)
+{
+    const SimT lastTime = this->pointCount ? this->next.time : -std::numeric_limits<SimT>::infinity();
+    if(!(this->binary ? this->readBinaryPoint(point) : this->readCsvPoint(point)))
+        return false;
+
+    if(!(point.time >= lastTime))
+    {
+        std::cerr << this->path << ": time goes back at point " << this->pointCount << std::endl;
+        this->position = this->file.getSize();
+        return false;
+    }
+
+    this->pointCount++;
+    return true;
+}
+
+bool VehicleLog::readBinaryPoint(VehicleLogPoint& point)
+{
+    double values[4];
+    if(this->file.getSize() - this->position < sizeof(values))
+        return false;
+
+    std::memcpy(values, this->file.getData() + this->position, sizeof(values));
+    this->position += sizeof(values);
+    point = VehicleLogPoint {values[0], values[1], values[2], values[3]};
+    return true;
+}
+
+bool VehicleLog::readCsvPoint(VehicleLogPoint& point)
+{
+    const char* const data = reinterpret_cast<const char*>(this->file.getData());
+    const char* const end = data + this->file.getSize();
+
+    // empty lines are skipped
+    const char* line = data + this->position;
+    while(line < end && (*line == '\n' || *line == '\r'))
+        line++;
+    if(line == end)
+    {
+        this->position = this->file.getSize();
+        return false;
+    }
+
+    const char* const lineEnd = std::find(line, end, '\n');
+    this->position = static_cast<size_t>(std::min(lineEnd + 1, end) - data);
+
+    point = VehicleLogPoint{};
+    size_t column = 0, parsedCount = 0;
+    for(const char* field = line;; field++, column++)
+    {
+        const char* const fieldEnd = std::find(field, lineEnd, ',');
+        SimT* const value =
+            column == this->columns.time ? &point.time :
+            column == this->columns.rpm ? &point.rpm :
+            column == this->columns.throttle ? &point.throttle :
+            column == this->columns.speed ? &point.speed : nullptr;
+        if(value)
+        {
+            const char* first = field;
+            while(first < fieldEnd && *first == ' ')
+                first++;
+            if(std::from_chars(first, fieldEnd, *value).ec != std::errc{})
+                break;
+            parsedCount++;
+        }
+
+        field = fieldEnd;
+        if(field == lineEnd)
+            break;
+    }
+
+    const size_t columnCount = this->columns.speed == SIZE_MAX ? 3 : 4;
+    if(parsedCount != columnCount)
+    {
+        std::cerr << this->path << ": malformed point " << this->pointCount << std::endl;
+        this->position = this->file.getSize();
+        return false;
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+#include "wave.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+class Cylinder;
+
+// read only view of a whole file through the virtual memory;
+// the pages are read in as they are touched and can be dropped by the system again, so a file
+// that is read forward costs no more memory than the pages around the read position
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { this->close(); }
+
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* getData() const { return this->data; }
+    size_t getSize() const { return this->size; }
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    // handles of the file and of the mapping on windows, the descriptor elsewhere
+    void* file = nullptr;
+    void* mapping = nullptr;
+    int descriptor = -1;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+// point of a recorded drive;
+// time in seconds from the start of the log, throttle in range [0, 1] and speed in the unit of
+// the log
+struct VehicleLogPoint
+{
+    SimT time = 0.0, rpm = 0.0, throttle = 0.0, speed = 0.0;
+};
+
+// recorded drive that is replayed to the cylinder, the rpm drives the cycle rate and the throttle
+// the load;
+// csv logs have a header row that names the columns time, rpm, throttle and speed in any order,
+// the speed is optional and the other columns are skipped;
+// binary logs start with the magic and the version, followed by the points as 4 doubles in the
+// order of VehicleLogPoint;
+// the file is mapped and parsed forward as the replay reaches it, so only the two points around
+// the replay time are kept however long the log is;
+// a malformed point ends the log at the point before it
+class VehicleLog
+{
+public:
+    static constexpr char binaryMagic[4] = {'E', 'V', 'L', 'G'};
+    static constexpr uint32_t binaryVersion = 1;
+public:
+    bool open(const std::string& path);
+    static bool writeBinary(const std::string& path, const std::vector<VehicleLogPoint>& points);
+
+    // the point interpolated linearly at the time, the ends are held;
+    // the times may not decrease between the calls
+    VehicleLogPoint getPoint(const SimT time);
+    // ramps the cylinder to the point at the end of the block, so the log is followed exactly at
+    // the block boundaries and linearly per sample between them;
+    // the frequency scale spreads the rpm of the voices
+    void apply(Cylinder& cylinder, const SimT time, const SimT duration, const SimT frequencyScale = 1.0);
+    // whether the time is past the last point
+    bool isFinished(const SimT time) const { return this->atEnd && time >= this->next.time; }
+    bool isBinary() const { return this->binary; }
+    // points parsed so far
+    uint64_t getPointCount() const { return this->pointCount; }
+private:
+    // columns of the csv fields, SIZE_MAX for a missing column
+    struct Columns
+    {
+        size_t time = SIZE_MAX, rpm = SIZE_MAX, throttle = SIZE_MAX, speed = SIZE_MAX;
+        size_t count = 0;
+    };
+
+    std::string path;
+    MappedFile file;
+    bool binary = false;
+    size_t position = 0;
+    Columns columns;
+    VehicleLogPoint previous, next;
+    bool atEnd = true;
+    uint64_t pointCount = 0;
+
+    bool readHeader();
+    // false at the end of the file or at a malformed point
+    bool readPoint(VehicleLogPoint& point);
+    bool readBinaryPoint(VehicleLogPoint& point);
+    bool readCsvPoint(VehicleLogPoint& point);
+};
\ No newline at end of file
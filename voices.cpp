@@ -0,0 +1,212 @@
+#include "voices.h"
+#include "trace.h"
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+
+VoiceManager::VoiceManager(const SimT samplingRate, const size_t workerCount,
+    const WorkStealingPool::ThreadInit& threadInit) :
+    samplingRate(samplingRate),
+    fadeSampleCount(std::max<size_t>(1, static_cast<size_t>(fadeDuration * samplingRate))),
+    pool(workerCount, threadInit),
+    workerBuses(workerCount)
+{
+    this->voiceJob = [this](const size_t job, const size_t worker)
+    {
+        this->renderVoice(job, worker);
+    };
+}
+
+VoiceManager::VoiceId VoiceManager::addVoice()
+{
+    const auto freeVoice = std::find_if(this->voices.begin(), this->voices.end(),
+        [](const std::unique_ptr<Voice>& voice) { return !voice->active; });
+
+    VoiceId id;
+    if(freeVoice == this->voices.end())
+    {
+        id = this->voices.size();
+        this->voices.push_back(std::make_unique<Voice>(this->samplingRate, this->fadeSampleCount));
+    }
+    else
+    {
+        // the slot is recreated so that the voice starts from the default engine
+        id = static_cast<VoiceId>(freeVoice - this->voices.begin());
+        *freeVoice = std::make_unique<Voice>(this->samplingRate, this->fadeSampleCount);
+    }
+
+    Simulation& simulation = this->voices[id]->simulation;
+    if(this->detailPrepared)
+        simulation.prepareDetailTiers();
+    simulation.setDetailCostMeasuring(this->detailCostMeasuring);
+
+    this->order.reserve(this->voices.size());
+    return id;
+}
+
+void VoiceManager::removeVoice(const VoiceId voice)
+{
+    assert(this->voices[voice]->active);
+    this->voices[voice]->active = false;
+}
+
+size_t VoiceManager::getVoiceCount() const
+{
+    return static_cast<size_t>(std::count_if(this->voices.begin(), this->voices.end(),
+        [](const std::unique_ptr<Voice>& voice) { return voice->active; }));
+}
+
+VoiceStats VoiceManager::getStats(const VoiceId voice) const
+{
+    const Voice& v = *this->voices[voice];
+
+    VoiceStats stats;
+    stats.blockCount = v.blockCount.load(std::memory_order_relaxed);
+    stats.skippedBlockCount = v.skippedBlockCount.load(std::memory_order_relaxed);
+    stats.renderTime = static_cast<SimT>(v.renderTimeNs.load(std::memory_order_relaxed)) * 1e-9;
+    stats.lastRenderTime = static_cast<SimT>(v.lastRenderTimeNs.load(std::memory_order_relaxed)) * 1e-9;
+
+    const uint64_t renderedSampleCount = v.renderedSampleCount.load(std::memory_order_relaxed);
+    if(renderedSampleCount)
+        stats.cpuUsage = stats.renderTime * this->samplingRate / static_cast<SimT>(renderedSampleCount);
+
+    return stats;
+}
+
+void VoiceManager::setDetailTier(const size_t tier)
+{
+    for(const auto& voice : this->voices)
+        voice->simulation.setDetailTier(tier);
+}
+
+void VoiceManager::prepareDetailTiers()
+{
+    this->detailPrepared = true;
+    for(const auto& voice : this->voices)
+        voice->simulation.prepareDetailTiers();
+}
+
+void VoiceManager::setDetailCostMeasuring(const bool measuring)
+{
+    this->detailCostMeasuring = measuring;
+    for(const auto& voice : this->voices)
+        voice->simulation.setDetailCostMeasuring(measuring);
+}
+
+SimT VoiceManager::getDetailCost(const size_t tier) const
+{
+    SimT cost = 0.0;
+    for(const auto& voice : this->voices)
+    {
+        if(!voice->active)
+            continue;
+
+        const SimT voiceCost = voice->simulation.getDetailCost(tier);
+        if(voiceCost == 0.0)
+            return 0.0;
+        cost += voiceCost;
+    }
+
+    return cost;
+}
+
+const Wave::SampleContainer& VoiceManager::render(const size_t sampleCount)
+{
+    TRACE_SCOPE("VoiceManager::render");
+
+    this->sampleCount = sampleCount;
+    this->deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<SimT>(
+        this->deadlineFraction * static_cast<SimT>(sampleCount) / this->samplingRate));
+
+    this->order.clear();
+    for(const auto& voice : this->voices)
+    {
+        if(voice->active)
+            this->order.push_back(voice.get());
+    }
+    // the loudest voices are handed out first so that they make the deadline
+    std::sort(this->order.begin(), this->order.end(), [](const Voice* a, const Voice* b)
+    {
+        return a->gain != b->gain ? a->gain > b->gain : a < b;
+    });
+
+    for(auto& bus : this->workerBuses)
+        bus.assign(sampleCount, 0.0);
+
+    this->skippedCount.store(0, std::memory_order_relaxed);
+    this->pool.run(this->order.size(), this->voiceJob);
+
+    this->masterBus.assign(sampleCount, 0.0);
+    for(const auto& bus : this->workerBuses)
+    {
+        for(size_t i = 0; i < sampleCount; i++)
+            this->masterBus[i] += bus[i];
+    }
+
+    this->lastSkippedCount.store(this->skippedCount.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+
+    return this->masterBus;
+}
+
+void VoiceManager::renderVoice(const size_t job, const size_t worker)
+{
+    Voice& voice = *this->order[job];
+    voice.blockCount.fetch_add(1, std::memory_order_relaxed);
+
+    Wave::SampleContainer& bus = this->workerBuses[worker];
+    const auto start = std::chrono::steady_clock::now();
+    if(start >= this->deadline)
+    {
+        voice.skippedBlockCount.fetch_add(1, std::memory_order_relaxed);
+        this->skippedCount.fetch_add(1, std::memory_order_relaxed);
+
+        // the backwards tail starts at the last rendered sample, so the fade out is continuous;
+        // it may span several skipped blocks
+        if(!voice.skipped)
+        {
+            voice.skipped = true;
+            voice.fadeOutPosition = 0;
+        }
+        const size_t fadeCount = std::min(this->sampleCount, this->fadeSampleCount - voice.fadeOutPosition);
+        for(size_t i = 0; i < fadeCount; i++, voice.fadeOutPosition++)
+        {
+            const SimT weight = static_cast<SimT>(this->fadeSampleCount - voice.fadeOutPosition) /
+                static_cast<SimT>(this->fadeSampleCount + 1);
+            bus[i] += voice.gain * weight * voice.tail[this->fadeSampleCount - 1 - voice.fadeOutPosition];
+        }
+        return;
+    }
+
+    // the simulation continues from where it was skipped, so it fades in from the silence
+    if(voice.skipped)
+    {
+        voice.skipped = false;
+        voice.fadeInRemaining = this->fadeSampleCount;
+    }
+
+    const Wave& wave = voice.simulation.progressSimulation(static_cast<SimT>(this->sampleCount));
+    for(size_t i = 0; i < this->sampleCount; i++)
+    {
+        SimT weight = 1.0;
+        if(voice.fadeInRemaining)
+        {
+            weight = static_cast<SimT>(this->fadeSampleCount + 1 - voice.fadeInRemaining) /
+                static_cast<SimT>(this->fadeSampleCount + 1);
+            voice.fadeInRemaining--;
+        }
+        bus[i] += voice.gain * weight * wave.samples[i];
+    }
+
+    const size_t tailCount = std::min(this->sampleCount, this->fadeSampleCount);
+    std::copy(voice.tail.begin() + tailCount, voice.tail.end(), voice.tail.begin());
+    const auto blockEnd = wave.samples.begin() + this->sampleCount;
+    std::copy(blockEnd - tailCount, blockEnd, voice.tail.end() - tailCount);
+
+    const uint64_t renderTimeNs = static_cast<uint64_t>(std::chrono::nanoseconds(
+        std::chrono::steady_clock::now() - start).count());
+    voice.lastRenderTimeNs.store(renderTimeNs, std::memory_order_relaxed);
+    voice.renderTimeNs.fetch_add(renderTimeNs, std::memory_order_relaxed);
+    voice.renderedSampleCount.fetch_add(this->sampleCount, std::memory_order_relaxed);
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+#include "simulation.h"
+#include "pool.h"
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+// cpu accounting of one voice
+struct VoiceStats
+{
+    uint64_t blockCount = 0;
+    // blocks that were not rendered because the deadline had passed
+    uint64_t skippedBlockCount = 0;
+    // seconds
+    SimT renderTime = 0.0, lastRenderTime = 0.0;
+    // render time in relation to the rendered duration, 1 is a whole core
+    SimT cpuUsage = 0.0;
+};
+
+// hosts many independent engines and mixes them to a master bus;
+// the voices of a block are rendered in parallel on a work stealing pool, the loudest first;
+// voices that haven't been started when the deadline of the block has passed are skipped for
+// that block, so an overload drops the quietest voices instead of the whole output;
+// a skipped voice fades out over its last rendered samples played backwards, so that it doesn't
+// click, and its simulation stays where it was; the next rendered block of it fades back in
+class VoiceManager
+{
+public:
+    using VoiceId = size_t;
+    // fraction of the block duration that the voices may use by default;
+    // the rest is left for the mixing and the device
+    static constexpr SimT defaultDeadlineFraction = 0.8;
+    // seconds of the fade out of a skipped voice and the fade in when it is rendered again
+    static constexpr SimT fadeDuration = 0.005;
+public:
+    const SimT samplingRate;
+    const size_t fadeSampleCount;
+
+    // the calling thread of render is one of the workers;
+    // the thread init is run at the start of the other workers
+    VoiceManager(const SimT samplingRate, const size_t workerCount,
+        const WorkStealingPool::ThreadInit& threadInit = {});
+
+    // the voices are added and removed between the renders;
+    // ids of removed voices are reused
+    VoiceId addVoice();
+    void removeVoice(const VoiceId voice);
+    size_t getVoiceCount() const;
+    // the simulation of the voice is configured through this between the renders
+    Simulation& getSimulation(const VoiceId voice) { return this->voices[voice]->simulation; }
+    // gain of the voice on the master bus, also its priority
+    void setGain(const VoiceId voice, const SimT gain) { this->voices[voice]->gain = gain; }
+    SimT getGain(const VoiceId voice) const { return this->voices[voice]->gain; }
+    // the stats can be read from any thread
+    VoiceStats getStats(const VoiceId voice) const;
+
+    // applies the detail tier to every voice
+    void setDetailTier(const size_t tier);
+    // see Simulation::prepareDetailTiers and Simulation::setDetailCostMeasuring;
+    // also applied to the voices that are added later
+    void prepareDetailTiers();
+    void setDetailCostMeasuring(const bool measuring);
+    // sum of the measured costs of the tier over the voices, 0 if some voice hasn't rendered it
+    SimT getDetailCost(const size_t tier) const;
+
+    void setDeadlineFraction(const SimT fraction) { this->deadlineFraction = fraction; }
+    // renders sample count samples of every voice;
+    // returns the master bus
+    const Wave::SampleContainer& render(const size_t sampleCount);
+
+    const WorkStealingPool& getPool() const { return this->pool; }
+    // voices that were skipped in the last render
+    size_t getLastSkippedCount() const { return this->lastSkippedCount.load(std::memory_order_relaxed); }
+private:
+    struct Voice
+    {
+        Simulation simulation;
+        SimT gain = 1.0;
+        bool active = true;
+
+        // written by the worker that renders the voice
+        std::atomic<uint64_t> blockCount = 0, skippedBlockCount = 0, renderedSampleCount = 0;
+        std::atomic<uint64_t> renderTimeNs = 0, lastRenderTimeNs = 0;
+
+        // last rendered samples without the gain, the newest at the end;
+        // the fade out plays them from the end and the fade in counts down the remaining samples
+        Wave::SampleContainer tail;
+        bool skipped = false;
+        size_t fadeOutPosition = 0, fadeInRemaining = 0;
+
+        Voice(const SimT samplingRate, const size_t fadeSampleCount) :
+            simulation(samplingRate), tail(fadeSampleCount, 0.0) {}
+    };
+
+    std::vector<std::unique_ptr<Voice>> voices;
+    // render order of the active voices
+    std::vector<Voice*> order;
+    WorkStealingPool pool;
+    SimT deadlineFraction = defaultDeadlineFraction;
+    bool detailPrepared = false, detailCostMeasuring = false;
+
+    // one bus per worker so that the mixing doesn't need synchronization
+    std::vector<Wave::SampleContainer> workerBuses;
+    Wave::SampleContainer masterBus;
+
+    // state of the render in progress;
+    // the job is created once so that dispatching it doesn't allocate
+    WorkStealingPool::Job voiceJob;
+    std::chrono::steady_clock::time_point deadline;
+    size_t sampleCount = 0;
+    std::atomic<size_t> skippedCount = 0, lastSkippedCount = 0;
+
+    void renderVoice(const size_t job, const size_t worker);
+};
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include "wallloss.h"
+#include "simulators.h"
+#include <cmath>
+#include <numbers>
+#include <complex>
+#include <algorithm>
+#include <utility>
+#include <mutex>
+#include <atomic>
+
+SimT WallLossFilter::getAttenuation(const Pipe& pipe)
+{
+    // the viscous boundary layer takes 1 / (r c) sqrt(w eta / 2 rho) nepers per meter and the thermal
+    // one (gamma - 1) / sqrt(Pr) of that, with gamma = 1.4 and Pr = 0.71;
+    // sqrt(w eta / 2 rho) = sqrt(pi eta / rho) sqrt(f)
+    constexpr SimT thermalLossFactor = 0.4747;
+
+    const size_t segmentCount = std::max<size_t>(1, pipe.getTemperatures().size());
+    const SimT segmentLength = pipe.getPipePhysicalLength() / static_cast<SimT>(segmentCount);
+    SimT attenuation = 0.0;
+    for(size_t i = 0; i < segmentCount; i++)
+    {
+        const SimT position = (static_cast<SimT>(i) + 0.5) / static_cast<SimT>(segmentCount);
+        const SimT density = pipe.getDensity(position);
+        const SimT viscosity = getAirViscosity(pipe.getTemperature(position));
+        attenuation += segmentLength / (pipe.getPipeRadius() * pipe.getWaveSpeed(position)) *
+            std::sqrt(std::numbers::pi * viscosity / density) * (1.0 + thermalLossFactor);
+    }
+
+    // there and back
+    return 2.0 * attenuation;
+}
+
+void WallLossFilter::prepare(const SimT samplingRate)
+{
+    getGainTable(samplingRate);
+}
+
+void WallLossFilter::design(const SimT samplingRate, const SimT attenuation, const SimT frequency)
+{
+    if(samplingRate == this->samplingRate && attenuation == this->attenuation && frequency == this->frequency)
+        return;
+    this->samplingRate = samplingRate;
+    this->attenuation = attenuation;
+    this->frequency = frequency;
+    for(size_t i = 0; i < sectionCount; i++)
+        this->setShelf(i, 0.25 * samplingRate, 0.0);
+    this->delay = 0.0;
+    if(attenuation <= 0.0)
+        return;
+
+    // the db response of the target is proportional to the attenuation and the one of a shelf
+    // close to proportional to its gain, so the gains are interpolated linearly between the points;
+    // an attenuation beyond the table is fitted on the spot
+    SimT gains[sectionCount];
+    const GainTable* table = getGainTable(samplingRate);
+    if(table && attenuation < maxTableAttenuation)
+    {
+        size_t point = static_cast<size_t>(std::sqrt(attenuation / maxTableAttenuation) *
+            static_cast<SimT>(gainTableLength - 1));
+        point = std::min(point, gainTableLength - 2);
+        const SimT start = getTableAttenuation(point), end = getTableAttenuation(point + 1);
+        const SimT fraction = std::clamp((attenuation - start) / (end - start), 0.0, 1.0);
+        const auto& startGains = table->gains[point];
+        const auto& endGains = table->gains[point + 1];
+        for(size_t i = 0; i < sectionCount; i++)
+            gains[i] = startGains[i] + fraction * (endGains[i] - startGains[i]);
+    }
+    else
+        this->fit(attenuation, gains);
+
+    for(size_t i = 0; i < sectionCount; i++)
+        this->setShelf(i, getCorner(samplingRate, i), gains[i]);
+
+    // the engines take the delay off the length, so the physical delay stays in the loop
+    const SimT phase = -std::arg(this->getResponse(frequency)) - attenuation * std::sqrt(frequency);
+    this->delay = phase / (2.0 * std::numbers::pi * frequency / samplingRate);
+}
+
+const WallLossFilter::GainTable* WallLossFilter::getGainTable(const SimT samplingRate)
+{
+    // the tables are only appended, so a published table can be read without the lock
+    static std::atomic<const GainTable*> tables[maxGainTableCount] = {};
+    static std::atomic<size_t> tableCount = 0;
+    static std::mutex mutex;
+
+    const auto find = [samplingRate]() -> const GainTable*
+    {
+        const size_t count = tableCount.load(std::memory_order_acquire);
+        for(size_t i = 0; i < count; i++)
+        {
+            const GainTable* table = tables[i].load(std::memory_order_relaxed);
+            if(table->samplingRate == samplingRate)
+                return table;
+        }
+        return nullptr;
+    };
+    if(const GainTable* table = find())
+        return table;
+
+    const std::lock_guard lock{mutex};
+    if(const GainTable* table = find())
+        return table;
+    const size_t count = tableCount.load(std::memory_order_relaxed);
+    if(count == maxGainTableCount)
+        return nullptr;
+
+    GainTable* table = new GainTable;
+    table->samplingRate = samplingRate;
+    WallLossFilter filter;
+    filter.samplingRate = samplingRate;
+    table->gains[0].fill(0.0);
+    for(size_t point = 1; point < gainTableLength; point++)
+        filter.fit(getTableAttenuation(point), table->gains[point].data());
+
+    tables[count].store(table, std::memory_order_relaxed);
+    tableCount.store(count + 1, std::memory_order_release);
+    return table;
+}
+
+SimT WallLossFilter::getTableAttenuation(const size_t point)
+{
+    const SimT position = static_cast<SimT>(point) / static_cast<SimT>(gainTableLength - 1);
+    return maxTableAttenuation * position * position;
+}
+
+SimT WallLossFilter::getCorner(const SimT samplingRate, const size_t section)
+{
+    // the corners are spread evenly in octaves over the band of the fit
+    const SimT minFrequency = 20.0, maxFrequency = 0.45 * samplingRate;
+    return minFrequency * std::pow(maxFrequency / minFrequency,
+        (static_cast<SimT>(section) + 0.5) / static_cast<SimT>(sectionCount));
+}
+
+void WallLossFilter::fit(const SimT attenuation, SimT gains[sectionCount])
+{
+    // the fit points are spread evenly in octaves over the band;
+    // the db response of a shelf is close to proportional to its gain, so the gains are the least
+    // squares solution of the responses of the shelves for the last gains, which is repeated a few
+    // times for the small nonlinearity
+    constexpr size_t pointCount = 64, iterationCount = 4;
+    const SimT minFrequency = 20.0, maxFrequency = 0.45 * this->samplingRate;
+    SimT corners[sectionCount];
+    for(size_t i = 0; i < sectionCount; i++)
+    {
+        corners[i] = getCorner(this->samplingRate, i);
+        gains[i] = -1.0;
+    }
+    SimT frequencies[pointCount], targets[pointCount];
+    for(size_t m = 0; m < pointCount; m++)
+    {
+        frequencies[m] = minFrequency * std::pow(maxFrequency / minFrequency,
+            static_cast<SimT>(m) / static_cast<SimT>(pointCount - 1));
+        targets[m] = 20.0 * std::log10(std::exp(-attenuation * std::sqrt(frequencies[m])));
+    }
+
+    for(size_t iteration = 0; iteration < iterationCount; iteration++)
+    {
+        SimT basis[sectionCount][pointCount];
+        for(size_t i = 0; i < sectionCount; i++)
+        {
+            // a gain of zero has no shape, so the shape of a small cut stands for it
+            const SimT gain = std::abs(gains[i]) > 1e-3 ? gains[i] : -1e-3;
+            this->setShelf(i, corners[i], gain);
+            for(size_t m = 0; m < pointCount; m++)
+                basis[i][m] = 20.0 * std::log10(std::abs(this->getSectionResponse(i, frequencies[m]))) / gain;
+        }
+
+        // normal equations, solved with gaussian elimination
+        SimT matrix[sectionCount][sectionCount + 1] = {};
+        for(size_t i = 0; i < sectionCount; i++)
+        {
+            for(size_t m = 0; m < pointCount; m++)
+            {
+                for(size_t j = 0; j < sectionCount; j++)
+                    matrix[i][j] += basis[i][m] * basis[j][m];
+                matrix[i][sectionCount] += basis[i][m] * targets[m];
+            }
+        }
+        for(size_t i = 0; i < sectionCount; i++)
+        {
+            size_t pivot = i;
+            for(size_t j = i + 1; j < sectionCount; j++)
+            {
+                if(std::abs(matrix[j][i]) > std::abs(matrix[pivot][i]))
+                    pivot = j;
+            }
+            std::swap(matrix[i], matrix[pivot]);
+            for(size_t j = i + 1; j < sectionCount; j++)
+            {
+                const SimT factor = matrix[j][i] / matrix[i][i];
+                for(size_t k = i; k <= sectionCount; k++)
+                    matrix[j][k] -= factor * matrix[i][k];
+            }
+        }
+        for(size_t i = sectionCount; i-- > 0;)
+        {
+            SimT sum = matrix[i][sectionCount];
+            for(size_t j = i + 1; j < sectionCount; j++)
+                sum -= matrix[i][j] * gains[j];
+            gains[i] = sum / matrix[i][i];
+        }
+    }
+}
+
+SimT WallLossFilter::getTargetMagnitude(const SimT frequency) const
+{
+    return std::exp(-this->attenuation * std::sqrt(frequency));
+}
+
+std::complex<SimT> WallLossFilter::getResponse(const SimT frequency) const
+{
+    std::complex<SimT> response = 1.0;
+    for(size_t i = 0; i < sectionCount; i++)
+        response *= this->getSectionResponse(i, frequency);
+
+    return response;
+}
+
+void WallLossFilter::process(State& state, SimT* samples, const size_t sampleCount) const
+{
+    for(size_t i = 0; i < sampleCount; i++)
+        samples[i] = this->process(state, samples[i]);
+}
+
+void WallLossFilter::setSteadyState(State& state, const std::complex<SimT> input, const SimT frequency) const
+{
+    // the input of a section is the output of the previous one a step before;
+    // s2[n] = b2 x[n] - a2 y[n], s1[n] = b1 x[n] - a1 y[n] + s2[n-1]
+    const std::complex<SimT> delay = std::polar(1.0, -2.0 * std::numbers::pi * frequency / this->samplingRate);
+    std::complex<SimT> sectionInput = input;
+    for(size_t i = 0; i < sectionCount; i++)
+    {
+        const std::complex<SimT> output = this->getSectionResponse(i, frequency) * sectionInput;
+        const std::complex<SimT> s2 = this->b2[i] * sectionInput - this->a2[i] * output;
+        state.s2[i] = std::imag(s2);
+        state.s1[i] = std::imag(this->b1[i] * sectionInput - this->a1[i] * output + s2 * delay);
+        state.outputs[i] = std::imag(output);
+        sectionInput = output * delay;
+    }
+}
+
+void WallLossFilter::setShelf(const size_t section, const SimT corner, const SimT gainDb)
+{
+    // high shelf of the audio eq cookbook with a slope of 1
+    const SimT a = std::pow(10.0, gainDb / 40.0);
+    const SimT w0 = 2.0 * std::numbers::pi * corner / this->samplingRate;
+    const SimT cosine = std::cos(w0);
+    const SimT alpha = std::sin(w0) / std::numbers::sqrt2;
+    const SimT root = 2.0 * std::sqrt(a) * alpha;
+
+    const SimT a0 = (a + 1.0) - (a - 1.0) * cosine + root;
+    this->b0[section] = a * ((a + 1.0) + (a - 1.0) * cosine + root) / a0;
+    this->b1[section] = -2.0 * a * ((a - 1.0) + (a + 1.0) * cosine) / a0;
+    this->b2[section] = a * ((a + 1.0) + (a - 1.0) * cosine - root) / a0;
+    this->a1[section] = 2.0 * ((a - 1.0) - (a + 1.0) * cosine) / a0;
+    this->a2[section] = ((a + 1.0) - (a - 1.0) * cosine - root) / a0;
+}
+
+std::complex<SimT> WallLossFilter::getSectionResponse(const size_t section, const SimT frequency) const
+{
+    const std::complex<SimT> z = std::polar(1.0, -2.0 * std::numbers::pi * frequency / this->samplingRate);
+    return (this->b0[section] + this->b1[section] * z + this->b2[section] * z * z) /
+        (1.0 + this->a1[section] * z + this->a2[section] * z * z);
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+#include "wave.h"
+#include <complex>
+#include <array>
+#include <cstddef>
+
+class Pipe;
+
+// viscothermal loss of the walls of a pipe over a round trip, lumped to one filter at the open end;
+// the boundary layers at the walls take exp(-k sqrt(f)) of the wave, where k follows from the
+// length, the radius and the temperatures of the pipe;
+// fitted with a cascade of high shelves, whose sections run in the lanes of a vector with a sample
+// between them, so the whole cascade is one vector step per sample and its output is latency
+// samples late;
+// the latency is taken off the length of the pipe by the engines;
+// the fit is done ahead over a range of the attenuation per sampling rate and interpolated,
+// so that the filter can follow the temperatures of every block
+class WallLossFilter
+{
+public:
+    static constexpr size_t sectionCount = 4;
+    static constexpr size_t latency = sectionCount - 1;
+    // fitted attenuations of the table, a 5 mm pipe of 10 m at 600 c has about 0.17;
+    // the points are closer at the low attenuations where the fit bends the most
+    static constexpr size_t gainTableLength = 64;
+    static constexpr SimT maxTableAttenuation = 0.2;
+    // sampling rates that have a table, the others are fitted on the spot
+    static constexpr size_t maxGainTableCount = 16;
+
+    // state of a filtered stream
+    struct State
+    {
+        // outputs of the sections of the last step, the inputs of the next sections
+        SimT outputs[sectionCount] = {};
+        SimT s1[sectionCount] = {}, s2[sectionCount] = {};
+    };
+public:
+    // k of exp(-k sqrt(f)) over a round trip of the pipe
+    static SimT getAttenuation(const Pipe& pipe);
+    // fits the table of the sampling rate if it hasn't been yet, which takes a few milliseconds;
+    // design does it at the first use of the rate
+    static void prepare(const SimT samplingRate);
+
+    // trivially copyable, the engines keep copies of the filter and save them to the snapshots
+
+    // the delay is fitted at the frequency, e.g. the fundamental of the pipe
+    void design(const SimT samplingRate, const SimT attenuation, const SimT frequency);
+    SimT getAttenuation() const { return this->attenuation; }
+    // exp(-k sqrt(f)) that the cascade is fitted to
+    SimT getTargetMagnitude(const SimT frequency) const;
+    SimT getMagnitude(const SimT frequency) const { return std::abs(this->getResponse(frequency)); }
+    // of the cascade without the latency
+    std::complex<SimT> getResponse(const SimT frequency) const;
+    // phase delay of the cascade in samples at the frequency of the design, without the latency and
+    // the delay of the boundary layers themselves, which slow the wave by as many radians as they
+    // take nepers
+    SimT getDelay() const { return this->delay; }
+
+    // returns the output of the sample latency samples ago
+    SimT process(State& state, const SimT sample) const
+    {
+        SimT inputs[sectionCount];
+        inputs[0] = sample;
+        for(size_t i = 1; i < sectionCount; i++)
+            inputs[i] = state.outputs[i - 1];
+
+        // transposed direct form 2
+        for(size_t i = 0; i < sectionCount; i++)
+        {
+            const SimT output = this->b0[i] * inputs[i] + state.s1[i];
+            state.s1[i] = this->b1[i] * inputs[i] - this->a1[i] * output + state.s2[i];
+            state.s2[i] = this->b2[i] * inputs[i] - this->a2[i] * output;
+            state.outputs[i] = output;
+        }
+
+        return state.outputs[sectionCount - 1];
+    }
+    // in place
+    void process(State& state, SimT* samples, const size_t sampleCount) const;
+    // the state after the last input of the sine Im(x e^jwn) at n = 0
+    void setSteadyState(State& state, const std::complex<SimT> input, const SimT frequency) const;
+private:
+    // gains of the shelves in db per attenuation of the table
+    struct GainTable
+    {
+        SimT samplingRate;
+        std::array<SimT, sectionCount> gains[gainTableLength];
+    };
+
+    SimT samplingRate = 0.0, attenuation = 0.0, frequency = 0.0, delay = 0.0;
+    // normalized by a0; a pass through until designed
+    alignas(32) SimT b0[sectionCount] = {1.0, 1.0, 1.0, 1.0};
+    alignas(32) SimT b1[sectionCount] = {}, b2[sectionCount] = {};
+    alignas(32) SimT a1[sectionCount] = {}, a2[sectionCount] = {};
+
+    // the tables are kept for the lifetime of the process and found without a lock;
+    // nullptr if there are too many rates
+    static const GainTable* getGainTable(const SimT samplingRate);
+    static SimT getTableAttenuation(const size_t point);
+    static SimT getCorner(const SimT samplingRate, const size_t section);
+    // least squares fit of the gains in db, the shelves are left at the last iteration
+    void fit(const SimT attenuation, SimT gains[sectionCount]);
+    // high shelf of the gain in db at the corner
+    void setShelf(const size_t section, const SimT corner, const SimT gainDb);
+    std::complex<SimT> getSectionResponse(const size_t section, const SimT frequency) const;
+};
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "watchdog.h"
+#include "trace.h"
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+
+void WatchdogEvent::print(std::ostream& stream) const
+{
+    stream << this->time << " s: block " << this->block << " missed" <<
+        (this->late ? ", earlier block still rendering" : "") <<
+        ", run " << this->missRun << ", loop " << this->loopLength <<
+        " samples, correlation " << this->loopCorrelation << std::endl;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+DeadlineWatchdog::DeadlineWatchdog(const SimT samplingRate, const ThreadInit& threadInit) :
+    samplingRate(samplingRate),
+    history(historyLength, 0.0),
+    events(eventCapacity)
+{
+    static_assert(maxLoopLength + loopWindowLength <= historyLength);
+
+    this->loop.reserve(maxLoopLength);
+    this->thread = std::thread(&DeadlineWatchdog::threadEntryPoint, this, threadInit);
+}
+
+DeadlineWatchdog::~DeadlineWatchdog()
+{
+    this->finish();
+
+    this->stopping.store(true, std::memory_order_relaxed);
+    this->requested.release();
+    this->thread.join();
+}
+
+const Wave::SampleContainer& DeadlineWatchdog::render(const Job& job, const size_t sampleCount)
+{
+    TRACE_SCOPE("DeadlineWatchdog::render");
+
+    const auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<SimT>(
+        this->deadlineFraction * static_cast<SimT>(sampleCount) / this->samplingRate));
+
+    // the late block continues the samples of the next one, so it only goes to the history
+    if(this->pending && this->finished.try_acquire())
+    {
+        this->pending = false;
+        this->appendHistory(*this->result);
+    }
+
+    const bool late = this->pending;
+    if(!late)
+    {
+        this->job = &job;
+        this->jobSampleCount = sampleCount;
+        this->pending = true;
+        this->requested.release();
+
+        if(this->finished.try_acquire_until(deadline))
+        {
+            this->pending = false;
+
+            const Wave::SampleContainer& samples = *this->result;
+            assert(samples.size() == sampleCount);
+            this->output.assign(samples.begin(), samples.end());
+            this->appendHistory(samples);
+
+            if(this->missRun)
+            {
+                const size_t crossfadeSampleCount = std::min(sampleCount,
+                    static_cast<size_t>(crossfadeDuration * this->samplingRate));
+                for(size_t i = 0; i < crossfadeSampleCount; i++)
+                {
+                    const SimT weight = static_cast<SimT>(i + 1) / static_cast<SimT>(crossfadeSampleCount + 1);
+                    const SimT loopSample = this->getLoopSample();
+                    this->output[i] = loopSample + weight * (this->output[i] - loopSample);
+                }
+                this->missRun = 0;
+            }
+
+            this->blockCount++;
+            this->outputSampleCount += sampleCount;
+            return this->output;
+        }
+    }
+
+    this->renderFallback(sampleCount, late);
+    return this->output;
+}
+
+void DeadlineWatchdog::finish()
+{
+    if(!this->pending)
+        return;
+
+    this->finished.acquire();
+    this->pending = false;
+}
+
+void DeadlineWatchdog::drainEvents(std::vector<WatchdogEvent>& events)
+{
+    const size_t head = this->head.load(std::memory_order_acquire);
+    size_t tail = this->tail.load(std::memory_order_relaxed);
+    for(; tail != head; tail = (tail + 1) % this->events.size())
+        events.push_back(this->events[tail]);
+
+    this->tail.store(tail, std::memory_order_release);
+}
+
+void DeadlineWatchdog::threadEntryPoint(const ThreadInit threadInit)
+{
+    TRACE_THREAD();
+    if(threadInit)
+        threadInit();
+
+    for(;;)
+    {
+        this->requested.acquire();
+        if(this->stopping.load(std::memory_order_relaxed))
+            break;
+
+        {
+            TRACE_SCOPE("DeadlineWatchdog::job");
+            this->result = &(*this->job)(this->jobSampleCount);
+        }
+        this->finished.release();
+    }
+}
+
+void DeadlineWatchdog::appendHistory(const Wave::SampleContainer& samples)
+{
+    const size_t count = std::min(samples.size(), historyLength);
+    std::copy(this->history.begin() + count, this->history.end(), this->history.begin());
+    std::copy(samples.end() - count, samples.end(), this->history.end() - count);
+}
+
+void DeadlineWatchdog::findLoop()
+{
+    TRACE_SCOPE("DeadlineWatchdog::findLoop");
+
+    // the window at the end of the history is compared with the window one loop length earlier;
+    // the energy of the earlier window slides along with the loop length
+    const SimT* end = this->history.data() + historyLength;
+    const SimT* window = end - loopWindowLength;
+
+    SimT windowEnergy = 0.0, candidateEnergy = 0.0;
+    for(size_t i = 0; i < loopWindowLength; i++)
+    {
+        windowEnergy += window[i] * window[i];
+        candidateEnergy += window[i - minLoopLength] * window[i - minLoopLength];
+    }
+
+    size_t bestLength = minLoopLength;
+    SimT bestCorrelation = -1.0;
+    for(size_t length = minLoopLength; length <= maxLoopLength; length++)
+    {
+        const SimT* candidate = window - length;
+        if(length > minLoopLength)
+        {
+            const SimT entering = candidate[0], leaving = candidate[loopWindowLength];
+            candidateEnergy = std::max(0.0, candidateEnergy + entering * entering - leaving * leaving);
+        }
+
+        SimT product = 0.0;
+        for(size_t i = 0; i < loopWindowLength; i++)
+            product += window[i] * candidate[i];
+
+        const SimT energy = windowEnergy * candidateEnergy;
+        const SimT correlation = energy > 0.0 ? product / std::sqrt(energy) : 0.0;
+        if(correlation > bestCorrelation)
+        {
+            bestCorrelation = correlation;
+            bestLength = length;
+        }
+    }
+
+    // the loop starts where the end of the history would continue
+    this->loop.assign(end - bestLength, end);
+    this->loopCorrelation = bestCorrelation;
+    this->loopPosition = 0;
+}
+
+SimT DeadlineWatchdog::getLoopSample()
+{
+    const SimT sample = this->loop[this->loopPosition];
+    this->loopPosition = (this->loopPosition + 1) % this->loop.size();
+    return sample;
+}
+
+void DeadlineWatchdog::renderFallback(const size_t sampleCount, const bool late)
+{
+    TRACE_SCOPE("DeadlineWatchdog::renderFallback");
+
+    // the loop is kept over a run of misses so that it continues seamlessly
+    if(this->missRun == 0)
+        this->findLoop();
+    this->missRun++;
+    this->missCount.fetch_add(1, std::memory_order_relaxed);
+
+    this->output.resize(sampleCount);
+    for(size_t i = 0; i < sampleCount; i++)
+        this->output[i] = this->getLoopSample();
+
+    this->log(WatchdogEvent {static_cast<SimT>(this->outputSampleCount) / this->samplingRate,
+        this->blockCount, late, this->missRun, this->loop.size(), this->loopCorrelation});
+
+    this->blockCount++;
+    this->outputSampleCount += sampleCount;
+}
+
+void DeadlineWatchdog::log(const WatchdogEvent& event)
+{
+    const size_t head = this->head.load(std::memory_order_relaxed);
+    const size_t next = (head + 1) % this->events.size();
+    if(next == this->tail.load(std::memory_order_acquire))
+    {
+        this->droppedEventCount.store(
+            this->droppedEventCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    this->events[head] = event;
+    this->head.store(next, std::memory_order_release);
+}
\ No newline at end of file
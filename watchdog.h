@@ -0,0 +1,110 @@
+#pragma once
+#include "wave.h"
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <semaphore>
+#include <functional>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+// block that wasn't rendered by its deadline
+struct WatchdogEvent
+{
+    // seconds of output
+    SimT time;
+    uint64_t block;
+    // the render of an earlier block was still running, so this one wasn't started
+    bool late;
+    // missed blocks in a row including this one
+    uint64_t missRun;
+    // the loop that was played instead, in samples, and the similarity of its ends in range
+    // [-1, 1]
+    size_t loopLength;
+    SimT loopCorrelation;
+
+    void print(std::ostream& stream) const;
+};
+
+// runs the render of each block on its own thread and waits for it until the deadline;
+// a block that misses the deadline is replaced with a loop cut from the last rendered samples
+// at the period that matches best, so the output keeps sounding instead of going silent;
+// the late render is let to finish and its samples only go to the history, the next rendered block
+// is crossfaded in from the loop;
+// the render thread of the caller is the only one that calls render, the misses are logged
+// to a ring that any one thread can drain
+class DeadlineWatchdog
+{
+public:
+    // renders sample count samples and returns them, valid until the next call
+    using Job = std::function<const Wave::SampleContainer&(size_t sampleCount)>;
+
+    // fraction of the block duration that the render may take by default;
+    // the rest is left for the fallback and the device
+    static constexpr SimT defaultDeadlineFraction = 0.8;
+    static constexpr size_t historyLength = 4096;
+    // range of the loop lengths that are searched and the compared length at the end of the history
+    static constexpr size_t minLoopLength = 32, maxLoopLength = 2048, loopWindowLength = 128;
+    // seconds of the crossfade from the loop back to the rendered blocks
+    static constexpr SimT crossfadeDuration = 0.005;
+    static constexpr size_t eventCapacity = 256;
+public:
+    const SimT samplingRate;
+
+    // called at the start of the thread, e.g. for the realtime setup
+    using ThreadInit = std::function<void()>;
+
+    explicit DeadlineWatchdog(const SimT samplingRate, const ThreadInit& threadInit = {});
+    ~DeadlineWatchdog();
+
+    void setDeadlineFraction(const SimT fraction) { this->deadlineFraction = fraction; }
+    // renders the block with the job or the fallback if the job misses the deadline;
+    // the job may still be running after this has returned, see isBusy
+    const Wave::SampleContainer& render(const Job& job, const size_t sampleCount);
+    // whether a late job may still be using the state that it renders;
+    // called from the render thread
+    bool isBusy() const { return this->pending; }
+    // whether the last block was the fallback
+    bool isFallback() const { return this->missRun != 0; }
+    // waits for the late job
+    void finish();
+
+    uint64_t getMissCount() const { return this->missCount.load(std::memory_order_relaxed); }
+    void drainEvents(std::vector<WatchdogEvent>& events);
+    uint64_t getDroppedEventCount() const { return this->droppedEventCount.load(std::memory_order_relaxed); }
+private:
+    std::thread thread;
+    std::binary_semaphore requested{0}, finished{0};
+    std::atomic<bool> stopping = false;
+    SimT deadlineFraction = defaultDeadlineFraction;
+
+    // state of the job in flight, written by the caller before requesting it and by the thread
+    // before finishing it
+    const Job* job = nullptr;
+    size_t jobSampleCount = 0;
+    const Wave::SampleContainer* result = nullptr;
+    bool pending = false;
+
+    // last rendered samples, the newest at the end
+    Wave::SampleContainer history;
+    Wave::SampleContainer output;
+    // loop of the fallback in progress, cut from the end of the history at the last miss
+    Wave::SampleContainer loop;
+    size_t loopPosition = 0;
+    SimT loopCorrelation = 0.0;
+    uint64_t blockCount = 0, missRun = 0;
+    uint64_t outputSampleCount = 0;
+    std::atomic<uint64_t> missCount = 0;
+
+    std::vector<WatchdogEvent> events;
+    std::atomic<size_t> head = 0, tail = 0;
+    std::atomic<uint64_t> droppedEventCount = 0;
+
+    void threadEntryPoint(const ThreadInit threadInit);
+    void appendHistory(const Wave::SampleContainer& samples);
+    void findLoop();
+    SimT getLoopSample();
+    void renderFallback(const size_t sampleCount, const bool late);
+    void log(const WatchdogEvent& event);
+};
\ No newline at end of file
@@ -1,11 +1,20 @@
 #pragma once
 #include <vector>
 #include <type_traits>
+#include <cmath>
+#include <cstddef>
 
 class Simulation;
 using SimT = double;
 
 constexpr SimT waveSpeed = 340.6520; // speed of sound in air at 15 c
+constexpr SimT referenceTemperature = 15.0, zeroCelsius = 273.15;
+
+// speed of sound at the temperature in celsius;
+// the exhaust gas is taken as air, so the speed grows with the square root of the absolute
+// temperature
+inline SimT getWaveSpeed(const SimT temperature)
+{ return waveSpeed * std::sqrt((temperature + zeroCelsius) / (referenceTemperature + zeroCelsius)); }
 
 class Wave
 {
@@ -1,4 +1,5 @@
 #include "window.h"
+#include "trace.h"
 #include <cassert>
 #include <string>
 
@@ -9,60 +10,6 @@
 
 extern CAppModule module_;
 
-// TODO: this is somewhat broken
-const int simSampleRateRatio = 1;
-
-inline void CHECK_HR(const HRESULT hr)
-{
-    if(FAILED(hr))
-    {
-        std::cout << std::hex << "0x" << hr << std::endl;
-        system("pause");
-        abort();
-    }
-}
-
-// returns if the buffer is just silence
-bool populateAudioBuffer(
-    const Wave& wave,
-    BYTE* const audioBuffer,
-    const UINT32 bufferFrameCount,
-    const WAVEFORMATEX* const mixFormat)
-{
-    assert(wave.samples.size() == bufferFrameCount * simSampleRateRatio);
-
-    // find the peak value and normalize in relation to that
-    SimT peakValue = 0.0001 * 1000.0;
-    const SimT normalizedPeakValue = 0.2;
-    /*for(auto val : wave.samples)
-    {
-        val -= atmosphericPressure;
-        peakValue = std::max(peakValue, std::abs(val));
-    }*/
-    const SimT normalizationFactor = normalizedPeakValue / peakValue;
-
-    for(UINT32 frame = 0; frame < bufferFrameCount; frame++)
-    {
-        float* const samplePtr =
-            reinterpret_cast<float* const>(audioBuffer + frame * mixFormat->nBlockAlign);
-        for(WORD channel = 0; channel < mixFormat->nChannels; channel++)
-        {
-            samplePtr[channel] = static_cast<float>(
-                (wave.samples[frame * simSampleRateRatio]) *
-                normalizationFactor);
-
-            if(samplePtr[channel] > normalizedPeakValue)
-                samplePtr[channel] = static_cast<float>(normalizedPeakValue);
-            if(samplePtr[channel] < -normalizedPeakValue)
-                samplePtr[channel] = -static_cast<float>(normalizedPeakValue);
-        }
-        /*std::cout << samplePtr[0] << std::endl;*/
-    }
-
-    return !std::isnormal(normalizationFactor);
-}
-
-
 LRESULT ControlDlg::OnInitDialog(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled)
 {
     this->startButton.Attach(this->GetDlgItem(IDC_STARTBUTTON));
@@ -255,6 +202,7 @@ void ControlDlg::setPipeRadiusPos(const int newSliderPos, const bool updateText)
 void ControlDlg::startAudioRenderAndSimulationThread()
 {
     assert(!this->simulationThread);
+    this->audioBackend.reset(new WasapiBackend);
     this->simulationThread.reset(new std::thread {&ControlDlg::simulationThreadEntryPoint, this});
 }
 
@@ -262,92 +210,24 @@ void ControlDlg::stopAudioRenderAndSimulationThread()
 {
     assert(this->simulationThread);
 
-    this->runSimulation = false;
+    this->audioBackend->stop();
     this->simulationThread->join();
 }
 
 void ControlDlg::simulationThreadEntryPoint()
 {
-    // debug flag
-    const DWORD force_silence = 0; AUDCLNT_BUFFERFLAGS_SILENT;
-    ///
-
-    HRESULT hr = S_OK;
-    CComPtr<IMMDeviceEnumerator> enumerator;
-    CComPtr<IMMDevice> device;
-    CComPtr<IAudioClient> audioClient;
-    WAVEFORMATEX* mixFormat = nullptr;
-    UINT32 bufferFrameCount;
-    CComPtr<IAudioRenderClient> renderClient;
-    BYTE* audioBuffer;
-
-    CHECK_HR(hr = CoInitialize(nullptr));
-
-    // create audio client
-    CHECK_HR(hr = CoCreateInstance(
-        __uuidof(MMDeviceEnumerator), nullptr,
-        CLSCTX_ALL, __uuidof(IMMDeviceEnumerator), (void**)&enumerator));
-    CHECK_HR(hr = enumerator->GetDefaultAudioEndpoint(eRender, eConsole, &device));
-    CHECK_HR(hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)&audioClient));
-    CHECK_HR(hr = audioClient->GetMixFormat(&mixFormat));
-    CHECK_HR(hr = audioClient->Initialize(AUDCLNT_SHAREMODE_SHARED, 0, 0, 0, mixFormat, nullptr));
-    CHECK_HR(hr = audioClient->GetBufferSize(&bufferFrameCount));
-
-    if(mixFormat->wBitsPerSample != 32)
-        CHECK_HR(hr = E_UNEXPECTED);
-
-    CHECK_HR(hr = audioClient->GetService(__uuidof(IAudioRenderClient), (void**)&renderClient));
-
-    // set the initial buffer
-    CHECK_HR(hr = renderClient->GetBuffer(bufferFrameCount, &audioBuffer));
-
-    const SimT simSampleRate = static_cast<SimT>(mixFormat->nSamplesPerSec * simSampleRateRatio);
-    Simulation simulation{simSampleRate};
+    Renderer renderer{*this->audioBackend};
+    if(!renderer.open(AudioFormat {}))
+        return;
 
-    this->checkAndApplyParameters(simulation);
-    const Wave& wave = simulation.progressSimulation(
-        static_cast<SimT>(bufferFrameCount * simSampleRateRatio));
-
-    const bool silence = populateAudioBuffer(wave, audioBuffer, bufferFrameCount, mixFormat);
-    const DWORD flags = silence ? AUDCLNT_BUFFERFLAGS_SILENT : 0;
-
-    CHECK_HR(hr = renderClient->ReleaseBuffer(bufferFrameCount, flags | force_silence));
-    CHECK_HR(hr = audioClient->Start());
-
-    while(this->runSimulation)
-    {
-        UINT32 numFramesPadding;
-        CHECK_HR(hr = audioClient->GetCurrentPadding(&numFramesPadding));
-
-        const UINT32 numFramesAvailable = bufferFrameCount - numFramesPadding;
-        if(numFramesAvailable)
-        {
-            this->checkAndApplyParameters(simulation);
-
-            const Wave& wave = simulation.progressSimulation(
-                static_cast<SimT>(numFramesAvailable * simSampleRateRatio));
-
-            CHECK_HR(hr = renderClient->GetBuffer(numFramesAvailable, &audioBuffer));
-
-            const bool silence =
-                populateAudioBuffer(wave, audioBuffer, numFramesAvailable, mixFormat);
-            const DWORD flags = silence ? AUDCLNT_BUFFERFLAGS_SILENT : 0;
-
-            CHECK_HR(hr = renderClient->ReleaseBuffer(numFramesAvailable, flags | force_silence));
-        }
-        else
-        {
-            // yield
-            Sleep(0);
-        }
-    }
-
-    CoTaskMemFree(mixFormat);
-    CoUninitialize();
+    renderer.run([this](Simulation& simulation, uint64_t) { this->checkAndApplyParameters(simulation); });
+    renderer.close();
 }
 
 void ControlDlg::checkAndApplyParameters(Simulation& simulation)
 {
+    TRACE_SCOPE("ControlDlg::checkAndApplyParameters");
+
     const bool generateInputSound = this->generateInputSound;
     const int inputSoundFrequency = this->inputSoundFrequency;
     const int echoIterations = this->echoIterations;
@@ -359,7 +239,9 @@ void ControlDlg::checkAndApplyParameters(Simulation& simulation)
     else
         simulation.cylinder.stop();
 
-    simulation.cylinder.setFrequency(inputSoundFrequency);
+    // the slider moves in steps, so the frequency glides to them instead of jumping per buffer
+    if(simulation.cylinder.getControls().frequency.getTarget() != inputSoundFrequency)
+        simulation.cylinder.rampFrequency(inputSoundFrequency, frequencyGlideDuration);
     if(simulation.pipe.getEchoIterations() != echoIterations)
         simulation.pipe.setEchoIterationsAndReset(echoIterations);
     if(std::lround(simulation.pipe.getPipePhysicalLength() * 100.0) != pipeLengthCm)
@@ -4,8 +4,8 @@
 #include "wave.h"
 #include "simulation.h"
 #include "simulators.h"
-#include <Audioclient.h>
-#include <mmdeviceapi.h>
+#include "backends.h"
+#include "renderer.h"
 #include <thread>
 #include <memory>
 #include <atomic>
@@ -14,6 +14,8 @@ class ControlDlg final : public CDialogImpl<ControlDlg>
 {
 public:
     enum { IDD = IDD_CONTROLDLG };
+    // seconds that the frequency glides to a new position of the slider
+    static constexpr SimT frequencyGlideDuration = 0.05;
 
     BEGIN_MSG_MAP(ControlDlg)
         MESSAGE_HANDLER(WM_INITDIALOG, OnInitDialog)
@@ -52,7 +54,7 @@ private:
     // audio/simulation thread stuff below
 
     std::unique_ptr<std::thread> simulationThread;
-    std::atomic_bool runSimulation = true;
+    std::unique_ptr<AudioBackend> audioBackend;
     std::atomic_bool generateInputSound = true;
     std::atomic_int inputSoundFrequency = static_cast<int>(Cylinder::startFrequency);
     std::atomic_int echoIterations = static_cast<int>(Pipe::startEchoIterations);